@@ -0,0 +1,835 @@
+#include "ConvolutionReverb.h"
+#include <juce_dsp/juce_dsp.h>
+#include <cmath>
+#include <thread>
+
+//==============================================================================
+namespace
+{
+    // acc += a * b over interleaved (re, im) bins
+    void multiplyAdd (float* acc, const float* a, const float* b, int numBins) noexcept
+    {
+        for (int k = 0; k < 2 * numBins; k += 2)
+        {
+            const float ar = a[k], ai = a[k + 1];
+            const float br = b[k], bi = b[k + 1];
+            acc[k]     += ar * br - ai * bi;
+            acc[k + 1] += ar * bi + ai * br;
+        }
+    }
+
+    // Whatever the FFT backend does about scaling, undo it
+    float measureInverseScale (const juce::dsp::FFT& fft)
+    {
+        std::vector<float> work ((size_t) fft.getSize() * 2, 0.0f);
+        work[0] = 1.0f;
+        fft.performRealOnlyForwardTransform (work.data(), true);
+        fft.performRealOnlyInverseTransform (work.data());
+        return work[0] != 0.0f ? 1.0f / work[0] : 1.0f;
+    }
+
+    // Offline windowed-sinc resampling of a whole impulse response. The
+    // cutoff follows the lower of the two rates so downsampling doesn't alias.
+    juce::AudioBuffer<float> resample (const juce::AudioBuffer<float>& in, double fromRate, double toRate)
+    {
+        constexpr int zeroCrossings = 16;
+
+        const double ratio = fromRate / toRate;
+        const double cutoff = 0.95 * juce::jmin (1.0, 1.0 / ratio);
+        const double halfWidth = zeroCrossings / cutoff;   // input samples
+        const int numIn = in.getNumSamples();
+        const int numOut = (int) std::ceil (numIn / ratio);
+
+        juce::AudioBuffer<float> out (in.getNumChannels(), numOut);
+
+        for (int ch = 0; ch < in.getNumChannels(); ++ch)
+        {
+            const auto* src = in.getReadPointer (ch);
+            auto* dst = out.getWritePointer (ch);
+
+            for (int n = 0; n < numOut; ++n)
+            {
+                const double centre = n * ratio;
+                const int first = juce::jmax (0, (int) std::ceil (centre - halfWidth));
+                const int last  = juce::jmin (numIn - 1, (int) std::floor (centre + halfWidth));
+                double sum = 0.0;
+
+                for (int i = first; i <= last; ++i)
+                {
+                    const double t = (i - centre) * cutoff;
+                    const double x = juce::MathConstants<double>::pi * t;
+                    const double sinc = std::abs (t) < 1.0e-9 ? 1.0 : std::sin (x) / x;
+
+                    // Blackman over the kernel's width
+                    const double w = 0.5 + 0.5 * (i - centre) / halfWidth;
+                    const double window = 0.42 - 0.5 * std::cos (juce::MathConstants<double>::twoPi * w)
+                                        + 0.08 * std::cos (2.0 * juce::MathConstants<double>::twoPi * w);
+
+                    sum += src[i] * sinc * window;
+                }
+
+                dst[n] = (float) (sum * cutoff);
+            }
+        }
+
+        return out;
+    }
+}
+
+//==============================================================================
+// One impulse response at one sample rate, with all the convolution state
+// for it. Built on the loader thread; process() runs on the audio thread and
+// serviceTail() on the worker.
+class ConvolutionReverb::Engine
+{
+public:
+    static constexpr int ringBlocks = 4;
+
+    Engine (const juce::AudioBuffer<float>& ir, double rate, int channelCount)
+        : sampleRate (rate),
+          length (ir.getNumSamples()),
+          numChannels (channelCount),
+          irChannels (ir.getNumChannels()),
+          tailSize (chooseTailSize (rate)),
+          midFFT (juce::roundToInt (std::log2 (2 * headSize))),
+          tailFFT (juce::roundToInt (std::log2 (2 * tailSize)))
+    {
+        const int tailStart = 2 * tailSize;
+
+        numMid  = juce::jlimit (0, (tailStart - headSize) / headSize, (length - 1) / headSize);
+        numTail = juce::jmax (0, (length - tailStart + tailSize - 1) / tailSize);
+
+        midScale  = measureInverseScale (midFFT);
+        tailScale = measureInverseScale (tailFFT);
+
+        // Partition spectra, per IR channel
+        head.assign ((size_t) (irChannels * headSize), 0.0f);
+        midSpectra.assign ((size_t) (irChannels * numMid * midSpectrumSize()), 0.0f);
+        tailSpectra.assign ((size_t) (irChannels * numTail * tailSpectrumSize()), 0.0f);
+
+        std::vector<float> work;
+
+        for (int ch = 0; ch < irChannels; ++ch)
+        {
+            const auto* h = ir.getReadPointer (ch);
+
+            for (int i = 0; i < juce::jmin (headSize, length); ++i)
+                head[(size_t) (ch * headSize + i)] = h[i];
+
+            auto partition = [&] (juce::dsp::FFT& fft, int offset, int size, float* dest)
+            {
+                work.assign ((size_t) fft.getSize() * 2, 0.0f);
+
+                for (int i = 0; i < size && offset + i < length; ++i)
+                    work[(size_t) i] = h[offset + i];
+
+                fft.performRealOnlyForwardTransform (work.data(), true);
+                std::copy (work.begin(), work.begin() + fft.getSize() + 2, dest);
+            };
+
+            for (int p = 0; p < numMid; ++p)
+                partition (midFFT, headSize * (p + 1), headSize, midSpectrum (midSpectra, ch * numMid + p));
+
+            for (int p = 0; p < numTail; ++p)
+                partition (tailFFT, tailStart + tailSize * p, tailSize, tailSpectrum (tailSpectra, ch * numTail + p));
+        }
+
+        // Audio thread state
+        channels.resize ((size_t) numChannels);
+
+        for (auto& c : channels)
+        {
+            c.headInput.assign (2 * headSize, 0.0f);
+            c.midInput.assign (2 * headSize, 0.0f);
+            c.midOutput.assign (headSize, 0.0f);
+            c.midHistory.assign ((size_t) (juce::jmax (1, numMid) * midSpectrumSize()), 0.0f);
+            c.tailPrevious.assign ((size_t) tailSize, 0.0f);
+            c.tailHistory.assign ((size_t) (juce::jmax (1, numTail) * tailSpectrumSize()), 0.0f);
+        }
+
+        midWork.assign ((size_t) midFFT.getSize() * 2, 0.0f);
+        tailWork.assign ((size_t) tailFFT.getSize() * 2, 0.0f);
+
+        tailInput.assign ((size_t) (numChannels * ringBlocks * tailSize), 0.0f);
+        tailOutput.assign ((size_t) (numChannels * ringBlocks * tailSize), 0.0f);
+    }
+
+    static int chooseTailSize (double rate) noexcept
+    {
+        int size = baseTailSize;
+
+        while (rate > 48000.0 * 1.01 * size / baseTailSize)
+            size *= 2;
+
+        return size;
+    }
+
+    bool matches (double rate, int channelCount) const noexcept
+    {
+        return sampleRate == rate && numChannels == channelCount;
+    }
+
+    //==============================================================================
+    // ===== Audio thread =====
+    // Restarts from silence. The worker notices the new epoch and clears its
+    // own history.
+    void reset() noexcept
+    {
+        for (auto& c : channels)
+        {
+            std::fill (c.headInput.begin(), c.headInput.end(), 0.0f);
+            std::fill (c.midInput.begin(), c.midInput.end(), 0.0f);
+            std::fill (c.midOutput.begin(), c.midOutput.end(), 0.0f);
+            std::fill (c.midHistory.begin(), c.midHistory.end(), 0.0f);
+        }
+
+        midFill = midHead = 0;
+        tailFill = 0;
+        blocksPosted = 0;
+        tailReady = false;
+
+        epoch = (epoch + 1) & epochMask;
+        posted.store (tag (epoch), std::memory_order_release);
+    }
+
+    // Overwrites wet with the convolution of in and wakes tailWorker for every
+    // block it posts. Returns the number of tail blocks that missed their
+    // deadline; with waitForTail there are none.
+    int process (const float* const* in, float* const* wet, int numCh, int numSamples,
+                 juce::Thread& tailWorker, bool waitForTail) noexcept
+    {
+        numCh = juce::jmin (numCh, numChannels);
+        int missed = 0;
+
+        for (int pos = 0; pos < numSamples;)
+        {
+            // The tail output for this block was computed from the block two
+            // before it; it's used only if it's ready as the block starts
+            if (tailFill == 0 && numTail > 0)
+            {
+                const auto m = blocksPosted - 2;
+                const auto done = completed.load (std::memory_order_acquire);
+
+                tailReady = m >= 0 && (done >> epochShift) == epoch && (juce::int64) (done & countMask) > m;
+
+                if (m >= 0 && ! tailReady)
+                    ++missed;
+            }
+
+            const int n = juce::jmin (numSamples - pos, headSize - midFill, tailSize - tailFill);
+            const int slot = (int) (blocksPosted % ringBlocks);
+
+            for (int ch = 0; ch < numCh; ++ch)
+            {
+                auto& c = channels[(size_t) ch];
+                const auto* x = in[ch] + pos;
+                auto* y = wet[ch] + pos;
+                const float* h = head.data() + (size_t) (irChannelFor (ch) * headSize);
+
+                // Head: y[i] = sum h[k] x[i - k], one vector multiply-add per tap
+                std::copy (x, x + n, c.headInput.data() + headSize);
+                juce::FloatVectorOperations::multiply (y, c.headInput.data() + headSize, h[0], n);
+
+                for (int k = 1; k < headSize; ++k)
+                    juce::FloatVectorOperations::addWithMultiply (y, c.headInput.data() + headSize - k, h[k], n);
+
+                std::copy (c.headInput.data() + n, c.headInput.data() + n + headSize, c.headInput.data());
+
+                // Mid: output of the previous headSize block
+                juce::FloatVectorOperations::add (y, c.midOutput.data() + midFill, n);
+                std::copy (x, x + n, c.midInput.data() + headSize + midFill);
+
+                // Tail
+                if (numTail > 0)
+                {
+                    auto* ring = tailInput.data() + (size_t) ((ch * ringBlocks + slot) * tailSize);
+                    std::copy (x, x + n, ring + tailFill);
+
+                    if (tailReady)
+                    {
+                        const auto m = (int) ((blocksPosted - 2) % ringBlocks);
+                        const auto* out = tailOutput.data() + (size_t) ((ch * ringBlocks + m) * tailSize);
+                        juce::FloatVectorOperations::add (y, out + tailFill, n);
+                    }
+                }
+            }
+
+            pos += n;
+            midFill += n;
+            tailFill += n;
+
+            if (midFill == headSize)
+            {
+                for (int ch = 0; ch < numCh; ++ch)
+                    runMidBlock (ch);
+
+                midHead = numMid > 0 ? (midHead + 1) % numMid : 0;
+                midFill = 0;
+            }
+
+            if (tailFill == tailSize)
+            {
+                ++blocksPosted;
+                posted.store (tag (epoch) | (juce::uint64) blocksPosted, std::memory_order_release);
+                tailFill = 0;
+
+                if (numTail > 0)
+                    tailWorker.notify();
+
+                if (waitForTail && numTail > 0)
+                    waitForWorker();
+            }
+        }
+
+        return missed;
+    }
+
+    //==============================================================================
+    // ===== Worker thread =====
+    // Handles the oldest posted block; returns false when there was nothing to do
+    bool serviceTail() noexcept
+    {
+        if (numTail == 0)
+            return false;
+
+        const auto p = posted.load (std::memory_order_acquire);
+        const auto postedEpoch = (juce::uint32) (p >> epochShift);
+        const auto count = (juce::int64) (p & countMask);
+
+        if (postedEpoch != workerEpoch)
+        {
+            for (auto& c : channels)
+            {
+                std::fill (c.tailPrevious.begin(), c.tailPrevious.end(), 0.0f);
+                std::fill (c.tailHistory.begin(), c.tailHistory.end(), 0.0f);
+            }
+
+            workerEpoch = postedEpoch;
+            processed = 0;
+            tailHead = 0;
+        }
+
+        if (processed >= count)
+            return false;
+
+        const auto m = processed;
+        const int slot = (int) (m % ringBlocks);
+
+        // Block m + ringBlocks reuses block m's input slot. Give up on the
+        // input a block before the audio thread gets there.
+        const bool overrun = count - m >= ringBlocks - 1;
+
+        // Past the deadline the output would never be heard: only keep the
+        // history up to date
+        const bool late = overrun || count > m + 1;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& c = channels[(size_t) ch];
+            auto* spectrum = tailSpectrum (c.tailHistory, tailHead);
+
+            if (overrun)
+            {
+                std::fill (spectrum, spectrum + tailSpectrumSize(), 0.0f);
+                std::fill (c.tailPrevious.begin(), c.tailPrevious.end(), 0.0f);
+                continue;
+            }
+
+            const auto* block = tailInput.data() + (size_t) ((ch * ringBlocks + slot) * tailSize);
+
+            std::fill (tailWork.begin(), tailWork.end(), 0.0f);
+            std::copy (c.tailPrevious.begin(), c.tailPrevious.end(), tailWork.begin());
+            std::copy (block, block + tailSize, tailWork.begin() + tailSize);
+            std::copy (block, block + tailSize, c.tailPrevious.begin());
+
+            tailFFT.performRealOnlyForwardTransform (tailWork.data(), true);
+            std::copy (tailWork.begin(), tailWork.begin() + tailSpectrumSize(), spectrum);
+
+            if (late)
+                continue;
+
+            std::fill (tailWork.begin(), tailWork.end(), 0.0f);
+            const int irCh = irChannelFor (ch);
+
+            for (int j = 0; j < numTail; ++j)
+                multiplyAdd (tailWork.data(),
+                             tailSpectrum (c.tailHistory, (tailHead - j + numTail) % numTail),
+                             tailSpectrum (tailSpectra, irCh * numTail + j),
+                             tailSize + 1);
+
+            tailFFT.performRealOnlyInverseTransform (tailWork.data());
+
+            auto* out = tailOutput.data() + (size_t) ((ch * ringBlocks + slot) * tailSize);
+            juce::FloatVectorOperations::multiply (out, tailWork.data() + tailSize, tailScale, tailSize);
+        }
+
+        tailHead = (tailHead + 1) % numTail;
+        processed = m + 1;
+
+        if (! late)
+            completed.store (tag (workerEpoch) | (juce::uint64) processed, std::memory_order_release);
+
+        return true;
+    }
+
+    double getSeconds() const noexcept   { return length / sampleRate; }
+
+private:
+    // Blocks until the worker has computed every posted block, so an offline
+    // render never misses a deadline and its output doesn't depend on thread
+    // timing. Gives up after a second in case the worker isn't running.
+    void waitForWorker() const noexcept
+    {
+        const auto start = juce::Time::getMillisecondCounter();
+
+        for (;;)
+        {
+            const auto done = completed.load (std::memory_order_acquire);
+
+            if ((done >> epochShift) == epoch && (juce::int64) (done & countMask) >= blocksPosted)
+                return;
+
+            if (juce::Time::getMillisecondCounter() - start > 1000)
+                return;
+
+            std::this_thread::yield();
+        }
+    }
+
+    static constexpr int epochShift = 40;
+    static constexpr juce::uint32 epochMask = 0xffffff;
+    static constexpr juce::uint64 countMask = (juce::uint64 (1) << epochShift) - 1;
+
+    static juce::uint64 tag (juce::uint32 e) noexcept   { return (juce::uint64) (e & epochMask) << epochShift; }
+
+    int midSpectrumSize() const noexcept    { return 2 * headSize + 2; }
+    int tailSpectrumSize() const noexcept   { return 2 * tailSize + 2; }
+
+    float* midSpectrum (std::vector<float>& v, int index) noexcept    { return v.data() + (size_t) (index * midSpectrumSize()); }
+    float* tailSpectrum (std::vector<float>& v, int index) noexcept   { return v.data() + (size_t) (index * tailSpectrumSize()); }
+
+    int irChannelFor (int ch) const noexcept   { return juce::jmin (ch, irChannels - 1); }
+
+    void runMidBlock (int ch) noexcept
+    {
+        auto& c = channels[(size_t) ch];
+
+        if (numMid == 0)
+        {
+            std::copy (c.midInput.begin() + headSize, c.midInput.end(), c.midInput.begin());
+            return;
+        }
+
+        std::fill (midWork.begin(), midWork.end(), 0.0f);
+        std::copy (c.midInput.begin(), c.midInput.end(), midWork.begin());
+        std::copy (c.midInput.begin() + headSize, c.midInput.end(), c.midInput.begin());
+
+        midFFT.performRealOnlyForwardTransform (midWork.data(), true);
+        std::copy (midWork.begin(), midWork.begin() + midSpectrumSize(), midSpectrum (c.midHistory, midHead));
+
+        std::fill (midWork.begin(), midWork.end(), 0.0f);
+        const int irCh = irChannelFor (ch);
+
+        for (int j = 0; j < numMid; ++j)
+            multiplyAdd (midWork.data(),
+                         midSpectrum (c.midHistory, (midHead - j + numMid) % numMid),
+                         midSpectrum (midSpectra, irCh * numMid + j),
+                         headSize + 1);
+
+        midFFT.performRealOnlyInverseTransform (midWork.data());
+        juce::FloatVectorOperations::multiply (c.midOutput.data(), midWork.data() + headSize, midScale, headSize);
+    }
+
+    const double sampleRate;
+    const int length;
+    const int numChannels, irChannels, tailSize;
+    int numMid = 0, numTail = 0;
+
+    juce::dsp::FFT midFFT, tailFFT;
+    float midScale = 1.0f, tailScale = 1.0f;
+
+    std::vector<float> head, midSpectra, tailSpectra;
+
+    struct Channel
+    {
+        // audio thread
+        std::vector<float> headInput;     // last headSize inputs, then the segment
+        std::vector<float> midInput;      // previous and current headSize block
+        std::vector<float> midOutput;
+        std::vector<float> midHistory;    // numMid input spectra, newest at midHead
+
+        // worker thread
+        std::vector<float> tailPrevious;
+        std::vector<float> tailHistory;   // numTail input spectra, newest at tailHead
+    };
+
+    std::vector<Channel> channels;
+
+    // audio thread
+    std::vector<float> midWork;
+    int midFill = 0, midHead = 0;
+    int tailFill = 0;
+    juce::int64 blocksPosted = 0;
+    bool tailReady = false;
+    juce::uint32 epoch = 0;
+
+    // worker thread
+    std::vector<float> tailWork;
+    juce::int64 processed = 0;
+    int tailHead = 0;
+    juce::uint32 workerEpoch = 0;
+
+    // audio <-> worker: ringBlocks blocks of tailSize per channel each way
+    std::vector<float> tailInput, tailOutput;
+    std::atomic<juce::uint64> posted { 0 };      // epoch << 40 | blocks posted
+    std::atomic<juce::uint64> completed { 0 };   // epoch << 40 | blocks computed in time
+
+    JUCE_DECLARE_NON_COPYABLE (Engine)
+};
+
+//==============================================================================
+ConvolutionReverb::ConvolutionReverb() = default;
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    stopTimer();
+    buildGeneration.fetch_add (1);
+
+    if (loader != nullptr)
+        loader->removeAllJobs (true, 4000);
+
+    stopWorker();
+
+    delete pending.exchange (nullptr);
+    delete current;
+    freeRetired();
+}
+
+void ConvolutionReverb::startWorker()
+{
+    if (! worker.isThreadRunning())
+        worker.startThread (juce::Thread::Priority::high);
+}
+
+void ConvolutionReverb::stopWorker()
+{
+    worker.signalThreadShouldExit();
+    worker.notify();
+    worker.stopThread (2000);
+}
+
+void ConvolutionReverb::timerCallback()
+{
+    if (workerWanted)
+    {
+        stopTimer();
+        return;
+    }
+
+    if (active.load (std::memory_order_acquire) != nullptr || pending.load() != nullptr)
+        return;
+
+    // The audio thread retired the engine before it cleared `active`, and
+    // with the worker gone nothing else reads the queue
+    stopTimer();
+    stopWorker();
+    freeRetired();
+}
+
+//==============================================================================
+void ConvolutionReverb::prepare (double sampleRate, int maxBlockSize, int numChannels)
+{
+    // Nothing else touches the engines while the worker is stopped
+    stopWorker();
+
+    delete pending.exchange (nullptr);
+    delete current;
+    current = nullptr;
+    active.store (nullptr);
+    freeRetired();
+    clearPending.store (false);
+
+    preparedRate = sampleRate;
+    preparedChannels = numChannels;
+    wetBuffer.setSize (juce::jmax (1, numChannels), maxBlockSize);
+    swapStep = (float) (1.0 / (swapFadeSeconds * sampleRate));
+    swapGain = 1.0f;
+    mix = targetMix;
+    missedDeadlines.store (0);
+
+    std::shared_ptr<const Source> s;
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        s = source;
+    }
+
+    if (workerWanted || s != nullptr)
+        startWorker();
+
+    if (s != nullptr)
+        startBuild (s);
+}
+
+juce::Result ConvolutionReverb::loadImpulseResponse (const juce::File& file)
+{
+    if (std::unique_ptr<juce::AudioFormatReader> (formats->createReaderFor (file)) == nullptr)
+        return juce::Result::fail ("Can't read " + file.getFileName() + " as audio");
+
+    workerWanted = true;
+
+    if (preparedRate > 0.0)
+        startWorker();
+
+    const auto generation = buildGeneration.fetch_add (1) + 1;
+
+    getLoader().addJob ([this, file, generation]
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader (formats->createReaderFor (file));
+
+        if (reader == nullptr || generation != buildGeneration.load())
+            return;
+
+        const auto maxSamples = (juce::int64) (maxImpulseSeconds * reader->sampleRate);
+        const int length = (int) juce::jmin (reader->lengthInSamples, maxSamples);
+        const int irChannels = (int) juce::jlimit (1u, 2u, reader->numChannels);
+
+        auto s = std::make_shared<Source>();
+        s->samples.setSize (irChannels, length);
+        s->sampleRate = reader->sampleRate;
+        reader->read (&s->samples, 0, length, 0, true, irChannels > 1);
+
+        {
+            const juce::ScopedLock sl (sourceLock);
+            source = s;
+        }
+
+        startBuild (s);
+    });
+
+    return juce::Result::ok();
+}
+
+void ConvolutionReverb::clearImpulseResponse()
+{
+    buildGeneration.fetch_add (1);
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        source.reset();
+    }
+
+    delete pending.exchange (nullptr);
+    clearPending.store (true, std::memory_order_release);
+
+    workerWanted = false;
+    startTimer (100);
+}
+
+// Created from the message thread by the first load; the loader thread only
+// calls this once it exists
+juce::ThreadPool& ConvolutionReverb::getLoader()
+{
+    if (loader == nullptr)
+        loader = std::make_unique<juce::ThreadPool> (1);
+
+    return *loader;
+}
+
+//==============================================================================
+// Loader thread (or the message thread from prepare). Resamples, trims the
+// silent end, normalises to unit energy and partitions.
+void ConvolutionReverb::startBuild (std::shared_ptr<const Source> s)
+{
+    const double rate = preparedRate;
+    const int numChannels = preparedChannels;
+
+    // Not prepared yet: prepare() builds it
+    if (rate <= 0.0 || numChannels <= 0)
+        return;
+
+    const auto generation = buildGeneration.fetch_add (1) + 1;
+
+    getLoader().addJob ([this, s, generation, rate, numChannels]
+    {
+        auto ir = s->sampleRate == rate ? s->samples : resample (s->samples, s->sampleRate, rate);
+
+        // Trim everything after the last sample above -90 dB
+        int length = 0;
+
+        for (int ch = 0; ch < ir.getNumChannels(); ++ch)
+        {
+            const auto* d = ir.getReadPointer (ch);
+
+            for (int i = ir.getNumSamples(); --i >= length;)
+                if (std::abs (d[i]) > 3.0e-5f)
+                {
+                    length = i + 1;
+                    break;
+                }
+        }
+
+        double energy = 0.0;
+
+        for (int ch = 0; ch < ir.getNumChannels(); ++ch)
+            for (int i = 0; i < length; ++i)
+                energy += ir.getSample (ch, i) * ir.getSample (ch, i);
+
+        if (length == 0 || energy <= 0.0 || generation != buildGeneration.load())
+            return;
+
+        juce::AudioBuffer<float> trimmed (ir.getArrayOfWritePointers(), ir.getNumChannels(), length);
+        trimmed.applyGain ((float) (1.0 / std::sqrt (energy / ir.getNumChannels())));
+
+        auto* engine = new Engine (trimmed, rate, numChannels);
+
+        if (generation != buildGeneration.load())
+        {
+            delete engine;
+            return;
+        }
+
+        // Anything still pending was never picked up by the audio thread
+        clearPending.store (false);
+        delete pending.exchange (engine, std::memory_order_acq_rel);
+    });
+}
+
+//==============================================================================
+double ConvolutionReverb::getTailSeconds() const noexcept
+{
+    return current != nullptr ? current->getSeconds() : 0.0;
+}
+
+void ConvolutionReverb::setMix (float newMix) noexcept
+{
+    targetMix = juce::jlimit (0.0f, 1.0f, newMix);
+}
+
+void ConvolutionReverb::setNonRealtime (bool shouldWait) noexcept
+{
+    nonRealtime = shouldWait;
+}
+
+void ConvolutionReverb::reset() noexcept
+{
+    if (current != nullptr)
+        current->reset();
+
+    mix = targetMix;
+}
+
+void ConvolutionReverb::swapEngine() noexcept
+{
+    // The old engine can only go if the worker can be handed it
+    if (retiredFifo.getFreeSpace() == 0)
+        return;
+
+    auto* next = clearPending.exchange (false, std::memory_order_acquire)
+                   ? nullptr
+                   : pending.exchange (nullptr, std::memory_order_acq_rel);
+
+    // One built for a previous prepare() is freed on the worker instead
+    if (next != nullptr && ! next->matches (preparedRate, preparedChannels))
+        std::swap (next, current);
+    else if (next != nullptr)
+        next->reset();
+
+    if (current != nullptr)
+    {
+        const auto scope = retiredFifo.write (1);
+
+        if (scope.blockSize1 > 0)
+            retired[(size_t) scope.startIndex1] = current;
+        else if (scope.blockSize2 > 0)
+            retired[(size_t) scope.startIndex2] = current;
+    }
+
+    current = next;
+    active.store (current, std::memory_order_release);
+    swapGain = 1.0f;
+
+    worker.notify();
+}
+
+void ConvolutionReverb::process (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    numChannels = juce::jmin (numChannels, wetBuffer.getNumChannels());
+
+    if (numSamples > wetBuffer.getNumSamples())
+        return;
+
+    auto isSwapWaiting = [this]
+    {
+        return clearPending.load (std::memory_order_relaxed)
+            || pending.load (std::memory_order_relaxed) != nullptr;
+    };
+
+    // A new IR starts from silence, so only the old one needs fading out
+    if (isSwapWaiting() && (current == nullptr || swapGain <= 0.0f))
+        swapEngine();
+
+    if (current == nullptr)
+        return;
+
+    const bool swapWaiting = isSwapWaiting();
+
+    missedDeadlines.fetch_add (current->process (channels, wetBuffer.getArrayOfWritePointers(),
+                                                 numChannels, numSamples, worker, nonRealtime),
+                               std::memory_order_relaxed);
+
+    const float mixStep = (targetMix - mix) / (float) numSamples;
+    const float gainStep = swapWaiting ? -swapStep : swapStep;
+    float endMix = mix, endGain = swapGain;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* data = channels[ch];
+        const auto* wet = wetBuffer.getReadPointer (ch);
+        float m = mix, g = swapGain;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            m += mixStep;
+            g = juce::jlimit (0.0f, 1.0f, g + gainStep);
+            data[i] += m * (g * wet[i] - data[i]);
+        }
+
+        endMix = m;
+        endGain = g;
+    }
+
+    mix = endMix;
+    swapGain = endGain;
+}
+
+//==============================================================================
+void ConvolutionReverb::freeRetired()
+{
+    const auto scope = retiredFifo.read (retiredFifo.getNumReady());
+
+    for (int i = 0; i < scope.blockSize1; ++i)
+        delete retired[(size_t) (scope.startIndex1 + i)];
+
+    for (int i = 0; i < scope.blockSize2; ++i)
+        delete retired[(size_t) (scope.startIndex2 + i)];
+}
+
+// Engines are only freed here, between tail jobs, so one the audio thread has
+// just swapped out is never deleted while the worker is still on it
+void ConvolutionReverb::Worker::run()
+{
+    while (! threadShouldExit())
+    {
+        owner.freeRetired();
+
+        bool busy = false;
+
+        if (auto* e = owner.active.load (std::memory_order_acquire))
+            busy = e->serviceTail();
+
+        // Woken by every posted tail block and retired engine
+        if (! busy)
+            wait (-1);
+    }
+}
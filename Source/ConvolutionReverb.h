@@ -0,0 +1,153 @@
+#ifndef EFFEM_UNIT_CONVOLUTIONREVERB_H
+#define EFFEM_UNIT_CONVOLUTIONREVERB_H
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+#include <array>
+#include <atomic>
+#include "MemoryWarmup.h"
+
+//==============================================================================
+// Zero-latency convolution with a recorded impulse response, partitioned
+// non-uniformly so the audio thread's cost doesn't grow with the IR:
+//
+//  - head: the first headSize taps, direct form on the audio thread
+//  - mid:  headSize partitions up to twice the tail partition size, FFT
+//          overlap-save on the audio thread, one transform pair per headSize
+//          samples. Each partition's output is one block late, which the
+//          taps ahead of it cover.
+//  - tail: everything after that in partitions of tailSize (1024 at 48 kHz,
+//          scaled with the rate), computed on a worker thread
+//
+// The audio thread hands the tail worker finished input blocks through a
+// ring. A block's tail output is first needed two blocks later, so the worker
+// has one block's time for it. If it isn't ready when that output block
+// starts, that block plays without its tail contribution and is counted as a
+// missed deadline. The worker skips the multiply-accumulate for blocks it
+// picks up past their deadline, so it catches up instead of falling further
+// behind.
+//
+// Offline renders (setNonRealtime) run faster than real time, so there the
+// audio thread waits for the worker at each tail block instead.
+//
+// The worker only runs while an impulse response is loaded: it's started by
+// the first load (or by prepare() with one loaded) and stopped once a clear
+// has reached the audio thread. In between it sleeps until the audio thread
+// posts a tail block or retires an engine.
+//
+// Impulse responses are decoded, resampled to the engine rate, trimmed and
+// partitioned on a loader thread. The result is handed over through an atomic
+// pointer; the audio thread fades the old one out, swaps at a block boundary
+// and sends the old one back to the worker thread to be freed.
+class ConvolutionReverb : private juce::Timer
+{
+public:
+    static constexpr int headSize = 128;
+    static constexpr int baseTailSize = 1024;   // at 48 kHz and below
+    static constexpr double maxImpulseSeconds = 10.0;
+    static constexpr double swapFadeSeconds = 0.01;
+
+    ConvolutionReverb();
+    ~ConvolutionReverb() override;
+
+    // ===== Message thread =====
+    // Rebuilds the loaded IR for the new rate on the loader thread; the stage
+    // is silent until it arrives
+    void prepare (double sampleRate, int maxBlockSize, int numChannels);
+
+    // Only the audio thread's scratch buffer: an engine's own buffers are
+    // built, and so touched, on the loader thread
+    void warmUp (MemoryWarmup& memory)   { memory.add (wetBuffer); }
+
+    // Only checks that the file can be opened; decoding happens on the loader
+    // thread
+    juce::Result loadImpulseResponse (const juce::File&);
+    void clearImpulseResponse();
+
+    // Tail blocks that were not ready in time since the last prepare()
+    int getMissedDeadlineCount() const noexcept   { return missedDeadlines.load (std::memory_order_relaxed); }
+
+    // ===== Audio thread =====
+    void setMix (float) noexcept;
+    void setNonRealtime (bool) noexcept;
+    void reset() noexcept;
+
+    // In place; does nothing until an impulse response has arrived
+    void process (float* const* channels, int numChannels, int numSamples) noexcept;
+
+    // Length of the impulse response in use, 0 before one has arrived
+    double getTailSeconds() const noexcept;
+
+private:
+    class Engine;
+
+    struct Source
+    {
+        juce::AudioBuffer<float> samples;
+        double sampleRate = 0.0;
+    };
+
+    void startBuild (std::shared_ptr<const Source>);
+    void swapEngine() noexcept;
+    void freeRetired();
+    void startWorker();
+    void stopWorker();
+
+    // Stops the worker once the audio thread has dropped the cleared engine
+    void timerCallback() override;
+
+    // message / loader. The readers are stateless, so one set serves every
+    // instance; the loader thread is only started by the first IR load.
+    struct Formats : juce::AudioFormatManager
+    {
+        Formats() { registerBasicFormats(); }
+    };
+
+    juce::SharedResourcePointer<Formats> formats;
+    std::unique_ptr<juce::ThreadPool> loader;
+    juce::ThreadPool& getLoader();
+    juce::CriticalSection sourceLock;
+    std::shared_ptr<const Source> source;
+    std::atomic<juce::uint32> buildGeneration { 0 };
+
+    double preparedRate = 0.0;
+    int preparedChannels = 0;
+    bool workerWanted = false;   // an IR is loaded or loading
+
+    // loader -> audio. clearPending asks the audio thread to drop its engine.
+    std::atomic<Engine*> pending { nullptr };
+    std::atomic<bool> clearPending { false };
+
+    // audio thread
+    Engine* current = nullptr;
+    juce::AudioBuffer<float> wetBuffer;
+    float mix = 0.0f, targetMix = 0.0f;
+    bool nonRealtime = false;
+    float swapGain = 1.0f, swapStep = 1.0f;
+    std::atomic<int> missedDeadlines { 0 };
+
+    // audio -> worker: the engine whose tail to compute, and old ones to free
+    std::atomic<Engine*> active { nullptr };
+
+    static constexpr int retiredCapacity = 8;
+    std::array<Engine*, retiredCapacity> retired {};
+    juce::AbstractFifo retiredFifo { retiredCapacity };
+
+    class Worker : public juce::Thread
+    {
+    public:
+        explicit Worker (ConvolutionReverb& o) : juce::Thread ("EFFEM convolution tail"), owner (o) {}
+        void run() override;
+
+    private:
+        ConvolutionReverb& owner;
+    };
+
+    Worker worker { *this };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConvolutionReverb)
+};
+
+#endif //EFFEM_UNIT_CONVOLUTIONREVERB_H
@@ -0,0 +1,53 @@
+#include "DelayLinePool.h"
+#include <algorithm>
+#include <cstdint>
+
+//==============================================================================
+void DelayLinePool::Line::clear() noexcept
+{
+    if (data != nullptr)
+        std::fill (data, data + mask + 1, 0.0f);
+
+    writePos = 0;
+}
+
+//==============================================================================
+void DelayLinePool::clear()
+{
+    requests.clear();
+}
+
+void DelayLinePool::add (Line& line, int maxDelaySamples)
+{
+    // One extra slot so the longest delay plus its interpolation neighbour fit
+    const int size = (int) juce::nextPowerOfTwo (juce::jmax (2, maxDelaySamples + 2));
+
+    line = Line();
+    requests.push_back ({ &line, size });
+}
+
+void DelayLinePool::allocate()
+{
+    constexpr size_t floatsPerCacheLine = alignment / sizeof (float);
+
+    // Power-of-two sizes of at least a cache line keep every line aligned
+    // once the first one is
+    size_t total = floatsPerCacheLine;
+
+    for (const auto& r : requests)
+        total += juce::jmax ((size_t) r.size, floatsPerCacheLine);
+
+    storage.assign (total, 0.0f);
+
+    const auto address = reinterpret_cast<std::uintptr_t> (storage.data());
+    const auto skew = (alignment - address % alignment) % alignment;
+    auto* next = storage.data() + skew / sizeof (float);
+
+    for (const auto& r : requests)
+    {
+        r.line->data = next;
+        r.line->mask = r.size - 1;
+        r.line->writePos = 0;
+        next += juce::jmax ((size_t) r.size, floatsPerCacheLine);
+    }
+}
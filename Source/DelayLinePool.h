@@ -0,0 +1,84 @@
+#ifndef EFFEM_UNIT_DELAYLINEPOOL_H
+#define EFFEM_UNIT_DELAYLINEPOOL_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+#include "MemoryWarmup.h"
+
+//==============================================================================
+// Backing store for every delay line of the master effects. Lines are added
+// in prepare() and then allocate() makes one allocation for all of them, each
+// line starting on its own cache line, so the audio thread never allocates
+// and lines of different effects never share a cache line.
+//
+// Line lengths are rounded up to a power of two so the ring wraps with a mask.
+class DelayLinePool
+{
+public:
+    static constexpr size_t alignment = 64;   // bytes
+
+    class Line
+    {
+    public:
+        // The sample written `delay` samples ago, 1 .. the line's capacity.
+        // Read before write() for a delay of exactly `delay` samples.
+        float read (int delay) const noexcept   { return data[(writePos - delay) & mask]; }
+
+        // Linear interpolation between whole-sample taps, delay >= 1
+        float read (float delay) const noexcept
+        {
+            const int whole = (int) delay;
+            const float frac = delay - (float) whole;
+            const float a = read (whole);
+            return a + frac * (read (whole + 1) - a);
+        }
+
+        void write (float x) noexcept
+        {
+            data[writePos] = x;
+            writePos = (writePos + 1) & mask;
+        }
+
+        void clear() noexcept;
+        int getCapacity() const noexcept   { return mask; }
+
+    private:
+        friend class DelayLinePool;
+
+        float* data = nullptr;
+        int mask = 0;
+        int writePos = 0;
+    };
+
+    DelayLinePool() = default;
+
+    // ===== Message thread =====
+    // Drops every line added so far; their storage is released on allocate()
+    void clear();
+
+    // Registers a line that must hold delays up to maxDelaySamples. The line
+    // stays unusable until allocate(), and must outlive the pool's next clear().
+    void add (Line& line, int maxDelaySamples);
+
+    void allocate();
+
+    size_t getSizeInBytes() const noexcept   { return storage.size() * sizeof (float); }
+
+    void warmUp (MemoryWarmup& memory)   { memory.add (storage); }
+
+private:
+    struct Request
+    {
+        Line* line;
+        int size;   // floats, power of two
+    };
+
+    std::vector<Request> requests;
+    std::vector<float> storage;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayLinePool)
+};
+
+#endif //EFFEM_UNIT_DELAYLINEPOOL_H
@@ -0,0 +1,439 @@
+#include "EffectsRack.h"
+#include <cmath>
+
+//==============================================================================
+double EffectsRack::getSyncBeats (int index) noexcept
+{
+    // Free, 1/4, 1/8, dotted 1/8, 1/16, 1/4 triplet, 1/8 triplet
+    static constexpr double beats[numSyncDivisions] = { 0.0, 1.0, 0.5, 0.75, 0.25, 2.0 / 3.0, 1.0 / 3.0 };
+    return beats[juce::jlimit (0, numSyncDivisions - 1, index)];
+}
+
+//==============================================================================
+const EffectsRack::Stage EffectsRack::stages[] =
+{
+    &EffectsRack::processSlot<chorusSlot>,
+    &EffectsRack::processSlot<delaySlot>,
+    &EffectsRack::processSlot<reverbSlot>,
+    &EffectsRack::processSlot<convolutionSlot>
+};
+
+void EffectsRack::prepare (double sampleRate, int maxBlockSize, int numChannels)
+{
+    preparedChannels = juce::jlimit (0, maxChannels, numChannels);
+
+    pool.clear();
+    chorus.prepare (pool, sampleRate, preparedChannels);
+    delay.prepare (pool, sampleRate, preparedChannels);
+    reverb.prepare (pool, sampleRate, preparedChannels);
+    pool.allocate();
+
+    convolution.prepare (sampleRate, maxBlockSize, preparedChannels);
+
+    dryBuffer.setSize (juce::jmax (1, preparedChannels), maxBlockSize);
+    fadeStep = (float) (1.0 / (fadeSeconds * sampleRate));
+
+    // Whatever was on comes back in with clean lines
+    for (auto& s : slots)
+        s.level = s.on ? 1.0f : 0.0f;
+
+    chorus.reset();
+    delay.reset();
+    reverb.reset();
+    convolution.reset();
+}
+
+void EffectsRack::setChorus (bool on, float rateHz, float depth, float mix) noexcept
+{
+    slots[chorusSlot].on = on;
+    chorus.set (rateHz, depth, mix);
+}
+
+void EffectsRack::setDelay (bool on, float timeMs, int syncIndex, float feedback, float mix) noexcept
+{
+    slots[delaySlot].on = on;
+    delay.set (timeMs, syncIndex, bpm, feedback, mix);
+}
+
+void EffectsRack::setReverb (bool on, float size, float damping, float mix) noexcept
+{
+    slots[reverbSlot].on = on;
+    reverb.set (size, damping, mix);
+}
+
+void EffectsRack::setConvolution (bool on, float mix) noexcept
+{
+    slots[convolutionSlot].on = on;
+    convolution.setMix (mix);
+}
+
+void EffectsRack::warmUp (MemoryWarmup& memory)
+{
+    pool.warmUp (memory);
+    memory.add (dryBuffer);
+    convolution.warmUp (memory);
+}
+
+void EffectsRack::setNonRealtime (bool nonRealtime) noexcept
+{
+    convolution.setNonRealtime (nonRealtime);
+}
+
+double EffectsRack::getTailSeconds() const noexcept
+{
+    double tail = 0.0;
+
+    if (slots[chorusSlot].on)
+        tail += (Chorus::baseDelayMs + Chorus::maxSwingMs) * 0.001;
+
+    if (slots[delaySlot].on)
+        tail += delay.getTailSeconds();
+
+    if (slots[reverbSlot].on)
+        tail += reverb.getTailSeconds();
+
+    if (slots[convolutionSlot].on)
+        tail += convolution.getTailSeconds();
+
+    return tail;
+}
+
+void EffectsRack::setTempo (double newBpm) noexcept
+{
+    if (newBpm > 0.0)
+        bpm = newBpm;
+}
+
+void EffectsRack::resetSlot (int slot) noexcept
+{
+    switch (slot)
+    {
+        case chorusSlot: chorus.reset(); break;
+        case delaySlot:  delay.reset();  break;
+        case reverbSlot: reverb.reset(); break;
+        default:         convolution.reset(); break;
+    }
+}
+
+//==============================================================================
+template <int slot>
+void EffectsRack::processSlot (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    if constexpr (slot == chorusSlot)
+        chorus.process (channels, numChannels, numSamples);
+    else if constexpr (slot == delaySlot)
+        delay.process (channels, numChannels, numSamples);
+    else if constexpr (slot == reverbSlot)
+        reverb.process (channels, numChannels, numSamples);
+    else
+        convolution.process (channels, numChannels, numSamples);
+}
+
+void EffectsRack::process (juce::AudioBuffer<float>& buffer, int numSamples) noexcept
+{
+    const int numChannels = juce::jmin (buffer.getNumChannels(), preparedChannels);
+
+    if (numChannels == 0 || numSamples > dryBuffer.getNumSamples())
+        return;
+
+    auto* const* channels = buffer.getArrayOfWritePointers();
+
+    for (int s = 0; s < numSlots; ++s)
+    {
+        auto& state = slots[(size_t) s];
+        const float target = state.on ? 1.0f : 0.0f;
+
+        // Bypassed and faded out: not part of the chain
+        if (! state.on && state.level <= 0.0f)
+            continue;
+
+        if (state.level == target)
+        {
+            (this->*stages[s]) (channels, numChannels, numSamples);
+            continue;
+        }
+
+        if (state.level <= 0.0f)
+            resetSlot (s);
+
+        // Crossfade between the input and the slot's output across the block
+        for (int ch = 0; ch < numChannels; ++ch)
+            dryBuffer.copyFrom (ch, 0, channels[ch], numSamples);
+
+        (this->*stages[s]) (channels, numChannels, numSamples);
+
+        const float end = target > state.level ? juce::jmin (1.0f, state.level + fadeStep * (float) numSamples)
+                                               : juce::jmax (0.0f, state.level - fadeStep * (float) numSamples);
+        const float step = (end - state.level) / (float) numSamples;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* out = channels[ch];
+            const auto* dry = dryBuffer.getReadPointer (ch);
+            float level = state.level;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                level += step;
+                out[i] = dry[i] + level * (out[i] - dry[i]);
+            }
+        }
+
+        state.level = end;
+    }
+}
+
+//==============================================================================
+// Chorus
+void EffectsRack::Chorus::prepare (DelayLinePool& pool, double sr, int numChannels)
+{
+    sampleRate = sr;
+
+    const int maxDelay = (int) std::ceil ((baseDelayMs + maxSwingMs) * 0.001 * sampleRate) + 1;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        pool.add (lines[(size_t) ch], maxDelay);
+}
+
+void EffectsRack::Chorus::set (float rateHz, float depth, float newMix) noexcept
+{
+    const double angle = juce::MathConstants<double>::twoPi * rateHz / sampleRate;
+    rotSin = (float) std::sin (angle);
+    rotCos = (float) std::cos (angle);
+
+    swing = (float) (juce::jlimit (0.0f, 1.0f, depth) * maxSwingMs * 0.001 * sampleRate);
+    targetMix = juce::jlimit (0.0f, 1.0f, newMix);
+}
+
+void EffectsRack::Chorus::reset() noexcept
+{
+    for (auto& line : lines)
+        line.clear();
+
+    mix = targetMix;
+}
+
+void EffectsRack::Chorus::process (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    const float base = (float) (baseDelayMs * 0.001 * sampleRate);
+    const float mixStep = (targetMix - mix) / (float) numSamples;
+    float endSin = lfoSin, endCos = lfoCos;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto& line = lines[(size_t) ch];
+        auto* data = channels[ch];
+
+        // Every channel runs the same phasor; the right one reads it 90° on
+        float s = lfoSin, c = lfoCos, m = mix;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float nextCos = c * rotCos - s * rotSin;
+            s = s * rotCos + c * rotSin;
+            c = nextCos;
+
+            const float lfo = ch == 0 ? s : c;
+            const float wet = line.read (base + swing * 0.5f * (1.0f + lfo));
+
+            line.write (data[i]);
+
+            m += mixStep;
+            data[i] += m * (wet - data[i]);
+        }
+
+        endSin = s;
+        endCos = c;
+    }
+
+    // Keep the phasor on the unit circle
+    const float norm = 1.0f / std::sqrt (endSin * endSin + endCos * endCos);
+    lfoSin = endSin * norm;
+    lfoCos = endCos * norm;
+    mix = targetMix;
+}
+
+//==============================================================================
+// Delay
+void EffectsRack::Delay::prepare (DelayLinePool& pool, double sr, int numChannels)
+{
+    sampleRate = sr;
+    maxTime = (float) std::ceil (maxDelaySeconds * sampleRate);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        pool.add (lines[(size_t) ch], (int) maxTime + 1);
+
+    glide = (float) (1.0 - std::exp (-1.0 / (0.05 * sampleRate)));   // 50 ms
+}
+
+void EffectsRack::Delay::set (float timeMs, int syncIndex, double bpm, float newFeedback, float newMix) noexcept
+{
+    const double beats = getSyncBeats (syncIndex);
+    const double seconds = beats > 0.0 ? beats * 60.0 / bpm : timeMs * 0.001;
+
+    targetTime = juce::jlimit (1.0f, maxTime, (float) (seconds * sampleRate));
+    feedback = juce::jlimit (0.0f, 0.95f, newFeedback);
+    targetMix = juce::jlimit (0.0f, 1.0f, newMix);
+}
+
+// Each repeat is `feedback` times the last, so -60 dB takes
+// ln (0.001) / ln (feedback) of them
+double EffectsRack::Delay::getTailSeconds() const noexcept
+{
+    const double seconds = targetTime / sampleRate;
+
+    if (feedback <= 0.0f)
+        return seconds;
+
+    return seconds * (1.0 + std::ceil (std::log (0.001) / std::log ((double) feedback)));
+}
+
+void EffectsRack::Delay::reset() noexcept
+{
+    for (auto& line : lines)
+        line.clear();
+
+    time = targetTime;
+    mix = targetMix;
+}
+
+void EffectsRack::Delay::process (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    const float mixStep = (targetMix - mix) / (float) numSamples;
+    float endTime = time;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto& line = lines[(size_t) ch];
+        auto* data = channels[ch];
+        float t = time, m = mix;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            t += glide * (targetTime - t);
+
+            const float wet = line.read (t);
+            line.write (data[i] + feedback * wet);
+
+            m += mixStep;
+            data[i] += m * (wet - data[i]);
+        }
+
+        endTime = t;
+    }
+
+    time = endTime;
+    mix = targetMix;
+}
+
+//==============================================================================
+// Reverb. Freeverb's tunings at 44.1 kHz, right channel spread by 23 samples.
+namespace
+{
+    constexpr int combTuning[]    = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+    constexpr int allpassTuning[] = { 556, 441, 341, 225 };
+    constexpr int stereoSpread = 23;
+
+    constexpr float reverbInputGain = 0.015f;
+    constexpr float reverbWetGain = 3.0f;
+}
+
+void EffectsRack::Reverb::prepare (DelayLinePool& pool, double sampleRate, int numChannels)
+{
+    const double scale = sampleRate / 44100.0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto& c = chans[(size_t) ch];
+        const int spread = ch * stereoSpread;
+
+        for (int i = 0; i < numCombs; ++i)
+        {
+            c.combLength[(size_t) i] = juce::jmax (1, juce::roundToInt ((combTuning[i] + spread) * scale));
+            pool.add (c.combs[(size_t) i], c.combLength[(size_t) i]);
+        }
+
+        for (int i = 0; i < numAllpasses; ++i)
+        {
+            c.allpassLength[(size_t) i] = juce::jmax (1, juce::roundToInt ((allpassTuning[i] + spread) * scale));
+            pool.add (c.allpasses[(size_t) i], c.allpassLength[(size_t) i]);
+        }
+    }
+}
+
+// The longest comb decays slowest; damping only shortens it. The lengths scale
+// with the rate, so this is the same at any rate.
+double EffectsRack::Reverb::getTailSeconds() const noexcept
+{
+    constexpr double longestComb = (combTuning[numCombs - 1] + stereoSpread) / 44100.0;
+    constexpr double allpassChain = (allpassTuning[0] + allpassTuning[1] + allpassTuning[2] + allpassTuning[3]
+                                            + numAllpasses * stereoSpread) / 44100.0;
+
+    return longestComb * std::log (0.001) / std::log ((double) feedback) + allpassChain;
+}
+
+void EffectsRack::Reverb::set (float size, float newDamping, float newMix) noexcept
+{
+    feedback = 0.7f + 0.28f * juce::jlimit (0.0f, 1.0f, size);
+    damping = 0.4f * juce::jlimit (0.0f, 1.0f, newDamping);
+    targetMix = juce::jlimit (0.0f, 1.0f, newMix);
+}
+
+void EffectsRack::Reverb::reset() noexcept
+{
+    for (auto& c : chans)
+    {
+        for (auto& line : c.combs)
+            line.clear();
+
+        for (auto& line : c.allpasses)
+            line.clear();
+
+        c.damped.fill (0.0f);
+    }
+
+    mix = targetMix;
+}
+
+void EffectsRack::Reverb::process (float* const* channels, int numChannels, int numSamples) noexcept
+{
+    const float mixStep = (targetMix - mix) / (float) numSamples;
+
+    // Sample by sample: every channel's tank is fed from the same mono sum
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float input = 0.0f;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            input += channels[ch][i];
+
+        input *= reverbInputGain;
+        mix += mixStep;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& c = chans[(size_t) ch];
+            float out = 0.0f;
+
+            for (size_t k = 0; k < (size_t) numCombs; ++k)
+            {
+                const float y = c.combs[k].read (c.combLength[k]);
+                c.damped[k] = y + damping * (c.damped[k] - y);
+                c.combs[k].write (input + feedback * c.damped[k]);
+                out += y;
+            }
+
+            for (size_t k = 0; k < (size_t) numAllpasses; ++k)
+            {
+                const float y = c.allpasses[k].read (c.allpassLength[k]);
+                c.allpasses[k].write (out + 0.5f * y);
+                out = y - out;
+            }
+
+            auto& sample = channels[ch][i];
+            sample += mix * (reverbWetGain * out - sample);
+        }
+    }
+
+    mix = targetMix;
+}
@@ -0,0 +1,184 @@
+#ifndef EFFEM_UNIT_EFFECTSRACK_H
+#define EFFEM_UNIT_EFFECTSRACK_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include "DelayLinePool.h"
+#include "ConvolutionReverb.h"
+
+//==============================================================================
+// Master effects after pan: chorus, then delay, then reverb, then the
+// convolution reverb.
+//
+// Every delay line comes out of one DelayLinePool sized in prepare(), so the
+// audio thread never allocates; the convolution stage builds its buffers with
+// each impulse response, off the audio thread. A bypassed effect is left out
+// of the chain entirely rather than run at zero mix: switching one on or off
+// crossfades over fadeSeconds and after that it costs nothing. An effect starts from
+// cleared lines each time it comes back into the chain.
+//
+// Each effect's mix blends from the dry signal (0) to its output alone (1).
+class EffectsRack
+{
+public:
+    enum Slot
+    {
+        chorusSlot = 0,
+        delaySlot,
+        reverbSlot,
+        convolutionSlot,
+        numSlots
+    };
+
+    static constexpr int maxChannels = 2;
+    static constexpr double fadeSeconds = 0.01;
+    static constexpr double maxDelaySeconds = 2.0;
+
+    // Tempo-synced delay lengths; index 0 uses the free time instead
+    static constexpr int numSyncDivisions = 7;
+    static double getSyncBeats (int index) noexcept;
+
+    EffectsRack() = default;
+
+    // ===== Message thread =====
+    void prepare (double sampleRate, int maxBlockSize, int numChannels);
+    void warmUp (MemoryWarmup&);
+
+    // ===== Audio thread =====
+    void setChorus (bool on, float rateHz, float depth, float mix) noexcept;
+    void setDelay (bool on, float timeMs, int syncIndex, float feedback, float mix) noexcept;
+    void setReverb (bool on, float size, float damping, float mix) noexcept;
+    void setConvolution (bool on, float mix) noexcept;
+
+    // Host tempo for the synced delay; stays at the last value when the host
+    // doesn't report one
+    void setTempo (double bpm) noexcept;
+
+    // Offline renders let the convolution stage wait for its worker
+    void setNonRealtime (bool) noexcept;
+
+    void process (juce::AudioBuffer<float>&, int numSamples) noexcept;
+
+    // How long the enabled stages keep sounding after their input stops, for
+    // the settings last passed in: each one's decay to -60 dB, summed since
+    // they run in series
+    double getTailSeconds() const noexcept;
+
+    // Impulse response loading goes straight to the stage (message thread)
+    ConvolutionReverb& getConvolution() noexcept   { return convolution; }
+
+private:
+    //==============================================================================
+    class Chorus
+    {
+    public:
+        static constexpr double baseDelayMs = 7.0;
+        static constexpr double maxSwingMs = 6.0;
+
+        void prepare (DelayLinePool&, double sampleRate, int numChannels);
+        void set (float rateHz, float depth, float mix) noexcept;
+        void reset() noexcept;
+        void process (float* const* channels, int numChannels, int numSamples) noexcept;
+
+    private:
+        std::array<DelayLinePool::Line, maxChannels> lines;
+        double sampleRate = 44100.0;
+
+        // Quadrature LFO as a rotating phasor: left follows sin, right cos
+        float lfoSin = 0.0f, lfoCos = 1.0f;
+        float rotSin = 0.0f, rotCos = 1.0f;
+
+        float swing = 0.0f;          // samples, peak to peak
+        float mix = 0.0f, targetMix = 0.0f;
+    };
+
+    //==============================================================================
+    class Delay
+    {
+    public:
+        void prepare (DelayLinePool&, double sampleRate, int numChannels);
+        void set (float timeMs, int syncIndex, double bpm, float feedback, float mix) noexcept;
+        void reset() noexcept;
+        double getTailSeconds() const noexcept;
+        void process (float* const* channels, int numChannels, int numSamples) noexcept;
+
+    private:
+        std::array<DelayLinePool::Line, maxChannels> lines;
+        double sampleRate = 44100.0;
+        float maxTime = 1.0f;
+
+        // Delay time in samples glides to its target so moving it doesn't click
+        float time = 1.0f, targetTime = 1.0f;
+        float glide = 0.0f;
+
+        float feedback = 0.0f;
+        float mix = 0.0f, targetMix = 0.0f;
+    };
+
+    //==============================================================================
+    // Schroeder-Moorer network as in Freeverb: eight damped combs in parallel
+    // into four allpasses in series, per channel, fed from the mono sum.
+    class Reverb
+    {
+    public:
+        static constexpr int numCombs = 8;
+        static constexpr int numAllpasses = 4;
+
+        void prepare (DelayLinePool&, double sampleRate, int numChannels);
+        void set (float size, float damping, float mix) noexcept;
+        void reset() noexcept;
+        double getTailSeconds() const noexcept;
+        void process (float* const* channels, int numChannels, int numSamples) noexcept;
+
+    private:
+        struct Channel
+        {
+            std::array<DelayLinePool::Line, numCombs> combs;
+            std::array<DelayLinePool::Line, numAllpasses> allpasses;
+            std::array<int, numCombs> combLength {};
+            std::array<int, numAllpasses> allpassLength {};
+            std::array<float, numCombs> damped {};
+        };
+
+        std::array<Channel, maxChannels> chans;
+
+        float feedback = 0.0f, damping = 0.0f;
+        float mix = 0.0f, targetMix = 0.0f;
+    };
+
+    //==============================================================================
+    template <int slot>
+    void processSlot (float* const* channels, int numChannels, int numSamples) noexcept;
+
+    using Stage = void (EffectsRack::*) (float* const*, int, int) noexcept;
+    static const Stage stages[numSlots];
+
+    void resetSlot (int slot) noexcept;
+
+    struct SlotState
+    {
+        bool on = false;
+        float level = 0.0f;   // 0 while out of the chain, 1 when fully in
+    };
+
+    std::array<SlotState, numSlots> slots;
+    float fadeStep = 1.0f;    // level change per sample
+
+    DelayLinePool pool;
+    Chorus chorus;
+    Delay delay;
+    Reverb reverb;
+    ConvolutionReverb convolution;
+
+    double bpm = 120.0;
+    int preparedChannels = 0;
+
+    // Dry copy while a slot fades in or out
+    juce::AudioBuffer<float> dryBuffer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EffectsRack)
+};
+
+#endif //EFFEM_UNIT_EFFECTSRACK_H
@@ -0,0 +1,103 @@
+#include "EffemSynthesiser.h"
+#include "SynthVoice.h"
+#include "SynthSound.h"
+
+//==============================================================================
+void EffemSynthesiser::handleMidiEvent (const juce::MidiMessage& m)
+{
+   #if EFFEM_TRACING
+    const auto* raw = m.getRawData();
+    const auto packed = m.getRawDataSize() >= 2 ? (raw[0] << 8) | raw[1] : (int) raw[0];
+   #endif
+
+    EFFEM_TRACE_BEGIN(tracer, midi, 0, packed);
+    juce::Synthesiser::handleMidiEvent (m);
+    EFFEM_TRACE_END(tracer, midi, 0);
+}
+
+//==============================================================================
+void EffemSynthesiser::setMaxSynthVoices (int maxVoices) noexcept
+{
+    maxSynthVoices = maxVoices;
+    limitSynthVoices (maxVoices);
+}
+
+void EffemSynthesiser::noteOn (int midiChannel, int midiNoteNumber, float velocity)
+{
+    const juce::ScopedLock sl (lock);
+
+    int layers = 0;
+
+    for (auto* sound : sounds)
+        if (dynamic_cast<SynthSound*> (sound) != nullptr
+             && sound->appliesToNote (midiNoteNumber) && sound->appliesToChannel (midiChannel))
+            ++layers;
+
+    // Without a cap, stealing stays juce::Synthesiser's business
+    if (maxSynthVoices < getNumVoices())
+        limitSynthVoices (maxSynthVoices - layers);
+
+    // juce::Synthesiser stops a ringing copy of the note before starting each
+    // sound, which would cut the layers it has just started. Stop it once.
+    for (auto* voice : voices)
+        if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel (midiChannel))
+            stopVoice (voice, 1.0f, true);
+
+    for (auto* sound : sounds)
+        if (sound->appliesToNote (midiNoteNumber) && sound->appliesToChannel (midiChannel))
+            startVoice (findFreeVoice (sound, midiChannel, midiNoteNumber, isNoteStealingEnabled()),
+                        sound, midiChannel, midiNoteNumber, velocity);
+}
+
+//==============================================================================
+void EffemSynthesiser::setPartOutput (int part, juce::AudioBuffer<float>* output) noexcept
+{
+    partOutputs[(size_t) part] = output;
+}
+
+std::unique_ptr<juce::SynthesiserVoice> EffemSynthesiser::takeVoice (int index)
+{
+    const juce::ScopedLock sl (lock);
+    return std::unique_ptr<juce::SynthesiserVoice> (voices.removeAndReturn (index));
+}
+
+void EffemSynthesiser::renderVoices (juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    for (auto* voice : voices)
+    {
+        auto* output = &buffer;
+
+        if (auto* v = dynamic_cast<SynthVoice*> (voice))
+            if (auto* own = partOutputs[(size_t) v->getPart()])
+                output = own;
+
+        voice->renderNextBlock (*output, startSample, numSamples);
+    }
+}
+
+void EffemSynthesiser::limitSynthVoices (int maxSounding) noexcept
+{
+    auto isSounding = [] (juce::SynthesiserVoice* v)
+    {
+        auto* sv = dynamic_cast<SynthVoice*> (v);
+        return sv != nullptr && sv->isVoiceActive() && ! sv->isFadingOut() ? sv : nullptr;
+    };
+
+    int sounding = 0;
+
+    for (int i = 0; i < getNumVoices(); ++i)
+        if (isSounding (getVoice (i)) != nullptr)
+            ++sounding;
+
+    for (; sounding > juce::jmax (0, maxSounding); --sounding)
+    {
+        SynthVoice* oldest = nullptr;
+
+        for (int i = 0; i < getNumVoices(); ++i)
+            if (auto* v = isSounding (getVoice (i)))
+                if (oldest == nullptr || v->wasStartedBefore (*oldest))
+                    oldest = v;
+
+        oldest->fadeOut();
+    }
+}
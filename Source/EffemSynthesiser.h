@@ -0,0 +1,51 @@
+#ifndef EFFEM_UNIT_EFFEMSYNTHESISER_H
+#define EFFEM_UNIT_EFFEMSYNTHESISER_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "TraceRecorder.h"
+#include "EngineState.h"
+
+//==============================================================================
+// juce::Synthesiser with EFFEM's hooks into MIDI dispatch and voice handling.
+class EffemSynthesiser : public juce::Synthesiser
+{
+public:
+    EffemSynthesiser() = default;
+
+    void setTraceRecorder (TraceRecorder* t) { tracer = t; }
+
+    void handleMidiEvent (const juce::MidiMessage&) override;
+
+    // Caps how many SynthVoices sound at once (audio thread, between blocks).
+    // Voices over the cap fade out oldest first instead of being cut, and a
+    // new note makes room the same way.
+    void setMaxSynthVoices (int maxVoices) noexcept;
+
+    // Starts a voice for every part listening on the channel, so parts that
+    // share a channel layer instead of each cutting the last
+    void noteOn (int midiChannel, int midiNoteNumber, float velocity) override;
+
+    // Audio thread, per block: where a part's voices render. nullptr (the
+    // default) mixes them into the buffer handed to renderNextBlock.
+    void setPartOutput (int part, juce::AudioBuffer<float>* output) noexcept;
+
+    // Like removeVoice(), but hands the voice back instead of deleting it
+    std::unique_ptr<juce::SynthesiserVoice> takeVoice (int index);
+
+protected:
+    using juce::Synthesiser::renderVoices;
+    void renderVoices (juce::AudioBuffer<float>&, int startSample, int numSamples) override;
+
+private:
+    void limitSynthVoices (int maxSounding) noexcept;
+
+    TraceRecorder* tracer = nullptr;
+    int maxSynthVoices = std::numeric_limits<int>::max();
+    std::array<juce::AudioBuffer<float>*, EngineState::maxParts> partOutputs {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EffemSynthesiser)
+};
+
+#endif //EFFEM_UNIT_EFFEMSYNTHESISER_H
@@ -0,0 +1,368 @@
+#include "EngineState.h"
+#include "VoiceFilter.h"
+
+// Parameters that feed EngineState; everything else is read per block
+static const char* const structuralParameters[] =
+{
+    "osc1On", "osc1Wave", "osc1Pitch",
+    "osc2On", "osc2Wave", "osc2Pitch",
+    "filterType", "filterModel",
+    "attack", "decay", "sustain", "release"
+};
+
+// Converts choice index → pitch ratio
+static float pitchIndexToRatio (int index)
+{
+    static constexpr float semitones[] = { -12.f, -7.f, 0.f, +7.f, +12.f };
+
+    if (! juce::isPositiveAndBelow (index, 5))
+        return 1.0f;
+
+    return std::pow (2.f, semitones[index] / 12.f);
+}
+
+//==============================================================================
+EngineStateManager::EngineStateManager (juce::AudioProcessorValueTreeState& s)
+    : apvts (s), tuning (TuningTable::createEqualTemperament())
+{
+    current = build();
+
+    for (auto* id : structuralParameters)
+        apvts.addParameterListener (id, this);
+
+    builder->add (this);
+}
+
+EngineStateManager::~EngineStateManager()
+{
+    // After this the builder thread can't be inside service()
+    builder->remove (this);
+
+    for (auto* id : structuralParameters)
+        apvts.removeParameterListener (id, this);
+
+    service();   // frees anything still waiting in the retired queue
+
+    delete pending.exchange (nullptr);
+    delete current;
+}
+
+//==============================================================================
+void EngineStateManager::beginBatch()
+{
+    ++batchDepth;
+}
+
+void EngineStateManager::endBatch()
+{
+    if (--batchDepth == 0)
+        builder->notify();
+}
+
+void EngineStateManager::prepare (double sampleRate)
+{
+    crossfadeSamples = juce::roundToInt (sampleRate * crossfadeSeconds);
+}
+
+void EngineStateManager::setTuning (const juce::String& scaleText, const juce::String& keyboardMapText)
+{
+    {
+        const juce::ScopedLock sl (sourceLock);
+        tuningScale = scaleText;
+        tuningKeyboardMap = keyboardMapText;
+    }
+
+    tuningDirty.store (true, std::memory_order_release);
+    dirty.store (true, std::memory_order_release);
+
+    if (batchDepth.load() == 0)
+        builder->notify();
+}
+
+void EngineStateManager::setUserWaveTable (int oscIndex, const juce::File& file)
+{
+    if (! juce::isPositiveAndBelow (oscIndex, (int) userTableFiles.size()))
+        return;
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        userTableFiles[(size_t) oscIndex] = file;
+    }
+
+    userTablesDirty.store (true, std::memory_order_release);
+    dirty.store (true, std::memory_order_release);
+
+    if (batchDepth.load() == 0)
+        builder->notify();
+}
+
+void EngineStateManager::setParts (const juce::ValueTree& partsTree)
+{
+    {
+        const juce::ScopedLock sl (sourceLock);
+        partsSource = partsTree.createCopy();
+    }
+
+    dirty.store (true, std::memory_order_release);
+
+    if (batchDepth.load() == 0)
+        builder->notify();
+}
+
+void EngineStateManager::parameterChanged (const juce::String&, float)
+{
+    // May be called on the audio thread by host automation, so the builder is
+    // woken only on the clean -> dirty edge: once per build however many
+    // parameters move, and the event's lock is only ever held momentarily
+    if (! dirty.exchange (true, std::memory_order_acq_rel) && batchDepth.load() == 0)
+        builder->notify();
+}
+
+EngineState* EngineStateManager::build() const
+{
+    juce::ValueTree partsTree;
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        partsTree = partsSource;
+    }
+
+    auto* s = new EngineState();
+
+    s->multitimbral = partsTree[PartTree::multitimbral];
+    s->tuning = tuning;
+
+    for (int i = 0; i < EngineState::maxParts; ++i)
+    {
+        auto& part = s->parts[(size_t) i];
+        const auto tree = partsTree.getChildWithProperty (PartTree::index, i);
+
+        part.enabled   = i == 0 || (bool) tree[PartTree::enabled];
+        part.channel   = juce::jlimit (1, 16, (int) tree.getProperty (PartTree::channel, i + 1));
+        part.ownOutput = i > 0 && (bool) tree[PartTree::ownOutput];
+
+        if (i == 0)
+        {
+            buildPart (part, [this] (const char* id) { return apvts.getRawParameterValue (id)->load(); });
+        }
+        else if (part.enabled)
+        {
+            // Parameters the stored patch predates take their defaults
+            const auto patch = tree.getChildWithName (PartTree::patch);
+
+            buildPart (part, [this, &patch] (const char* id)
+            {
+                if (patch.hasProperty (id))
+                    return (float) patch[id];
+
+                auto* param = apvts.getParameter (id);
+                return param->convertFrom0to1 (param->getDefaultValue());
+            });
+        }
+    }
+
+    return s;
+}
+
+void EngineStateManager::buildPart (EngineState::Part& part, const std::function<float (const char*)>& value) const
+{
+    part.osc1.waveform   = juce::roundToInt (value ("osc1Wave"));
+    part.osc1.table      = tables->get (part.osc1.waveform);
+    part.osc1.userTable  = userTables[0];
+    part.osc1.on         = value ("osc1On") > 0.5f;
+    part.osc1.pitchRatio = pitchIndexToRatio (juce::roundToInt (value ("osc1Pitch")));
+
+    part.osc2.waveform   = juce::roundToInt (value ("osc2Wave"));
+    part.osc2.table      = tables->get (part.osc2.waveform);
+    part.osc2.userTable  = userTables[1];
+    part.osc2.on         = value ("osc2On") > 0.5f;
+    part.osc2.pitchRatio = pitchIndexToRatio (juce::roundToInt (value ("osc2Pitch")));
+
+    // Filter Model 0 is the state variable filter in the Filter Type response;
+    // 1-3 are VoiceFilter::ladder onwards
+    const auto filterModel = juce::roundToInt (value ("filterModel"));
+    part.filterType = filterModel > 0 ? VoiceFilter::ladder + filterModel - 1
+                                      : juce::roundToInt (value ("filterType"));
+
+    part.envelope.attack  = value ("attack");
+    part.envelope.decay   = value ("decay");
+    part.envelope.sustain = value ("sustain");
+    part.envelope.release = value ("release");
+
+    for (auto* osc : { &part.osc1, &part.osc2 })
+        if (osc->waveform == WaveTableCache::user && osc->userTable != nullptr)
+            osc->table = osc->userTable.get();
+
+    // Only used by parts 2-16; part 1's are read per block
+    auto& c = part.controls;
+    c.gain1     = value ("osc1Gain");
+    c.detune1   = value ("osc1Detune");
+    c.gain2     = value ("osc2Gain");
+    c.detune2   = value ("osc2Detune");
+    c.blend     = value ("oscBlend");
+    c.cutoff    = value ("filterCutoff");
+    c.resonance = value ("filterResonance");
+    c.wtPos1    = value ("osc1WtPos");
+    c.wtPos2    = value ("osc2WtPos");
+    c.drive     = value ("drive");
+    c.driveType = juce::roundToInt (value ("driveType"));
+    c.fm1       = value ("osc1FM");
+    c.fm2       = value ("osc2FM");
+}
+
+//==============================================================================
+void EngineStateManager::service()
+{
+    // Delete what the audio thread has swapped out
+    {
+        const auto scope = retiredFifo.read (retiredFifo.getNumReady());
+
+        for (int i = 0; i < scope.blockSize1; ++i)  delete retired[(size_t) (scope.startIndex1 + i)];
+        for (int i = 0; i < scope.blockSize2; ++i)  delete retired[(size_t) (scope.startIndex2 + i)];
+    }
+
+    if (batchDepth.load() > 0)
+        return;
+
+    // Raised before dirty is taken so a waiter never sees neither
+    building.store (true);
+
+    if (! dirty.exchange (false))
+    {
+        building.store (false);
+        return;
+    }
+
+    if (tuningDirty.exchange (false, std::memory_order_acq_rel))
+        compileTuning();
+
+    if (userTablesDirty.exchange (false, std::memory_order_acq_rel))
+        loadUserWaveTables();
+
+    // A state the audio thread never picked up can be replaced outright
+    delete pending.exchange (build(), std::memory_order_acq_rel);
+    building.store (false);
+}
+
+void EngineStateManager::compileTuning()
+{
+    juce::String scaleText, keyboardMapText;
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        scaleText = tuningScale;
+        keyboardMapText = tuningKeyboardMap;
+    }
+
+    if (scaleText.isEmpty())
+    {
+        tuning = TuningTable::createEqualTemperament();
+        return;
+    }
+
+    auto table = std::make_shared<TuningTable>();
+
+    // The text was validated when it was loaded; keep the old table if not
+    if (ScalaTuning::build (scaleText, keyboardMapText, *table).wasOk())
+        tuning = std::move (table);
+}
+
+void EngineStateManager::loadUserWaveTables()
+{
+    std::array<juce::File, 2> files;
+
+    {
+        const juce::ScopedLock sl (sourceLock);
+        files = userTableFiles;
+    }
+
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        if (files[i] == loadedTableFiles[i])
+            continue;
+
+        // A file that fails to load leaves the oscillator on the sine fallback
+        userTables[i] = files[i] == juce::File() ? nullptr : library->load (files[i]);
+        loadedTableFiles[i] = files[i];
+    }
+}
+
+bool EngineStateManager::update() noexcept
+{
+    if (pending.load (std::memory_order_relaxed) == nullptr)
+        return false;
+
+    // Only swap if the old state can be handed back for deletion
+    if (retiredFifo.getFreeSpace() == 0)
+        return false;
+
+    auto* next = pending.exchange (nullptr, std::memory_order_acq_rel);
+
+    if (next == nullptr)
+        return false;
+
+    retire (current);
+    current = next;
+    return true;
+}
+
+void EngineStateManager::waitForPendingBuild (int timeoutMs) const noexcept
+{
+    const auto start = juce::Time::getMillisecondCounter();
+    builder->notify();
+
+    while ((dirty.load() || building.load()) && batchDepth.load() == 0
+           && (int) (juce::Time::getMillisecondCounter() - start) < timeoutMs)
+        juce::Thread::sleep (1);
+}
+
+void EngineStateManager::retire (EngineState* s) noexcept
+{
+    const auto scope = retiredFifo.write (1);
+
+    if (scope.blockSize1 > 0)
+        retired[(size_t) scope.startIndex1] = s;
+    else if (scope.blockSize2 > 0)
+        retired[(size_t) scope.startIndex2] = s;
+}
+
+//==============================================================================
+EngineStateManager::Builder::Builder()
+    : juce::Thread ("EFFEM engine state")
+{
+    startThread (juce::Thread::Priority::low);
+}
+
+EngineStateManager::Builder::~Builder()
+{
+    stopThread (2000);
+}
+
+void EngineStateManager::Builder::add (EngineStateManager* m)
+{
+    const juce::ScopedLock sl (lock);
+    managers.addIfNotAlreadyThere (m);
+}
+
+void EngineStateManager::Builder::remove (EngineStateManager* m)
+{
+    const juce::ScopedLock sl (lock);
+    managers.removeFirstMatchingValue (m);
+}
+
+void EngineStateManager::Builder::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl (lock);
+
+            for (auto* m : managers)
+                m->service();
+        }
+
+        // Sleeps until a change is requested. States the audio thread retired
+        // are freed on the next wake, or when their manager goes away.
+        wait (-1);
+    }
+}
@@ -0,0 +1,201 @@
+#ifndef EFFEM_UNIT_ENGINESTATE_H
+#define EFFEM_UNIT_ENGINESTATE_H
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "WaveTableLibrary.h"
+#include "Tuning.h"
+
+//==============================================================================
+// Everything a voice needs that is expensive or structural to change: which
+// tables the oscillators read, on/off, pitch ratios, filter type and envelope
+// settings, and the tuning table. Built off the audio thread and never
+// modified once published.
+// Continuous controls (gains, detune, cutoff, resonance, blend, pan) are still
+// read per block by the processor.
+//
+// In multitimbral mode there is one of these per part. Part 1 follows the
+// plugin's parameters; parts 2-16 play a patch stored in the session, so
+// their continuous controls are fixed and built here too.
+struct EngineState
+{
+    static constexpr int maxParts = 16;
+
+    struct OscSettings
+    {
+        int waveform = 0;
+        const WaveTableSet* table = nullptr;   // nullptr = noise
+        bool on = true;
+        float pitchRatio = 1.0f;
+
+        // Keeps a loaded wavetable alive while a state refers to it
+        std::shared_ptr<const WaveTableSet> userTable;
+    };
+
+    struct Controls
+    {
+        float gain1 = 0.8f, detune1 = 0.0f;
+        float gain2 = 0.8f, detune2 = 0.0f;
+        float blend = 0.5f;
+        float cutoff = 1000.0f, resonance = 0.707f;
+        float wtPos1 = 0.0f, wtPos2 = 0.0f;
+        float drive = 0.0f;
+        int driveType = 0;
+        float fm1 = 0.0f, fm2 = 0.0f;
+    };
+
+    struct Part
+    {
+        OscSettings osc1, osc2;
+        int filterType = 0;
+        juce::ADSR::Parameters envelope;
+
+        Controls controls;      // parts 2-16 only; part 1 reads its parameters
+        bool enabled = false;   // part 1 always is
+        int channel = 0;        // MIDI channel 1-16
+        bool ownOutput = false; // its own output bus rather than the main one
+    };
+
+    std::array<Part, maxParts> parts;
+    bool multitimbral = false;
+
+    // Never null. Shared between successive states and released along with
+    // them on the background thread.
+    std::shared_ptr<const TuningTable> tuning;
+};
+
+// Layout of the session's PARTS tree. Each PART child holds its index
+// (0-15), channel, enabled and ownOutput, plus a PATCH child with the
+// stored parameter values (denormalised, keyed by parameter ID).
+namespace PartTree
+{
+    inline const juce::Identifier type         { "PARTS" };
+    inline const juce::Identifier multitimbral { "multitimbral" };
+    inline const juce::Identifier part         { "PART" };
+    inline const juce::Identifier index        { "index" };
+    inline const juce::Identifier enabled      { "enabled" };
+    inline const juce::Identifier channel      { "channel" };
+    inline const juce::Identifier ownOutput    { "ownOutput" };
+    inline const juce::Identifier name         { "name" };
+    inline const juce::Identifier patch        { "PATCH" };
+}
+
+//==============================================================================
+// Double-buffers EngineState between the message/background side and the audio
+// thread.
+//
+//  - Parameter listeners only flag the state dirty (safe from any thread).
+//  - A shared background thread rebuilds the state and publishes it through an
+//    atomic pointer.
+//  - The audio thread picks it up at a block boundary with a single exchange;
+//    voices crossfade from the old tables/filter type to the new ones.
+//  - Retired states go back to the background thread to be deleted, so the
+//    audio thread never allocates or frees.
+class EngineStateManager : private juce::AudioProcessorValueTreeState::Listener
+{
+public:
+    static constexpr double crossfadeSeconds = 0.005;
+
+    explicit EngineStateManager (juce::AudioProcessorValueTreeState&);
+    ~EngineStateManager() override;
+
+    // ===== Message thread =====
+    // Hold publishing while a preset pushes many parameters, so the audio
+    // thread sees one switch instead of a series of partial ones.
+    void beginBatch();
+    void endBatch();
+
+    void prepare (double sampleRate);
+
+    // Scala scale / keyboard mapping text, compiled on the background thread.
+    // An empty scale means 12-TET; an empty mapping means the default one.
+    void setTuning (const juce::String& scaleText, const juce::String& keyboardMapText);
+
+    // Wavetable file for the "User" waveform of oscillator 0 or 1. Decoding
+    // and mip-mapping happen on the background thread; an empty file clears it.
+    // Every part that picks "User" shares the same table.
+    void setUserWaveTable (int oscIndex, const juce::File& file);
+
+    // The session's PARTS tree (mode, and each part's channel, output and
+    // stored patch). Copied, so the caller may keep editing its own.
+    void setParts (const juce::ValueTree& partsTree);
+
+    // ===== Audio thread =====
+    // Call once at the top of each block. Returns true when a new state was
+    // installed; voices should then fade to it over getCrossfadeSamples().
+    bool update() noexcept;
+
+    // Offline renders only: waits up to timeoutMs for parameter changes to be
+    // built, so they take effect on the next update() rather than whenever the
+    // background thread gets round to them
+    void waitForPendingBuild (int timeoutMs) const noexcept;
+
+    const EngineState& getCurrent() const noexcept    { return *current; }
+    int getCrossfadeSamples() const noexcept          { return crossfadeSamples; }
+
+    // ===== Background thread =====
+    void service();
+
+private:
+    void parameterChanged (const juce::String&, float) override;
+    EngineState* build() const;
+    void buildPart (EngineState::Part&, const std::function<float (const char*)>& value) const;
+    void compileTuning();
+    void loadUserWaveTables();
+    void retire (EngineState*) noexcept;
+
+    juce::AudioProcessorValueTreeState& apvts;
+    juce::SharedResourcePointer<WaveTableCache> tables;
+
+    std::atomic<EngineState*> pending { nullptr };
+    std::atomic<bool> dirty { false };
+    std::atomic<bool> building { false };
+    std::atomic<int> batchDepth { 0 };
+
+    // message -> background
+    juce::CriticalSection sourceLock;
+    juce::String tuningScale, tuningKeyboardMap;
+    std::array<juce::File, 2> userTableFiles;
+    juce::ValueTree partsSource;
+    std::atomic<bool> tuningDirty { false }, userTablesDirty { false };
+
+    // background
+    std::shared_ptr<const TuningTable> tuning;
+    std::array<juce::File, 2> loadedTableFiles;
+    std::array<std::shared_ptr<const WaveTableSet>, 2> userTables;
+    juce::SharedResourcePointer<WaveTableLibrary> library;
+
+    // audio thread
+    EngineState* current = nullptr;
+    int crossfadeSamples = 0;
+
+    // audio -> background
+    static constexpr int retiredCapacity = 32;
+    std::array<EngineState*, retiredCapacity> retired {};
+    juce::AbstractFifo retiredFifo { retiredCapacity };
+
+    // One low-priority thread services every instance in the process. It runs
+    // only when notified: by endBatch(), the setters, a structural parameter
+    // change or waitForPendingBuild().
+    class Builder : public juce::Thread
+    {
+    public:
+        Builder();
+        ~Builder() override;
+
+        void add (EngineStateManager*);
+        void remove (EngineStateManager*);
+        void run() override;
+
+    private:
+        juce::CriticalSection lock;
+        juce::Array<EngineStateManager*> managers;
+    };
+
+    juce::SharedResourcePointer<Builder> builder;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EngineStateManager)
+};
+
+#endif //EFFEM_UNIT_ENGINESTATE_H
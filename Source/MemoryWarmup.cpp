@@ -0,0 +1,148 @@
+#include "MemoryWarmup.h"
+#include <cstdint>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+#endif
+
+//==============================================================================
+MemoryWarmup::~MemoryWarmup()
+{
+    clear();
+}
+
+void MemoryWarmup::clear()
+{
+    for (auto& r : ranges)
+        unlock (r);
+
+    ranges.clear();
+    totalBytes = lockedBytes = 0;
+}
+
+void MemoryWarmup::add (void* data, size_t bytes)
+{
+    if (data == nullptr || bytes == 0)
+        return;
+
+    const auto pageSize = (std::uintptr_t) juce::SystemStats::getPageSize();
+
+    // Read and write back one byte per page: the write is what makes a
+    // copy-on-write zero page private
+    auto* bytesToTouch = static_cast<volatile char*> (data);
+
+    for (size_t i = 0; i < bytes; i += (size_t) pageSize)
+        bytesToTouch[i] = bytesToTouch[i];
+
+    bytesToTouch[bytes - 1] = bytesToTouch[bytes - 1];
+
+    auto first = reinterpret_cast<std::uintptr_t> (data) & ~(pageSize - 1);
+    auto end = (reinterpret_cast<std::uintptr_t> (data) + bytes + pageSize - 1) & ~(pageSize - 1);
+
+    // Absorb every range this one overlaps or touches; the grown range may
+    // reach ones already passed, hence the rescan
+    bool partlyLocked = false;
+
+    for (auto it = ranges.begin(); it != ranges.end();)
+    {
+        const auto rangeEnd = it->start + it->bytes;
+
+        if (it->start > end || rangeEnd < first)
+        {
+            ++it;
+            continue;
+        }
+
+        first = juce::jmin (first, it->start);
+        end = juce::jmax (end, rangeEnd);
+
+        totalBytes -= it->bytes;
+
+        if (it->locked)
+        {
+            // Still locked; the merged range takes them over
+            lockedBytes -= it->bytes;
+            partlyLocked = true;
+        }
+
+        ranges.erase (it);
+        it = ranges.begin();
+    }
+
+    ranges.push_back ({ first, (size_t) (end - first), false });
+    auto& r = ranges.back();
+    totalBytes += r.bytes;
+
+    if (locking)
+    {
+        lock (r);
+
+        // If the OS refused the merged range, the pages the absorbed ranges
+        // had locked are let go rather than left with nothing to unlock them
+        if (partlyLocked && ! r.locked)
+        {
+            r.locked = true;
+            lockedBytes += r.bytes;
+            unlock (r);
+        }
+    }
+}
+
+void MemoryWarmup::add (juce::AudioBuffer<float>& buffer)
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        add (buffer.getWritePointer (ch), (size_t) buffer.getNumSamples() * sizeof (float));
+}
+
+void MemoryWarmup::setLocked (bool shouldLock)
+{
+    if (shouldLock == locking)
+        return;
+
+    locking = shouldLock;
+
+    for (auto& r : ranges)
+    {
+        if (locking)
+            lock (r);
+        else
+            unlock (r);
+    }
+}
+
+//==============================================================================
+void MemoryWarmup::lock (Range& r)
+{
+    auto* start = reinterpret_cast<void*> (r.start);
+
+   #if JUCE_WINDOWS
+    r.locked = VirtualLock (start, r.bytes) != 0;
+   #else
+    r.locked = mlock (start, r.bytes) == 0;
+   #endif
+
+    if (r.locked)
+        lockedBytes += r.bytes;
+}
+
+void MemoryWarmup::unlock (Range& r)
+{
+    if (! r.locked)
+        return;
+
+    auto* start = reinterpret_cast<void*> (r.start);
+
+   #if JUCE_WINDOWS
+    VirtualUnlock (start, r.bytes);
+   #else
+    munlock (start, r.bytes);
+   #endif
+
+    r.locked = false;
+    lockedBytes -= r.bytes;
+}
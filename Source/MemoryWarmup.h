@@ -0,0 +1,68 @@
+#ifndef EFFEM_UNIT_MEMORYWARMUP_H
+#define EFFEM_UNIT_MEMORYWARMUP_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstdint>
+#include <vector>
+
+//==============================================================================
+// Memory the audio thread works in, faulted in during prepareToPlay and
+// optionally locked into RAM.
+//
+// add() touches every page of a range so the OS maps it now rather than on
+// the first callback that writes there; a freshly sized AudioBuffer is not
+// touched until then. Contents are left as they were.
+//
+// Ranges are kept as whole pages, and buffers that share a page (or whose
+// pages overlap) are merged into one range, so unlocking one buffer can't
+// unlock a page another still needs and no page is counted twice.
+//
+// With locking on, every range is also mlock()ed (VirtualLock on Windows) so
+// a long live set can't have it paged out. Locking is best effort: what the
+// OS refuses (RLIMIT_MEMLOCK, the working-set quota) is only counted. The
+// shared wavetables are never locked, since unlocking is not reference
+// counted between plugin instances.
+class MemoryWarmup
+{
+public:
+    MemoryWarmup() = default;
+    ~MemoryWarmup();
+
+    // ===== Message thread =====
+    // Unlocks and forgets every range; call before re-adding them in prepare
+    void clear();
+
+    void add (void* data, size_t bytes);
+    void add (juce::AudioBuffer<float>&);
+
+    template <typename T>
+    void add (std::vector<T>& v)   { add (v.data(), v.size() * sizeof (T)); }
+
+    // Applies to the ranges added so far and to ones added later. Doesn't
+    // modify memory, so it's safe while the audio thread runs.
+    void setLocked (bool shouldLock);
+
+    size_t getTotalBytes() const noexcept    { return totalBytes; }
+    size_t getLockedBytes() const noexcept   { return lockedBytes; }
+
+private:
+    struct Range
+    {
+        std::uintptr_t start;   // page aligned
+        size_t bytes;           // whole pages
+        bool locked;
+    };
+
+    void lock (Range&);
+    void unlock (Range&);
+
+    std::vector<Range> ranges;   // disjoint
+    bool locking = false;
+    size_t totalBytes = 0, lockedBytes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MemoryWarmup)
+};
+
+#endif //EFFEM_UNIT_MEMORYWARMUP_H
@@ -0,0 +1,295 @@
+#include "NoteRenderCache.h"
+
+//==============================================================================
+int NoteRenderCache::quantiseVelocity (float velocity) noexcept
+{
+    return juce::jlimit (0, velocitySteps - 1, juce::roundToInt (velocity * (float) (velocitySteps - 1)));
+}
+
+float NoteRenderCache::getVelocityForStep (int step) noexcept
+{
+    return (float) step / (float) (velocitySteps - 1);
+}
+
+bool NoteRenderCache::canCache (const EngineState& s) noexcept
+{
+    const auto& envelope = s.parts[0].envelope;
+
+    // With any sustain the note's length depends on when the key goes up
+    return envelope.sustain <= 0.0f
+        && envelope.attack + envelope.decay < (float) maxNoteSeconds;
+}
+
+//==============================================================================
+NoteRenderCache::PatchHash& NoteRenderCache::PatchHash::add (const EngineState& s) noexcept
+{
+    const auto& part = s.parts[0];
+
+    for (auto* osc : { &part.osc1, &part.osc2 })
+    {
+        add (osc->waveform);
+        add (osc->table != nullptr ? osc->table->getId() : 0);
+        add (osc->on ? 1 : 0);
+        add (osc->pitchRatio);
+    }
+
+    add (part.filterType);
+    add (part.envelope.attack);
+    add (part.envelope.decay);
+    add (part.envelope.sustain);
+    add (part.envelope.release);
+    add (s.tuning != nullptr ? s.tuning->id : 0);
+    return *this;
+}
+
+NoteRenderCache::PatchHash& NoteRenderCache::PatchHash::add (float v) noexcept
+{
+    addBytes (&v, sizeof (v));
+    return *this;
+}
+
+NoteRenderCache::PatchHash& NoteRenderCache::PatchHash::add (int v) noexcept
+{
+    addBytes (&v, sizeof (v));
+    return *this;
+}
+
+NoteRenderCache::PatchHash& NoteRenderCache::PatchHash::add (juce::uint64 v) noexcept
+{
+    addBytes (&v, sizeof (v));
+    return *this;
+}
+
+void NoteRenderCache::PatchHash::addBytes (const void* data, size_t size) noexcept
+{
+    auto* bytes = static_cast<const juce::uint8*> (data);
+
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+}
+
+//==============================================================================
+void NoteRenderCache::prepare (double sampleRate, size_t budgetBytes)
+{
+    const auto numSlabs = juce::jmax ((size_t) 1, budgetBytes / (sizeof (float) * (size_t) slabSize));
+
+    pool.assign (numSlabs * (size_t) slabSize, 0.0f);
+    nextSlab.resize (numSlabs);
+
+    for (size_t i = 0; i < numSlabs; ++i)
+        nextSlab[i] = i + 1 < numSlabs ? (int) i + 1 : -1;
+
+    freeSlabs = 0;
+
+    entries.assign ((size_t) maxEntries, Entry());
+    clock = 0;
+    currentPatch = 0;
+    maxNoteSamples = (juce::int64) (sampleRate * maxNoteSeconds);
+}
+
+//==============================================================================
+void NoteRenderCache::setPatch (juce::uint64 hash) noexcept
+{
+    if (hash == currentPatch)
+        return;
+
+    currentPatch = hash;
+
+    for (auto& e : entries)
+    {
+        if (e.state == EntryState::empty)
+            continue;
+
+        if (e.users > 0)
+            e.stale = true;
+        else
+            freeEntry (e);
+    }
+}
+
+int NoteRenderCache::find (const Key& key) noexcept
+{
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        auto& e = entries[i];
+
+        if (e.state == EntryState::ready && ! e.stale && e.key == key)
+        {
+            e.lastUsed = ++clock;
+            ++e.users;
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
+
+int NoteRenderCache::read (int entry, Cursor& cursor, float* dest, int numSamples) const noexcept
+{
+    const auto& e = entries[(size_t) entry];
+    int done = 0;
+
+    while (done < numSamples && cursor.slab >= 0)
+    {
+        // The last slab is only filled up to the entry's length
+        const int slabEnd = cursor.slab == e.lastSlab ? (int) ((e.length - 1) % slabSize) + 1 : slabSize;
+        const int n = juce::jmin (numSamples - done, slabEnd - cursor.offset);
+
+        const auto* src = pool.data() + (size_t) cursor.slab * slabSize + (size_t) cursor.offset;
+        std::copy (src, src + n, dest + done);
+
+        done += n;
+        cursor.offset += n;
+
+        if (cursor.offset == slabEnd)
+        {
+            cursor.slab = cursor.slab == e.lastSlab ? -1 : nextSlab[(size_t) cursor.slab];
+            cursor.offset = 0;
+        }
+    }
+
+    return done;
+}
+
+//==============================================================================
+int NoteRenderCache::beginRecording (const Key& key) noexcept
+{
+    int slot = -1;
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& e = entries[i];
+
+        if (e.state == EntryState::recording && ! e.stale && e.key == key)
+            return -1;
+
+        if (slot < 0 && e.state == EntryState::empty)
+            slot = (int) i;
+    }
+
+    if (slot < 0)
+    {
+        if (! evictLeastRecent())
+            return -1;
+
+        for (size_t i = 0; i < entries.size() && slot < 0; ++i)
+            if (entries[i].state == EntryState::empty)
+                slot = (int) i;
+    }
+
+    auto& e = entries[(size_t) slot];
+    e.key = key;
+    e.state = EntryState::recording;
+    e.firstSlab = e.lastSlab = -1;
+    e.length = 0;
+    e.lastUsed = ++clock;
+    e.users = 1;
+    e.stale = false;
+    return slot;
+}
+
+bool NoteRenderCache::append (int entry, const float* samples, int numSamples) noexcept
+{
+    auto& e = entries[(size_t) entry];
+
+    if (e.length + numSamples > maxNoteSamples)
+    {
+        e.stale = true;
+        return false;
+    }
+
+    while (numSamples > 0)
+    {
+        int offset = (int) (e.length % slabSize);
+
+        if (offset == 0)
+        {
+            // The recording itself is referenced, so it can't evict its own slabs
+            const int slab = allocateSlab();
+
+            if (slab < 0)
+            {
+                e.stale = true;
+                return false;
+            }
+
+            if (e.lastSlab >= 0)
+                nextSlab[(size_t) e.lastSlab] = slab;
+            else
+                e.firstSlab = slab;
+
+            e.lastSlab = slab;
+        }
+
+        const int n = juce::jmin (numSamples, slabSize - offset);
+        std::copy (samples, samples + n, pool.data() + (size_t) e.lastSlab * slabSize + (size_t) offset);
+
+        e.length += n;
+        samples += n;
+        numSamples -= n;
+    }
+
+    return true;
+}
+
+void NoteRenderCache::finishRecording (int entry) noexcept
+{
+    auto& e = entries[(size_t) entry];
+
+    if (e.length > 0)
+        e.state = EntryState::ready;
+    else
+        e.stale = true;
+
+    release (entry);
+}
+
+void NoteRenderCache::release (int entry) noexcept
+{
+    auto& e = entries[(size_t) entry];
+    jassert (e.users > 0);
+
+    // An abandoned recording is never complete
+    if (--e.users == 0 && (e.stale || e.state == EntryState::recording))
+        freeEntry (e);
+}
+
+//==============================================================================
+int NoteRenderCache::allocateSlab() noexcept
+{
+    if (freeSlabs < 0 && ! evictLeastRecent())
+        return -1;
+
+    const int slab = freeSlabs;
+    freeSlabs = nextSlab[(size_t) slab];
+    nextSlab[(size_t) slab] = -1;
+    return slab;
+}
+
+bool NoteRenderCache::evictLeastRecent() noexcept
+{
+    Entry* oldest = nullptr;
+
+    for (auto& e : entries)
+        if (e.state == EntryState::ready && e.users == 0
+             && (oldest == nullptr || e.lastUsed < oldest->lastUsed))
+            oldest = &e;
+
+    if (oldest == nullptr)
+        return false;
+
+    freeEntry (*oldest);
+    return true;
+}
+
+void NoteRenderCache::freeEntry (Entry& e) noexcept
+{
+    // Return the chain to the free list in one splice
+    if (e.firstSlab >= 0)
+    {
+        nextSlab[(size_t) e.lastSlab] = freeSlabs;
+        freeSlabs = e.firstSlab;
+    }
+
+    e = Entry();
+}
@@ -0,0 +1,154 @@
+#ifndef EFFEM_UNIT_NOTERENDERCACHE_H
+#define EFFEM_UNIT_NOTERENDERCACHE_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <vector>
+#include "EngineState.h"
+#include "MemoryWarmup.h"
+
+//==============================================================================
+// Opt-in cache of whole one-shot note renders. The first hit of a note at a
+// given velocity on a given patch is recorded while it is synthesised; later
+// identical hits play back from memory instead of running the oscillators,
+// envelope and filter.
+//
+// A voice's output only depends on the note, the velocity and the patch:
+// phases restart and the noise source is reseeded on every note, and cached
+// notes also start from a cleared filter. Entries are keyed on (patch hash,
+// note, quantised velocity) and all of them are dropped when the patch hash
+// changes.
+//
+// Only envelopes that decay to silence on their own (sustain at zero) are
+// cached, so a held note's render is the same however long the key is held.
+// Note-off before the decay has finished still releases the note (see
+// SynthVoice); a recording cut short that way is dropped.
+//
+// Storage is a pool of fixed-size slabs allocated in prepare(); an entry is a
+// chain of slabs and entries are evicted least recently used first. Past
+// prepare() everything runs on the audio thread and never allocates.
+class NoteRenderCache
+{
+public:
+    static constexpr int slabSize = 4096;                  // mono samples
+    static constexpr size_t defaultBudgetBytes = 8 << 20;
+    static constexpr int maxEntries = 256;
+    static constexpr int velocitySteps = 32;
+    static constexpr double maxNoteSeconds = 10.0;
+
+    struct Key
+    {
+        juce::uint64 patch = 0;
+        int note = -1;
+        int velocity = 0;   // 0 .. velocitySteps - 1
+
+        bool operator== (const Key& other) const noexcept
+        {
+            return patch == other.patch && note == other.note && velocity == other.velocity;
+        }
+    };
+
+    static int quantiseVelocity (float velocity) noexcept;
+    static float getVelocityForStep (int step) noexcept;
+
+    // Whether part 1's notes can be cached with this state. Other parts'
+    // notes never are.
+    static bool canCache (const EngineState&) noexcept;
+
+    // FNV-1a over everything that shapes a voice's output
+    class PatchHash
+    {
+    public:
+        PatchHash& add (const EngineState&) noexcept;
+        PatchHash& add (float) noexcept;
+        PatchHash& add (int) noexcept;
+        PatchHash& add (juce::uint64) noexcept;
+
+        juce::uint64 get() const noexcept   { return hash; }
+
+    private:
+        void addBytes (const void*, size_t) noexcept;
+
+        juce::uint64 hash = 0xcbf29ce484222325ull;
+    };
+
+    // Read position inside an entry
+    struct Cursor
+    {
+        int slab = -1;
+        int offset = 0;
+    };
+
+    NoteRenderCache() = default;
+
+    // ===== Message thread =====
+    void prepare (double sampleRate, size_t budgetBytes = defaultBudgetBytes);
+    void warmUp (MemoryWarmup& memory)
+    {
+        memory.add (pool);
+        memory.add (nextSlab);
+        memory.add (entries);
+    }
+
+    // ===== Audio thread =====
+    // Once per block while the cache is in use. A different hash drops every
+    // entry; ones still being played are freed when their voice lets go.
+    void setPatch (juce::uint64 hash) noexcept;
+    juce::uint64 getPatch() const noexcept   { return currentPatch; }
+
+    // Finished render for the key, or -1. A hit holds a reference until release().
+    int find (const Key&) noexcept;
+    Cursor getStart (int entry) const noexcept   { return { entries[(size_t) entry].firstSlab, 0 }; }
+
+    // Copies up to numSamples from the cursor and returns how many there were
+    int read (int entry, Cursor&, float* dest, int numSamples) const noexcept;
+
+    // Starts a new entry, or returns -1 when there is no room or the same key
+    // is already being recorded. The recorder holds a reference.
+    int beginRecording (const Key&) noexcept;
+
+    // Returns false (and drops the entry) when the render outgrows
+    // maxNoteSeconds or the pool
+    bool append (int entry, const float* samples, int numSamples) noexcept;
+    void finishRecording (int entry) noexcept;
+
+    // A player is done, or a recording is abandoned
+    void release (int entry) noexcept;
+
+private:
+    enum class EntryState
+    {
+        empty,
+        recording,
+        ready
+    };
+
+    struct Entry
+    {
+        Key key;
+        EntryState state = EntryState::empty;
+        int firstSlab = -1, lastSlab = -1;
+        juce::int64 length = 0;
+        juce::uint64 lastUsed = 0;
+        int users = 0;
+        bool stale = false;
+    };
+
+    int allocateSlab() noexcept;
+    bool evictLeastRecent() noexcept;
+    void freeEntry (Entry&) noexcept;
+
+    std::vector<float> pool;
+    std::vector<int> nextSlab;          // chain links, and the free list
+    int freeSlabs = -1;
+
+    std::vector<Entry> entries;
+    juce::uint64 clock = 0;
+    juce::uint64 currentPatch = 0;
+    juce::int64 maxNoteSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NoteRenderCache)
+};
+
+#endif //EFFEM_UNIT_NOTERENDERCACHE_H
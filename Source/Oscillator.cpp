@@ -1,113 +1,196 @@
 #include "Oscillator.h"
+#include "SimdKernels.h"
+
+static constexpr juce::int64 noiseSeed = 0x45464645; // fixed, so renders are repeatable
 
 Oscillator::Oscillator() {}
 
-void Oscillator::prepare(double sampleRate, int samplesPerBlock, int channels)
+void Oscillator::prepare(double newSampleRate, int samplesPerBlock, int)
 {
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = channels;
+    sampleRate = newSampleRate;
+    increment.setRampLength(samplesPerBlock);
+    gain.setRampLength(samplesPerBlock);
+
+    // Default frequency until the voice sets one
+    setFrequency(440.0f);
+    reset();
+}
+
+void Oscillator::process(juce::AudioBuffer<float>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+    auto* first = buffer.getWritePointer(0);
+
+    beginBlock(numSamples);
 
-    osc.prepare(spec);
-    gain.prepare(spec);
+    (this->*kernels[(size_t) getSource()])(first, numSamples);
 
-    // Default waveform
-    initWaveform(0);
+    framePosition = frameTarget;
 
-    // Disable smoothing
-    osc.setFrequency(440.0f, true);
+    // Every channel carries the same signal
+    for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+        buffer.copyFrom(ch, 0, first, numSamples);
 }
 
-void Oscillator::process(juce::AudioBuffer<float>& buffer)
+void Oscillator::advance(int numSamples) noexcept
 {
-    juce::dsp::AudioBlock<float> audioBlock(buffer);
-    juce::dsp::ProcessContextReplacing<float> context(audioBlock);
+    gain.next(numSamples);
 
-    osc.process(context);
-    gain.process(context);
+    // Sum of the ramped increments over the block
+    const auto inc = increment.next(numSamples);
+    phase += inc.start * numSamples + inc.step * (0.5 * numSamples * (numSamples - 1));
+    phase -= std::floor(phase);
+    framePosition = frameTarget;
 }
 
+//==============================================================================
+const Oscillator::Kernel Oscillator::kernels[] =
+{
+    &Oscillator::render<Source::noise>,
+    &Oscillator::render<Source::singleFrame>,
+    &Oscillator::render<Source::multiFrame>,
+    &Oscillator::render<Source::crossfade>
+};
+
+Oscillator::Source Oscillator::getSource() const noexcept
+{
+    if (fadeRemaining > 0)
+        return Source::crossfade;
+
+    if (table == nullptr)
+        return Source::noise;
+
+    return table->getNumFrames() == 1 ? Source::singleFrame : Source::multiFrame;
+}
+
+template <Oscillator::Source source>
+void Oscillator::render(float* dest, int numSamples) noexcept
+{
+    if constexpr (source == Source::singleFrame)
+    {
+        // The built-in waveforms: one table, one level, nothing to morph
+        SimdKernels::get().readTable(table->getFrame(level, 0).getData(), WaveTable::size,
+                                     phase, blockIncrement.start, blockIncrement.step,
+                                     blockGain.start, blockGain.step, dest, numSamples);
+    }
+    else if constexpr (source == Source::multiFrame)
+    {
+        const int lastPair = table->getNumFrames() - 2;
+        const float scale  = (float) (table->getNumFrames() - 1);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto pos  = juce::jlimit(0.0f, 1.0f, framePosition) * scale;
+            const auto i0   = juce::jmin((int) pos, lastPair);
+            const auto frac = pos - (float) i0;
+
+            const auto a = table->getFrame(level, i0).lookup(phase);
+            dest[i] = (a + frac * (table->getFrame(level, i0 + 1).lookup(phase) - a)) * blockGain.at(i);
+
+            phase += blockIncrement.at(i);
+            phase -= std::floor(phase);
+            framePosition += frameStep;
+        }
+    }
+    else
+    {
+        // Noise and crossfades keep the general per-sample path
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = nextSample(blockIncrement.at(i)) * blockGain.at(i);
+    }
+}
+
+//==============================================================================
 void Oscillator::setFrequency(float freq)
 {
     baseFrequency = freq;        // store the frequency so FM can modify it later
-    osc.setFrequency(freq, true); // true = no smoothing
+    increment.setTarget((double) freq / sampleRate);
 }
 
 void Oscillator::setGain(float newGain)
 {
-    gain.setGainLinear(newGain);
+    gain.setTarget(newGain);
+}
+
+void Oscillator::setWaveTable(const WaveTableSet* newTable, int crossfadeSamples)
+{
+    if (newTable == table && fadeRemaining == 0)
+        return;
+
+    fadeFromTable = table;
+    table = newTable;
+    fadeLength = fadeRemaining = juce::jmax(0, crossfadeSamples);
 }
 
-void Oscillator::setWaveform(int type)
+void Oscillator::setFramePosition(float position)
 {
-    initWaveform(type);
+    frameTarget = juce::jlimit(0.0f, 1.0f, position);
+}
+
+void Oscillator::beginBlock(int numSamples) noexcept
+{
+    blockGain = gain.next(numSamples);
+    blockIncrement = increment.next(numSamples);
+
+    // A pitch ramp picks the level for its higher end, so it never aliases
+    const auto highest = juce::jmax(blockIncrement.start, blockIncrement.at(juce::jmax(0, numSamples - 1)));
+
+    if (table != nullptr)
+        level = table->getLevelFor(highest);
+
+    if (fadeRemaining > 0 && fadeFromTable != nullptr)
+        fadeFromLevel = fadeFromTable->getLevelFor(highest);
+
+    frameStep = numSamples > 0 ? (frameTarget - framePosition) / (float) numSamples : 0.0f;
 }
 
 void Oscillator::reset()
 {
-    // Reset phase to zero
-    osc.reset();
+    // Reset phase to the start of the cycle
+    phase = 0.0;
+    fadeRemaining = 0;
+    framePosition = frameTarget;
+    increment.finish();
+    gain.finish();
+
+    noiseRandom.setSeed(noiseSeed);
+    noiseSegment = -1;
 }
 
-void Oscillator::initWaveform(int waveformIndex)
+float Oscillator::readSource(const WaveTableSet* source, int sourceLevel, double p) noexcept
 {
-    switch (waveformIndex)
+    if (source != nullptr)
+        return source->lookup(p, sourceLevel, framePosition);
+
+    const auto pos = p * noisePointsPerCycle;
+    const auto segment = (int) pos;
+
+    if (segment != noiseSegment)
     {
-        case 0: // Sine
-            osc.initialise([](float x) { return std::sin(x); }, 128);
-            break;
-
-        case 1: // Square
-            osc.initialise([](float x)
-            {
-                return (x < 0.0f ? -1.0f : 1.0f);
-            }, 2);
-            break;
-
-        case 2: // Saw
-            osc.initialise([](float x)
-            {
-                return juce::jmap(x,
-                                  -juce::MathConstants<float>::pi,
-                                   juce::MathConstants<float>::pi,
-                                  -1.0f, 1.0f);
-            }, 128);
-            break;
-
-        case 3: // Triangle
-            osc.initialise([](float x)
-            {
-                return asinf(std::sin(x)) * (2.0f / juce::MathConstants<float>::pi);
-            }, 128);
-            break;
-
-        case 4: // Noise
-            osc.initialise([](float)
-            {
-                return juce::Random::getSystemRandom().nextFloat() * 2.0f - 1.0f;
-            }, 256);
-            break;
-
-        case 5:
-            osc.initialise([](float x)
-            {
-                return std::sin(x) + 0.3f * std::sin(2.0f * x);
-            }, 128);
-            break;
-
-        case 6:
-            osc.initialise([](float x)
-            {
-                return std::sin(x)
-                       + 0.3f * std::sin(2.0f * x)
-                       + 0.15f * std::sin(3.0f * x);
-            }, 128);
-            break;
-
-        default:
-            osc.initialise([](float x) { return std::sin(x); }, 128);
-            break;
+        noiseFrom = noiseSegment < 0 ? noiseRandom.nextFloat() * 2.0f - 1.0f : noiseTo;
+        noiseTo = noiseRandom.nextFloat() * 2.0f - 1.0f;
+        noiseSegment = segment;
     }
+
+    return noiseFrom + (float) (pos - segment) * (noiseTo - noiseFrom);
+}
+
+inline float Oscillator::nextSample(double sampleIncrement) noexcept
+{
+    float out = readSource(table, level, phase);
+
+    if (fadeRemaining > 0)
+    {
+        const float a = (float) fadeRemaining / (float) fadeLength;
+        out += a * (readSource(fadeFromTable, fadeFromLevel, phase) - out);
+        --fadeRemaining;
+    }
+
+    phase += sampleIncrement;
+    phase -= std::floor(phase);
+    framePosition += frameStep;
+
+    return out;
 }
 
 void Oscillator::processWithFM(juce::AudioBuffer<float>& buffer,
@@ -116,14 +199,16 @@ void Oscillator::processWithFM(juce::AudioBuffer<float>& buffer,
 {
     auto numSamples = buffer.getNumSamples();
 
+    beginBlock(numSamples);
+
     for (int i = 0; i < numSamples; ++i)
     {
         // true FM: change frequency BEFORE generating the sample
-        float freq = baseFrequency + fmBuffer[i] * fmDepth;
+        const double fm = (double) (fmBuffer[i] * fmDepth) / sampleRate;
 
-        osc.setFrequency(freq, false);   // fast update, no smoothing
-
-        float out = osc.processSample(0.0f);
+        float out = nextSample(blockIncrement.at(i) + fm);
         buffer.setSample(0, i, out);
     }
-}
\ No newline at end of file
+
+    framePosition = frameTarget;
+}
@@ -7,6 +7,8 @@
 
 #pragma once
 #include <juce_dsp/juce_dsp.h>
+#include "WaveTable.h"
+#include "ParameterRamp.h"
 
 
 class Oscillator {
@@ -19,32 +21,78 @@ public:
     //call from processBlock
     void process (juce::AudioBuffer<float>& buffer);
 
+    // Continuous controls: each new value is ramped to across the next block
+    // (see ParameterRamp); reset() jumps straight to the latest one
     void setFrequency(float freq);
     void setGain (float newGain);
-    void setWaveform(int type);
+
+    // Switches to a prebuilt table (nullptr = noise). With crossfadeSamples > 0
+    // the old and new tables are blended so the change doesn't click. Never
+    // allocates; the tables are owned by WaveTableCache or the engine state.
+    void setWaveTable (const WaveTableSet* newTable, int crossfadeSamples);
+
+    // Frame morph position in [0, 1], ramped across the next block
+    void setFramePosition (float position);
 
     void reset();
 
+    // Moves the phase on as if numSamples had been rendered, for a voice that
+    // skips a switched-off oscillator but wants it to stay in step
+    void advance (int numSamples) noexcept;
+
     void processWithFM (juce::AudioBuffer<float>& buffer, const float* fmBuffer, float fmDepth);
 
 private:
-    juce::dsp::Oscillator<float> osc;
-    juce::dsp::Gain<float> gain;
-
-    juce::dsp::ProcessSpec spec;
+    double sampleRate = 44100.0;
+    double phase = 0.0;
+    ParameterRamp<double> increment;
+    ParameterRamp<float> gain { 1.0f };
 
     float baseFrequency = 440.0f; // default
 
-    enum Waveforms
+    const WaveTableSet* table = nullptr;
+    const WaveTableSet* fadeFromTable = nullptr;
+    int fadeRemaining = 0;
+    int fadeLength = 0;
+
+    // Per block: mip levels for the current pitch, frame position ramp and
+    // the gain / increment segments the kernels read
+    int level = 0, fadeFromLevel = 0;
+    float framePosition = 0.0f, frameTarget = 0.0f, frameStep = 0.0f;
+    ParameterRamp<float>::Segment blockGain { 1.0f, 0.0f };
+    ParameterRamp<double>::Segment blockIncrement { 0.0, 0.0 };
+
+    void beginBlock (int numSamples) noexcept;
+
+    // Noise: a new random point every 1/256 of a cycle, linearly interpolated
+    // (what the old 256-point random lookup table sounded like)
+    static constexpr int noisePointsPerCycle = 256;
+    juce::Random noiseRandom;
+    float noiseFrom = 0.0f, noiseTo = 0.0f;
+    int noiseSegment = -1;
+
+    float readSource (const WaveTableSet* source, int sourceLevel, double p) noexcept;
+    inline float nextSample (double sampleIncrement) noexcept;
+
+    // Block kernels, one per kind of source. Chosen once per block, so the
+    // per-sample loop doesn't test for noise, frame count or crossfades.
+    enum class Source
     {
-        Sine = 0,
-        Saw,
-        Square,
-        Triangle
+        noise = 0,
+        singleFrame,
+        multiFrame,
+        crossfade,
+        numSources
     };
 
-    void initWaveform (int waveformIndex);
+    template <Source>
+    void render (float* dest, int numSamples) noexcept;
+
+    using Kernel = void (Oscillator::*) (float*, int) noexcept;
+    static const Kernel kernels[(size_t) Source::numSources];
+
+    Source getSource() const noexcept;
 };
 
 
-#endif //EFFEM_UNIT_OSCILLATOR_H
\ No newline at end of file
+#endif //EFFEM_UNIT_OSCILLATOR_H
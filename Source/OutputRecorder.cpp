@@ -0,0 +1,144 @@
+#include "OutputRecorder.h"
+
+//==============================================================================
+OutputRecorder::~OutputRecorder()
+{
+    stop();
+}
+
+void OutputRecorder::prepare (double newSampleRate, int newNumChannels)
+{
+    if (newSampleRate == sampleRate && newNumChannels == numChannels)
+        return;
+
+    stop();
+
+    sampleRate  = newSampleRate;
+    numChannels = newNumChannels;
+
+    const int capacity = (int) std::ceil (sampleRate * ringSeconds);
+    ring.setSize (numChannels, capacity);
+    fifo = std::make_unique<juce::AbstractFifo> (capacity);
+}
+
+//==============================================================================
+juce::Result OutputRecorder::start (const juce::File& outputFile)
+{
+    stop();
+
+    if (fifo == nullptr)
+        return juce::Result::fail ("The plugin hasn't started processing yet");
+
+    std::unique_ptr<juce::AudioFormat> format;
+
+    if (outputFile.hasFileExtension ("flac"))
+        format = std::make_unique<juce::FlacAudioFormat>();
+    else
+        format = std::make_unique<juce::WavAudioFormat>();
+
+    outputFile.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream = std::make_unique<juce::FileOutputStream> (outputFile);
+
+    if (! static_cast<juce::FileOutputStream&> (*stream).openedOk())
+        return juce::Result::fail ("Couldn't open " + outputFile.getFullPathName() + " for writing");
+
+    fileWriter = format->createWriterFor (stream, juce::AudioFormatWriterOptions{}
+                                                      .withSampleRate (sampleRate)
+                                                      .withNumChannels (numChannels)
+                                                      .withBitsPerSample (bitsPerSample));
+
+    if (fileWriter == nullptr)
+        return juce::Result::fail ("Couldn't create a " + format->getFormatName() + " writer");
+
+    // Anything a block pushed while stopping left behind belongs to the
+    // previous take. The audio thread doesn't write while recording is false.
+    fifo->read (fifo->getNumReady());
+
+    overruns.store (0);
+    samplesRecorded.store (0);
+
+    writer = std::make_unique<Writer> (*this);
+    writer->startThread();
+
+    recording.store (true, std::memory_order_release);
+    return juce::Result::ok();
+}
+
+void OutputRecorder::stop()
+{
+    if (! recording.exchange (false))
+        return;
+
+    writer->stopThread (2000);
+    writer.reset();
+
+    drain();
+    fileWriter.reset();   // flushes and finalises the header
+}
+
+double OutputRecorder::getRecordedSeconds() const noexcept
+{
+    return sampleRate > 0.0 ? (double) samplesRecorded.load (std::memory_order_relaxed) / sampleRate : 0.0;
+}
+
+//==============================================================================
+void OutputRecorder::push (const juce::AudioBuffer<float>& buffer, int numSamples) noexcept
+{
+    if (! recording.load (std::memory_order_acquire))
+        return;
+
+    // Only this thread writes, so the free space can only grow under us
+    if (fifo->getFreeSpace() < numSamples)
+    {
+        overruns.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    int start1, size1, start2, size2;
+    fifo->prepareToWrite (numSamples, start1, size1, start2, size2);
+
+    const int channels = juce::jmin (numChannels, buffer.getNumChannels());
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        if (size1 > 0)
+            ring.copyFrom (ch, start1, buffer, ch, 0, size1);
+
+        if (size2 > 0)
+            ring.copyFrom (ch, start2, buffer, ch, size1, size2);
+    }
+
+    // A mono bus recorded into a stereo file
+    for (int ch = channels; ch < numChannels; ++ch)
+    {
+        if (size1 > 0)
+            ring.copyFrom (ch, start1, ring, 0, start1, size1);
+
+        if (size2 > 0)
+            ring.copyFrom (ch, start2, ring, 0, start2, size2);
+    }
+
+    fifo->finishedWrite (size1 + size2);
+    samplesRecorded.fetch_add (size1 + size2, std::memory_order_relaxed);
+}
+
+//==============================================================================
+void OutputRecorder::Writer::run()
+{
+    while (! threadShouldExit())
+    {
+        owner.drain();
+        wait (50);
+    }
+}
+
+void OutputRecorder::drain()
+{
+    const auto scope = fifo->read (fifo->getNumReady());
+
+    if (scope.blockSize1 > 0)
+        fileWriter->writeFromAudioSampleBuffer (ring, scope.startIndex1, scope.blockSize1);
+
+    if (scope.blockSize2 > 0)
+        fileWriter->writeFromAudioSampleBuffer (ring, scope.startIndex2, scope.blockSize2);
+}
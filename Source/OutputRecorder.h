@@ -0,0 +1,75 @@
+#ifndef EFFEM_UNIT_OUTPUTRECORDER_H
+#define EFFEM_UNIT_OUTPUTRECORDER_H
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <atomic>
+#include "MemoryWarmup.h"
+
+//==============================================================================
+// Records the plugin's final output to a WAV or FLAC file.
+//
+// The audio thread copies each block into a ring sized in prepare() and
+// never touches the file. A writer thread drains the ring to disk. If the
+// disk falls further behind than the ring holds, whole blocks are dropped and
+// counted as overruns rather than stalling the audio thread.
+class OutputRecorder
+{
+public:
+    static constexpr double ringSeconds = 4.0;
+    static constexpr int bitsPerSample = 24;
+
+    OutputRecorder() = default;
+    ~OutputRecorder();
+
+    // ===== Message thread =====
+    // Sizes the ring. A recording in progress is stopped if the rate or
+    // channel count changes, since the file can't follow it.
+    void prepare (double sampleRate, int numChannels);
+    void warmUp (MemoryWarmup& memory)   { memory.add (ring); }
+
+    // FLAC for a .flac file, WAV otherwise
+    juce::Result start (const juce::File& outputFile);
+    void stop();
+    bool isRecording() const noexcept { return recording.load (std::memory_order_relaxed); }
+
+    // Blocks dropped because the ring was full, since start()
+    int getOverrunCount() const noexcept { return overruns.load (std::memory_order_relaxed); }
+
+    // Seconds written to the ring since start()
+    double getRecordedSeconds() const noexcept;
+
+    // ===== Audio thread =====
+    void push (const juce::AudioBuffer<float>& buffer, int numSamples) noexcept;
+
+private:
+    //==============================================================================
+    class Writer : public juce::Thread
+    {
+    public:
+        explicit Writer (OutputRecorder& o) : juce::Thread ("EFFEM output recorder"), owner (o) {}
+        void run() override;
+
+    private:
+        OutputRecorder& owner;
+    };
+
+    void drain();
+
+    juce::AudioBuffer<float> ring;
+    std::unique_ptr<juce::AbstractFifo> fifo;
+    std::unique_ptr<Writer> writer;
+    std::unique_ptr<juce::AudioFormatWriter> fileWriter;
+
+    std::atomic<bool> recording { false };
+    std::atomic<int> overruns { 0 };
+    std::atomic<juce::int64> samplesRecorded { 0 };
+
+    double sampleRate = 0.0;
+    int numChannels = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (OutputRecorder)
+};
+
+#endif //EFFEM_UNIT_OUTPUTRECORDER_H
@@ -0,0 +1,83 @@
+#ifndef EFFEM_UNIT_PARAMETERRAMP_H
+#define EFFEM_UNIT_PARAMETERRAMP_H
+
+#pragma once
+
+//==============================================================================
+// A continuous control that moves linearly to each new target over a fixed
+// ramp length (one block), instead of stepping at the block boundary.
+//
+// The DSP consumes it a sub-block at a time as a Segment: value[i] =
+// start + step * i. Kernels compute that per sample themselves, so nothing
+// calls a setter per sample, and a flat segment (step 0) gives exactly the
+// same values as the constant it replaces. SimdKernels take the segment as
+// plain start / step arguments, since they may not share inline code.
+template <typename T>
+class ParameterRamp
+{
+public:
+    struct Segment
+    {
+        T start, step;
+
+        T at (int i) const noexcept   { return start + step * (T) i; }
+    };
+
+    ParameterRamp() = default;
+    explicit ParameterRamp (T initial) : current (initial), target (initial) {}
+
+    void setRampLength (int numSamples) noexcept   { rampLength = numSamples > 1 ? numSamples : 1; }
+
+    // Starts a ramp from wherever the last one got to
+    void setTarget (T newTarget) noexcept
+    {
+        if (newTarget != target)
+        {
+            target = newTarget;
+            remaining = rampLength;
+        }
+    }
+
+    // Skips any ramp in progress, e.g. at note-on
+    void setCurrentAndTarget (T value) noexcept
+    {
+        current = target = value;
+        remaining = 0;
+    }
+
+    void finish() noexcept   { setCurrentAndTarget (target); }
+
+    T getTarget() const noexcept    { return target; }
+    bool isRamping() const noexcept { return remaining > 0; }
+
+    // The next numSamples of the ramp. A ramp with fewer samples left than
+    // that finishes within them, so it always ends exactly on its target.
+    Segment next (int numSamples) noexcept
+    {
+        if (remaining <= 0 || numSamples <= 0)
+            return { target, T() };
+
+        const int length = remaining > numSamples ? remaining : numSamples;
+        const Segment segment { current, (target - current) / (T) length };
+
+        if (remaining > numSamples)
+        {
+            current += segment.step * (T) numSamples;
+            remaining -= numSamples;
+        }
+        else
+        {
+            current = target;
+            remaining = 0;
+        }
+
+        return segment;
+    }
+
+private:
+    T current {}, target {};
+    int remaining = 0;
+    int rampLength = 1;
+};
+
+#endif //EFFEM_UNIT_PARAMETERRAMP_H
@@ -9,26 +9,117 @@ static void configureSliderTwoDecimals(juce::Slider& s)
 WaveformDisplay::WaveformDisplay(AudioPluginAudioProcessor& p)
     : processor(p)
 {
-    startTimerHz(60); // redraw at 60fps
+    setOpaque(true);
+    refreshHub->add(this);
+}
+
+WaveformDisplay::~WaveformDisplay()
+{
+    refreshHub->remove(this);
+}
+
+SpectrumDisplay::SpectrumDisplay(SpectrumAnalyzer& a)
+    : analyzer(a)
+{
+    setOpaque(true);
+    analyzer.addViewer();
+    refreshHub->add(this);
+}
+
+SpectrumDisplay::~SpectrumDisplay()
+{
+    refreshHub->remove(this);
+    analyzer.removeViewer();
+}
+
+ProfilerOverlay::ProfilerOverlay(AudioPluginAudioProcessor& p)
+    : processor(p)
+{
+    setInterceptsMouseClicks(false, false);
+    startTimerHz(4);
 }
 
 //==============================================================================
+// Editor-only session state
+static const juce::Identifier editorType         { "EDITOR" };
+static const juce::Identifier editorEffectsShown { "effectsShown" };
+
 AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAudioProcessor& p)
-    : AudioProcessorEditor (&p), processorRef (p), waveformDisplay(p)
+    : AudioProcessorEditor (&p), waveformDisplay(p), processorRef (p), profilerOverlay(p),
+      spectrumDisplay(p.getSpectrumAnalyzer())
 {
-    setSize (850, 780);
-
-    auto& state = processorRef.getState();
+    setOpaque (true);
+    setSize (850, 1060);
 
     addAndMakeVisible(waveformDisplay);
+    addAndMakeVisible(profilerOverlay);
+    addAndMakeVisible(spectrumDisplay);
+
+    // =========================================================
+    // PRESETS
+    // =========================================================
+    presetBox.setTextWhenNothingSelected("No presets");
+    presetBox.onChange = [this]
+    {
+        if (presetBox.getSelectedId() > 0)
+            processorRef.setCurrentProgram(presetBox.getSelectedId() - 1);
+    };
+    addAndMakeVisible(presetBox);
+
+    savePresetButton.onClick = [this] { showSavePresetDialog(); };
+    addAndMakeVisible(savePresetButton);
+
+    // Picks up presets saved by another process since the bank was opened
+    processorRef.getPresetBank().addChangeListener(this);
+    processorRef.getPresetBank().refresh();
+    refreshPresetList();
+
+    tuningButton.setButtonText(processorRef.getTuningName());
+    tuningButton.setTooltip("Tuning (Scala .scl / .kbm)");
+    tuningButton.onClick = [this] { showTuningMenu(); };
+    addAndMakeVisible(tuningButton);
+
+    sampleKitButton.setTooltip("Sample layer (WAV / AIFF / FLAC)");
+    sampleKitButton.onClick = [this] { showSampleKitMenu(); };
+    addAndMakeVisible(sampleKitButton);
+
+    partsButton.setTooltip("Multitimbral parts: a patch per MIDI channel, sharing one voice pool");
+    partsButton.onClick = [this] { showPartsMenu(); };
+    addAndMakeVisible(partsButton);
+    updatePartsButton();
+
+    engineRateBox.addItem("Host rate", 1);
+    engineRateBox.addItem("Engine 48k", 2);
+    engineRateBox.addItem("Engine 96k", 3);
+    engineRateBox.setTooltip("Run the voices at a fixed internal rate and resample to a faster host rate");
+    engineRateBox.setSelectedId(processorRef.getEngineRate() == 96000 ? 3
+                                : processorRef.getEngineRate() == 48000 ? 2 : 1,
+                                juce::dontSendNotification);
+    engineRateBox.onChange = [this]
+    {
+        const int id = engineRateBox.getSelectedId();
+        processorRef.setEngineRate(id == 3 ? 96000 : id == 2 ? 48000 : 0);
+    };
+    addAndMakeVisible(engineRateBox);
+
+    lockMemoryButton.setTooltip("Keep the audio buffers locked in RAM so they can't be paged out");
+    lockMemoryButton.setToggleState(processorRef.isMemoryLockingEnabled(), juce::dontSendNotification);
+    lockMemoryButton.onClick = [this] { toggleMemoryLocking(); };
+    addAndMakeVisible(lockMemoryButton);
+
+    renderCacheButton.setTooltip("Replay repeated one-shot notes from memory (patches with zero sustain)");
+    addAndMakeVisible(renderCacheButton);
+    updateSampleKitButton();
+
+    recordButton.setTooltip("Record the plugin's output to a WAV or FLAC file");
+    recordButton.onClick = [this] { toggleRecording(); };
+    addAndMakeVisible(recordButton);
+    updateRecordButton();
 
     // =========================================================
     // PLAY BUTTON
     // =========================================================
     addAndMakeVisible (playButton);
-    playAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::ButtonAttachment>(
-            state, "play", playButton);
 
     // =========================================================
     // GLOBAL CONTROLS
@@ -38,28 +129,16 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     masterGainSlider.setSliderStyle (juce::Slider::LinearHorizontal);
     masterGainSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible (masterGainSlider);
-    addAndMakeVisible (masterGainLabel);
-    masterGainAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "masterGain", masterGainSlider);
 
     // Pan (horizontal, lives in filter row)
     panSlider.setSliderStyle (juce::Slider::LinearHorizontal);
     panSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible (panSlider);
-    addAndMakeVisible (panLabel);
-    panAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "pan", panSlider);
 
     // Global FM amount (if you keep it)
     fmSlider.setSliderStyle (juce::Slider::LinearHorizontal);
     fmSlider.setTextBoxStyle (juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible (fmSlider);
-    addAndMakeVisible (fmLabel);
-    fmAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "fmAmount", fmSlider);
 
     configureSliderTwoDecimals(detuneSlider);
     configureSliderTwoDecimals(panSlider);
@@ -71,38 +150,18 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     attackSlider.setSliderStyle(juce::Slider::LinearVertical);
     attackSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 16);
     addAndMakeVisible(attackSlider);
-    addAndMakeVisible(attackLabel);
-
-    attackAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "attack", attackSlider);
 
     decaySlider.setSliderStyle(juce::Slider::LinearVertical);
     decaySlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 16);
     addAndMakeVisible(decaySlider);
-    addAndMakeVisible(decayLabel);
-
-    decayAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "decay", decaySlider);
 
     sustainSlider.setSliderStyle(juce::Slider::LinearVertical);
     sustainSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 16);
     addAndMakeVisible(sustainSlider);
-    addAndMakeVisible(sustainLabel);
-
-    sustainAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "sustain", sustainSlider);
 
     releaseSlider.setSliderStyle(juce::Slider::LinearVertical);
     releaseSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 16);
     addAndMakeVisible(releaseSlider);
-    addAndMakeVisible(releaseLabel);
-
-    releaseAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "release", releaseSlider);
 
     configureSliderTwoDecimals(attackSlider);
     configureSliderTwoDecimals(decaySlider);
@@ -113,42 +172,39 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     // FILTER SECTION (with Pan)
     // =========================================================
 
-    filterLabel.setText("Filter", juce::dontSendNotification);
-    filterLabel.setJustificationType(juce::Justification::centred);
-    addAndMakeVisible(filterLabel);
+    driveType.addItem("Tanh", 1);
+    driveType.addItem("Hard Clip", 2);
+    driveType.addItem("Foldback", 3);
+    addAndMakeVisible(driveType);
+
+    driveSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    driveSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 50, 20);
+    addAndMakeVisible(driveSlider);
 
     filterType.addItem("Lowpass", 1);
     filterType.addItem("Highpass", 2);
     filterType.addItem("Bandpass", 3);
     addAndMakeVisible(filterType);
 
-    filterTypeAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
-            state, "filterType", filterType);
+    filterModel.addItem("State Variable", 1);
+    filterModel.addItem("Ladder", 2);
+    filterModel.addItem("Formant", 3);
+    filterModel.addItem("Comb", 4);
+    addAndMakeVisible(filterModel);
 
     cutoffSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     cutoffSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(cutoffSlider);
-    addAndMakeVisible(cutoffLabel);
-
-    cutoffAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "filterCutoff", cutoffSlider);
 
     resonanceSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     resonanceSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(resonanceSlider);
-    addAndMakeVisible(resonanceLabel);
-
-    resonanceAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "filterResonance", resonanceSlider);
 
     // =========================================================
     // OSCILLATOR 1
     // =========================================================
 
-    osc1WaveBox.addItemList({ "Sine","Square","Saw","Triangle","Noise","Add1","Add2" }, 1);
+    osc1WaveBox.addItemList({ "Sine","Square","Saw","Triangle","Noise","Add1","Add2","User" }, 1);
     addAndMakeVisible(osc1WaveBox);
 
     osc1PitchBox.addItem("-12", 1);
@@ -158,12 +214,6 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     osc1PitchBox.addItem("+12",5);
     addAndMakeVisible(osc1PitchBox);
 
-    addAndMakeVisible(osc1GainLabel);
-    addAndMakeVisible(osc1DetuneLabel);
-    addAndMakeVisible(osc1FmLabel);
-    addAndMakeVisible(osc1PitchLabel);
-    addAndMakeVisible(osc1WaveLabel);
-
     detune1Slider.setSliderStyle(juce::Slider::LinearVertical);
     detune1Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(detune1Slider);
@@ -176,31 +226,18 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     fm1Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(fm1Slider);
 
-    osc1WaveAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
-            state, "osc1Wave", osc1WaveBox);
-
-    osc1PitchAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
-            state, "osc1Pitch", osc1PitchBox);
-
-    osc1DetuneAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "osc1Detune", detune1Slider);
-
-    osc1GainAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "osc1Gain", gain1Slider);
+    wtPos1Slider.setSliderStyle(juce::Slider::LinearVertical);
+    wtPos1Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
+    addAndMakeVisible(wtPos1Slider);
 
-    osc1FmAttachment = std::make_unique<
-        juce::AudioProcessorValueTreeState::SliderAttachment>(
-            state, "osc1FM", fm1Slider);
+    loadTable1Button.onClick = [this] { chooseWaveTable(0); };
+    addAndMakeVisible(loadTable1Button);
 
     // =========================================================
     // OSCILLATOR 2
     // =========================================================
 
-    osc2WaveBox.addItemList({ "Sine","Square","Saw","Triangle","Noise","Add1","Add2" }, 1);
+    osc2WaveBox.addItemList({ "Sine","Square","Saw","Triangle","Noise","Add1","Add2","User" }, 1);
     addAndMakeVisible(osc2WaveBox);
 
     osc2PitchBox.addItem("-12", 1);
@@ -210,12 +247,6 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     osc2PitchBox.addItem("+12",5);
     addAndMakeVisible(osc2PitchBox);
 
-    addAndMakeVisible(osc2GainLabel);
-    addAndMakeVisible(osc2DetuneLabel);
-    addAndMakeVisible(osc2FmLabel);
-    addAndMakeVisible(osc2PitchLabel);
-    addAndMakeVisible(osc2WaveLabel);
-
     detune2Slider.setSliderStyle(juce::Slider::LinearVertical);
     detune2Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(detune2Slider);
@@ -228,6 +259,140 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
     fm2Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
     addAndMakeVisible(fm2Slider);
 
+    wtPos2Slider.setSliderStyle(juce::Slider::LinearVertical);
+    wtPos2Slider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
+    addAndMakeVisible(wtPos2Slider);
+
+    loadTable2Button.onClick = [this] { chooseWaveTable(1); };
+    addAndMakeVisible(loadTable2Button);
+
+    updateWaveTableButtons();
+
+    // =========================================================
+    // BLEND SLIDER (between the two oscillators)
+    // =========================================================
+
+    blendSlider.setSliderStyle(juce::Slider::LinearHorizontal);
+    blendSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
+    addAndMakeVisible(blendSlider);
+
+    // Before the first paint, so no control shows its default first
+    attachControls();
+
+    // =========================================================
+    // EFFECTS RACK (built when first shown)
+    // =========================================================
+    effectsButton.setTooltip("Show the chorus, delay, reverb and convolution controls");
+    effectsButton.onClick = [this] { showEffects(); };
+    addAndMakeVisible(effectsButton);
+
+    if ((bool) processorRef.getState().state.getChildWithName(editorType)[editorEffectsShown])
+        showEffects();
+}
+
+void AudioPluginAudioProcessorEditor::showEffects()
+{
+    if (effectsPanel == nullptr)
+    {
+        effectsPanel = std::make_unique<EffectsPanel>(processorRef);
+        effectsPanel->setBounds(effectsArea);
+        addAndMakeVisible(*effectsPanel);
+    }
+
+    effectsButton.setVisible(false);
+
+    processorRef.getState().state.getOrCreateChildWithName(editorType, nullptr)
+                                 .setProperty(editorEffectsShown, true, nullptr);
+}
+
+void AudioPluginAudioProcessorEditor::attachControls()
+{
+    auto& state = processorRef.getState();
+
+    renderCacheAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ButtonAttachment>(
+            state, "renderCache", renderCacheButton);
+
+    playAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ButtonAttachment>(
+            state, "play", playButton);
+
+    masterGainAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "masterGain", masterGainSlider);
+
+    panAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "pan", panSlider);
+
+    fmAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "fmAmount", fmSlider);
+
+    attackAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "attack", attackSlider);
+
+    decayAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "decay", decaySlider);
+
+    sustainAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "sustain", sustainSlider);
+
+    releaseAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "release", releaseSlider);
+
+    driveTypeAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "driveType", driveType);
+
+    driveAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "drive", driveSlider);
+
+    filterTypeAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "filterType", filterType);
+
+    filterModelAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "filterModel", filterModel);
+
+    cutoffAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "filterCutoff", cutoffSlider);
+
+    resonanceAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "filterResonance", resonanceSlider);
+
+    osc1WaveAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "osc1Wave", osc1WaveBox);
+
+    osc1PitchAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "osc1Pitch", osc1PitchBox);
+
+    osc1DetuneAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "osc1Detune", detune1Slider);
+
+    osc1GainAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "osc1Gain", gain1Slider);
+
+    osc1FmAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "osc1FM", fm1Slider);
+
+    osc1WtPosAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "osc1WtPos", wtPos1Slider);
+
     osc2WaveAttachment = std::make_unique<
         juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
             state, "osc2Wave", osc2WaveBox);
@@ -248,82 +413,804 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor (AudioPluginAud
         juce::AudioProcessorValueTreeState::SliderAttachment>(
             state, "osc2FM", fm2Slider);
 
-    // =========================================================
-    // BLEND SLIDER (between the two oscillators)
-    // =========================================================
-
-    blendLabel.setJustificationType(juce::Justification::centred);
-    addAndMakeVisible(blendLabel);
-
-    blendSlider.setSliderStyle(juce::Slider::LinearHorizontal);
-    blendSlider.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 20);
-    addAndMakeVisible(blendSlider);
+    osc2WtPosAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::SliderAttachment>(
+            state, "osc2WtPos", wtPos2Slider);
 
     blendAttachment = std::make_unique<
         juce::AudioProcessorValueTreeState::SliderAttachment>(
             state, "oscBlend", blendSlider);
+}
 
-    // =============== LABEL STYLING ================= //
-    for (auto* label : {
-        &masterGainLabel, &detuneLabel, &pitchShiftLabel,
-        &panLabel, &fmLabel, &attackLabel, &decayLabel,
-        &sustainLabel, &releaseLabel, &filterLabel,
-        &cutoffLabel, &resonanceLabel, &blendLabel,
-        &osc1GainLabel, &osc1DetuneLabel, &osc1FmLabel,
-        &osc1PitchLabel, &osc1WaveLabel,
-        &osc2GainLabel, &osc2DetuneLabel, &osc2FmLabel,
-        &osc2PitchLabel, &osc2WaveLabel
-    })
+AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor()
+{
+    processorRef.getPresetBank().removeChangeListener(this);
+}
+
+void AudioPluginAudioProcessorEditor::refreshPresetList()
+{
+    auto& bank = processorRef.getPresetBank();
+
+    presetBox.clear(juce::dontSendNotification);
+
+    for (int i = 0; i < bank.getNumPresets(); ++i)
+        presetBox.addItem(bank.getPresetName(i), i + 1);
+
+    if (bank.getNumPresets() > 0)
+        presetBox.setSelectedId(processorRef.getCurrentProgram() + 1, juce::dontSendNotification);
+}
+
+void AudioPluginAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster*)
+{
+    refreshPresetList();
+}
+
+void AudioPluginAudioProcessorEditor::showSavePresetDialog()
+{
+    const auto defaultName = "Preset " + juce::String(processorRef.getPresetBank().getNumPresets() + 1);
+
+    savePresetWindow = std::make_unique<juce::AlertWindow>("Save preset", "Preset name:",
+                                                           juce::MessageBoxIconType::NoIcon);
+    savePresetWindow->addTextEditor("name", defaultName);
+    savePresetWindow->addButton("Save", 1, juce::KeyPress(juce::KeyPress::returnKey));
+    savePresetWindow->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+
+    savePresetWindow->enterModalState(true, juce::ModalCallbackFunction::create([this](int result)
+    {
+        if (result == 1)
+        {
+            auto name = savePresetWindow->getTextEditorContents("name").trim();
+
+            // Other editors refresh from the bank's change message; this one
+            // again here, to select the new preset
+            if (name.isNotEmpty() && processorRef.saveCurrentAsPreset(name))
+                refreshPresetList();
+        }
+
+        savePresetWindow.reset();
+    }));
+}
+
+void AudioPluginAudioProcessorEditor::showTuningMenu()
+{
+    tuningButton.setButtonText(processorRef.getTuningName());
+
+    juce::PopupMenu menu;
+    menu.addItem(1, "Load Scala scale...");
+    menu.addItem(2, "Reset to 12-TET");
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(tuningButton), [this](int result)
+    {
+        if (result == 1)
+            chooseTuningFiles();
+        else if (result == 2)
+        {
+            processorRef.resetTuning();
+            tuningButton.setButtonText(processorRef.getTuningName());
+        }
+    });
+}
+
+void AudioPluginAudioProcessorEditor::updatePartsButton()
+{
+    if (! processorRef.isMultitimbral())
+    {
+        partsButton.setButtonText("1 part");
+        return;
+    }
+
+    int enabled = 0;
+
+    for (int part = 0; part < EngineState::maxParts; ++part)
+        if (processorRef.isPartEnabled(part))
+            ++enabled;
+
+    partsButton.setButtonText(juce::String(enabled) + " parts");
+}
+
+void AudioPluginAudioProcessorEditor::showPartsMenu()
+{
+    auto& bank = processorRef.getPresetBank();
+    const bool multitimbral = processorRef.isMultitimbral();
+
+    juce::PopupMenu menu;
+    menu.addItem("Multitimbral", true, multitimbral, [this, multitimbral]
+    {
+        processorRef.setMultitimbral(! multitimbral);
+        updatePartsButton();
+    });
+    menu.addSeparator();
+
+    for (int part = 0; part < EngineState::maxParts; ++part)
     {
-        label->setColour (juce::Label::textColourId, juce::Colours::white);
-        label->setJustificationType (juce::Justification::centred);
+        juce::PopupMenu partMenu, channelMenu;
+
+        for (int channel = 1; channel <= 16; ++channel)
+            channelMenu.addItem("Channel " + juce::String(channel), true,
+                                processorRef.getPartChannel(part) == channel,
+                                [this, part, channel] { processorRef.setPartChannel(part, channel); });
+
+        partMenu.addSubMenu("MIDI channel", channelMenu);
+
+        if (part > 0)
+        {
+            const bool enabled = processorRef.isPartEnabled(part);
+            const bool ownOutput = processorRef.hasPartOwnOutput(part);
+
+            juce::PopupMenu presetMenu;
+
+            for (int i = 0; i < bank.getNumPresets(); ++i)
+                presetMenu.addItem(bank.getPresetName(i), [this, part, i]
+                {
+                    processorRef.loadPresetIntoPart(part, i);
+                    updatePartsButton();
+                });
+
+            partMenu.addItem("Enabled", true, enabled, [this, part, enabled]
+            {
+                processorRef.setPartEnabled(part, ! enabled);
+                updatePartsButton();
+            });
+            partMenu.addItem("Own output (Part " + juce::String(part + 1) + " bus)", true, ownOutput,
+                             [this, part, ownOutput] { processorRef.setPartOwnOutput(part, ! ownOutput); });
+            partMenu.addSeparator();
+            partMenu.addItem("Copy current sound", [this, part]
+            {
+                processorRef.copySoundToPart(part);
+                updatePartsButton();
+            });
+            partMenu.addSubMenu("Load preset", presetMenu, bank.getNumPresets() > 0);
+        }
+
+        auto name = processorRef.getPartName(part);
+        auto title = "Part " + juce::String(part + 1) + (name.isNotEmpty() ? ": " + name : juce::String());
+
+        menu.addSubMenu(title, partMenu, multitimbral, juce::Image(), processorRef.isPartEnabled(part));
     }
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(partsButton));
 }
 
-AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor() = default;
+void AudioPluginAudioProcessorEditor::updateSampleKitButton()
+{
+    const auto name = processorRef.getSampleKitName();
+    sampleKitButton.setButtonText(name.isNotEmpty() ? name : "No samples");
+}
+
+void AudioPluginAudioProcessorEditor::showSampleKitMenu()
+{
+    updateSampleKitButton();
+
+    juce::PopupMenu menu;
+    menu.addItem(1, "Load drum kit folder...");
+    menu.addItem(2, "Load single sample...");
+    menu.addItem(3, "Clear", processorRef.getSampleKitName().isNotEmpty());
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(sampleKitButton), [this](int result)
+    {
+        if (result == 1 || result == 2)
+            chooseSampleKit(result == 1);
+        else if (result == 3)
+        {
+            processorRef.clearSampleKit();
+            updateSampleKitButton();
+        }
+    });
+}
+
+void AudioPluginAudioProcessorEditor::chooseSampleKit(bool folder)
+{
+    sampleKitChooser = std::make_unique<juce::FileChooser>(folder ? "Load drum kit folder" : "Load sample",
+                                                           juce::File(), folder ? "" : "*.wav;*.aif;*.aiff;*.flac");
+
+    const auto flags = juce::FileBrowserComponent::openMode
+                     | (folder ? juce::FileBrowserComponent::canSelectDirectories
+                               : juce::FileBrowserComponent::canSelectFiles);
+
+    sampleKitChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+    {
+        const auto file = chooser.getResult();
+
+        if (file == juce::File())
+            return;
+
+        const auto result = processorRef.loadSampleKit(file);
+
+        if (result.failed())
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Couldn't load samples", result.getErrorMessage());
+
+        updateSampleKitButton();
+    });
+}
+
+void AudioPluginAudioProcessorEditor::updateRecordButton()
+{
+    const bool recording = processorRef.getOutputRecorder().isRecording();
+    recordButton.setButtonText(recording ? "Stop" : "Rec");
+    recordButton.setColour(juce::TextButton::buttonColourId,
+                           recording ? juce::Colours::darkred
+                                     : getLookAndFeel().findColour(juce::TextButton::buttonColourId));
+}
+
+void AudioPluginAudioProcessorEditor::toggleRecording()
+{
+    auto& recorder = processorRef.getOutputRecorder();
+
+    if (recorder.isRecording())
+    {
+        recorder.stop();
+        updateRecordButton();
+        return;
+    }
+
+    const auto defaultFile = juce::File::getSpecialLocation(juce::File::userMusicDirectory)
+                                 .getNonexistentChildFile("EFFEM take", ".wav");
+
+    recordChooser = std::make_unique<juce::FileChooser>("Record output to", defaultFile, "*.wav;*.flac");
+
+    recordChooser->launchAsync(juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles
+                                 | juce::FileBrowserComponent::warnAboutOverwriting,
+                               [this](const juce::FileChooser& chooser)
+    {
+        const auto file = chooser.getResult();
+
+        if (file == juce::File())
+            return;
+
+        const auto result = processorRef.getOutputRecorder().start(file);
+
+        if (result.failed())
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Couldn't start recording", result.getErrorMessage());
+
+        updateRecordButton();
+    });
+}
+
+void AudioPluginAudioProcessorEditor::toggleMemoryLocking()
+{
+    const bool shouldLock = lockMemoryButton.getToggleState();
+    processorRef.setMemoryLocking(shouldLock);
+
+    const auto locked = processorRef.getLockedMemoryBytes();
+    const auto total  = processorRef.getWarmedMemoryBytes();
+
+    // The setting is kept either way; the OS may allow more next time
+    if (shouldLock && locked < total)
+        juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                               "Couldn't lock all memory",
+                                               "Locked " + juce::File::descriptionOfSizeInBytes((juce::int64) locked)
+                                                 + " of " + juce::File::descriptionOfSizeInBytes((juce::int64) total)
+                                                 + ". The system's locked-memory limit is too low for the rest.");
+}
+
+void AudioPluginAudioProcessorEditor::updateWaveTableButtons()
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        const auto name = processorRef.getWaveTableName(i);
+        (i == 0 ? loadTable1Button : loadTable2Button).setButtonText(name.isNotEmpty() ? name : "Load table...");
+    }
+}
+
+// Loads a single-cycle or multi-frame WAV for the "User" waveform and selects it
+void AudioPluginAudioProcessorEditor::chooseWaveTable(int oscIndex)
+{
+    waveTableChooser = std::make_unique<juce::FileChooser>("Load wavetable", juce::File(), "*.wav;*.aif;*.aiff;*.flac");
+
+    waveTableChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                                  [this, oscIndex](const juce::FileChooser& chooser)
+    {
+        const auto file = chooser.getResult();
+
+        if (file == juce::File())
+            return;
+
+        const auto result = processorRef.loadWaveTable(oscIndex, file);
+
+        if (result.failed())
+        {
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Couldn't load wavetable", result.getErrorMessage());
+            return;
+        }
+
+        auto* wave = processorRef.getState().getParameter(oscIndex == 0 ? "osc1Wave" : "osc2Wave");
+        wave->beginChangeGesture();
+        wave->setValueNotifyingHost(wave->convertTo0to1((float) WaveTableCache::user));
+        wave->endChangeGesture();
+
+        updateWaveTableButtons();
+    });
+}
+
+// Pick a .scl, optionally together with a .kbm keyboard mapping
+void AudioPluginAudioProcessorEditor::chooseTuningFiles()
+{
+    tuningChooser = std::make_unique<juce::FileChooser>("Load tuning", juce::File(), "*.scl;*.kbm");
+
+    const auto flags = juce::FileBrowserComponent::openMode
+                     | juce::FileBrowserComponent::canSelectFiles
+                     | juce::FileBrowserComponent::canSelectMultipleItems;
+
+    tuningChooser->launchAsync(flags, [this](const juce::FileChooser& chooser)
+    {
+        juce::File scale, mapping;
+
+        for (auto& f : chooser.getResults())
+        {
+            if (f.hasFileExtension("scl"))      scale = f;
+            else if (f.hasFileExtension("kbm")) mapping = f;
+        }
+
+        if (scale == juce::File())
+            return;
+
+        const auto result = processorRef.loadTuning(scale, mapping);
+
+        if (result.failed())
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Couldn't load tuning", result.getErrorMessage());
+
+        tuningButton.setButtonText(processorRef.getTuningName());
+    });
+}
 
 //==============================================================================
 
 
 void WaveformDisplay::paint(juce::Graphics& g) {
+    if (image.isValid())
+        g.drawImageAt(image, 0, 0);
+    else
+        g.fillAll(juce::Colours::black);
+}
+
+void WaveformDisplay::resized()
+{
+    const int w = juce::jmax(1, getWidth());
+
+    image = juce::Image(juce::Image::RGB, w, juce::jmax(1, getHeight()), true);
+    columnMin.assign((size_t) w, 0.0f);
+    columnMax.assign((size_t) w, 0.0f);
+
+    // Redraw the last frame at the new size
+    computeColumns(processor.getScopeFrames().getReadBuffer());
+    renderImage();
+}
+
+void WaveformDisplay::refresh()
+{
+    if (! processor.getScopeFrames().fetch())
+        return;
+
+    computeColumns(processor.getScopeFrames().getReadBuffer());
+    renderImage();
+    repaint();
+}
+
+// Min/max of the samples under each pixel column. Neighbouring columns share
+// their edge sample so the trace stays connected when zoomed in.
+void WaveformDisplay::computeColumns(const AudioPluginAudioProcessor::ScopeFrame& frame)
+{
+    const int w = (int) columnMin.size();
+    const int n = AudioPluginAudioProcessor::scopeSize;
+
+    for (int x = 0; x < w; ++x)
+    {
+        const int start = juce::jmin(n - 1, x * n / w);
+        const int end   = juce::jmin(n, (x + 1) * n / w + 1);
+
+        const auto range = juce::FloatVectorOperations::findMinAndMax(frame.data() + start, juce::jmax(1, end - start));
+        columnMin[(size_t) x] = range.getStart();
+        columnMax[(size_t) x] = range.getEnd();
+    }
+}
+
+void WaveformDisplay::renderImage()
+{
+    if (! image.isValid())
+        return;
+
+    juce::Graphics g(image);
     g.fillAll(juce::Colours::black);
+    g.setColour(juce::Colours::orange);
+
+    const float h = (float) image.getHeight();
+
+    for (int x = 0; x < (int) columnMin.size(); ++x)
+    {
+        const float top    = juce::jmap(juce::jlimit(-1.f, 1.f, columnMax[(size_t) x]), -1.f, 1.f, h, 0.f);
+        const float bottom = juce::jmap(juce::jlimit(-1.f, 1.f, columnMin[(size_t) x]), -1.f, 1.f, h, 0.f);
+
+        // keep the 2 px trace thickness of the old stroked path
+        const float mid = (top + bottom) * 0.5f;
+        g.fillRect(juce::Rectangle<float>((float) x, juce::jmin(top, mid - 1.0f),
+                                          1.0f, juce::jmax(bottom - top, 2.0f)));
+    }
+}
+
+//==============================================================================
+void SpectrumDisplay::paint(juce::Graphics& g) {
+    if (image.isValid())
+        g.drawImageAt(image, 0, 0);
+    else
+        g.fillAll(juce::Colours::black);
+}
+
+void SpectrumDisplay::resized()
+{
+    image = juce::Image(juce::Image::RGB, juce::jmax(1, getWidth()), juce::jmax(1, getHeight()), true);
+    curve.preallocateSpace(SpectrumAnalyzer::numBands * 3 + 8);
+    renderImage();
+}
 
-    auto& data = processor.scopeData;
-    int writePos = processor.scopeWritePos.load();
+void SpectrumDisplay::refresh()
+{
+    if (! analyzer.getFrames().fetch())
+        return;
+
+    levels = analyzer.getFrames().getReadBuffer();
+    hasFrame = true;
 
-    juce::Path p;
-    p.startNewSubPath(0, getHeight() / 2);
+    renderImage();
+    repaint();
+}
 
-    for (int i = 0; i < AudioPluginAudioProcessor::scopeSize; ++i)
+void SpectrumDisplay::renderImage()
+{
+    if (! image.isValid())
+        return;
+
+    juce::Graphics g(image);
+    g.fillAll(juce::Colours::black);
+
+    const float w = (float) image.getWidth();
+    const float h = (float) image.getHeight();
+    const float minF = SpectrumAnalyzer::minFrequency;
+    const float maxF = analyzer.getMaxFrequency();
+
+    // Decade grid
+    g.setColour(juce::Colours::darkgrey);
+
+    for (float f : { 100.0f, 1000.0f, 10000.0f })
     {
-        int index = (writePos + i) % AudioPluginAudioProcessor::scopeSize;
+        if (f < maxF)
+        {
+            const float x = w * std::log(f / minF) / std::log(maxF / minF);
+            g.drawVerticalLine(juce::roundToInt(x), 0.0f, h);
+        }
+    }
 
-        float x = juce::jmap((float)i, 0.f,
-                             (float)AudioPluginAudioProcessor::scopeSize - 1,
-                             0.f, (float)getWidth());
+    if (! hasFrame)
+        return;
 
-        float y = juce::jmap(data[index],
-                             -1.f, 1.f,
-                             (float)getHeight(), 0.f);
+    curve.clear();
+    curve.startNewSubPath(0.0f, h);
 
-        p.lineTo(x, y);
+    for (int b = 0; b < SpectrumAnalyzer::numBands; ++b)
+    {
+        const float x = w * ((float) b + 0.5f) / (float) SpectrumAnalyzer::numBands;
+        const float y = juce::jmap(levels[(size_t) b], SpectrumAnalyzer::minDecibels, 0.0f, h, 0.0f);
+        curve.lineTo(x, y);
     }
+
+    curve.lineTo(w, h);
+    curve.closeSubPath();
+
+    g.setColour(juce::Colours::orange.withAlpha(0.35f));
+    g.fillPath(curve);
     g.setColour(juce::Colours::orange);
-    g.strokePath(p, juce::PathStrokeType(2.0f));
+    g.strokePath(curve, juce::PathStrokeType(1.5f));
 }
 
-void WaveformDisplay::timerCallback()
+//==============================================================================
+void ProfilerOverlay::timerCallback()
 {
-    repaint();
+    const auto newLoad  = processor.getCallbackLoad();
+    const auto newXruns = processor.getXrunCount();
+    const auto newQuality = processor.getQualityLevel();
+
+    auto& recorder = processor.getOutputRecorder();
+    const auto newRecording = recorder.isRecording();
+    const auto newSeconds   = (int) recorder.getRecordedSeconds();
+    const auto newOverruns  = recorder.getOverrunCount();
+
+    // Skip the repaint when an idle synth shows the same numbers
+    bool changed = std::abs(newLoad - load) >= 0.001 || newXruns != xruns || newQuality != quality
+                || newRecording != recording || newSeconds != recordedSeconds || newOverruns != recordOverruns;
+
+    load    = newLoad;
+    xruns   = newXruns;
+    quality = newQuality;
+
+    recording       = newRecording;
+    recordedSeconds = newSeconds;
+    recordOverruns  = newOverruns;
+
+   #if EFFEM_PROFILING
+    const auto newStats = reader.update(processor.getProfiler());
+
+    for (size_t i = 0; i < newStats.size(); ++i)
+        changed = changed || std::abs(newStats[i].meanMicros - stats[i].meanMicros) >= 0.05
+                          || std::abs(newStats[i].maxMicros  - stats[i].maxMicros)  >= 0.05;
+
+    stats = newStats;
+   #endif
+
+    if (changed)
+        repaint();
+}
+
+void ProfilerOverlay::paint(juce::Graphics& g)
+{
+    g.setColour(juce::Colours::black.withAlpha(0.6f));
+    g.fillRoundedRectangle(getLocalBounds().toFloat(), 4.0f);
+
+    g.setFont(juce::FontOptions(juce::Font::getDefaultMonospacedFontName(), 11.0f, juce::Font::plain));
+    auto area = getLocalBounds().reduced(6, 4);
+    auto row = [&area] { return area.removeFromTop(13); };
+
+    g.setColour(load > 0.8 ? juce::Colours::red : juce::Colours::white);
+    g.drawText(juce::String::formatted("CPU %5.1f%%   xruns %d", load * 100.0, xruns),
+               row(), juce::Justification::left);
+
+    g.setColour(quality > 0 ? juce::Colours::orange : juce::Colours::white);
+    g.drawText(juce::String("Quality ") + QualityGovernor::getLevelName(quality),
+               row(), juce::Justification::left);
+
+    if (recording)
+    {
+        g.setColour(recordOverruns > 0 ? juce::Colours::red : juce::Colours::white);
+        g.drawText(juce::String::formatted("Rec %d:%02d  overruns %d",
+                                           recordedSeconds / 60, recordedSeconds % 60, recordOverruns),
+                   row(), juce::Justification::left);
+    }
+
+   #if EFFEM_PROFILING
+    g.setColour(juce::Colours::lightgrey);
+    g.drawText("stage        mean   p99    max  (us)", row(), juce::Justification::left);
+
+    for (int i = 0; i < StageProfiler::numStages; ++i)
+    {
+        const auto& st = stats[(size_t) i];
+        g.drawText(juce::String(StageProfiler::getStageName(i)).paddedRight(' ', 11)
+                     + juce::String::formatted(" %6.1f %6.1f %6.1f %4.1f%%",
+                                               st.meanMicros, st.p99Micros, st.maxMicros,
+                                               st.budgetShare * 100.0),
+                   row(), juce::Justification::left);
+    }
+   #endif
+}
+
+//==============================================================================
+void CaptionLayer::clear()
+{
+    captions.clear();
+    image = {};
+}
+
+void CaptionLayer::add(juce::Rectangle<int> area, const juce::String& text)
+{
+    captions.push_back({ area, text });
+    image = {};
+}
+
+void CaptionLayer::draw(juce::Graphics& g, juce::Rectangle<int> bounds, juce::Colour background)
+{
+    const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+
+    if (! image.isValid() || scale != imageScale)
+    {
+        imageScale = scale;
+        image = juce::Image(background.isOpaque() ? juce::Image::RGB : juce::Image::ARGB,
+                            juce::jmax(1, juce::roundToInt((float) bounds.getWidth() * scale)),
+                            juce::jmax(1, juce::roundToInt((float) bounds.getHeight() * scale)), true);
+
+        juce::Graphics ig(image);
+        ig.addTransform(juce::AffineTransform::scale(scale));
+        ig.fillAll(background);
+
+        // As the juce::Labels they replace drew them: 15 pt, inside a 5 x 1 border
+        ig.setColour(juce::Colours::white);
+        ig.setFont(juce::FontOptions(15.0f));
+
+        for (const auto& c : captions)
+            ig.drawFittedText(c.text, c.area.reduced(5, 1), juce::Justification::centred, 1);
+    }
+
+    g.drawImage(image, bounds.toFloat());
+}
+
+//==============================================================================
+EffectsPanel::EffectsPanel(AudioPluginAudioProcessor& p)
+    : processor(p)
+{
+    auto& state = processor.getState();
+
+    for (auto [button, paramId] : {
+        std::pair { &chorusOnButton, "chorusOn" },
+        std::pair { &delayOnButton,  "delayOn" },
+        std::pair { &reverbOnButton, "reverbOn" },
+        std::pair { &convolutionOnButton, "convOn" }
+    })
+    {
+        addAndMakeVisible(*button);
+        buttonAttachments.push_back(std::make_unique<
+            juce::AudioProcessorValueTreeState::ButtonAttachment>(state, paramId, *button));
+    }
+
+    for (auto [slider, paramId] : {
+        std::pair { &chorusRateSlider,    "chorusRate" },
+        std::pair { &chorusDepthSlider,   "chorusDepth" },
+        std::pair { &chorusMixSlider,     "chorusMix" },
+        std::pair { &delayTimeSlider,     "delayTime" },
+        std::pair { &delayFeedbackSlider, "delayFeedback" },
+        std::pair { &delayMixSlider,      "delayMix" },
+        std::pair { &reverbSizeSlider,    "reverbSize" },
+        std::pair { &reverbDampingSlider, "reverbDamping" },
+        std::pair { &reverbMixSlider,     "reverbMix" },
+        std::pair { &convolutionMixSlider, "convMix" }
+    })
+    {
+        slider->setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+        slider->setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 16);
+        addAndMakeVisible(*slider);
+        sliderAttachments.push_back(std::make_unique<
+            juce::AudioProcessorValueTreeState::SliderAttachment>(state, paramId, *slider));
+    }
+
+    delaySyncBox.addItemList({ "Free", "1/4", "1/8", "1/8 D", "1/16", "1/4 T", "1/8 T" }, 1);
+    delaySyncBox.setTooltip("Sync the delay time to the host tempo");
+    addAndMakeVisible(delaySyncBox);
+
+    delaySyncAttachment = std::make_unique<
+        juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            state, "delaySync", delaySyncBox);
+
+    impulseButton.setTooltip("Impulse response for the convolution reverb (WAV / AIFF / FLAC)");
+    impulseButton.onClick = [this] { showImpulseMenu(); };
+    addAndMakeVisible(impulseButton);
+    updateImpulseButton();
+}
+
+void EffectsPanel::paint(juce::Graphics& g)
+{
+    captions.draw(g, getLocalBounds(), juce::Colours::transparentBlack);
+}
+
+void EffectsPanel::resized()
+{
+    captions.clear();
+
+    auto fxArea = getLocalBounds();
+    const int columnWidth = fxArea.getWidth() * 2 / 7;
+
+    auto layoutEffect = [this] (juce::Rectangle<int> column, juce::ToggleButton& onButton,
+                                juce::ComboBox* extraBox,
+                                std::initializer_list<std::pair<juce::Slider*, const char*>> knobs)
+    {
+        column = column.reduced(10, 0);
+
+        auto header = column.removeFromTop(24);
+        onButton.setBounds(header.removeFromLeft(90));
+
+        if (extraBox != nullptr)
+            extraBox->setBounds(header.removeFromRight(90));
+
+        const int knobWidth = column.getWidth() / (int) knobs.size();
+
+        for (auto [slider, caption] : knobs)
+        {
+            auto knobArea = column.removeFromLeft(knobWidth);
+            captions.add(knobArea.removeFromTop(16), caption);
+            slider->setBounds(knobArea);
+        }
+    };
+
+    layoutEffect(fxArea.removeFromLeft(columnWidth), chorusOnButton, nullptr,
+                 { { &chorusRateSlider, "Rate" },
+                   { &chorusDepthSlider, "Depth" },
+                   { &chorusMixSlider, "Mix" } });
+
+    layoutEffect(fxArea.removeFromLeft(columnWidth), delayOnButton, &delaySyncBox,
+                 { { &delayTimeSlider, "Time" },
+                   { &delayFeedbackSlider, "Feedback" },
+                   { &delayMixSlider, "Mix" } });
+
+    layoutEffect(fxArea.removeFromLeft(columnWidth), reverbOnButton, nullptr,
+                 { { &reverbSizeSlider, "Size" },
+                   { &reverbDampingSlider, "Damping" },
+                   { &reverbMixSlider, "Mix" } });
+
+    // Convolution: one knob, with the IR picker under its toggle
+    auto convolutionArea = fxArea.reduced(10, 0);
+    convolutionOnButton.setBounds(convolutionArea.removeFromTop(24));
+    impulseButton.setBounds(convolutionArea.removeFromTop(22));
+    captions.add(convolutionArea.removeFromTop(16), "Mix");
+    convolutionMixSlider.setBounds(convolutionArea);
+}
+
+void EffectsPanel::updateImpulseButton()
+{
+    const auto name = processor.getImpulseResponseName();
+    impulseButton.setButtonText(name.isNotEmpty() ? name : "No IR");
+}
+
+void EffectsPanel::showImpulseMenu()
+{
+    updateImpulseButton();
+
+    juce::PopupMenu menu;
+    menu.addItem(1, "Load impulse response...");
+    menu.addItem(2, "Clear", processor.getImpulseResponseName().isNotEmpty());
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(impulseButton), [this](int result)
+    {
+        if (result == 1)
+            chooseImpulseResponse();
+        else if (result == 2)
+        {
+            processor.clearImpulseResponse();
+            updateImpulseButton();
+        }
+    });
+}
+
+void EffectsPanel::chooseImpulseResponse()
+{
+    impulseChooser = std::make_unique<juce::FileChooser>("Load impulse response", juce::File(),
+                                                         "*.wav;*.aif;*.aiff;*.flac");
+
+    impulseChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                                [this](const juce::FileChooser& chooser)
+    {
+        const auto file = chooser.getResult();
+
+        if (file == juce::File())
+            return;
+
+        const auto result = processor.loadImpulseResponse(file);
+
+        if (result.failed())
+            juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                                   "Couldn't load impulse response", result.getErrorMessage());
+
+        updateImpulseButton();
+    });
 }
 
 void AudioPluginAudioProcessorEditor::paint (juce::Graphics& g)
 {
-    g.fillAll(juce::Colours::black);
+    captions.draw(g, getLocalBounds(), juce::Colours::black);
 }
 
 void AudioPluginAudioProcessorEditor::resized() {
     auto area = getLocalBounds().reduced(20);
+    captions.clear();
+
+    // ================= PRESETS =================
+    {
+        auto presetRow = area.removeFromTop(26).withSizeKeepingCentre(800, 26);
+        recordButton.setBounds(presetRow.removeFromRight(64));
+        presetRow.removeFromRight(6);
+        renderCacheButton.setBounds(presetRow.removeFromRight(70));
+        presetRow.removeFromRight(6);
+        lockMemoryButton.setBounds(presetRow.removeFromRight(80));
+        presetRow.removeFromRight(6);
+        engineRateBox.setBounds(presetRow.removeFromRight(100));
+        presetRow.removeFromRight(6);
+        partsButton.setBounds(presetRow.removeFromRight(60));
+        presetRow.removeFromRight(6);
+        sampleKitButton.setBounds(presetRow.removeFromRight(100));
+        presetRow.removeFromRight(6);
+        tuningButton.setBounds(presetRow.removeFromRight(100));
+        presetRow.removeFromRight(6);
+        savePresetButton.setBounds(presetRow.removeFromRight(60));
+        presetRow.removeFromRight(6);
+        presetBox.setBounds(presetRow);
+    }
 
     // ================= MASTER CONTROLS =================
     juce::Rectangle<int> masterRow = area.removeFromTop(60).reduced(20, 5);
@@ -333,17 +1220,25 @@ void AudioPluginAudioProcessorEditor::resized() {
     auto rightHalf = masterRow.reduced(10, 0);
 
     // Left: Master Gain
-    masterGainLabel.setBounds(leftHalf.removeFromTop(20));
+    captions.add(leftHalf.removeFromTop(20), "Master Gain");
     masterGainSlider.setBounds(leftHalf);
 
     // Right: FM Amount
-    fmLabel.setBounds(rightHalf.removeFromTop(20));
+    captions.add(rightHalf.removeFromTop(20), "FM Amount");
     fmSlider.setBounds(rightHalf);
 
     // Reserve top 150px for waveform
     auto waveformArea = area.removeFromTop(150).reduced(10);
     waveformDisplay.setBounds(waveformArea);
 
+   #if EFFEM_PROFILING
+    profilerOverlay.setBounds(waveformArea.removeFromRight(230).removeFromTop(160).reduced(4));
+   #else
+    profilerOverlay.setBounds(waveformArea.removeFromRight(150).removeFromTop(50).reduced(4));
+   #endif
+
+    spectrumDisplay.setBounds(area.removeFromTop(120).reduced(10));
+
     // =========================================================
     // TOP: OSCILLATOR SECTION (horizontal per oscillator)
     // =========================================================
@@ -357,21 +1252,25 @@ void AudioPluginAudioProcessorEditor::resized() {
         auto topRow = osc1Area.removeFromTop(30);
         osc1WaveBox.setBounds(topRow.removeFromLeft(120));
         osc1PitchBox.setBounds(topRow.removeFromLeft(70));
+        loadTable1Button.setBounds(topRow.removeFromLeft(110).reduced(4, 0));
 
         auto labelY = osc1WaveBox.getY() - 16;
-        osc1WaveLabel.setBounds(osc1WaveBox.getX(), labelY, 120, 16);
-        osc1PitchLabel.setBounds(osc1PitchBox.getX(), labelY, 70, 16);
+        captions.add({ osc1WaveBox.getX(), labelY, 120, 16 }, "Wave");
+        captions.add({ osc1PitchBox.getX(), labelY, 70, 16 }, "Pitch");
 
         auto knobRow = osc1Area.removeFromTop(90);
 
         detune1Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc1DetuneLabel.setBounds(detune1Slider.getX(), detune1Slider.getY() - 16, 80, 16);
+        captions.add({ detune1Slider.getX(), detune1Slider.getY() - 16, 80, 16 }, "Detune");
 
         gain1Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc1GainLabel.setBounds(gain1Slider.getX(), gain1Slider.getY() - 16, 80, 16);
+        captions.add({ gain1Slider.getX(), gain1Slider.getY() - 16, 80, 16 }, "Gain");
 
         fm1Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc1FmLabel.setBounds(fm1Slider.getX(), fm1Slider.getY() - 16, 80, 16);
+        captions.add({ fm1Slider.getX(), fm1Slider.getY() - 16, 80, 16 }, "FM");
+
+        wtPos1Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
+        captions.add({ wtPos1Slider.getX(), wtPos1Slider.getY() - 16, 80, 16 }, "Position");
     }
 
     // ------------- OSC 2 ------------- //
@@ -379,30 +1278,39 @@ void AudioPluginAudioProcessorEditor::resized() {
         auto topRow = osc2Area.removeFromTop(30);
         osc2WaveBox.setBounds(topRow.removeFromLeft(120));
         osc2PitchBox.setBounds(topRow.removeFromLeft(70));
+        loadTable2Button.setBounds(topRow.removeFromLeft(110).reduced(4, 0));
 
         auto labelY = osc2WaveBox.getY() - 16;
-        osc2WaveLabel.setBounds(osc2WaveBox.getX(), labelY, 120, 16);
-        osc2PitchLabel.setBounds(osc2PitchBox.getX(), labelY, 70, 16);
+        captions.add({ osc2WaveBox.getX(), labelY, 120, 16 }, "Wave");
+        captions.add({ osc2PitchBox.getX(), labelY, 70, 16 }, "Pitch");
 
         auto knobRow = osc2Area.removeFromTop(90);
 
         detune2Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc2DetuneLabel.setBounds(detune2Slider.getX(), detune2Slider.getY() - 16, 80, 16);
+        captions.add({ detune2Slider.getX(), detune2Slider.getY() - 16, 80, 16 }, "Detune");
 
         gain2Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc2GainLabel.setBounds(gain2Slider.getX(), gain2Slider.getY() - 16, 80, 16);
+        captions.add({ gain2Slider.getX(), gain2Slider.getY() - 16, 80, 16 }, "Gain");
 
         fm2Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
-        osc2FmLabel.setBounds(fm2Slider.getX(), fm2Slider.getY() - 16, 80, 16);
+        captions.add({ fm2Slider.getX(), fm2Slider.getY() - 16, 80, 16 }, "FM");
+
+        wtPos2Slider.setBounds(knobRow.removeFromLeft(80).reduced(5));
+        captions.add({ wtPos2Slider.getX(), wtPos2Slider.getY() - 16, 80, 16 }, "Position");
     }
 
+    // Caption strip above a control, as wide as the control
+    auto captionAbove = [this] (const juce::Component& c, const char* text)
+    {
+        captions.add({ c.getX(), c.getY() - 16, c.getWidth(), 16 }, text);
+    };
+
     // =========================================================
     // OSC BLEND (center)
     // =========================================================
     auto blendArea = area.removeFromTop(60);
     blendSlider.setBounds(blendArea.withSizeKeepingCentre(300, 40));
-    blendLabel.setBounds(blendSlider.getX(), blendSlider.getY() - 16,
-                         blendSlider.getWidth(), 16);
+    captionAbove(blendSlider, "Osc Blend");
 
     // =========================================================
     // ADSR (Attack / Decay / Sustain / Release)
@@ -411,53 +1319,52 @@ void AudioPluginAudioProcessorEditor::resized() {
     int adsrWidth = adsrArea.getWidth() / 4;
 
     attackSlider.setBounds(adsrArea.removeFromLeft(adsrWidth).reduced(10));
-    attackLabel.setBounds(attackSlider.getX(), attackSlider.getY() - 16,
-                          attackSlider.getWidth(), 16);
+    captionAbove(attackSlider, "Attack");
 
     decaySlider.setBounds(adsrArea.removeFromLeft(adsrWidth).reduced(10));
-    decayLabel.setBounds(decaySlider.getX(), decaySlider.getY() - 16,
-                         decaySlider.getWidth(), 16);
+    captionAbove(decaySlider, "Decay");
 
     sustainSlider.setBounds(adsrArea.removeFromLeft(adsrWidth).reduced(10));
-    sustainLabel.setBounds(sustainSlider.getX(), sustainSlider.getY() - 16,
-                           sustainSlider.getWidth(), 16);
+    captionAbove(sustainSlider, "Sustain");
 
     releaseSlider.setBounds(adsrArea.removeFromLeft(adsrWidth).reduced(10));
-    releaseLabel.setBounds(releaseSlider.getX(), releaseSlider.getY() - 16,
-                           releaseSlider.getWidth(), 16);
+    captionAbove(releaseSlider, "Release");
 
     // =========================================================
     // FILTER SECTION + PAN SLIDER
     // =========================================================
     auto filterArea = area.removeFromTop(180);
 
-    filterType.setBounds(filterArea.removeFromTop(30).withSizeKeepingCentre(140, 30));
-    filterLabel.setBounds(filterType.getX(), filterType.getY() - 16,
-                          filterType.getWidth(), 16);
+    {
+        // Drive type and amount to the left of the filter type
+        auto topRow = filterArea.removeFromTop(30);
+        auto driveArea = topRow.removeFromLeft(topRow.getWidth() / 2 - 70).reduced(20, 0);
+
+        driveType.setBounds(driveArea.removeFromLeft(100));
+        driveSlider.setBounds(driveArea.withTrimmedLeft(6));
+        captionAbove(driveType, "Drive");
+
+        filterType.setBounds(topRow.removeFromLeft(120));
+        filterModel.setBounds(topRow.removeFromLeft(130).withTrimmedLeft(10));
+    }
+    captionAbove(filterType, "Filter");
+    captionAbove(filterModel, "Model");
 
     cutoffSlider.setBounds(filterArea.removeFromTop(50).reduced(20));
-    cutoffLabel.setBounds(cutoffSlider.getX(), cutoffSlider.getY() - 16,
-                          cutoffSlider.getWidth(), 16);
+    captionAbove(cutoffSlider, "Cutoff");
 
     resonanceSlider.setBounds(filterArea.removeFromTop(50).reduced(20));
-    resonanceLabel.setBounds(resonanceSlider.getX(), resonanceSlider.getY() - 16,
-                             resonanceSlider.getWidth(), 16);
+    captionAbove(resonanceSlider, "Resonance");
 
     panSlider.setBounds(filterArea.removeFromTop(40).withSizeKeepingCentre(220, 30));
-    panLabel.setBounds(panSlider.getX(), panSlider.getY() - 16,
-                       panSlider.getWidth(), 16);
+    captionAbove(panSlider, "Pan");
 
     // =========================================================
-    // BOTTOM: MASTER CONTROLS (Gain / FM / Detune)
+    // BOTTOM: EFFECTS RACK (Chorus / Delay / Reverb / Convolution)
     // =========================================================
-    {
-        auto bottomArea = area.removeFromBottom(150).reduced(40);
-
-        int columnWidth = bottomArea.getWidth() / 3;
+    effectsArea = area.removeFromTop(110).reduced(10, 0);
+    effectsButton.setBounds(effectsArea.withSizeKeepingCentre(160, 30));
 
-    }
+    if (effectsPanel != nullptr)
+        effectsPanel->setBounds(effectsArea);
 }
-
-
-
-
@@ -3,30 +3,179 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
 #include "PluginProcessor.h"
+#include "ScopeRefreshHub.h"
 
 //==============================================================================
 //   WAVEFORM VISUALIZER COMPONENT
 //==============================================================================
+// Repaints only when the processor publishes a new scope frame. Each frame is
+// reduced to one min/max column per pixel and drawn into a cached image.
 class WaveformDisplay : public juce::Component,
-                        private juce::Timer
+                        private ScopeRefreshHub::Client
 {
 public:
     WaveformDisplay(AudioPluginAudioProcessor& p);
+    ~WaveformDisplay() override;
 
     void paint(juce::Graphics& g) override;
-    void resized() override {}
+    void resized() override;
 
 private:
     AudioPluginAudioProcessor& processor;
+    juce::SharedResourcePointer<ScopeRefreshHub> refreshHub;
 
-    void timerCallback() override;
+    juce::Image image;
+    std::vector<float> columnMin, columnMax;
+
+    void refresh() override;
+    juce::Component& getRefreshComponent() override { return *this; }
+
+    void computeColumns(const AudioPluginAudioProcessor::ScopeFrame& frame);
+    void renderImage();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformDisplay)
 };
 
 //==============================================================================
+//   SPECTRUM ANALYZER
+//==============================================================================
+// Draws the analyzer's band levels on a log-frequency axis. The analyzer's
+// worker thread only runs while a SpectrumDisplay exists.
+class SpectrumDisplay : public juce::Component,
+                        private ScopeRefreshHub::Client
+{
+public:
+    SpectrumDisplay(SpectrumAnalyzer& a);
+    ~SpectrumDisplay() override;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    SpectrumAnalyzer& analyzer;
+    juce::SharedResourcePointer<ScopeRefreshHub> refreshHub;
+
+    juce::Image image;
+    juce::Path curve;
+    SpectrumAnalyzer::Frame levels {};
+    bool hasFrame = false;
+
+    void refresh() override;
+    juce::Component& getRefreshComponent() override { return *this; }
+
+    void renderImage();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumDisplay)
+};
+
+//==============================================================================
+//   CPU LOAD OVERLAY
+//==============================================================================
+// Polls the processor's load measurer and stage counters at UI rate. Only
+// atomics are read, so the audio thread is never blocked.
+class ProfilerOverlay : public juce::Component,
+                        private juce::Timer
+{
+public:
+    ProfilerOverlay(AudioPluginAudioProcessor& p);
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    AudioPluginAudioProcessor& processor;
+
+    StageProfiler::Reader reader;
+    std::array<StageProfiler::StageStats, StageProfiler::numStages> stats {};
+    double load = 0.0;
+    int xruns = 0;
+    int quality = 0;
+
+    bool recording = false;
+    int recordedSeconds = 0;
+    int recordOverruns = 0;
+
+    void timerCallback() override;
 
-class AudioPluginAudioProcessorEditor final : public juce::AudioProcessorEditor
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ProfilerOverlay)
+};
+
+//==============================================================================
+//   STATIC CAPTIONS
+//==============================================================================
+// Text that only moves when the layout does, drawn into one cached image
+// instead of a juce::Label component per caption. resized() re-adds the
+// captions; the next paint renders them at the display's pixel scale and
+// later paints just blit the image.
+class CaptionLayer
+{
+public:
+    void clear();
+    void add(juce::Rectangle<int> area, const juce::String& text);
+
+    // Fills `bounds` with the background and the captions on top
+    void draw(juce::Graphics& g, juce::Rectangle<int> bounds, juce::Colour background);
+
+private:
+    struct Caption
+    {
+        juce::Rectangle<int> area;
+        juce::String text;
+    };
+
+    std::vector<Caption> captions;
+    juce::Image image;
+    float imageScale = 0.0f;
+};
+
+//==============================================================================
+//   EFFECTS RACK
+//==============================================================================
+// Chorus / delay / reverb / convolution. The editor only builds it when the
+// user first shows the effects (see AudioPluginAudioProcessorEditor::showEffects).
+class EffectsPanel : public juce::Component
+{
+public:
+    EffectsPanel(AudioPluginAudioProcessor& p);
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    AudioPluginAudioProcessor& processor;
+    CaptionLayer captions;
+
+    juce::ToggleButton chorusOnButton { "Chorus" };
+    juce::ToggleButton delayOnButton  { "Delay" };
+    juce::ToggleButton reverbOnButton { "Reverb" };
+    juce::ToggleButton convolutionOnButton { "Convolution" };
+    juce::ComboBox delaySyncBox;
+
+    juce::Slider chorusRateSlider, chorusDepthSlider, chorusMixSlider;
+    juce::Slider delayTimeSlider, delayFeedbackSlider, delayMixSlider;
+    juce::Slider reverbSizeSlider, reverbDampingSlider, reverbMixSlider;
+    juce::Slider convolutionMixSlider;
+
+    std::vector<std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>> buttonAttachments;
+    std::vector<std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>> sliderAttachments;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> delaySyncAttachment;
+
+    // Convolution impulse response
+    juce::TextButton impulseButton;
+    std::unique_ptr<juce::FileChooser> impulseChooser;
+
+    void showImpulseMenu();
+    void chooseImpulseResponse();
+    void updateImpulseButton();
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EffectsPanel)
+};
+
+//==============================================================================
+// The effects rack is built the first time the user shows it, not on every
+// open; the session remembers that it was shown and later opens build it
+// straight away. Everything else is attached before the first paint.
+class AudioPluginAudioProcessorEditor final : public juce::AudioProcessorEditor,
+                                              private juce::ChangeListener
 {
 public:
     explicit AudioPluginAudioProcessorEditor (AudioPluginAudioProcessor&);
@@ -35,9 +184,73 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
 
+    // Builds the effects rack if it hasn't been yet and shows it in place of
+    // the "Effects" button
+    void showEffects();
+
 private:
     WaveformDisplay waveformDisplay;
     AudioPluginAudioProcessor& processorRef;
+    ProfilerOverlay profilerOverlay;
+    SpectrumDisplay spectrumDisplay;
+
+    // Captions for everything but the effects rack, on the cached background
+    CaptionLayer captions;
+
+    void attachControls();
+
+    juce::TextButton effectsButton { "Effects" };
+    std::unique_ptr<EffectsPanel> effectsPanel;
+    juce::Rectangle<int> effectsArea;
+
+    // Presets
+    juce::ComboBox presetBox;
+    juce::TextButton savePresetButton { "Save" };
+    std::unique_ptr<juce::AlertWindow> savePresetWindow;
+
+    void refreshPresetList();
+    void showSavePresetDialog();
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;   // the bank changed
+
+    // Tuning
+    juce::TextButton tuningButton;
+    std::unique_ptr<juce::FileChooser> tuningChooser;
+
+    void showTuningMenu();
+    void chooseTuningFiles();
+
+    // Sample layer
+    juce::TextButton sampleKitButton;
+    std::unique_ptr<juce::FileChooser> sampleKitChooser;
+
+    void showSampleKitMenu();
+    void chooseSampleKit(bool folder);
+    void updateSampleKitButton();
+
+    // Multitimbral parts
+    juce::TextButton partsButton;
+
+    void showPartsMenu();
+    void updatePartsButton();
+
+    // Internal engine rate
+    juce::ComboBox engineRateBox;
+
+    // Output recorder
+    juce::TextButton recordButton { "Rec" };
+    std::unique_ptr<juce::FileChooser> recordChooser;
+
+    void toggleRecording();
+    void updateRecordButton();
+
+    // Memory locking
+    juce::ToggleButton lockMemoryButton { "Lock RAM" };
+
+    void toggleMemoryLocking();
+
+    // Note render cache
+    juce::ToggleButton renderCacheButton { "Cache" };
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> renderCacheAttachment;
 
     // Play
     juce::ToggleButton playButton { "Play" };
@@ -45,53 +258,49 @@ private:
 
     // Master Gain
     juce::Slider masterGainSlider;
-    juce::Label masterGainLabel { "MasterGainLabel", "Master Gain" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> masterGainAttachment;
 
     // Detune (vertical)
     juce::Slider detuneSlider;
-    juce::Label detuneLabel { "DetuneLabel", "Detune (cents)" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> detuneAttachment;
 
     // Pitch Shift (combo)
     juce::ComboBox pitchShiftBox;
-    juce::Label pitchShiftLabel { "PitchShiftLabel", "Pitch (semitones)" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> pitchShiftAttachment;
 
     // Pan
     juce::Slider panSlider;
-    juce::Label panLabel { "PanLabel", "Pan" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> panAttachment;
 
     // FM Amount
     juce::Slider fmSlider;
-    juce::Label fmLabel { "FMLabel", "FM Amount" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> fmAttachment;
 
-    // ADSR sliders + labels
+    // ADSR sliders
     juce::Slider attackSlider, decaySlider, sustainSlider, releaseSlider;
 
-    juce::Label attackLabel  { "attackLabel",  "Attack" };
-    juce::Label decayLabel   { "decayLabel",   "Decay" };
-    juce::Label sustainLabel { "sustainLabel", "Sustain" };
-    juce::Label releaseLabel { "releaseLabel", "Release" };
-
     // attachments
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> attackAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> decayAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> sustainAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> releaseAttachment;
 
+    // Drive
+    juce::ComboBox driveType;
+    juce::Slider driveSlider;
+
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> driveTypeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> driveAttachment;
+
     // Filters
-    juce::Label filterLabel;
-    juce::Label cutoffLabel    { "cutoffLabel",    "Cutoff" };
-    juce::Label resonanceLabel { "resonanceLabel", "Resonance" };
     juce::ComboBox filterType;
+    juce::ComboBox filterModel;
 
     juce::Slider cutoffSlider;
     juce::Slider resonanceSlider;
 
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> filterTypeAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> filterModelAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> cutoffAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> resonanceAttachment;
 
@@ -101,6 +310,8 @@ private:
     juce::Slider   detune1Slider;
     juce::Slider   gain1Slider;
     juce::Slider   fm1Slider;
+    juce::Slider   wtPos1Slider;
+    juce::TextButton loadTable1Button;
 
     // OSC1 attachments
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> osc1WaveAttachment;
@@ -108,13 +319,7 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc1DetuneAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc1GainAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc1FmAttachment;
-
-    // OSC1 labels
-    juce::Label osc1GainLabel      { "osc1GainLabel",      "Gain" };
-    juce::Label osc1DetuneLabel    { "osc1DetuneLabel",    "Detune" };
-    juce::Label osc1FmLabel        { "osc1FmLabel",        "FM" };
-    juce::Label osc1PitchLabel     { "osc1PitchLabel",     "Pitch" };
-    juce::Label osc1WaveLabel      { "osc1WaveLabel",      "Wave" };
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc1WtPosAttachment;
 
     // OSC2
     juce::ComboBox osc2WaveBox;
@@ -122,6 +327,8 @@ private:
     juce::Slider   detune2Slider;
     juce::Slider   gain2Slider;
     juce::Slider   fm2Slider;
+    juce::Slider   wtPos2Slider;
+    juce::TextButton loadTable2Button;
 
     // OSC2 attachments
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> osc2WaveAttachment;
@@ -129,17 +336,16 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc2DetuneAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc2GainAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc2FmAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   osc2WtPosAttachment;
+
+    // User wavetables
+    std::unique_ptr<juce::FileChooser> waveTableChooser;
 
-    // OSC2 labels
-    juce::Label osc2GainLabel      { "osc2GainLabel",      "Gain" };
-    juce::Label osc2DetuneLabel    { "osc2DetuneLabel",    "Detune" };
-    juce::Label osc2FmLabel        { "osc2FmLabel",        "FM" };
-    juce::Label osc2PitchLabel     { "osc2PitchLabel",     "Pitch" };
-    juce::Label osc2WaveLabel      { "osc2WaveLabel",      "Wave" };
+    void chooseWaveTable (int oscIndex);
+    void updateWaveTableButtons();
 
     // Blend
     juce::Slider blendSlider;
-    juce::Label blendLabel { "blendLabel", "Osc Blend" };
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> blendAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (AudioPluginAudioProcessorEditor)
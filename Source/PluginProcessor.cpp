@@ -1,5 +1,7 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "StateCodec.h"
+#include "SimdKernels.h"
 #include <cmath>
 
 static constexpr float pitchTable[9] =
@@ -8,27 +10,63 @@ static constexpr float pitchTable[9] =
 };
 
 //==============================================================================
+static juce::AudioProcessor::BusesProperties createBusesProperties()
+{
+    juce::AudioProcessor::BusesProperties buses;
+
+   #if ! JucePlugin_IsMidiEffect
+    #if ! JucePlugin_IsSynth
+    buses = buses.withInput ("Input", juce::AudioChannelSet::stereo(), true);
+    #endif
+    buses = buses.withOutput ("Output", juce::AudioChannelSet::stereo(), true);
+
+    // Multitimbral parts 2-16 can each have their own output; off until the
+    // host enables them
+    for (int part = 2; part <= EngineState::maxParts; ++part)
+        buses = buses.withOutput ("Part " + juce::String (part), juce::AudioChannelSet::stereo(), false);
+   #endif
+
+    return buses;
+}
+
 AudioPluginAudioProcessor::AudioPluginAudioProcessor()
-    : AudioProcessor (BusesProperties()
-        #if ! JucePlugin_IsMidiEffect
-         #if ! JucePlugin_IsSynth
-          .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-         #endif
-          .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-        #endif
-      ), state (*this, nullptr, "parameters", createParameters())
+    : AudioProcessor (createBusesProperties()),
+      state (*this, nullptr, "parameters", createParameters())
 {
     synth.clearVoices();
-    for (int i = 0; i < 8; ++i)         // 8-voice polyphony
-        synth.addVoice (new SynthVoice);
+    resizeVoicePool (singleVoices);
+
+    for (int i = 0; i < 16; ++i)        // sample layer, only plays keys the kit maps
+        synth.addVoice (new SampleVoice);
 
     synth.clearSounds();
-    synth.addSound (new SynthSound);
+
+    for (int part = 0; part < EngineState::maxParts; ++part)
+    {
+        partSounds[(size_t) part] = new SynthSound (part);
+        synth.addSound (partSounds[(size_t) part]);
+    }
+
+    sampleSound = new SampleSound();
+    synth.addSound (sampleSound);
+
+   #if EFFEM_TRACING
+    // Set EFFEM_TRACE_FILE to capture a Chrome trace from a host session
+    auto traceFile = juce::SystemStats::getEnvironmentVariable ("EFFEM_TRACE_FILE", {});
+
+    if (traceFile.isNotEmpty())
+        tracer.start (juce::File::getCurrentWorkingDirectory().getChildFile (traceFile));
+   #endif
+
+    synth.setTraceRecorder (&tracer);
+
+    presetBank->addChangeListener (this);
 }
 
 
 AudioPluginAudioProcessor::~AudioPluginAudioProcessor()
 {
+    presetBank->removeChangeListener (this);
 }
 
 //==============================================================================
@@ -66,29 +104,554 @@ bool AudioPluginAudioProcessor::isMidiEffect() const
 
 double AudioPluginAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    return tailSeconds.load();
 }
 
 int AudioPluginAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    // NB: some hosts don't cope very well if you tell them there are 0 programs,
+    // so this should be at least 1, even if the bank is empty.
+    return juce::jmax (1, presetBank->getNumPresets());
 }
 
 int AudioPluginAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram;
 }
 
 void AudioPluginAudioProcessor::setCurrentProgram (int index)
 {
-    juce::ignoreUnused (index);
+    // One engine-state switch for the whole preset, not one per parameter
+    engineState.beginBatch();
+
+    if (presetBinding.apply (index))
+        currentProgram = index;
+
+    engineState.endBatch();
 }
 
 const juce::String AudioPluginAudioProcessor::getProgramName (int index)
 {
-    juce::ignoreUnused (index);
-    return {};
+    return presetBank->getPresetName (index);
+}
+
+bool AudioPluginAudioProcessor::saveCurrentAsPreset (const juce::String& name)
+{
+    if (! presetBank->addPreset (name, *this))
+        return false;
+
+    currentProgram = presetBank->getNumPresets() - 1;
+    updateHostDisplay (ChangeDetails().withProgramChanged (true));
+    return true;
+}
+
+void AudioPluginAudioProcessor::changeListenerCallback (juce::ChangeBroadcaster*)
+{
+    // The bank was replaced, possibly by another instance. Presets are only
+    // ever appended, so the current index still names the same preset.
+    currentProgram = juce::jlimit (0, getNumPrograms() - 1, currentProgram);
+    updateHostDisplay (ChangeDetails().withProgramChanged (true));
+}
+
+static const juce::Identifier programType  { "PROGRAM" };
+static const juce::Identifier programIndex { "index" };
+static const juce::Identifier programName  { "name" };
+
+void AudioPluginAudioProcessor::writeProgramToState()
+{
+    auto tree = state.state.getOrCreateChildWithName (programType, nullptr);
+    tree.setProperty (programIndex, currentProgram, nullptr);
+    tree.setProperty (programName, getProgramName (currentProgram), nullptr);
+}
+
+void AudioPluginAudioProcessor::applyProgramFromState()
+{
+    // Only the selection is restored: the parameters come with the state, and
+    // may have been edited since the preset was loaded
+    auto tree = state.state.getChildWithName (programType);
+    const auto name = tree[programName].toString();
+    int index = tree[programIndex];
+
+    // The bank is shared, so other instances may have added presets since:
+    // fall back to looking the preset up by name
+    if (name.isNotEmpty() && getProgramName (index) != name)
+    {
+        for (int i = 0; i < presetBank->getNumPresets(); ++i)
+        {
+            if (presetBank->getPresetName (i) == name)
+            {
+                index = i;
+                break;
+            }
+        }
+    }
+
+    currentProgram = juce::jlimit (0, getNumPrograms() - 1, index);
+    updateHostDisplay (ChangeDetails().withProgramChanged (true));
+}
+
+//==============================================================================
+static const juce::Identifier tuningType    { "TUNING" };
+static const juce::Identifier tuningName    { "name" };
+static const juce::Identifier tuningScale   { "scl" };
+static const juce::Identifier tuningMapping { "kbm" };
+
+juce::Result AudioPluginAudioProcessor::loadTuning (const juce::File& scaleFile, const juce::File& keyboardMapFile)
+{
+    const auto scaleText   = scaleFile.loadFileAsString();
+    const auto mappingText = keyboardMapFile.existsAsFile() ? keyboardMapFile.loadFileAsString() : juce::String();
+
+    TuningTable check;
+    const auto result = ScalaTuning::build (scaleText, mappingText, check);
+
+    if (result.failed())
+        return result;
+
+    auto tree = state.state.getOrCreateChildWithName (tuningType, nullptr);
+    tree.setProperty (tuningName, check.name.isNotEmpty() ? check.name : scaleFile.getFileNameWithoutExtension(), nullptr);
+    tree.setProperty (tuningScale, scaleText, nullptr);
+    tree.setProperty (tuningMapping, mappingText, nullptr);
+
+    applyTuningFromState();
+    return result;
+}
+
+void AudioPluginAudioProcessor::resetTuning()
+{
+    state.state.removeChild (state.state.getChildWithName (tuningType), nullptr);
+    applyTuningFromState();
+}
+
+juce::String AudioPluginAudioProcessor::getTuningName() const
+{
+    const auto tree = state.state.getChildWithName (tuningType);
+    return tree.isValid() ? tree[tuningName].toString() : juce::String ("12-TET");
+}
+
+void AudioPluginAudioProcessor::applyTuningFromState()
+{
+    const auto tree = state.state.getChildWithName (tuningType);
+    engineState.setTuning (tree[tuningScale].toString(), tree[tuningMapping].toString());
+}
+
+//==============================================================================
+static const juce::Identifier waveTablesType { "WAVETABLES" };
+static const juce::Identifier waveTableOsc[] = { "osc1", "osc2" };
+
+juce::Result AudioPluginAudioProcessor::loadWaveTable (int oscIndex, const juce::File& file)
+{
+    jassert (juce::isPositiveAndBelow (oscIndex, 2));
+
+    const auto result = juce::SharedResourcePointer<WaveTableLibrary>()->canLoad (file);
+
+    if (result.failed())
+        return result;
+
+    state.state.getOrCreateChildWithName (waveTablesType, nullptr)
+               .setProperty (waveTableOsc[oscIndex], file.getFullPathName(), nullptr);
+
+    applyWaveTablesFromState();
+    return result;
+}
+
+juce::String AudioPluginAudioProcessor::getWaveTableName (int oscIndex) const
+{
+    const auto path = state.state.getChildWithName (waveTablesType)[waveTableOsc[oscIndex]].toString();
+    return path.isNotEmpty() ? juce::File (path).getFileNameWithoutExtension() : juce::String();
+}
+
+void AudioPluginAudioProcessor::applyWaveTablesFromState()
+{
+    const auto tree = state.state.getChildWithName (waveTablesType);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        const auto path = tree[waveTableOsc[i]].toString();
+        engineState.setUserWaveTable (i, juce::File::isAbsolutePath (path) ? juce::File (path) : juce::File());
+    }
+}
+
+//==============================================================================
+static const juce::Identifier sampleKitType { "SAMPLEKIT" };
+static const juce::Identifier sampleKitPath { "path" };
+
+juce::Result AudioPluginAudioProcessor::loadSampleKit (const juce::File& fileOrFolder)
+{
+    if (fileOrFolder.existsAsFile() ? ! SampleKit::isSupportedFile (fileOrFolder)
+                                    : ! fileOrFolder.isDirectory())
+        return juce::Result::fail ("Choose a WAV, AIFF or FLAC file, or a folder of them");
+
+    state.state.getOrCreateChildWithName (sampleKitType, nullptr)
+               .setProperty (sampleKitPath, fileOrFolder.getFullPathName(), nullptr);
+
+    applySampleKitFromState();
+    return juce::Result::ok();
+}
+
+void AudioPluginAudioProcessor::clearSampleKit()
+{
+    state.state.removeChild (state.state.getChildWithName (sampleKitType), nullptr);
+    applySampleKitFromState();
+}
+
+juce::String AudioPluginAudioProcessor::getSampleKitName() const
+{
+    const auto path = state.state.getChildWithName (sampleKitType)[sampleKitPath].toString();
+    return path.isNotEmpty() ? juce::File (path).getFileNameWithoutExtension() : juce::String();
+}
+
+void AudioPluginAudioProcessor::applySampleKitFromState()
+{
+    const auto path = state.state.getChildWithName (sampleKitType)[sampleKitPath].toString();
+
+    if (juce::File::isAbsolutePath (path))
+    {
+        // A ring allocated after prepareToPlay is warmed (and locked, if
+        // locking is on) here; prepareToPlay re-adds the rest
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+            if (auto* v = dynamic_cast<SampleVoice*> (synth.getVoice (i)))
+                if (v->allocateStream())
+                    v->warmUp (memoryWarmup);
+
+        sampleSound->loadKit (juce::File (path));
+    }
+    else
+        sampleSound->clearKit();
+}
+
+//==============================================================================
+static const juce::Identifier impulseType { "IMPULSE" };
+static const juce::Identifier impulsePath { "path" };
+
+juce::Result AudioPluginAudioProcessor::loadImpulseResponse (const juce::File& file)
+{
+    const auto result = effects.getConvolution().loadImpulseResponse (file);
+
+    if (result.wasOk())
+        state.state.getOrCreateChildWithName (impulseType, nullptr)
+                   .setProperty (impulsePath, file.getFullPathName(), nullptr);
+
+    return result;
+}
+
+void AudioPluginAudioProcessor::clearImpulseResponse()
+{
+    state.state.removeChild (state.state.getChildWithName (impulseType), nullptr);
+    applyImpulseResponseFromState();
+}
+
+juce::String AudioPluginAudioProcessor::getImpulseResponseName() const
+{
+    const auto path = state.state.getChildWithName (impulseType)[impulsePath].toString();
+    return path.isNotEmpty() ? juce::File (path).getFileNameWithoutExtension() : juce::String();
+}
+
+void AudioPluginAudioProcessor::applyImpulseResponseFromState()
+{
+    const auto path = state.state.getChildWithName (impulseType)[impulsePath].toString();
+
+    // A session whose IR has gone missing loads without it
+    if (juce::File::isAbsolutePath (path) && juce::File (path).existsAsFile())
+        effects.getConvolution().loadImpulseResponse (juce::File (path));
+    else
+        effects.getConvolution().clearImpulseResponse();
+}
+
+//==============================================================================
+static const juce::Identifier engineType { "ENGINE" };
+static const juce::Identifier engineRate { "rate" };
+
+void AudioPluginAudioProcessor::setEngineRate (int hz)
+{
+    state.state.getOrCreateChildWithName (engineType, nullptr).setProperty (engineRate, hz, nullptr);
+    applyEngineRateFromState();
+}
+
+int AudioPluginAudioProcessor::getEngineRate() const
+{
+    return (int) state.state.getChildWithName (engineType).getProperty (engineRate, 0);
+}
+
+void AudioPluginAudioProcessor::applyEngineRateFromState()
+{
+    // Nothing to redo before the host has prepared us
+    if (getSampleRate() <= 0.0 || getEngineRate() == preparedEngineRate)
+        return;
+
+    suspendProcessing (true);
+    prepareToPlay (getSampleRate(), getBlockSize());
+    suspendProcessing (false);
+}
+
+static const juce::Identifier engineLockMemory { "lockMemory" };
+
+void AudioPluginAudioProcessor::setMemoryLocking (bool shouldLock)
+{
+    state.state.getOrCreateChildWithName (engineType, nullptr).setProperty (engineLockMemory, shouldLock, nullptr);
+    memoryWarmup.setLocked (shouldLock);
+}
+
+bool AudioPluginAudioProcessor::isMemoryLockingEnabled() const
+{
+    return (bool) state.state.getChildWithName (engineType).getProperty (engineLockMemory, false);
+}
+
+//==============================================================================
+void AudioPluginAudioProcessor::setMultitimbral (bool shouldBeOn)
+{
+    state.state.getOrCreateChildWithName (PartTree::type, nullptr).setProperty (PartTree::multitimbral, shouldBeOn, nullptr);
+    applyPartsFromState();
+}
+
+bool AudioPluginAudioProcessor::isMultitimbral() const
+{
+    return (bool) state.state.getChildWithName (PartTree::type)[PartTree::multitimbral];
+}
+
+juce::ValueTree AudioPluginAudioProcessor::getPartTree (int part) const
+{
+    return state.state.getChildWithName (PartTree::type).getChildWithProperty (PartTree::index, part);
+}
+
+juce::ValueTree AudioPluginAudioProcessor::getOrCreatePartTree (int part)
+{
+    auto parts = state.state.getOrCreateChildWithName (PartTree::type, nullptr);
+    auto tree = parts.getChildWithProperty (PartTree::index, part);
+
+    if (! tree.isValid())
+    {
+        tree = juce::ValueTree (PartTree::part);
+        tree.setProperty (PartTree::index, part, nullptr);
+        parts.appendChild (tree, nullptr);
+    }
+
+    return tree;
+}
+
+void AudioPluginAudioProcessor::setPartEnabled (int part, bool shouldBeEnabled)
+{
+    if (! juce::isPositiveAndBelow (part, EngineState::maxParts) || part == 0)
+        return;
+
+    getOrCreatePartTree (part).setProperty (PartTree::enabled, shouldBeEnabled, nullptr);
+    applyPartsFromState();
+}
+
+bool AudioPluginAudioProcessor::isPartEnabled (int part) const
+{
+    return part == 0 || (bool) getPartTree (part)[PartTree::enabled];
+}
+
+void AudioPluginAudioProcessor::setPartChannel (int part, int midiChannel)
+{
+    if (! juce::isPositiveAndBelow (part, EngineState::maxParts))
+        return;
+
+    getOrCreatePartTree (part).setProperty (PartTree::channel, juce::jlimit (1, 16, midiChannel), nullptr);
+    applyPartsFromState();
+}
+
+int AudioPluginAudioProcessor::getPartChannel (int part) const
+{
+    return (int) getPartTree (part).getProperty (PartTree::channel, part + 1);
+}
+
+void AudioPluginAudioProcessor::setPartOwnOutput (int part, bool shouldUseOwnOutput)
+{
+    if (! juce::isPositiveAndBelow (part, EngineState::maxParts) || part == 0)
+        return;
+
+    getOrCreatePartTree (part).setProperty (PartTree::ownOutput, shouldUseOwnOutput, nullptr);
+    applyPartsFromState();
+}
+
+bool AudioPluginAudioProcessor::hasPartOwnOutput (int part) const
+{
+    return part > 0 && (bool) getPartTree (part)[PartTree::ownOutput];
+}
+
+void AudioPluginAudioProcessor::copySoundToPart (int part)
+{
+    if (! juce::isPositiveAndBelow (part, EngineState::maxParts) || part == 0)
+        return;
+
+    juce::ValueTree patch (PartTree::patch);
+
+    for (auto* p : getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p))
+            patch.setProperty (ranged->getParameterID(), ranged->convertFrom0to1 (ranged->getValue()), nullptr);
+
+    const auto name = getProgramName (currentProgram);
+    setPartPatch (part, patch, name.isNotEmpty() ? name + " (copy)" : juce::String ("Current sound"));
+}
+
+bool AudioPluginAudioProcessor::loadPresetIntoPart (int part, int presetIndex)
+{
+    if (! juce::isPositiveAndBelow (part, EngineState::maxParts) || part == 0)
+        return false;
+
+    juce::ValueTree patch (PartTree::patch);
+
+    const auto found = presetBinding.visit (presetIndex, [&patch] (juce::RangedAudioParameter& param, float value)
+    {
+        patch.setProperty (param.getParameterID(), value, nullptr);
+    });
+
+    if (! found)
+        return false;
+
+    setPartPatch (part, patch, presetBank->getPresetName (presetIndex));
+    return true;
+}
+
+void AudioPluginAudioProcessor::setPartPatch (int part, const juce::ValueTree& patch, const juce::String& name)
+{
+    auto tree = getOrCreatePartTree (part);
+    tree.removeChild (tree.getChildWithName (PartTree::patch), nullptr);
+    tree.appendChild (patch, nullptr);
+    tree.setProperty (PartTree::name, name, nullptr);
+    tree.setProperty (PartTree::enabled, true, nullptr);
+    applyPartsFromState();
+}
+
+juce::String AudioPluginAudioProcessor::getPartName (int part) const
+{
+    return part == 0 ? juce::String ("Parameters") : getPartTree (part)[PartTree::name].toString();
+}
+
+void AudioPluginAudioProcessor::applyPartsFromState()
+{
+    engineState.setParts (state.state.getChildWithName (PartTree::type));
+
+    // The parts share one pool, sized for the mode. Only the pool changes:
+    // the effects, the convolution and the notes already sounding carry on.
+    resizeVoicePool (isMultitimbral() ? multitimbralVoices : singleVoices);
+}
+
+int AudioPluginAudioProcessor::getNumSynthVoices() const
+{
+    int count = 0;
+
+    for (int i = 0; i < synth.getNumVoices(); ++i)
+        if (dynamic_cast<SynthVoice*> (synth.getVoice (i)) != nullptr)
+            ++count;
+
+    return count;
+}
+
+void AudioPluginAudioProcessor::resizeVoicePool (int numSynthVoices)
+{
+    // Voices to add are prepared and warmed up here, before the audio thread
+    // can reach them. Ones parked by an earlier shrink already are.
+    juce::OwnedArray<SynthVoice> added;
+
+    for (int count = getNumSynthVoices(); count < numSynthVoices; ++count)
+    {
+        if (! spareVoices.isEmpty())
+        {
+            added.add (spareVoices.removeAndReturn (spareVoices.size() - 1));
+            continue;
+        }
+
+        auto* v = added.add (new SynthVoice);
+
+        if (preparedVoiceBlockSize > 0)
+            prepareSynthVoice (*v);
+    }
+
+    const juce::ScopedLock sl (getCallbackLock());
+
+    while (! added.isEmpty())
+    {
+        auto* v = added.removeAndReturn (0);
+
+        if (preparedVoiceBlockSize > 0)
+            attachSynthVoice (*v, synth.getNumVoices());
+
+        synth.addVoice (v);
+    }
+
+    // Surplus voices are parked rather than freed, so their memory stays in
+    // memoryWarmup; idle ones go first
+    for (int count = getNumSynthVoices(), pass = 0; pass < 2 && count > numSynthVoices; ++pass)
+    {
+        for (int i = synth.getNumVoices(); --i >= 0 && count > numSynthVoices;)
+        {
+            auto* v = dynamic_cast<SynthVoice*> (synth.getVoice (i));
+
+            if (v == nullptr || (pass == 0 && v->isVoiceActive()))
+                continue;
+
+            v->stopNote (0.0f, false);
+            spareVoices.add (static_cast<SynthVoice*> (synth.takeVoice (i).release()));
+            --count;
+        }
+    }
+}
+
+// Message thread, before the voice is in the synth
+void AudioPluginAudioProcessor::prepareSynthVoice (SynthVoice& v)
+{
+    juce::SharedResourcePointer<WaveTableCache> tables;
+
+    v.prepare (synth.getSampleRate(), preparedVoiceBlockSize, getMainBusNumOutputChannels());
+    v.warmUp (memoryWarmup, *tables);
+}
+
+// With the audio thread held off: index is where the voice sits in the synth
+void AudioPluginAudioProcessor::attachSynthVoice (SynthVoice& v, int index)
+{
+    v.applyEngineState (engineState.getCurrent(), 0);
+    v.setPartControls (partControls.data());
+    v.setProfiler (&profiler);
+    v.setTraceRecorder (&tracer, index + 1);
+}
+
+// Audio thread, whenever a new engine state is installed
+void AudioPluginAudioProcessor::updatePartRouting() noexcept
+{
+    const auto& s = engineState.getCurrent();
+
+    for (int part = 0; part < EngineState::maxParts; ++part)
+    {
+        const auto& p = s.parts[(size_t) part];
+
+        if (! s.multitimbral)
+            partSounds[(size_t) part]->setChannel (part == 0 ? 0 : -1);
+        else
+            partSounds[(size_t) part]->setChannel (p.enabled ? p.channel : -1);
+
+        if (part > 0)
+            partControls[(size_t) part] = p.controls;
+    }
+
+    // The sample layer belongs to part 1
+    sampleSound->setChannel (s.multitimbral ? s.parts[0].channel : 0);
+}
+
+// Audio thread, per block: parts with their own output render straight into
+// that bus when the host has it enabled. The resampled engine has no
+// per-part outputs, so then everything goes to the main one.
+void AudioPluginAudioProcessor::updatePartOutputs (juce::AudioBuffer<float>& buffer) noexcept
+{
+    const auto& s = engineState.getCurrent();
+
+    for (int part = 1; part < EngineState::maxParts; ++part)
+    {
+        juce::AudioBuffer<float>* output = nullptr;
+        auto* bus = getBus (false, part);
+
+        if (s.multitimbral && s.parts[(size_t) part].ownOutput && ! resampling
+             && bus != nullptr && bus->isEnabled())
+        {
+            auto& view = partBuffers[(size_t) part];
+            view.setDataToReferTo (buffer.getArrayOfWritePointers() + bus->getChannelIndexInProcessBlockBuffer (0),
+                                   bus->getNumberOfChannels(), buffer.getNumSamples());
+            output = &view;
+        }
+
+        synth.setPartOutput (part, output);
+    }
 }
 
 void AudioPluginAudioProcessor::changeProgramName (int index, const juce::String& newName)
@@ -99,15 +662,68 @@ void AudioPluginAudioProcessor::changeProgramName (int index, const juce::String
 //==============================================================================
 void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    const int numCh = getTotalNumOutputChannels();
-    synth.setCurrentPlaybackSampleRate(sampleRate);
+    // Picks the kernel variant here so the audio thread only reads the choice
+    SimdKernels::resolve();
+
+    // Part outputs match the main one (see isBusesLayoutSupported)
+    const int numCh = getMainBusNumOutputChannels();
+
+    // The voices can run below the host rate and be resampled up at the output
+    preparedEngineRate = getEngineRate();
+    resampling = preparedEngineRate > 0 && sampleRate > preparedEngineRate * 1.01;
+
+    const double engineSampleRate = resampling ? (double) preparedEngineRate : sampleRate;
+    int engineBlockSize = samplesPerBlock;
+
+    if (resampling)
+    {
+        outputResampler.prepare(engineSampleRate, sampleRate, samplesPerBlock, numCh);
+        engineBlockSize = outputResampler.getMaxInputBlock();
+        engineBuffer.setSize(numCh, engineBlockSize);
+        engineMidi.ensureSize(4096);
+    }
+
+    setLatencySamples(resampling ? juce::roundToInt(outputResampler.getLatencySamples()) : 0);
+
+    synth.setCurrentPlaybackSampleRate(engineSampleRate);
+
+    profiler.prepare(sampleRate, samplesPerBlock);
+    loadMeasurer.reset(sampleRate, samplesPerBlock);
+    governor.prepare(sampleRate);
+    tracer.prepare(sampleRate);
+    engineState.prepare(engineSampleRate);
+    spectrum.prepare(sampleRate);
+    noteCache.prepare(engineSampleRate);
+    effects.prepare(sampleRate, samplesPerBlock, numCh);
+    outputRecorder.prepare(sampleRate, numCh);
+
+    // Everything just sized gets faulted in here rather than by the first
+    // callbacks, and locked if the user asked for it
+    memoryWarmup.clear();
+    spareVoices.clear();
+    preparedVoiceBlockSize = engineBlockSize;
 
     for (int i = 0; i < synth.getNumVoices(); ++i)
     {
         if (auto* v = dynamic_cast<SynthVoice*>(synth.getVoice(i)))
-            v->prepare(sampleRate, samplesPerBlock, numCh);   // USE numCh
+        {
+            prepareSynthVoice(*v);
+            attachSynthVoice(*v, i);
+        }
+        else if (auto* sv = dynamic_cast<SampleVoice*>(synth.getVoice(i)))
+        {
+            sv->warmUp(memoryWarmup);
+        }
     }
 
+    updatePartRouting();
+
+    memoryWarmup.add(engineBuffer);
+    effects.warmUp(memoryWarmup);
+    noteCache.warmUp(memoryWarmup);
+    outputRecorder.warmUp(memoryWarmup);
+    memoryWarmup.setLocked(isMemoryLockingEnabled());
+
     // ======== Parameters ============ //
 
     // Buttons & sliders
@@ -115,6 +731,14 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     masterGainParam = state.getRawParameterValue ("masterGain");
     pitchChoiceParam = state.getRawParameterValue ("pitchShift");
     panParam = state.getRawParameterValue ("pan");
+
+    // Start on the current pan rather than ramping in from the last session
+    panLeft.setRampLength(samplesPerBlock);
+    panRight.setRampLength(samplesPerBlock);
+    setPanTargets(panParam->load());
+    panLeft.finish();
+    panRight.finish();
+
     osc1FmParam = state.getRawParameterValue ("osc1FM");
     osc2FmParam = state.getRawParameterValue ("osc2FM");
     fmAmountParam   = state.getRawParameterValue("fmAmount");
@@ -125,6 +749,10 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     sustainParam = state.getRawParameterValue ("sustain");
     releaseParam = state.getRawParameterValue ("release");
 
+    // Drive
+    driveParam     = state.getRawParameterValue("drive");
+    driveTypeParam = state.getRawParameterValue("driveType");
+
     // Filter
     filterCutoffParam    = state.getRawParameterValue("filterCutoff");
     filterResonanceParam = state.getRawParameterValue("filterResonance");
@@ -137,6 +765,7 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     osc1DetuneParam = state.getRawParameterValue("osc1Detune");
     osc1GainParam   = state.getRawParameterValue("osc1Gain");
     osc1FmParam     = state.getRawParameterValue("osc1FM");
+    osc1WtPosParam  = state.getRawParameterValue("osc1WtPos");
 
     // osc 2
     osc2OnParam     = state.getRawParameterValue("osc2On");
@@ -145,16 +774,42 @@ void AudioPluginAudioProcessor::prepareToPlay (double sampleRate, int samplesPer
     osc2DetuneParam = state.getRawParameterValue("osc2Detune");
     osc2GainParam   = state.getRawParameterValue("osc2Gain");
     osc2FmParam     = state.getRawParameterValue("osc2FM");
+    osc2WtPosParam  = state.getRawParameterValue("osc2WtPos");
 
     // blend
     blendParam      = state.getRawParameterValue("oscBlend");
+
+    // sample layer
+    sampleLevelParam = state.getRawParameterValue("sampleLevel");
+
+    renderCacheParam = state.getRawParameterValue("renderCache");
+
+    // effects
+    chorusOnParam      = state.getRawParameterValue("chorusOn");
+    chorusRateParam    = state.getRawParameterValue("chorusRate");
+    chorusDepthParam   = state.getRawParameterValue("chorusDepth");
+    chorusMixParam     = state.getRawParameterValue("chorusMix");
+
+    delayOnParam       = state.getRawParameterValue("delayOn");
+    delayTimeParam     = state.getRawParameterValue("delayTime");
+    delaySyncParam     = state.getRawParameterValue("delaySync");
+    delayFeedbackParam = state.getRawParameterValue("delayFeedback");
+    delayMixParam      = state.getRawParameterValue("delayMix");
+
+    reverbOnParam      = state.getRawParameterValue("reverbOn");
+    reverbSizeParam    = state.getRawParameterValue("reverbSize");
+    reverbDampingParam = state.getRawParameterValue("reverbDamping");
+    reverbMixParam     = state.getRawParameterValue("reverbMix");
+
+    convolutionOnParam  = state.getRawParameterValue("convOn");
+    convolutionMixParam = state.getRawParameterValue("convMix");
 }
 
 
 void AudioPluginAudioProcessor::releaseResources()
 {
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
+    // Hand locked pages back while the host isn't playing us
+    memoryWarmup.clear();
 }
 
 bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
@@ -171,6 +826,12 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported (const BusesLayout& layou
      && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
         return false;
 
+    // Part outputs are off or match the main output
+    for (int bus = 1; bus < layouts.outputBuses.size(); ++bus)
+        if (! layouts.outputBuses[bus].isDisabled()
+             && layouts.outputBuses[bus] != layouts.getMainOutputChannelSet())
+            return false;
+
     // This checks if the input layout matches the output layout
    #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -185,19 +846,49 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
+    juce::AudioProcessLoadMeasurer::ScopedTimer loadTimer (loadMeasurer, buffer.getNumSamples());
+
+    EFFEM_TRACE_BEGIN_CALLBACK(tracer);
 
     buffer.clear();
 
-    // Read all Osc Params
+    // Everything after the synth works on the main output; part outputs are
+    // only written by their voices
+    auto output = getBusBuffer(buffer, false, 0);
+
+    EFFEM_PROFILE_LAP_START(&profiler);
+    EFFEM_TRACE_BEGIN(&tracer, params, 0, 0);
+
+    // ===================== QUALITY ===================== //
+    // The previous blocks' load decides what this one may spend
 
-    auto* osc1OnParam   = state.getRawParameterValue("osc1On");
-    auto* osc2OnParam   = state.getRawParameterValue("osc2On");
+    governor.update(loadMeasurer.getLoadAsProportion(), loadMeasurer.getXRunCount(),
+                    isNonRealtime(), buffer.getNumSamples());
 
-    auto* osc1WaveParam = state.getRawParameterValue("osc1Wave");
-    auto* osc2WaveParam = state.getRawParameterValue("osc2Wave");
+    const auto& quality = governor.getCurrentSettings();
+    synth.setMaxSynthVoices(quality.maxVoices);
+
+    // ===================== ENGINE STATE ===================== //
+    // Waveforms, on/off, pitch, filter type and ADSR are prepared off the audio
+    // thread; a new state is swapped in here and the voices crossfade to it.
+
+    // A bounce would otherwise pick up automated waveform / envelope changes
+    // at a point that depends on the builder thread's timing
+    if (isNonRealtime())
+        engineState.waitForPendingBuild(1000);
+
+    if (engineState.update())
+    {
+        for (int i = 0; i < synth.getNumVoices(); ++i)
+            if (auto* v = dynamic_cast<SynthVoice*>(synth.getVoice(i)))
+                v->applyEngineState(engineState.getCurrent(), engineState.getCrossfadeSamples());
+
+        updatePartRouting();
+    }
 
-    auto* osc1PitchParam = state.getRawParameterValue("osc1Pitch");
-    auto* osc2PitchParam = state.getRawParameterValue("osc2Pitch");
+    updatePartOutputs(buffer);
+
+    // Read all Osc Params
 
     auto* osc1DetuneParam = state.getRawParameterValue("osc1Detune");
     auto* osc2DetuneParam = state.getRawParameterValue("osc2Detune");
@@ -207,33 +898,15 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
 
     auto* blendParam = state.getRawParameterValue("oscBlend");
 
-    // ===================== ADSR / FILTER / GLOBAL ===================== //
-
-    float attack  = *state.getRawParameterValue("attack");
-    float decay   = *state.getRawParameterValue("decay");
-    float sustain = *state.getRawParameterValue("sustain");
-    float release = *state.getRawParameterValue("release");
+    // ===================== FILTER / GLOBAL ===================== //
 
     float cutoff    = *state.getRawParameterValue("filterCutoff");
     float resonance = *state.getRawParameterValue("filterResonance");
-    int   filterType= (int)*state.getRawParameterValue("filterType");
 
     float pan = *state.getRawParameterValue("pan");
 
     // ===================== MAP RAW PARAMETERS ===================== //
 
-    // On/off (bool)
-    bool osc1On  = osc1OnParam ? (bool)*osc1OnParam : true;
-    bool osc2On  = osc2OnParam ? (bool)*osc2OnParam : true;
-
-    // Waveforms (choice -> int)
-    int wave1 = osc1WaveParam ? (int) std::round(*osc1WaveParam) : 0;
-    int wave2 = osc2WaveParam ? (int) std::round(*osc2WaveParam) : 0;
-
-    // Pitch (choice -> int)
-    int pitch1 = osc1PitchParam ? (int) std::round(*osc1PitchParam) : 4;  // index 4 = "0"
-    int pitch2 = osc2PitchParam ? (int) std::round(*osc2PitchParam) : 4;
-
     float detune1 = osc1DetuneParam ? osc1DetuneParam->load() : 0.0f;
     float detune2 = osc2DetuneParam ? osc2DetuneParam->load() : 0.0f;
 
@@ -247,106 +920,253 @@ void AudioPluginAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     float fm1 = osc1FmParam ? osc1FmParam->load() : 0.0f;
     float fm2 = osc2FmParam ? osc2FmParam->load() : 0.0f;
 
-    auto* read = buffer.getReadPointer(0);
-    for (int i = 0; i < buffer.getNumSamples(); ++i)
-        pushNextSampleIntoScope(read[i]);
-
-    // ===================== VISUALIZER ======================= //
-    // for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-    // {
-    //     auto* data = buffer.getReadPointer(ch);
-    //     for (int i = 0; i < buffer.getNumSamples(); ++i)
-    //     {
-    //         // Use channel 0 or the average — here we use CH0:
-    //         if (ch == 0)
-    //             pushNextSampleIntoScope(data[i]);
-    //     }
-    // }
+    if (sampleLevelParam != nullptr)
+        sampleSound->setLevel(sampleLevelParam->load());
+
+    float wtPos1 = osc1WtPosParam ? osc1WtPosParam->load() : 0.0f;
+    float wtPos2 = osc2WtPosParam ? osc2WtPosParam->load() : 0.0f;
+
+    float driveAmount = driveParam ? driveParam->load() : 0.0f;
+    int driveType = driveTypeParam ? juce::roundToInt(driveTypeParam->load()) : 0;
+
+    // ===================== NOTE RENDER CACHE ===================== //
+    // Everything a voice's output depends on goes into the patch hash; any
+    // change to it invalidates the cached notes.
+
+    NoteRenderCache* renderCache = nullptr;
+
+    if (renderCacheParam != nullptr && renderCacheParam->load() > 0.5f
+         && NoteRenderCache::canCache(engineState.getCurrent()))
+    {
+        noteCache.setPatch(NoteRenderCache::PatchHash()
+                               .add(engineState.getCurrent())
+                               .add(gain1).add(detune1)
+                               .add(gain2).add(detune2)
+                               .add(blend)
+                               .add(cutoff).add(resonance)
+                               .add(wtPos1).add(wtPos2)
+                               .add(driveAmount).add(driveType)
+                               .get());
+        renderCache = &noteCache;
+    }
 
     // ===================== UPDATE ALL VOICES ===================== //
+    // Under load the governor lowers the control rate of these updates.
+    // Part 1 plays the parameters; the other parts' controls came with the
+    // engine state.
+
+    auto& live = partControls[0];
+    live.gain1     = gain1;
+    live.detune1   = detune1;
+    live.gain2     = gain2;
+    live.detune2   = detune2;
+    live.blend     = blend;
+    live.cutoff    = cutoff;
+    live.resonance = resonance;
+    live.wtPos1    = wtPos1;
+    live.wtPos2    = wtPos2;
+    live.drive     = driveAmount;
+    live.driveType = driveType;
+    live.fm1       = fm1;
+    live.fm2       = fm2;
+
+    const bool controlUpdate = ++controlBlockCount >= quality.controlDivider;
+
+    if (controlUpdate)
+        controlBlockCount = 0;
 
     for (int i = 0; i < synth.getNumVoices(); ++i)
     {
         if (auto* v = dynamic_cast<SynthVoice*>(synth.getVoice(i)))
         {
-            // waveforms + blend
-            v->updateOscillators(wave1, wave2, blend);
-
-            // oscillator on/off states
-            v->updateOscOnOff(osc1On, osc2On);
-
-            // pitch, detune, gain for each oscillator
-            v->updateFromParameters(
-                gain1, pitch1, detune1,   // osc1 params
-                gain2, pitch2, detune2,   // osc2 params
-                blend                     // blend
-            );
-
-            // envelopes + filters
-            v->updateEnvelope(attack, decay, sustain, release);
-            v->updateFilter(cutoff, resonance, filterType);
-            // FM
-            v->updateFM(fm1, fm2);
+            const auto& controls = partControls[(size_t) v->getPart()];
+
+            // detune, gain, blend, filter, drive and FM
+            if (controlUpdate)
+                v->updateControls(controls);
+
+            // wavetable frame morph
+            v->updateWaveTablePosition(controls.wtPos1, controls.wtPos2);
+
+            v->setRenderCache(renderCache);
         }
     }
 
+    EFFEM_PROFILE_LAP(params);
+    EFFEM_TRACE_END(&tracer, params, 0);
+
     // ===================== RENDER SYNTH ===================== //
 
-    synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+    renderEngine(output, midiMessages);
 
-    // Visualizer
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-    {
-        const float* read = buffer.getReadPointer(ch);
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-        {
-            // Track left channel only (common oscilloscope behavior)
-            if (ch == 0)
-                pushNextSampleIntoScope(read[i]);
-        }
-    }
+    EFFEM_PROFILE_LAP(synthRender);
+
+    // Visualizer: track left channel only (common oscilloscope behavior)
+    pushIntoScope(output.getReadPointer(0), output.getNumSamples());
+    spectrum.push(output.getReadPointer(0), output.getNumSamples());
+
+    EFFEM_PROFILE_LAP(scope);
 
     // ===================== PAN ===================== //
 
-    if (buffer.getNumChannels() >= 2)
+    if (output.getNumChannels() >= 2)
     {
-        const float angle = (pan + 1.0f) * juce::MathConstants<float>::halfPi * 0.5f;
-        float leftGain  = std::cos(angle);
-        float rightGain = std::sin(angle);
+        setPanTargets(pan);
 
-        auto* left  = buffer.getWritePointer(0);
-        auto* right = buffer.getWritePointer(1);
+        const int n = output.getNumSamples();
+        const auto left  = panLeft.next(n);
+        const auto right = panRight.next(n);
 
-        for (int s = 0; s < buffer.getNumSamples(); ++s)
-        {
-            left[s]  *= leftGain;
-            right[s] *= rightGain;
-        }
+        const auto& kernels = SimdKernels::get();
+        kernels.applyGainRamp(output.getWritePointer(0), left.start,  left.step,  n);
+        kernels.applyGainRamp(output.getWritePointer(1), right.start, right.step, n);
     }
 
     // Apply master gain AFTER pan and before output
     float masterGain = masterGainParam ? masterGainParam->load() : 1.0f;
 
-    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
-    {
-        for (int i = 0; i < buffer.getNumSamples(); ++i)
-        {
-            float s = buffer.getSample(ch, i);
-            pushNextSampleIntoScope(s);
-        }
-        pushNextSampleIntoScope(buffer.getSample(0, 0));
+    EFFEM_PROFILE_LAP(master);
 
-        break; // just take channel 0
-    }
+    // ===================== EFFECTS ===================== //
 
+    updateEffects();
+    effects.process(output, output.getNumSamples());
 
+    EFFEM_PROFILE_LAP(effects);
 
     // ===================== PLAY PARAM (MUTE) ===================== //
 
     if (playParam && ! (bool)playParam->load())
         buffer.clear();
+
+    outputRecorder.push(output, output.getNumSamples());
+
+    EFFEM_PROFILE_LAP(master);
+    EFFEM_PROFILE_END_CALLBACK(profiler, buffer.getNumSamples());
+    EFFEM_TRACE_END_CALLBACK(tracer, buffer.getNumSamples());
+}
+
+
+//==============================================================================
+void AudioPluginAudioProcessor::setPanTargets(float pan) noexcept
+{
+    // Equal-power pan law
+    const float angle = (pan + 1.0f) * juce::MathConstants<float>::halfPi * 0.5f;
+    panLeft.setTarget(std::cos(angle));
+    panRight.setTarget(std::sin(angle));
+}
+
+//==============================================================================
+// The playhead is only valid inside processBlock, and getPosition() just
+// copies what the host handed us, so reading it here takes no lock.
+void AudioPluginAudioProcessor::updateEffects()
+{
+    if (chorusOnParam == nullptr)
+        return;
+
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (auto bpm = position->getBpm())
+                effects.setTempo(*bpm);
+
+    effects.setChorus((bool) chorusOnParam->load(), chorusRateParam->load(),
+                      chorusDepthParam->load(), chorusMixParam->load());
+
+    effects.setDelay((bool) delayOnParam->load(), delayTimeParam->load(),
+                     (int) delaySyncParam->load(), delayFeedbackParam->load(),
+                     delayMixParam->load());
+
+    effects.setReverb((bool) reverbOnParam->load(), reverbSizeParam->load(),
+                      reverbDampingParam->load(), reverbMixParam->load());
+
+    effects.setConvolution((bool) convolutionOnParam->load(), convolutionMixParam->load());
+    effects.setNonRealtime(isNonRealtime());
+
+    updateTailLength();
+}
+
+// The longest release of any playing part, then the effects ringing out.
+// Rounded up to a step so automation doesn't have the host re-query it on
+// every block.
+void AudioPluginAudioProcessor::updateTailLength() noexcept
+{
+    const auto& engine = engineState.getCurrent();
+    double release = 0.0;
+
+    for (int part = 0; part < EngineState::maxParts; ++part)
+        if (part == 0 || (engine.multitimbral && engine.parts[(size_t) part].enabled))
+            release = juce::jmax (release, (double) engine.parts[(size_t) part].envelope.release);
+
+    const auto tail = std::ceil ((release + effects.getTailSeconds()) / tailStepSeconds) * tailStepSeconds;
+
+    if (tailSeconds.exchange (tail) != tail)
+        triggerAsyncUpdate();
+}
+
+void AudioPluginAudioProcessor::handleAsyncUpdate()
+{
+    updateHostDisplay();
 }
 
+//==============================================================================
+// At the host rate the synth renders straight into the output. Otherwise it
+// renders however many engine-rate samples the resampler needs for this block,
+// with the MIDI moved to the matching engine samples.
+void AudioPluginAudioProcessor::renderEngine(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    if (! resampling)
+    {
+        synth.renderNextBlock(buffer, midiMessages, 0, buffer.getNumSamples());
+        return;
+    }
+
+    const int numOut = buffer.getNumSamples();
+    const int numIn  = outputResampler.getInputNeeded(numOut);
+
+    engineMidi.clear();
+
+    for (const auto metadata : midiMessages)
+        engineMidi.addEvent(metadata.data, metadata.numBytes,
+                            outputResampler.getInputOffset(metadata.samplePosition, numIn));
+
+    engineBuffer.clear(0, numIn);
+    synth.renderNextBlock(engineBuffer, engineMidi, 0, numIn);
+
+    outputResampler.process(engineBuffer, numIn, buffer, numOut);
+}
+
+//==============================================================================
+// Collects scopeSize samples per frame. Silent frames are only published once,
+// so an idle synth stops waking the editor.
+void AudioPluginAudioProcessor::pushIntoScope(const float* samples, int numSamples)
+{
+    while (numSamples > 0)
+    {
+        const int n = juce::jmin(numSamples, scopeSize - scopeFill);
+        auto* dst = scopeFrames.getWriteBuffer().data() + scopeFill;
+
+        std::copy(samples, samples + n, dst);
+
+        const auto range = juce::FloatVectorOperations::findMinAndMax(dst, n);
+        scopePeak = juce::jmax(scopePeak, -range.getStart(), range.getEnd());
+
+        scopeFill += n;
+        samples += n;
+        numSamples -= n;
+
+        if (scopeFill == scopeSize)
+        {
+            const bool silent = scopePeak < 1.0e-5f;
+
+            if (! (silent && lastScopeFrameSilent))
+                scopeFrames.publish();
+
+            lastScopeFrameSilent = silent;
+            scopeFill = 0;
+            scopePeak = 0.0f;
+        }
+    }
+}
 
 //==============================================================================
 bool AudioPluginAudioProcessor::hasEditor() const
@@ -362,21 +1182,27 @@ juce::AudioProcessorEditor* AudioPluginAudioProcessor::createEditor()
 //==============================================================================
 void AudioPluginAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    auto valueTree = state.copyState();
-
-    std::unique_ptr<juce::XmlElement> xml (valueTree.createXml());
-    copyXmlToBinary(*xml, destData);
+    writeProgramToState();
+    StateCodec::write(state, destData);
 }
 
 void AudioPluginAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xml (getXmlFromBinary(data, sizeInBytes));
+    engineState.beginBatch();
 
-    if (xml && xml->hasTagName(state.state.getType()))
-    {
-        auto vt = juce::ValueTree::fromXml(*xml);
-        state.replaceState(vt);
-    }
+    // Binary state, or the XML written by older versions
+    StateCodec::read(state, data, sizeInBytes);
+    applyTuningFromState();
+    applyWaveTablesFromState();
+    applySampleKitFromState();
+    applyImpulseResponseFromState();
+    applyPartsFromState();
+    applyProgramFromState();
+
+    engineState.endBatch();
+
+    applyEngineRateFromState();
+    memoryWarmup.setLocked (isMemoryLockingEnabled());
 }
 
 //==============================================================================
@@ -429,6 +1255,17 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
         NormalisableRange<float> (0.001f, 5.0f, 0.0f, 0.5f),
         0.2f));
 
+    // ========== DRIVE ========== //
+    // Per-voice waveshaper ahead of the filter; off at zero
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "drive", "Drive",
+        NormalisableRange<float>(0.0f, 1.0f, 0.001f), 0.0f));
+
+    params.push_back(std::make_unique<AudioParameterChoice>(
+        "driveType", "Drive Type",
+        StringArray { "Tanh", "Hard Clip", "Foldback" },
+        0));
+
     // ========== FILTER CONTROLS ========== //
     params.push_back(std::make_unique<AudioParameterFloat>(
         "filterCutoff", "Cutoff",
@@ -441,7 +1278,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
     params.push_back(std::make_unique<AudioParameterChoice>(
         "filterType", "Filter Type",
         StringArray { "Lowpass", "Highpass", "Bandpass" },
-        0     // 0 = LP, 1 = HP, 2 = BP
+        0     // index = VoiceFilter::Type
     ));
 
     // ========== OSC1 ========== //
@@ -450,7 +1287,7 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
 
     params.push_back(std::make_unique<AudioParameterChoice>(
         "osc1Wave", "OSC1 Waveform",
-        StringArray{ "Sine","Square","Saw","Triangle","Noise","Add1","Add2" }, 0));
+        StringArray{ "Sine","Square","Saw","Triangle","Noise","Add1","Add2","User" }, 0));
 
     // 5-point pitch for OSC1 (matches editor)
     params.push_back(std::make_unique<AudioParameterChoice>(
@@ -466,13 +1303,16 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
     params.push_back(std::make_unique<AudioParameterFloat>(
         "osc1FM", "OSC1 FM", 0.f, 10.f, 0.f));
 
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "osc1WtPos", "OSC1 Wavetable Position", 0.f, 1.f, 0.f));
+
     // ========== OSC2 ========== //
     params.push_back(std::make_unique<AudioParameterBool>(
         "osc2On", "OSC2 On", true));
 
     params.push_back(std::make_unique<AudioParameterChoice>(
         "osc2Wave", "OSC2 Waveform",
-        StringArray{ "Sine","Square","Saw","Triangle","Noise","Add1","Add2" }, 0));
+        StringArray{ "Sine","Square","Saw","Triangle","Noise","Add1","Add2","User" }, 0));
 
     params.push_back(std::make_unique<AudioParameterChoice>(
         "osc2Pitch", "OSC2 Pitch",
@@ -487,9 +1327,81 @@ juce::AudioProcessorValueTreeState::ParameterLayout AudioPluginAudioProcessor::c
     params.push_back(std::make_unique<AudioParameterFloat>(
         "osc2FM", "OSC2 FM", 0.f, 10.f, 0.f));
 
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "osc2WtPos", "OSC2 Wavetable Position", 0.f, 1.f, 0.f));
+
     // ========== BLEND ========== //
     params.push_back(std::make_unique<AudioParameterFloat>(
         "oscBlend", "OSC Blend", 0.f, 1.f, 0.5f));
 
+    // ========== SAMPLE LAYER ========== //
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "sampleLevel", "Sample Level", 0.f, 1.f, 0.8f));
+
+    // ========== NOTE RENDER CACHE ========== //
+    // Replays identical one-shot hits (sustain at zero) from memory
+    params.push_back(std::make_unique<AudioParameterBool>(
+        "renderCache", "Note Render Cache", false));
+
+    // ========== EFFECTS ========== //
+    // Master chorus -> delay -> reverb; each is out of the chain when off
+    params.push_back(std::make_unique<AudioParameterBool>(
+        "chorusOn", "Chorus On", false));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "chorusRate", "Chorus Rate",
+        NormalisableRange<float>(0.05f, 5.0f, 0.0f, 0.5f), 0.8f));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "chorusDepth", "Chorus Depth", 0.f, 1.f, 0.5f));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "chorusMix", "Chorus Mix", 0.f, 1.f, 0.5f));
+
+    params.push_back(std::make_unique<AudioParameterBool>(
+        "delayOn", "Delay On", false));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "delayTime", "Delay Time",
+        NormalisableRange<float>(10.0f, 2000.0f, 1.0f, 0.5f), 350.0f));
+
+    params.push_back(std::make_unique<AudioParameterChoice>(
+        "delaySync", "Delay Sync",
+        StringArray { "Free", "1/4", "1/8", "1/8 D", "1/16", "1/4 T", "1/8 T" },
+        0));   // matches EffectsRack::getSyncBeats
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "delayFeedback", "Delay Feedback", 0.f, 0.95f, 0.35f));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "delayMix", "Delay Mix", 0.f, 1.f, 0.3f));
+
+    params.push_back(std::make_unique<AudioParameterBool>(
+        "reverbOn", "Reverb On", false));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "reverbSize", "Reverb Size", 0.f, 1.f, 0.5f));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "reverbDamping", "Reverb Damping", 0.f, 1.f, 0.5f));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "reverbMix", "Reverb Mix", 0.f, 1.f, 0.25f));
+
+    // Silent until an impulse response is loaded
+    params.push_back(std::make_unique<AudioParameterBool>(
+        "convOn", "Convolution On", false));
+
+    params.push_back(std::make_unique<AudioParameterFloat>(
+        "convMix", "Convolution Mix", 0.f, 1.f, 0.3f));
+
+    // Added after the rest so existing automation keeps its meaning: Filter
+    // Type stays three choices and the newer models are a separate choice.
+    // State Variable uses Filter Type; any other model replaces it.
+    params.push_back(std::make_unique<AudioParameterChoice>(
+        "filterModel", "Filter Model",
+        StringArray { "State Variable", "Ladder", "Formant", "Comb" },
+        0));
+
     return { params.begin(), params.end() };
 }
@@ -4,9 +4,25 @@
 #include "Oscillator.h"
 #include "SynthVoice.h"
 #include "SynthSound.h"
+#include "StageProfiler.h"
+#include "TraceRecorder.h"
+#include "EffemSynthesiser.h"
+#include "PresetBank.h"
+#include "EngineState.h"
+#include "TripleBuffer.h"
+#include "SpectrumAnalyzer.h"
+#include "SampleVoice.h"
+#include "NoteRenderCache.h"
+#include "PolyphaseResampler.h"
+#include "QualityGovernor.h"
+#include "EffectsRack.h"
+#include "OutputRecorder.h"
+#include "MemoryWarmup.h"
 
 //==============================================================================
-class AudioPluginAudioProcessor final : public juce::AudioProcessor
+class AudioPluginAudioProcessor final : public juce::AudioProcessor,
+                                        private juce::ChangeListener,
+                                        private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -48,26 +64,202 @@ public:
 
     juce::AudioProcessorValueTreeState& getState() { return state; }
 
+    // Presets (message thread)
+    PresetBank& getPresetBank() { return *presetBank; }
+    bool saveCurrentAsPreset (const juce::String& name);
+
+    // Microtuning (message thread). The files are checked here and kept in the
+    // session state; the frequency table is compiled on the engine state thread.
+    juce::Result loadTuning (const juce::File& scaleFile, const juce::File& keyboardMapFile);
+    void resetTuning();
+    juce::String getTuningName() const;
+
+    // User wavetables for the "User" waveform (message thread). Only the file
+    // header is checked here; decoding happens on the engine state thread.
+    juce::Result loadWaveTable (int oscIndex, const juce::File& file);
+    juce::String getWaveTableName (int oscIndex) const;
+
+    // Sample layer (message thread). A folder is a drum kit, a single file a
+    // pitched instrument; loading and preloading run on the streamer thread.
+    juce::Result loadSampleKit (const juce::File& fileOrFolder);
+    void clearSampleKit();
+    juce::String getSampleKitName() const;
+
+    // Impulse response for the convolution reverb (message thread). Decoding
+    // and resampling happen on the stage's loader thread.
+    juce::Result loadImpulseResponse (const juce::File& file);
+    void clearImpulseResponse();
+    juce::String getImpulseResponseName() const;
+
+    // Internal engine rate (message thread). 0 runs the engine at the host
+    // rate; 48000 or 96000 run it at that rate and resample up to the host
+    // when the host is faster. Changing it re-prepares the engine.
+    void setEngineRate (int hz);
+    int getEngineRate() const;
+    bool isResampling() const noexcept { return resampling; }
+
+    // Keeps the audio thread's buffers locked in RAM (message thread). Best
+    // effort: compare the byte counts to see how much the OS allowed.
+    void setMemoryLocking (bool shouldLock);
+    bool isMemoryLockingEnabled() const;
+    size_t getLockedMemoryBytes() const noexcept { return memoryWarmup.getLockedBytes(); }
+    size_t getWarmedMemoryBytes() const noexcept { return memoryWarmup.getTotalBytes(); }
+
+    // Multitimbral mode (message thread). Part 1 (index 0) plays the plugin's
+    // parameters; parts 2-16 each play a patch stored in the session. Parts
+    // listen on a MIDI channel each, and parts on the same channel layer. All
+    // of them draw on one voice pool, which grows while the mode is on.
+    static constexpr int singleVoices = 8;
+    static constexpr int multitimbralVoices = 32;
+
+    void setMultitimbral (bool shouldBeOn);
+    bool isMultitimbral() const;
+
+    void setPartEnabled (int part, bool shouldBeEnabled);
+    bool isPartEnabled (int part) const;
+    void setPartChannel (int part, int midiChannel);
+    int getPartChannel (int part) const;
+
+    // Parts 2-16 can render to their own output bus, if the host enables it
+    void setPartOwnOutput (int part, bool shouldUseOwnOutput);
+    bool hasPartOwnOutput (int part) const;
+
+    // Stores the current sound, or a preset from the bank, as a part's patch
+    void copySoundToPart (int part);
+    bool loadPresetIntoPart (int part, int presetIndex);
+    juce::String getPartName (int part) const;
+
+    // Profiling (read from the editor at UI rate)
+    StageProfiler& getProfiler() { return profiler; }
+    double getCallbackLoad() const { return loadMeasurer.getLoadAsProportion(); }
+    int getXrunCount() const { return loadMeasurer.getXRunCount(); }
+    int getQualityLevel() const { return governor.getLevel(); }
+
+    // Callback timeline tracing (no-op unless built with EFFEM_TRACING)
+    TraceRecorder& getTraceRecorder() { return tracer; }
+
+    // Takes of the final output, written to disk off the audio thread
+    OutputRecorder& getOutputRecorder() { return outputRecorder; }
+
     // Visualizer
     static constexpr int scopeSize = 512;   // oscilloscope resolution
+    using ScopeFrame = std::array<float, scopeSize>;
 
-    std::atomic<int> scopeWritePos { 0 };
-    std::array<float, scopeSize> scopeData {};
+    // Completed scope frames; the editor fetch()es and repaints only when a
+    // new one has been published
+    TripleBuffer<ScopeFrame>& getScopeFrames() { return scopeFrames; }
 
-    // Call this for each sample to feed the oscilloscope
-    inline void pushNextSampleIntoScope(float sample)
-    {
-        int index = scopeWritePos.load(std::memory_order_relaxed);
+    SpectrumAnalyzer& getSpectrumAnalyzer() { return spectrum; }
 
-        scopeData[index] = sample;
+private:
+    EffemSynthesiser synth;
 
-        index = (index + 1) % scopeSize;
+    StageProfiler profiler;
+    juce::AudioProcessLoadMeasurer loadMeasurer;
+    QualityGovernor governor;
+    int controlBlockCount = 0;
+    TraceRecorder tracer;
+    OutputRecorder outputRecorder;
 
-        scopeWritePos.store(index, std::memory_order_relaxed);
-    }
+    // Shared by every instance; a preset saved by one shows up in all of them
+    juce::SharedResourcePointer<PresetBank> presetBank;
+    PresetBank::Binding presetBinding { *presetBank, *this };
+    int currentProgram = 0;
 
-private:
-    juce::Synthesiser synth;
+    void changeListenerCallback (juce::ChangeBroadcaster*) override;
+
+    // Oscilloscope feed (audio thread)
+    TripleBuffer<ScopeFrame> scopeFrames;
+    int scopeFill = 0;
+    float scopePeak = 0.0f;
+    bool lastScopeFrameSilent = false;
+
+    void pushIntoScope(const float* samples, int numSamples);
+
+    void applyTuningFromState();
+    void applyWaveTablesFromState();
+    void applySampleKitFromState();
+    void applyEngineRateFromState();
+    void applyImpulseResponseFromState();
+    void applyPartsFromState();
+    void writeProgramToState();
+    void applyProgramFromState();
+
+    // ===== Multitimbral parts =====
+    juce::ValueTree getPartTree (int part) const;
+    juce::ValueTree getOrCreatePartTree (int part);
+    void setPartPatch (int part, const juce::ValueTree& patch, const juce::String& name);
+    int getNumSynthVoices() const;
+    void resizeVoicePool (int numSynthVoices);
+    void prepareSynthVoice (SynthVoice&);
+    void attachSynthVoice (SynthVoice&, int index);
+    void updatePartRouting() noexcept;
+    void updatePartOutputs (juce::AudioBuffer<float>& buffer) noexcept;
+
+    std::array<SynthSound*, EngineState::maxParts> partSounds {};   // owned by synth
+    std::array<EngineState::Controls, EngineState::maxParts> partControls;
+    std::array<juce::AudioBuffer<float>, EngineState::maxParts> partBuffers;   // views of part buses
+
+    // SynthVoices a smaller pool left over, prepared for the current rate and
+    // reused when the pool grows again. Dropped by prepareToPlay.
+    juce::OwnedArray<SynthVoice> spareVoices;
+    int preparedVoiceBlockSize = 0;   // 0 until prepareToPlay
+
+    // Fixed-rate engine: the synth renders into engineBuffer at the internal
+    // rate and outputResampler converts it to the host rate
+    bool resampling = false;
+    int preparedEngineRate = 0;
+    PolyphaseResampler outputResampler;
+    juce::AudioBuffer<float> engineBuffer;
+    juce::MidiBuffer engineMidi;
+
+    void renderEngine(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+
+    SampleSound* sampleSound = nullptr;   // owned by synth
+    std::atomic<float>* sampleLevelParam = nullptr;
+
+    // Idle unless an editor is showing it
+    SpectrumAnalyzer spectrum;
+
+    // Opt-in replay of repeated one-shot notes
+    NoteRenderCache noteCache;
+    std::atomic<float>* renderCacheParam = nullptr;
+
+    // Master effects after pan, at the host rate
+    EffectsRack effects;
+
+    // The buffers above, faulted in and optionally locked in prepareToPlay.
+    // Declared after them so it unlocks before they're freed.
+    MemoryWarmup memoryWarmup;
+
+    std::atomic<float>* chorusOnParam      = nullptr;
+    std::atomic<float>* chorusRateParam    = nullptr;
+    std::atomic<float>* chorusDepthParam   = nullptr;
+    std::atomic<float>* chorusMixParam     = nullptr;
+
+    std::atomic<float>* delayOnParam       = nullptr;
+    std::atomic<float>* delayTimeParam     = nullptr;
+    std::atomic<float>* delaySyncParam     = nullptr;
+    std::atomic<float>* delayFeedbackParam = nullptr;
+    std::atomic<float>* delayMixParam      = nullptr;
+
+    std::atomic<float>* reverbOnParam      = nullptr;
+    std::atomic<float>* reverbSizeParam    = nullptr;
+    std::atomic<float>* reverbDampingParam = nullptr;
+    std::atomic<float>* reverbMixParam     = nullptr;
+
+    std::atomic<float>* convolutionOnParam  = nullptr;
+    std::atomic<float>* convolutionMixParam = nullptr;
+
+    void updateEffects();
+
+    // Reported to the host; updated from the audio thread, which then has the
+    // message thread tell the host
+    static constexpr double tailStepSeconds = 0.25;
+    std::atomic<double> tailSeconds { 0.0 };
+
+    void updateTailLength() noexcept;
+    void handleAsyncUpdate() override;
 
     // parameters
     std::atomic<float>* playParam = nullptr;
@@ -77,12 +269,20 @@ private:
     std::atomic<float>* panParam = nullptr;
     std::atomic<float>* fmAmountParam = nullptr;
 
+    // Pan gains, ramped across each block at the host rate
+    ParameterRamp<float> panLeft, panRight;
+    void setPanTargets (float pan) noexcept;
+
     // envelope
     std::atomic<float>* attackParam  = nullptr;
     std::atomic<float>* decayParam   = nullptr;
     std::atomic<float>* sustainParam = nullptr;
     std::atomic<float>* releaseParam = nullptr;
 
+    // drive
+    std::atomic<float>* driveParam = nullptr;
+    std::atomic<float>* driveTypeParam = nullptr;
+
     // filter
     std::atomic<float>* filterCutoffParam = nullptr;
     std::atomic<float>* filterResonanceParam = nullptr;
@@ -97,6 +297,9 @@ private:
     juce::AudioProcessorValueTreeState state;
     juce::AudioProcessorValueTreeState::ParameterLayout createParameters();
 
+    // Double-buffered structural state (tables, filter type, envelope)
+    EngineStateManager engineState { state };
+
     // OSC1 parameters
     std::atomic<float>* osc1OnParam      = nullptr;
     std::atomic<float>* osc1WaveParam    = nullptr;
@@ -104,6 +307,7 @@ private:
     std::atomic<float>* osc1DetuneParam  = nullptr;
     std::atomic<float>* osc1GainParam    = nullptr;
     std::atomic<float>* osc1FmParam      = nullptr;
+    std::atomic<float>* osc1WtPosParam   = nullptr;
 
     // OSC2 parameters
     std::atomic<float>* osc2OnParam      = nullptr;
@@ -112,6 +316,7 @@ private:
     std::atomic<float>* osc2DetuneParam  = nullptr;
     std::atomic<float>* osc2GainParam    = nullptr;
     std::atomic<float>* osc2FmParam      = nullptr;
+    std::atomic<float>* osc2WtPosParam   = nullptr;
 
     // Blend
     std::atomic<float>* blendParam       = nullptr;
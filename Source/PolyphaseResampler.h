@@ -0,0 +1,60 @@
+#ifndef EFFEM_UNIT_POLYPHASERESAMPLER_H
+#define EFFEM_UNIT_POLYPHASERESAMPLER_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+
+//==============================================================================
+// Converts the engine's output from its internal rate up to the host rate.
+//
+// A windowed-sinc FIR is stored as numPhases sub-filters of numTaps taps;
+// each output sample blends the two sub-filters around its fractional input
+// position, so any ratio works (48 kHz -> 176.4 kHz included). The filter is
+// centred numTaps / 2 input samples in the past, which is the latency: 48
+// engine samples, 1 ms at 48 kHz.
+//
+// The caller pulls: getInputNeeded() says how many engine samples to render
+// for the next host block, and getInputOffset() places MIDI events from that
+// block at the matching engine sample.
+class PolyphaseResampler
+{
+public:
+    static constexpr int numTaps   = 96;
+    static constexpr int numPhases = 256;
+
+    // ===== Message thread =====
+    void prepare (double inputRate, double outputRate, int maxOutputBlock, int numChannels);
+
+    // Output samples by which the resampled signal trails the host timeline
+    double getLatencySamples() const noexcept   { return (numTaps / 2) / step; }
+
+    // Largest getInputNeeded() for a block of up to maxOutputBlock
+    int getMaxInputBlock() const noexcept       { return maxInputBlock; }
+
+    // ===== Audio thread =====
+    void reset() noexcept;
+
+    int getInputNeeded (int numOutput) const noexcept;
+
+    // Engine sample (0 .. numInput - 1) of the block about to be rendered that
+    // lines up with outputSample of the host block
+    int getInputOffset (int outputSample, int numInput) const noexcept;
+
+    // Consumes numInput = getInputNeeded (numOutput) samples from every channel
+    // of input and writes numOutput samples to output
+    void process (const juce::AudioBuffer<float>& input, int numInput,
+                  juce::AudioBuffer<float>& output, int numOutput) noexcept;
+
+private:
+    double step = 1.0;          // input samples per output sample
+    double position = 0.0;      // input position of the next output, in history coordinates
+    int numBuffered = 0;
+    int maxInputBlock = 0;
+
+    std::vector<float> coefficients;            // (numPhases + 1) x numTaps
+    std::vector<std::vector<float>> history;    // per channel
+};
+
+#endif //EFFEM_UNIT_POLYPHASERESAMPLER_H
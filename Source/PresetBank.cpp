@@ -0,0 +1,325 @@
+#include "PresetBank.h"
+#include "StateCodec.h"
+#include <cstring>
+#include <unordered_map>
+
+static constexpr char bankMagic[4] = { 'E', 'F', 'B', 'K' };
+static constexpr int headerSize = 32;
+
+static juce::uint32 readU32 (const juce::uint8* p) noexcept { return juce::ByteOrder::littleEndianInt (p); }
+static juce::uint16 readU16 (const juce::uint8* p) noexcept { return juce::ByteOrder::littleEndianShort (p); }
+
+//==============================================================================
+juce::File PresetBank::getDefaultFile()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+               .getChildFile ("EFFEM")
+               .getChildFile ("Presets.effembank");
+}
+
+//==============================================================================
+PresetBank::PresetBank()
+{
+    open (getDefaultFile());
+}
+
+bool PresetBank::open (const juce::File& file)
+{
+    const juce::ScopedWriteLock sl (lock);
+    return openLocked (file);
+}
+
+void PresetBank::close()
+{
+    const juce::ScopedWriteLock sl (lock);
+    closeLocked();
+}
+
+bool PresetBank::isOpen() const noexcept
+{
+    const juce::ScopedReadLock sl (lock);
+    return base != nullptr;
+}
+
+void PresetBank::refresh()
+{
+    {
+        const juce::ScopedWriteLock sl (lock);
+
+        if (bankFile.getLastModificationTime() == bankModified)
+            return;
+
+        openLocked (bankFile);
+    }
+
+    sendSynchronousChangeMessage();
+}
+
+bool PresetBank::openLocked (const juce::File& file)
+{
+    closeLocked();
+    bankFile = file;
+    bankModified = file.getLastModificationTime();
+
+    if (! file.existsAsFile())
+        return false;
+
+   #if JUCE_WINDOWS
+    if (! file.loadFileAsData (contents))
+        return false;
+
+    const auto size = (juce::int64) contents.getSize();
+    auto* data = static_cast<const juce::uint8*> (contents.getData());
+   #else
+    auto mapped = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly);
+    const auto size = (juce::int64) mapped->getSize();
+    auto* data = static_cast<const juce::uint8*> (mapped->getData());
+   #endif
+
+    if (data == nullptr || size < headerSize || std::memcmp (data, bankMagic, sizeof (bankMagic)) != 0)
+        return false;
+
+    const auto version  = readU16 (data + 4);
+    const auto columns  = readU16 (data + 6);
+    const auto presets  = readU32 (data + 8);
+    const auto colOff   = readU32 (data + 12);
+    const auto nameOff  = readU32 (data + 16);
+    const auto recOff   = readU32 (data + 20);
+
+    if (version == 0 || version > currentVersion)
+        return false;
+
+    // Bounds-check every section before trusting the mapping
+    const auto end = (size_t) size;
+
+    if ((size_t) colOff  + (size_t) columns * 4 > end
+     || (size_t) nameOff + (size_t) presets * nameLength > end
+     || (size_t) recOff  + (size_t) presets * columns * 4 > end
+     || (colOff & 3) != 0 || (recOff & 3) != 0)
+        return false;
+
+   #if ! JUCE_WINDOWS
+    mapping      = std::move (mapped);
+   #endif
+    base         = data;
+    numColumns   = columns;
+    numPresets   = (int) presets;
+    columnHashes = data + colOff;
+    names        = reinterpret_cast<const char*> (data + nameOff);
+    records      = data + recOff;
+    return true;
+}
+
+void PresetBank::closeLocked()
+{
+    ++generation;
+    mapping.reset();
+    contents.reset();
+    base = nullptr;
+    numPresets = numColumns = 0;
+    columnHashes = nullptr;
+    names = nullptr;
+    records = nullptr;
+}
+
+//==============================================================================
+int PresetBank::getNumPresets() const noexcept
+{
+    const juce::ScopedReadLock sl (lock);
+    return numPresets;
+}
+
+int PresetBank::getNumColumns() const noexcept
+{
+    const juce::ScopedReadLock sl (lock);
+    return numColumns;
+}
+
+juce::String PresetBank::getPresetName (int index) const
+{
+    const juce::ScopedReadLock sl (lock);
+    return getPresetNameLocked (index);
+}
+
+float PresetBank::getValue (int index, int column) const noexcept
+{
+    const juce::ScopedReadLock sl (lock);
+    return getValueLocked (index, column);
+}
+
+juce::String PresetBank::getPresetNameLocked (int index) const
+{
+    if (! juce::isPositiveAndBelow (index, numPresets))
+        return {};
+
+    auto* n = names + (size_t) index * nameLength;
+    return juce::String::fromUTF8 (n, (int) strnlen (n, nameLength));
+}
+
+float PresetBank::getValueLocked (int index, int column) const noexcept
+{
+    if (! juce::isPositiveAndBelow (index, numPresets) || ! juce::isPositiveAndBelow (column, numColumns))
+        return 0.0f;
+
+    const auto bits = readU32 (records + ((size_t) index * (size_t) numColumns + (size_t) column) * 4);
+
+    float value;
+    std::memcpy (&value, &bits, sizeof (value));
+    return value;
+}
+
+juce::uint32 PresetBank::getColumnHashLocked (int column) const noexcept
+{
+    return readU32 (columnHashes + (size_t) column * 4);
+}
+
+//==============================================================================
+bool PresetBank::addPreset (const juce::String& name, juce::AudioProcessor& processor)
+{
+    // The new bank uses the current parameter set as its columns; older presets
+    // are remapped by hash and fall back to defaults for new parameters.
+    juce::Array<juce::RangedAudioParameter*> params;
+
+    for (auto* p : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p))
+            params.add (ranged);
+
+    // Another process may have added presets since this one mapped the file,
+    // so build from what's on disk now, with other writers held off
+    static juce::InterProcessLock bankLock ("EFFEM preset bank");
+    const juce::InterProcessLock::ScopedLockType fileLock (bankLock);
+
+    if (! fileLock.isLocked())
+        return false;
+
+    bool saved = false;
+
+    {
+        const juce::ScopedWriteLock sl (lock);
+
+        const auto file = bankFile != juce::File() ? bankFile : getDefaultFile();
+        openLocked (file);
+
+        const int newColumns = params.size();
+        const int newPresets = numPresets + 1;
+
+        std::unordered_map<juce::uint32, int> oldColumnByHash;
+
+        for (int c = 0; c < numColumns; ++c)
+            oldColumnByHash[getColumnHashLocked (c)] = c;
+
+        const int colOff  = headerSize;
+        const int nameOff = colOff + newColumns * 4;
+        const int recOff  = nameOff + newPresets * nameLength;   // nameLength keeps 4-byte alignment
+
+        juce::MemoryOutputStream out;
+        out.write (bankMagic, sizeof (bankMagic));
+        out.writeShort ((short) currentVersion);
+        out.writeShort ((short) newColumns);
+        out.writeInt (newPresets);
+        out.writeInt (colOff);
+        out.writeInt (nameOff);
+        out.writeInt (recOff);
+        out.writeRepeatedByte (0, (size_t) (headerSize - out.getPosition()));
+
+        for (auto* p : params)
+            out.writeInt ((int) StateCodec::hashParameterID (p->paramID));
+
+        auto writeName = [&out] (const juce::String& n)
+        {
+            char buffer[nameLength] = {};
+            n.copyToUTF8 (buffer, nameLength);
+            out.write (buffer, nameLength);
+        };
+
+        for (int i = 0; i < numPresets; ++i)
+            writeName (getPresetNameLocked (i));
+
+        writeName (name);
+
+        // writeFloat is little endian, like the reads in getValue()
+        for (int i = 0; i < numPresets; ++i)
+        {
+            for (auto* p : params)
+            {
+                auto it = oldColumnByHash.find (StateCodec::hashParameterID (p->paramID));
+                out.writeFloat (it != oldColumnByHash.end() ? getValueLocked (i, it->second)
+                                                           : p->convertFrom0to1 (p->getDefaultValue()));
+            }
+        }
+
+        for (auto* p : params)
+            out.writeFloat (p->convertFrom0to1 (p->getValue()));
+
+        // Written in full next to the bank, then renamed over it. This is the
+        // process's only view of the file, so once it's unmapped nothing here
+        // holds the old one open.
+        closeLocked();
+
+        file.getParentDirectory().createDirectory();
+        juce::TemporaryFile temp (file);
+
+        saved = temp.getFile().replaceWithData (out.getData(), out.getDataSize())
+                 && temp.overwriteTargetFileWithTemporary();
+
+        openLocked (file);
+    }
+
+    // Every instance's program list and bindings follow
+    sendSynchronousChangeMessage();
+    return saved;
+}
+
+//==============================================================================
+PresetBank::Binding::Binding (PresetBank& b, juce::AudioProcessor& p)
+    : bank (b), processor (p)
+{
+}
+
+void PresetBank::Binding::bind()
+{
+    std::unordered_map<juce::uint32, juce::RangedAudioParameter*> byHash;
+
+    for (auto* p : processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p))
+            byHash[StateCodec::hashParameterID (ranged->paramID)] = ranged;
+
+    columnParams.assign ((size_t) bank.numColumns, nullptr);
+
+    for (int c = 0; c < bank.numColumns; ++c)
+    {
+        auto it = byHash.find (bank.getColumnHashLocked (c));
+
+        if (it != byHash.end())
+            columnParams[(size_t) c] = it->second;
+    }
+
+    boundGeneration = bank.generation;
+}
+
+bool PresetBank::Binding::visit (int index, const std::function<void (juce::RangedAudioParameter&, float)>& fn)
+{
+    const juce::ScopedLock bl (bindLock);
+    const juce::ScopedReadLock sl (bank.lock);
+
+    if (! juce::isPositiveAndBelow (index, bank.numPresets))
+        return false;
+
+    // Unknown columns are skipped
+    if (boundGeneration != bank.generation)
+        bind();
+
+    for (int c = 0; c < bank.numColumns; ++c)
+        if (auto* p = columnParams[(size_t) c])
+            fn (*p, bank.getValueLocked (index, c));
+
+    return true;
+}
+
+bool PresetBank::Binding::apply (int index)
+{
+    return visit (index, [] (juce::RangedAudioParameter& p, float value)
+    {
+        p.setValueNotifyingHost (p.convertTo0to1 (value));
+    });
+}
@@ -0,0 +1,114 @@
+#ifndef EFFEM_UNIT_PRESETBANK_H
+#define EFFEM_UNIT_PRESETBANK_H
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <functional>
+
+//==============================================================================
+// Memory-mapped preset bank.
+//
+// File layout (little endian, all sections 4-byte aligned):
+//   header   32 bytes: "EFBK", uint16 version, uint16 numColumns, uint32 numPresets,
+//                      uint32 columnsOffset, uint32 namesOffset, uint32 recordsOffset
+//   columns  numColumns x uint32 parameter ID hash (see StateCodec::hashParameterID)
+//   names    numPresets x char[nameLength], UTF-8, zero padded
+//   records  numPresets x numColumns x float32 (denormalised values)
+//
+// Every preset has the same fixed-size record, so switching is a pointer offset
+// into the mapping: no parsing and no allocation. Values are read through
+// getValue(), which byte-swaps on big-endian hosts and is a plain load
+// elsewhere.
+//
+// One bank is shared by every instance in the process (use through
+// juce::SharedResourcePointer), so the file is mapped once. addPreset() holds
+// an inter-process lock, starts from the file as it is on disk, unmaps it and
+// renames a complete temporary file over it, then maps the new file and sends
+// a change message so every instance sees the new list. On Windows the file
+// is read into memory instead of mapped: a mapping in another process would
+// stop the rename. Other processes pick a new bank up on refresh().
+//
+// Accessors lock internally; a Binding reads a whole record under one lock.
+class PresetBank : public juce::ChangeBroadcaster
+{
+public:
+    static constexpr juce::uint16 currentVersion = 1;
+    static constexpr int nameLength = 32;
+
+    PresetBank();   // opens getDefaultFile()
+
+    static juce::File getDefaultFile();
+
+    bool open (const juce::File& file);
+    void close();
+    bool isOpen() const noexcept;
+
+    // Re-opens the file if it has been replaced since it was opened, and sends
+    // a change message if so. Message thread.
+    void refresh();
+
+    int getNumPresets() const noexcept;
+    int getNumColumns() const noexcept;
+    juce::String getPresetName (int index) const;
+
+    // A stored (denormalised) value, or 0 if out of range
+    float getValue (int index, int column) const noexcept;
+
+    // Appends the current parameter values as a new preset. The file is replaced
+    // and re-mapped, so call this from the message thread only.
+    bool addPreset (const juce::String& name, juce::AudioProcessor& processor);
+
+    //==============================================================================
+    // One processor's view of the bank: its columns resolved to that
+    // processor's parameters, and resolved again after the bank changes.
+    class Binding
+    {
+    public:
+        Binding (PresetBank&, juce::AudioProcessor&);
+
+        // Calls fn (parameter, denormalised value) for every column of preset
+        // `index` that maps to a parameter. False if there is no such preset.
+        bool visit (int index, const std::function<void (juce::RangedAudioParameter&, float)>& fn);
+
+        // Pushes preset `index` into the processor's parameters
+        bool apply (int index);
+
+    private:
+        PresetBank& bank;
+        juce::AudioProcessor& processor;
+        juce::CriticalSection bindLock;   // host and message thread may both apply
+        std::vector<juce::RangedAudioParameter*> columnParams;
+        int boundGeneration = -1;
+
+        void bind();
+
+        JUCE_DECLARE_NON_COPYABLE (Binding)
+    };
+
+private:
+    bool openLocked (const juce::File& file);
+    void closeLocked();
+    juce::String getPresetNameLocked (int index) const;
+    float getValueLocked (int index, int column) const noexcept;
+    juce::uint32 getColumnHashLocked (int column) const noexcept;
+
+    juce::ReadWriteLock lock;
+    int generation = 0;
+
+    std::unique_ptr<juce::MemoryMappedFile> mapping;
+    juce::MemoryBlock contents;   // instead of the mapping, on Windows
+    juce::File bankFile;
+    juce::Time bankModified;
+
+    const juce::uint8* base = nullptr;
+    int numPresets = 0;
+    int numColumns = 0;
+    const juce::uint8* columnHashes = nullptr;   // little-endian uint32s
+    const char* names = nullptr;
+    const juce::uint8* records = nullptr;        // little-endian float32s
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PresetBank)
+};
+
+#endif //EFFEM_UNIT_PRESETBANK_H
@@ -0,0 +1,72 @@
+#include "QualityGovernor.h"
+
+//==============================================================================
+QualityGovernor::Settings QualityGovernor::getSettings (int level) noexcept
+{
+    switch (level)
+    {
+        case 1:  return { 6, 2 };
+        case 2:  return { 4, 4 };
+        case 3:  return { 2, 8 };
+        default: break;
+    }
+
+    return { std::numeric_limits<int>::max(), 1 };
+}
+
+const char* QualityGovernor::getLevelName (int level)
+{
+    switch (level)
+    {
+        case 0:  return "Full";
+        case 1:  return "Reduced";
+        case 2:  return "Low";
+        case 3:  return "Minimal";
+        default: break;
+    }
+
+    return "";
+}
+
+//==============================================================================
+void QualityGovernor::prepare (double newSampleRate) noexcept
+{
+    sampleRate = newSampleRate;
+    overSamples = underSamples = 0;
+}
+
+void QualityGovernor::update (double load, int xruns, bool nonRealtime, int numSamples) noexcept
+{
+    const bool newXrun = xruns != lastXruns;
+    lastXruns = xruns;
+
+    if (nonRealtime)
+    {
+        overSamples = underSamples = 0;
+        setLevel (0);
+        return;
+    }
+
+    overSamples  = load > downThreshold ? overSamples + numSamples : 0;
+    underSamples = load < upThreshold   ? underSamples + numSamples : 0;
+
+    const int current = getLevel();
+
+    if (current < numLevels - 1
+         && (newXrun || overSamples >= (juce::int64) (downHoldSeconds * sampleRate)))
+    {
+        overSamples = underSamples = 0;
+        setLevel (current + 1);
+    }
+    else if (current > 0 && underSamples >= (juce::int64) (upHoldSeconds * sampleRate))
+    {
+        underSamples = 0;
+        setLevel (current - 1);
+    }
+}
+
+void QualityGovernor::setLevel (int newLevel) noexcept
+{
+    level.store (newLevel, std::memory_order_relaxed);
+    settings = getSettings (newLevel);
+}
@@ -0,0 +1,58 @@
+#ifndef EFFEM_UNIT_QUALITYGOVERNOR_H
+#define EFFEM_UNIT_QUALITYGOVERNOR_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+//==============================================================================
+// Steps the engine's quality down when the callback load nears the deadline
+// and back up when there is headroom again.
+//
+// Fed once per block with the load from juce::AudioProcessLoadMeasurer (time
+// spent / time available). Above downThreshold for downHoldSeconds, or on a
+// new xrun, it drops one level; below upThreshold for upHoldSeconds it climbs
+// one level. The gap between the two thresholds and the longer climb hold keep
+// it from oscillating. Non-realtime renders always run at level 0.
+class QualityGovernor
+{
+public:
+    static constexpr int numLevels = 4;
+
+    static constexpr double downThreshold   = 0.80;
+    static constexpr double upThreshold     = 0.50;
+    static constexpr double downHoldSeconds = 0.05;
+    static constexpr double upHoldSeconds   = 2.0;
+
+    // What each level allows
+    struct Settings
+    {
+        int maxVoices;          // synth voices sounding at once (level 0: no cap)
+        int controlDivider;     // voice parameter updates every n blocks
+    };
+
+    static Settings getSettings (int level) noexcept;
+    static const char* getLevelName (int level);
+
+    // ===== Audio thread =====
+    void prepare (double sampleRate) noexcept;
+    void update (double load, int xruns, bool nonRealtime, int numSamples) noexcept;
+
+    const Settings& getCurrentSettings() const noexcept   { return settings; }
+
+    // ===== Any thread =====
+    int getLevel() const noexcept   { return level.load (std::memory_order_relaxed); }
+
+private:
+    void setLevel (int newLevel) noexcept;
+
+    std::atomic<int> level { 0 };
+    Settings settings = getSettings (0);
+
+    double sampleRate = 44100.0;
+    juce::int64 overSamples = 0, underSamples = 0;
+    int lastXruns = 0;
+};
+
+#endif //EFFEM_UNIT_QUALITYGOVERNOR_H
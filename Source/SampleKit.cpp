@@ -0,0 +1,166 @@
+#include "SampleKit.h"
+
+//==============================================================================
+bool SampleKit::isSupportedFile (const juce::File& f)
+{
+    return f.hasFileExtension ("wav;aif;aiff;flac");
+}
+
+std::unique_ptr<SampleKit> SampleKit::load (const juce::File& fileOrFolder, juce::AudioFormatManager& formats,
+                                            const std::function<void()>& betweenFiles)
+{
+    auto kit = std::make_unique<SampleKit>();
+    kit->name = fileOrFolder.getFileNameWithoutExtension();
+
+    if (fileOrFolder.existsAsFile())
+    {
+        if (auto zone = openZone (fileOrFolder, formats))
+        {
+            zone->oneShot = false;
+            kit->zones.push_back (std::move (zone));
+        }
+
+        if (kit->zones.empty())
+            return nullptr;
+
+        return kit;
+    }
+
+    auto files = fileOrFolder.findChildFiles (juce::File::findFiles, false);
+    files.sort();
+
+    std::array<bool, 128> used {};
+    int nextKey = 36;
+
+    // Explicitly numbered files first, then the rest fill the gaps
+    std::vector<std::pair<juce::File, int>> mapped;
+
+    for (auto& f : files)
+        if (isSupportedFile (f))
+            mapped.emplace_back (f, parseNote (f.getFileNameWithoutExtension()));
+
+    for (auto& [file, note] : mapped)
+        if (note >= 0)
+            used[(size_t) note] = true;
+
+    for (auto& [file, note] : mapped)
+    {
+        if (note < 0)
+        {
+            while (nextKey < 128 && used[(size_t) nextKey])
+                ++nextKey;
+
+            if (nextKey >= 128)
+                continue;
+
+            note = nextKey;
+            used[(size_t) note] = true;
+        }
+
+        if (auto zone = openZone (file, formats))
+        {
+            zone->rootNote = zone->lowNote = zone->highNote = note;
+            kit->zones.push_back (std::move (zone));
+        }
+
+        if (betweenFiles)
+            betweenFiles();
+    }
+
+    if (kit->zones.empty())
+        return nullptr;
+
+    return kit;
+}
+
+std::unique_ptr<SampleZone> SampleKit::openZone (const juce::File& file, juce::AudioFormatManager& formats)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    // Memory-map where the format allows it, so streaming is page-ins rather
+    // than file reads and nothing beyond the preload has to sit in RAM
+    if (auto* format = formats.findFormatForFileExtension (file.getFileExtension()))
+    {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+
+        if (mapped != nullptr && mapped->mapEntireFile())
+            reader = std::move (mapped);
+    }
+
+    if (reader == nullptr)
+        reader.reset (formats.createReaderFor (file));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+        return nullptr;
+
+    auto zone = std::make_unique<SampleZone>();
+    zone->file       = file;
+    zone->sampleRate = reader->sampleRate;
+    zone->length     = reader->lengthInSamples;
+
+    const int numPreload = (int) juce::jmin ((juce::int64) preloadFrames, zone->length);
+    const int numChannels = (int) juce::jmin (2u, reader->numChannels);
+
+    zone->preload.setSize (numChannels, numPreload);
+    reader->read (zone->preload.getArrayOfWritePointers(), numChannels, 0, numPreload);
+
+    zone->reader = std::move (reader);
+    return zone;
+}
+
+// "36 Kick", "036_kick" or a note name token such as "C1", "F#2", "Db-1"
+int SampleKit::parseNote (const juce::String& fileName)
+{
+    const auto leading = fileName.initialSectionContainingOnly ("0123456789");
+
+    if (leading.isNotEmpty() && leading.length() <= 3 && leading.getIntValue() < 128)
+        return leading.getIntValue();
+
+    static const int semitones[] = { 9, 11, 0, 2, 4, 5, 7 };   // A..G
+
+    juce::StringArray tokens;
+    tokens.addTokens (fileName, " _.", {});
+
+    for (int t = tokens.size(); --t >= 0;)
+    {
+        const auto token = tokens[t].toUpperCase();
+
+        if (token.length() < 2 || token[0] < 'A' || token[0] > 'G')
+            continue;
+
+        int note = semitones[token[0] - 'A'];
+        auto rest = token.substring (1);
+
+        if (rest.startsWithChar ('#'))      { ++note; rest = rest.substring (1); }
+        else if (rest.startsWithChar ('B')) { --note; rest = rest.substring (1); }
+
+        if (! rest.containsOnly ("-0123456789") || rest.isEmpty() || rest == "-")
+            continue;
+
+        const int midi = note + (rest.getIntValue() + 2) * 12;
+
+        if (juce::isPositiveAndBelow (midi, 128))
+            return midi;
+    }
+
+    return -1;
+}
+
+//==============================================================================
+const SampleZone* SampleKit::findZone (int midiNote) const noexcept
+{
+    for (auto& z : zones)
+        if (midiNote >= z->lowNote && midiNote <= z->highNote)
+            return z.get();
+
+    return nullptr;
+}
+
+bool SampleKit::contains (const SampleZone* zone) const noexcept
+{
+    for (auto& z : zones)
+        if (z.get() == zone)
+            return true;
+
+    return false;
+}
@@ -0,0 +1,64 @@
+#ifndef EFFEM_UNIT_SAMPLEKIT_H
+#define EFFEM_UNIT_SAMPLEKIT_H
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <functional>
+#include <vector>
+
+//==============================================================================
+// One mapped sample. The first preloadFrames are decoded into RAM so a note
+// can start instantly; the rest is read on demand by SampleStreamer through
+// `reader`, which is memory-mapped for WAV and AIFF.
+struct SampleZone
+{
+    juce::File file;
+    int rootNote = 60;
+    int lowNote = 0, highNote = 127;
+    bool oneShot = true;            // ignores note-off (drums)
+
+    double sampleRate = 44100.0;
+    juce::int64 length = 0;         // frames
+    juce::AudioBuffer<float> preload;
+
+    // Streamer thread only
+    std::unique_ptr<juce::AudioFormatReader> reader;
+
+    int getNumChannels() const noexcept    { return preload.getNumChannels(); }
+    int getPreloadLength() const noexcept  { return preload.getNumSamples(); }
+};
+
+//==============================================================================
+// A set of zones played by SampleSound. Built on the streamer thread and not
+// modified once published.
+class SampleKit
+{
+public:
+    static constexpr int preloadFrames = 16384;
+
+    // A folder becomes a drum kit: one one-shot zone per key, taken from a
+    // leading MIDI note number ("36 Kick.wav") or a note name with C3 = 60
+    // ("Kick C1.wav"), otherwise the next free key from 36 up. A single file
+    // is a pitched instrument across the whole keyboard with its root on 60.
+    // `betweenFiles` runs after each file so a caller on a streaming thread
+    // can keep its streams fed while a large kit loads.
+    static std::unique_ptr<SampleKit> load (const juce::File& fileOrFolder,
+                                            juce::AudioFormatManager& formats,
+                                            const std::function<void()>& betweenFiles = {});
+
+    static bool isSupportedFile (const juce::File&);
+
+    const SampleZone* findZone (int midiNote) const noexcept;
+
+    bool contains (const SampleZone* zone) const noexcept;
+
+    juce::String name;
+    std::vector<std::unique_ptr<SampleZone>> zones;
+
+private:
+    static std::unique_ptr<SampleZone> openZone (const juce::File&, juce::AudioFormatManager&);
+    static int parseNote (const juce::String& fileName);
+};
+
+#endif //EFFEM_UNIT_SAMPLEKIT_H
@@ -0,0 +1,312 @@
+#include "SampleStreamer.h"
+
+//==============================================================================
+SampleStream::SampleStream() = default;
+
+bool SampleStream::allocate()
+{
+    if (ring.getNumSamples() > 0)
+        return false;
+
+    ring.setSize (2, ringFrames);
+    ring.clear();
+    return true;
+}
+
+void SampleStream::start (const SampleZone* z) noexcept
+{
+    // Only the audio thread writes the generation
+    const auto gen = generation.load (std::memory_order_relaxed) + 1;
+
+    consumed.store (0, std::memory_order_relaxed);
+    zone.store (z, std::memory_order_relaxed);
+    generation.store (gen, std::memory_order_release);
+
+    playingGeneration = gen;
+}
+
+void SampleStream::stop() noexcept
+{
+    const auto gen = generation.load (std::memory_order_relaxed) + 1;
+
+    zone.store (nullptr, std::memory_order_relaxed);
+    generation.store (gen, std::memory_order_release);
+
+    playingGeneration = gen;
+}
+
+juce::int64 SampleStream::getNumAvailable() const noexcept
+{
+    const auto p = published.load (std::memory_order_acquire);
+
+    if ((p & ~countMask) != tag (playingGeneration))
+        return 0;
+
+    return (juce::int64) (p & countMask);
+}
+
+bool SampleStream::service (int maxFrames)
+{
+    const auto gen = generation.load (std::memory_order_acquire);
+
+    if (gen != streamingGeneration)
+    {
+        streamingGeneration = gen;
+        activeZone = zone.load (std::memory_order_acquire);
+        written = 0;
+        published.store (tag (gen), std::memory_order_release);
+    }
+
+    if (activeZone == nullptr || activeZone->reader == nullptr)
+        return false;
+
+    const auto remaining = activeZone->length - activeZone->getPreloadLength() - written;
+    const auto space     = ringFrames - (written - consumed.load (std::memory_order_acquire));
+    const int  n         = (int) juce::jmin ((juce::int64) maxFrames, remaining, space);
+
+    if (n <= 0)
+        return false;
+
+    const int numChannels = activeZone->getNumChannels();
+    const auto sourceStart = activeZone->getPreloadLength() + written;
+
+    // Up to two reads when the block wraps around the ring
+    int done = 0;
+
+    while (done < n)
+    {
+        const int start = (int) ((written + done) & (ringFrames - 1));
+        const int count = juce::jmin (n - done, ringFrames - start);
+
+        float* dest[2] = { ring.getWritePointer (0, start), ring.getWritePointer (1, start) };
+        activeZone->reader->read (dest, numChannels, sourceStart + done, count);
+
+        done += count;
+    }
+
+    written += n;
+    published.store (tag (gen) | (juce::uint64) written, std::memory_order_release);
+    return true;
+}
+
+bool SampleStream::isStreaming() const noexcept
+{
+    if (generation.load() != streamingGeneration)
+        return true;
+
+    return activeZone != nullptr && activeZone->reader != nullptr
+            && written < activeZone->length - activeZone->getPreloadLength();
+}
+
+//==============================================================================
+SampleStreamer::SampleStreamer()
+    : juce::Thread ("EFFEM sample streamer")
+{
+    formats.registerBasicFormats();
+    startThread (juce::Thread::Priority::high);
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    stopThread (2000);
+}
+
+void SampleStreamer::add (SampleStream* s)
+{
+    const juce::ScopedLock sl (lock);
+    streams.addIfNotAlreadyThere (s);
+}
+
+void SampleStreamer::remove (SampleStream* s)
+{
+    const juce::ScopedLock service (serviceLock);
+    const juce::ScopedLock sl (lock);
+    streams.removeFirstMatchingValue (s);
+}
+
+void SampleStreamer::loadKit (const void* owner, const juce::File& fileOrFolder, KitCallback onLoaded)
+{
+    {
+        const juce::ScopedLock sl (lock);
+
+        // Only the newest request per owner matters
+        requests.erase (std::remove_if (requests.begin(), requests.end(),
+                                        [owner] (const KitRequest& r) { return r.owner == owner; }),
+                        requests.end());
+
+        requests.push_back ({ owner, fileOrFolder, std::move (onLoaded) });
+    }
+
+    notify();
+}
+
+void SampleStreamer::cancelLoads (const void* owner)
+{
+    {
+        const juce::ScopedLock sl (lock);
+
+        requests.erase (std::remove_if (requests.begin(), requests.end(),
+                                        [owner] (const KitRequest& r) { return r.owner == owner; }),
+                        requests.end());
+
+        if (loadingOwner == owner)
+            loadingCancelled = true;
+    }
+
+    // A callback that got past the check before the flag was set
+    const juce::ScopedLock cl (callbackLock);
+}
+
+void SampleStreamer::retire (std::unique_ptr<SampleKit> kit)
+{
+    if (kit == nullptr)
+        return;
+
+    {
+        const juce::ScopedLock sl (lock);
+        retired.push_back ({ std::move (kit) });
+    }
+
+    notify();
+}
+
+void SampleStreamer::streamStarted() noexcept
+{
+    // Pairs with the fence in run(): either this sees the thread going idle,
+    // or the thread sees the started stream
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+
+    if (idle.exchange (false))
+        notify();
+}
+
+//==============================================================================
+// The disk reads happen on a snapshot of the list, so add(), loadKit() and
+// retire() never wait for one
+bool SampleStreamer::serviceStreams()
+{
+    const juce::ScopedLock service (serviceLock);
+
+    {
+        const juce::ScopedLock sl (lock);
+        serviced.clearQuick();
+        serviced.addArray (streams);
+    }
+
+    bool busy = false;
+
+    for (auto* s : serviced)
+        busy = s->service (4096) || busy;
+
+    return busy;
+}
+
+// A voice can load a kit's pointer a moment before the kit is swapped out.
+// The kit was unpublished before retire(), so once no KitReader is open every
+// reader that saw it has either dropped it or started a stream on one of its
+// zones, which the check below then sees.
+bool SampleStreamer::freeRetiredKits()
+{
+    const juce::ScopedLock sl (lock);
+
+    if (kitReaders.load() == 0)
+        for (auto& r : retired)
+            r.unreachable = true;
+
+    retired.erase (std::remove_if (retired.begin(), retired.end(), [&] (const RetiredKit& r)
+    {
+        if (! r.unreachable)
+            return false;
+
+        for (auto* s : streams)
+            if (r.kit->contains (s->getRequestedZone()) || r.kit->contains (s->getStreamingZone()))
+                return false;
+
+        return true;
+    }), retired.end());
+
+    return ! retired.empty();
+}
+
+bool SampleStreamer::isStreaming()
+{
+    const juce::ScopedLock sl (lock);
+
+    for (auto* s : streams)
+        if (s->isStreaming())
+            return true;
+
+    return false;
+}
+
+void SampleStreamer::run()
+{
+    while (! threadShouldExit())
+    {
+        const bool busy = serviceStreams();
+        const bool retiring = freeRetiredKits();
+
+        KitRequest request;
+        bool hasRequest = false;
+
+        {
+            const juce::ScopedLock sl (lock);
+
+            if (! requests.empty())
+            {
+                request = std::move (requests.front());
+                requests.erase (requests.begin());
+                loadingOwner = request.owner;
+                loadingCancelled = false;
+                hasRequest = true;
+            }
+        }
+
+        if (hasRequest)
+        {
+            // Built without the lock, feeding the streams between files
+            auto kit = SampleKit::load (request.file, formats, [this] { serviceStreams(); });
+
+            {
+                const juce::ScopedLock cl (callbackLock);
+                bool cancelled;
+
+                {
+                    const juce::ScopedLock sl (lock);
+                    cancelled = loadingCancelled;
+                }
+
+                if (! cancelled)
+                    request.onLoaded (std::move (kit));
+            }
+
+            const juce::ScopedLock sl (lock);
+            loadingOwner = nullptr;
+            continue;
+        }
+
+        if (busy)
+            continue;
+
+        if (isStreaming())
+        {
+            wait (2);
+            continue;
+        }
+
+        if (retiring)
+        {
+            wait (50);
+            continue;
+        }
+
+        // Nothing to read: sleep until a load, a retire or a note start
+        idle.store (true);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (! isStreaming())
+            wait (-1);
+
+        idle.store (false);
+    }
+}
@@ -0,0 +1,176 @@
+#ifndef EFFEM_UNIT_SAMPLESTREAMER_H
+#define EFFEM_UNIT_SAMPLESTREAMER_H
+
+#pragma once
+
+#include "SampleKit.h"
+#include "MemoryWarmup.h"
+#include <atomic>
+#include <functional>
+
+//==============================================================================
+// Per-voice disk stream: a single-producer / single-consumer ring that the
+// streamer thread fills with the frames following a zone's preload.
+//
+// The voice restarts the stream by bumping a generation counter; the writer
+// tags every published fill level with the generation it was written for, so
+// the voice never reads frames left over from the previous note.
+class SampleStream
+{
+public:
+    static constexpr int ringFrames = 1 << 15;
+
+    SampleStream();
+
+    // ===== Message thread =====
+    // The ring is allocated before the first kit is loaded rather than up
+    // front, so a session that never uses the sample layer doesn't carry it.
+    // Call before anything can start() the stream. Returns true if this call
+    // allocated it, in which case it still needs warming up.
+    bool allocate();
+
+    // Adds the ring if it has been allocated
+    void warmUp (MemoryWarmup& memory)   { if (ring.getNumSamples() > 0) memory.add (ring); }
+
+    // ===== Audio thread =====
+    void start (const SampleZone*) noexcept;
+    void stop() noexcept;
+
+    // Frames past the preload that are ready to read
+    juce::int64 getNumAvailable() const noexcept;
+
+    // `frame` counts from the end of the preload
+    float getFrame (int channel, juce::int64 frame) const noexcept
+    {
+        return ring.getSample (channel, (int) (frame & (ringFrames - 1)));
+    }
+
+    // Frames before `frame` are no longer needed
+    void release (juce::int64 frame) noexcept   { consumed.store (frame, std::memory_order_release); }
+
+    // ===== Streamer thread =====
+    // Reads at most maxFrames; returns true if it did any work
+    bool service (int maxFrames);
+
+    // True while a start() hasn't been picked up yet or the zone has frames
+    // left to read
+    bool isStreaming() const noexcept;
+    const SampleZone* getStreamingZone() const noexcept   { return activeZone; }
+    const SampleZone* getRequestedZone() const noexcept   { return zone.load (std::memory_order_acquire); }
+
+private:
+    static constexpr int generationShift = 40;
+    static constexpr juce::uint64 countMask = (juce::uint64 (1) << generationShift) - 1;
+
+    static juce::uint64 tag (juce::uint32 gen) noexcept   { return (juce::uint64) (gen & 0xffffff) << generationShift; }
+
+    juce::AudioBuffer<float> ring;
+
+    std::atomic<const SampleZone*> zone { nullptr };
+    std::atomic<juce::uint32> generation { 0 };
+    std::atomic<juce::int64> consumed { 0 };
+    std::atomic<juce::uint64> published { 0 };   // generation << 40 | frames written
+
+    // audio thread
+    juce::uint32 playingGeneration = 0;
+
+    // streamer thread
+    juce::uint32 streamingGeneration = 0;
+    const SampleZone* activeZone = nullptr;
+    juce::int64 written = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleStream)
+};
+
+//==============================================================================
+// One thread per process that keeps every registered stream's ring topped up,
+// loads sample kits and frees kits once nothing reads from them any more. It
+// runs at high priority, since a ring it doesn't refill in time is an
+// audible underrun. Use through juce::SharedResourcePointer.
+//
+// It polls only while a stream is reading from disk (or, more slowly, while a
+// retired kit is waiting to be freed) and otherwise sleeps until loadKit(),
+// retire() or streamStarted() wakes it.
+class SampleStreamer : private juce::Thread
+{
+public:
+    using KitCallback = std::function<void (std::unique_ptr<SampleKit>)>;
+
+    SampleStreamer();
+    ~SampleStreamer() override;
+
+    void add (SampleStream*);
+    void remove (SampleStream*);
+
+    // Builds the kit on the streamer thread and hands it to `owner`'s callback
+    // there. cancelLoads() must be called before `owner` goes away.
+    void loadKit (const void* owner, const juce::File& fileOrFolder, KitCallback onLoaded);
+    void cancelLoads (const void* owner);
+
+    // Takes ownership of a kit that has already been unpublished. It is
+    // deleted once every KitReader that could have seen it has ended and no
+    // stream is playing from it.
+    void retire (std::unique_ptr<SampleKit>);
+
+    // ===== Audio thread =====
+    // Call after SampleStream::start(). Wakes the thread if it is asleep, so
+    // at most one event signal per idle period, not one per note.
+    void streamStarted() noexcept;
+
+    // Covers a kit pointer loaded from a SampleSound until it's either dropped
+    // or its zone has been start()ed on a stream, after which the stream
+    // keeps the kit alive.
+    class KitReader
+    {
+    public:
+        explicit KitReader (SampleStreamer& s) noexcept : streamer (s)   { streamer.kitReaders.fetch_add (1); }
+        ~KitReader() noexcept                                            { streamer.kitReaders.fetch_sub (1); }
+
+    private:
+        SampleStreamer& streamer;
+
+        JUCE_DECLARE_NON_COPYABLE (KitReader)
+    };
+
+private:
+    void run() override;
+    bool freeRetiredKits();   // true while some are left
+    bool isStreaming();
+
+    struct KitRequest
+    {
+        const void* owner = nullptr;
+        juce::File file;
+        KitCallback onLoaded;
+    };
+
+    struct RetiredKit
+    {
+        std::unique_ptr<SampleKit> kit;
+        bool unreachable = false;   // no KitReader can still hold it
+    };
+
+    juce::AudioFormatManager formats;
+
+    // lock guards the lists and is never held across disk reads or callbacks.
+    // serviceLock is held while the streams are read from, so remove() waits
+    // for a read in progress instead of the stream going away under it.
+    juce::CriticalSection lock, serviceLock;
+    juce::Array<SampleStream*> streams;
+    juce::Array<SampleStream*> serviced;   // streamer thread
+    std::vector<KitRequest> requests;
+    std::vector<RetiredKit> retired;
+
+    // The request being built outside the lock. callbackLock is held while
+    // its onLoaded runs, so cancelLoads() can wait for one already running.
+    const void* loadingOwner = nullptr;
+    bool loadingCancelled = false;
+    juce::CriticalSection callbackLock;
+
+    std::atomic<int> kitReaders { 0 };
+    std::atomic<bool> idle { false };
+
+    bool serviceStreams();
+};
+
+#endif //EFFEM_UNIT_SAMPLESTREAMER_H
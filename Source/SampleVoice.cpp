@@ -0,0 +1,192 @@
+#include "SampleVoice.h"
+
+//==============================================================================
+SampleSound::SampleSound() = default;
+
+SampleSound::~SampleSound()
+{
+    streamer->cancelLoads (this);
+
+    // Voices may still be streaming from it; the streamer frees it when safe
+    streamer->retire (std::unique_ptr<SampleKit> (kit.exchange (nullptr)));
+}
+
+bool SampleSound::appliesToNote (int midiNote)
+{
+    const SampleStreamer::KitReader reader (*streamer);
+    const auto* k = getKit();
+    return k != nullptr && k->findZone (midiNote) != nullptr;
+}
+
+void SampleSound::loadKit (const juce::File& fileOrFolder)
+{
+    streamer->loadKit (this, fileOrFolder, [this] (std::unique_ptr<SampleKit> loaded)
+    {
+        if (loaded != nullptr)
+            install (std::move (loaded));
+    });
+}
+
+void SampleSound::clearKit()
+{
+    streamer->cancelLoads (this);
+    install (nullptr);
+}
+
+void SampleSound::install (std::unique_ptr<SampleKit> newKit)
+{
+    streamer->retire (std::unique_ptr<SampleKit> (kit.exchange (newKit.release())));
+}
+
+//==============================================================================
+SampleVoice::SampleVoice()
+{
+    streamer->add (&stream);
+}
+
+SampleVoice::~SampleVoice()
+{
+    streamer->remove (&stream);
+}
+
+bool SampleVoice::canPlaySound (juce::SynthesiserSound* s)
+{
+    return dynamic_cast<SampleSound*> (s) != nullptr;
+}
+
+void SampleVoice::startNote (int midiNoteNumber, float velocity, juce::SynthesiserSound* s, int)
+{
+    sound = dynamic_cast<SampleSound*> (s);
+
+    // Until the stream has the zone, only the reader keeps the kit alive
+    const SampleStreamer::KitReader reader (*streamer);
+    const auto* kit = sound != nullptr ? sound->getKit() : nullptr;
+    zone = kit != nullptr ? kit->findZone (midiNoteNumber) : nullptr;
+
+    if (zone == nullptr)
+    {
+        clearCurrentNote();
+        return;
+    }
+
+    increment = std::pow (2.0, (midiNoteNumber - zone->rootNote) / 12.0) * zone->sampleRate / getSampleRate();
+    velocityGain = velocity;
+    position = 0.0;
+
+    fadeGain = 1.0f;
+    fadeStep = 0.0f;
+    holding = false;
+
+    stream.start (zone);
+    streamer->streamStarted();
+}
+
+void SampleVoice::stopNote (float, bool allowTailOff)
+{
+    if (! allowTailOff)
+        finish();
+    else if (zone != nullptr && ! zone->oneShot)
+        beginFade (releaseSeconds);
+}
+
+void SampleVoice::beginFade (double seconds) noexcept
+{
+    const auto samples = juce::jmax (1.0, seconds * getSampleRate());
+    fadeStep = juce::jmax (fadeStep, fadeGain / (float) samples);
+}
+
+void SampleVoice::finish() noexcept
+{
+    stream.stop();
+    zone = nullptr;
+    sound = nullptr;
+    clearCurrentNote();
+}
+
+//==============================================================================
+namespace
+{
+    // 4-point, 3rd-order Hermite
+    inline float hermite (float xm1, float x0, float x1, float x2, float t) noexcept
+    {
+        const float c1 = 0.5f * (x1 - xm1);
+        const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+        const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+
+        return ((c3 * t + c2) * t + c1) * t + x0;
+    }
+}
+
+void SampleVoice::renderNextBlock (juce::AudioBuffer<float>& outputBuffer, int startSample, int numSamples)
+{
+    if (zone == nullptr)
+        return;
+
+    const auto length  = zone->length;
+    const int  preload = zone->getPreloadLength();
+    const auto ready   = (juce::int64) preload + stream.getNumAvailable();
+
+    const int numOut = juce::jmin (2, outputBuffer.getNumChannels());
+    const int lastSourceChannel = zone->getNumChannels() - 1;
+    const float gain = velocityGain * (sound != nullptr ? sound->getLevel() : 1.0f);
+
+    auto frame = [&] (int ch, juce::int64 i) noexcept
+    {
+        if (i < 0 || i >= length)
+            return 0.0f;
+
+        return i < preload ? zone->preload.getSample (ch, (int) i)
+                           : stream.getFrame (ch, i - preload);
+    };
+
+    for (int s = 0; s < numSamples; ++s)
+    {
+        const auto i = (juce::int64) position;
+
+        if (i >= length)
+        {
+            finish();
+            break;
+        }
+
+        // The stream is behind: hold the last output and fade it out
+        if (! holding && i + 2 >= ready && ready < length)
+        {
+            holding = true;
+            underruns.fetch_add (1, std::memory_order_relaxed);
+            beginFade (fadeSeconds);
+        }
+
+        if (! holding)
+        {
+            const float t = (float) (position - (double) i);
+
+            for (int ch = 0; ch < numOut; ++ch)
+            {
+                const int src = juce::jmin (ch, lastSourceChannel);
+                lastOut[(size_t) ch] = hermite (frame (src, i - 1), frame (src, i),
+                                                frame (src, i + 1), frame (src, i + 2), t);
+            }
+
+            position += increment;
+        }
+
+        for (int ch = 0; ch < numOut; ++ch)
+            outputBuffer.addSample (ch, startSample + s, lastOut[(size_t) ch] * gain * fadeGain);
+
+        if (fadeStep > 0.0f)
+        {
+            fadeGain -= fadeStep;
+
+            if (fadeGain <= 0.0f)
+            {
+                finish();
+                break;
+            }
+        }
+    }
+
+    // Keep one frame behind the read position for the interpolator
+    if (zone != nullptr)
+        stream.release (juce::jmax ((juce::int64) 0, (juce::int64) position - 1 - preload));
+}
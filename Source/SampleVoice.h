@@ -0,0 +1,102 @@
+#ifndef EFFEM_UNIT_SAMPLEVOICE_H
+#define EFFEM_UNIT_SAMPLEVOICE_H
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "SampleStreamer.h"
+
+//==============================================================================
+// The sample layer. Holds the current SampleKit behind an atomic pointer so a
+// new kit can be swapped in while voices keep playing from the old one; old
+// kits are handed to the streamer to be freed once unused.
+class SampleSound : public juce::SynthesiserSound
+{
+public:
+    SampleSound();
+    ~SampleSound() override;
+
+    bool appliesToNote (int midiNote) override;
+    bool appliesToChannel (int midiChannel) override { return channel == 0 || channel == midiChannel; }
+
+    // ===== Message thread =====
+    // Loads on the streamer thread and swaps the kit in when it's ready
+    void loadKit (const juce::File& fileOrFolder);
+    void clearKit();
+
+    // ===== Audio thread =====
+    // Only inside a SampleStreamer::KitReader. Sequentially consistent, like
+    // the swap in install(), so the streamer's reader count orders against it.
+    const SampleKit* getKit() const noexcept   { return kit.load(); }
+
+    void setLevel (float newLevel) noexcept    { level = newLevel; }
+    float getLevel() const noexcept            { return level; }
+
+    // Follows part 1's channel in multitimbral mode; 0 for any channel
+    void setChannel (int newChannel) noexcept  { channel = newChannel; }
+
+private:
+    void install (std::unique_ptr<SampleKit>);
+
+    std::atomic<SampleKit*> kit { nullptr };
+    float level = 1.0f;
+    int channel = 0;
+
+    juce::SharedResourcePointer<SampleStreamer> streamer;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleSound)
+};
+
+//==============================================================================
+// Plays one zone of the current kit: the preload straight from RAM, then the
+// voice's disk stream, repitched with 4-point Hermite interpolation. If the
+// stream can't keep up the voice fades out instead of waiting for the disk.
+class SampleVoice : public juce::SynthesiserVoice
+{
+public:
+    SampleVoice();
+    ~SampleVoice() override;
+
+    bool canPlaySound (juce::SynthesiserSound*) override;
+    void startNote (int midiNoteNumber, float velocity,
+                    juce::SynthesiserSound*, int pitchWheelPos) override;
+    void stopNote (float velocity, bool allowTailOff) override;
+    void pitchWheelMoved (int) override {}
+    void controllerMoved (int, int) override {}
+    void renderNextBlock (juce::AudioBuffer<float>&, int startSample, int numSamples) override;
+
+    // Message thread, before a kit is loaded (see SampleStream::allocate)
+    bool allocateStream()                  { return stream.allocate(); }
+    void warmUp (MemoryWarmup& memory)     { stream.warmUp (memory); }
+
+    // Number of this voice's notes cut short because the disk stream fell behind
+    int getUnderrunCount() const noexcept   { return underruns.load (std::memory_order_relaxed); }
+
+private:
+    static constexpr double fadeSeconds = 0.005;
+    static constexpr double releaseSeconds = 0.05;
+
+    void beginFade (double seconds) noexcept;
+    void finish() noexcept;
+
+    SampleStream stream;
+    juce::SharedResourcePointer<SampleStreamer> streamer;
+
+    SampleSound* sound = nullptr;
+    const SampleZone* zone = nullptr;
+    double position = 0.0;
+    double increment = 1.0;
+    float velocityGain = 0.0f;
+
+    float fadeGain = 1.0f, fadeStep = 0.0f;
+
+    // After an underrun the last output is held and faded rather than cut
+    bool holding = false;
+    std::array<float, 2> lastOut {};
+
+    std::atomic<int> underruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SampleVoice)
+};
+
+#endif //EFFEM_UNIT_SAMPLEVOICE_H
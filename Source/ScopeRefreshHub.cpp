@@ -0,0 +1,66 @@
+#include "ScopeRefreshHub.h"
+
+//==============================================================================
+ScopeRefreshHub::~ScopeRefreshHub()
+{
+    for (auto* c : clients)
+        c->getRefreshComponent().removeComponentListener (this);
+}
+
+void ScopeRefreshHub::add (Client* c)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (! clients.addIfNotAlreadyThere (c))
+        return;
+
+    c->getRefreshComponent().addComponentListener (this);
+    updateWindows();
+}
+
+void ScopeRefreshHub::remove (Client* c)
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (! clients.contains (c))
+        return;
+
+    c->getRefreshComponent().removeComponentListener (this);
+    clients.removeFirstMatchingValue (c);
+    updateWindows();
+}
+
+void ScopeRefreshHub::componentParentHierarchyChanged (juce::Component&)
+{
+    updateWindows();
+}
+
+void ScopeRefreshHub::updateWindows()
+{
+    juce::Array<juce::Component*> wanted;
+
+    for (auto* c : clients)
+        wanted.addIfNotAlreadyThere (c->getRefreshComponent().getTopLevelComponent());
+
+    // Attachments follow their window onto a new peer by themselves; only a
+    // window that gained or lost its last client changes here
+    windows.erase (std::remove_if (windows.begin(), windows.end(),
+                                   [&wanted] (const Window& w) { return ! wanted.contains (w.topLevel); }),
+                   windows.end());
+
+    for (auto* topLevel : wanted)
+    {
+        const auto attached = std::any_of (windows.begin(), windows.end(),
+                                           [topLevel] (const Window& w) { return w.topLevel == topLevel; });
+
+        if (! attached)
+            windows.push_back ({ topLevel, std::make_unique<juce::VBlankAttachment> (topLevel, [this, topLevel] { tick (topLevel); }) });
+    }
+}
+
+void ScopeRefreshHub::tick (juce::Component* topLevel)
+{
+    for (auto* c : clients)
+        if (c->getRefreshComponent().getTopLevelComponent() == topLevel)
+            c->refresh();
+}
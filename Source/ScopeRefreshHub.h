@@ -0,0 +1,52 @@
+#ifndef EFFEM_UNIT_SCOPEREFRESHHUB_H
+#define EFFEM_UNIT_SCOPEREFRESHHUB_H
+
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+//==============================================================================
+// Display-refresh callbacks shared by every open editor in the process (use
+// through juce::SharedResourcePointer). There is one vblank attachment per
+// top-level window holding a client, and each drives only the clients in its
+// window, so a hidden or minimised window can't stall the others. Clients
+// only repaint when they have something new to show.
+class ScopeRefreshHub : private juce::ComponentListener
+{
+public:
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+
+        // Called once per vblank; poll for new data and repaint if needed
+        virtual void refresh() = 0;
+        virtual juce::Component& getRefreshComponent() = 0;
+    };
+
+    ScopeRefreshHub() = default;
+    ~ScopeRefreshHub() override;
+
+    void add (Client*);
+    void remove (Client*);
+
+private:
+    struct Window
+    {
+        juce::Component* topLevel;
+        std::unique_ptr<juce::VBlankAttachment> vblank;
+    };
+
+    // A client's window can change after add(): it is usually registered
+    // before its editor is on screen. Re-grouped whenever one moves.
+    void componentParentHierarchyChanged (juce::Component&) override;
+    void updateWindows();
+    void tick (juce::Component* topLevel);
+
+    juce::Array<Client*> clients;
+    std::vector<Window> windows;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScopeRefreshHub)
+};
+
+#endif //EFFEM_UNIT_SCOPEREFRESHHUB_H
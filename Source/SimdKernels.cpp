@@ -0,0 +1,95 @@
+#include "SimdKernels.h"
+#include <juce_core/juce_core.h>
+#include <atomic>
+
+#ifndef EFFEM_X86_KERNELS
+ #define EFFEM_X86_KERNELS 0
+#endif
+
+extern const SimdKernels baselineKernels;
+
+#if EFFEM_X86_KERNELS
+extern const SimdKernels avx2Kernels;
+extern const SimdKernels avx512Kernels;
+#endif
+
+//==============================================================================
+const SimdKernels* SimdKernels::forIsa (Isa isa) noexcept
+{
+    switch (isa)
+    {
+        case baseline: return &baselineKernels;
+       #if EFFEM_X86_KERNELS
+        case avx2:     return &avx2Kernels;
+        case avx512:   return &avx512Kernels;
+       #endif
+        default:       break;
+    }
+
+    return nullptr;
+}
+
+bool SimdKernels::isSupported (Isa isa) noexcept
+{
+    if (forIsa (isa) == nullptr)
+        return false;
+
+    switch (isa)
+    {
+        case avx2:   return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3();
+        case avx512: return juce::SystemStats::hasAVX512F();
+        default:     break;
+    }
+
+    return true;
+}
+
+//==============================================================================
+static const SimdKernels& selectKernels()
+{
+    const auto forced = juce::SystemStats::getEnvironmentVariable ("EFFEM_FORCE_ISA", {}).trim().toLowerCase();
+
+    if (forced.isNotEmpty())
+    {
+        for (int i = 0; i < SimdKernels::numIsas; ++i)
+        {
+            const auto isa = (SimdKernels::Isa) i;
+            auto* k = SimdKernels::forIsa (isa);
+
+            if (k != nullptr && forced == juce::String (k->name).toLowerCase().removeCharacters ("-"))
+            {
+                if (SimdKernels::isSupported (isa))
+                    return *k;
+
+                DBG ("EFFEM_FORCE_ISA=" << forced << " is not supported by this CPU");
+                break;
+            }
+        }
+    }
+
+    for (int i = SimdKernels::numIsas; --i >= 0;)
+        if (SimdKernels::isSupported ((SimdKernels::Isa) i))
+            return *SimdKernels::forIsa ((SimdKernels::Isa) i);
+
+    return baselineKernels;
+}
+
+static std::atomic<const SimdKernels*> selected { nullptr };
+
+const SimdKernels& SimdKernels::resolve()
+{
+    if (auto* k = selected.load (std::memory_order_acquire))
+        return *k;
+
+    auto& k = selectKernels();
+    selected.store (&k, std::memory_order_release);
+    return k;
+}
+
+const SimdKernels& SimdKernels::get() noexcept
+{
+    if (auto* k = selected.load (std::memory_order_acquire))
+        return *k;
+
+    return baselineKernels;
+}
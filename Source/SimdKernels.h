@@ -0,0 +1,66 @@
+#ifndef EFFEM_UNIT_SIMDKERNELS_H
+#define EFFEM_UNIT_SIMDKERNELS_H
+
+#pragma once
+
+//==============================================================================
+// The plain loops of the DSP path (oscillator table reads, voice mixing,
+// voice-to-output accumulation, master gain), compiled once per x86 ISA level
+// and picked at run time. One binary then runs on any x86-64 CPU and uses
+// AVX2 / AVX-512 where the CPU has them.
+//
+// resolve() chooses the widest variant the CPU supports; the processor calls
+// it from prepareToPlay, so the CPU query and the environment lookup never
+// run on the audio thread. get() only reads the stored choice, and returns
+// the baseline until something has resolved it. Set EFFEM_FORCE_ISA to
+// "baseline", "avx2" or "avx512" to force one for testing. A variant the CPU
+// can't run is ignored.
+//
+// This header is included by the translation units built with AVX flags, so
+// it deliberately holds no inline functions and no JUCE: an inline function
+// emitted in one of those units could be the copy the linker keeps for the
+// whole binary.
+struct SimdKernels
+{
+    enum Isa
+    {
+        baseline = 0,   // the build's own target (SSE2 on x86-64)
+        avx2,
+        avx512,
+        numIsas
+    };
+
+    // Ramped controls arrive as a start value and a per-sample step (a
+    // ParameterRamp segment): value[i] = start + step * i. A step of 0 gives
+    // exactly the constant.
+
+    // Voice oscillator mix with the saw-bleed threshold, indexed
+    // [osc1 on][osc2 on] (see SynthVoice)
+    using MixFn = void (*) (float* dst, const float* o1, const float* o2,
+                            float blend, float blendStep, float level, int numSamples) noexcept;
+
+    // Reads a single-cycle table of `size` + 1 points with linear
+    // interpolation: dest[i] = table (phase) * gain, advancing the phase
+    using TableFn = void (*) (const float* table, int size, double& phase,
+                              double increment, double incrementStep,
+                              float gain, float gainStep, float* dest, int numSamples) noexcept;
+
+    using AddFn      = void (*) (float* dst, const float* src, int numSamples) noexcept;
+    using GainFn     = void (*) (float* data, float gain, int numSamples) noexcept;
+    using GainRampFn = void (*) (float* data, float gain, float gainStep, int numSamples) noexcept;
+
+    const char* name;
+    MixFn mix[2][2];
+    TableFn readTable;
+    AddFn add;
+    GainFn applyGain;
+    GainRampFn applyGainRamp;
+
+    static const SimdKernels& get() noexcept;
+    static const SimdKernels& resolve();   // message thread
+
+    static const SimdKernels* forIsa (Isa) noexcept;   // nullptr if not built
+    static bool isSupported (Isa) noexcept;
+};
+
+#endif //EFFEM_UNIT_SIMDKERNELS_H
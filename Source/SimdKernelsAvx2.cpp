@@ -0,0 +1,7 @@
+// Built with AVX2 + FMA, without contraction (see CMakeLists.txt); empty on
+// other targets
+#if EFFEM_X86_KERNELS
+ #define EFFEM_SIMD_KERNELS_NAME  avx2Kernels
+ #define EFFEM_SIMD_KERNELS_LABEL "AVX2"
+ #include "SimdKernelsImpl.h"
+#endif
@@ -0,0 +1,6 @@
+// Built with AVX-512F (see CMakeLists.txt); empty on other targets
+#if EFFEM_X86_KERNELS
+ #define EFFEM_SIMD_KERNELS_NAME  avx512Kernels
+ #define EFFEM_SIMD_KERNELS_LABEL "AVX-512"
+ #include "SimdKernelsImpl.h"
+#endif
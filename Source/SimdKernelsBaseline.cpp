@@ -0,0 +1,4 @@
+// Built with the project's normal flags
+#define EFFEM_SIMD_KERNELS_NAME  baselineKernels
+#define EFFEM_SIMD_KERNELS_LABEL "baseline"
+#include "SimdKernelsImpl.h"
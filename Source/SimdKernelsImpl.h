@@ -0,0 +1,93 @@
+// Kernel bodies shared by the SimdKernels* variant translation units. Each
+// one defines EFFEM_SIMD_KERNELS_NAME / _LABEL and includes this once, so
+// everything here has internal linkage and nothing may come from headers
+// with inline functions (see SimdKernels.h).
+
+#include "SimdKernels.h"
+
+namespace
+{
+    template <bool osc1On, bool osc2On>
+    void mixOscillators (float* dst, const float* o1, const float* o2,
+                         float blend, float blendStep, float level, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const float b = blend + blendStep * (float) i;
+            float s1 = 0.0f, s2 = 0.0f;
+
+            // Absolute mute if gain is too low (prevents saw bleed), as a
+            // select rather than a branch
+            if constexpr (osc1On) s1 = (o1[i] < 1e-6f && o1[i] > -1e-6f) ? 0.0f : o1[i];
+            if constexpr (osc2On) s2 = (o2[i] < 1e-6f && o2[i] > -1e-6f) ? 0.0f : o2[i];
+
+            float mixed = s1 * (1.0f - b)
+                        + s2 * b;
+
+            dst[i] = mixed * level;
+        }
+    }
+
+    // The table and dest never overlap; saying so lets the table reads become
+    // gathers
+    void readTable (const float* __restrict table, int size, double& phase,
+                    double increment, double incrementStep,
+                    float gain, float gainStep, float* __restrict dest, int numSamples) noexcept
+    {
+        // Each sample's phase in closed form rather than carried from the last,
+        // so the loop has no dependency between iterations and vectorises:
+        // phase + i * increment + i (i - 1) / 2 * incrementStep, wrapped. The
+        // phase never goes negative, so truncation is floor, and within a
+        // block it stays far inside int range, which (unlike long long)
+        // converts in vector registers without AVX-512DQ.
+        const double start = phase;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto d     = (double) i;
+            auto p           = start + d * increment + 0.5 * d * (d - 1.0) * incrementStep;
+            p               -= (double) (int) p;
+
+            const auto pos   = p * (double) size;
+            const auto index = (int) pos;
+            const auto frac  = (float) (pos - (double) index);
+
+            dest[i] = (table[index] + frac * (table[index + 1] - table[index])) * (gain + gainStep * (float) i);
+        }
+
+        const auto n = (double) numSamples;
+        auto end = start + n * increment + 0.5 * n * (n - 1.0) * incrementStep;
+        phase = end - (double) (int) end;
+    }
+
+    void add (float* dst, const float* src, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dst[i] += src[i];
+    }
+
+    void applyGain (float* data, float gain, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] *= gain;
+    }
+
+    void applyGainRamp (float* data, float gain, float gainStep, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] *= gain + gainStep * (float) i;
+    }
+}
+
+extern const SimdKernels EFFEM_SIMD_KERNELS_NAME;
+
+const SimdKernels EFFEM_SIMD_KERNELS_NAME
+{
+    EFFEM_SIMD_KERNELS_LABEL,
+    { { &mixOscillators<false, false>, &mixOscillators<false, true> },
+      { &mixOscillators<true,  false>, &mixOscillators<true,  true> } },
+    &readTable,
+    &add,
+    &applyGain,
+    &applyGainRamp
+};
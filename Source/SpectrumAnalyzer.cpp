@@ -0,0 +1,175 @@
+#include "SpectrumAnalyzer.h"
+
+namespace
+{
+    constexpr float peakDecayDbPerSecond = 24.0f;
+}
+
+//==============================================================================
+SpectrumAnalyzer::SpectrumAnalyzer()
+{
+    held.fill(minDecibels);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    active.store(false, std::memory_order_relaxed);
+    worker.stopThread(1000);
+}
+
+//==============================================================================
+void SpectrumAnalyzer::prepare(double sampleRate)
+{
+    currentSampleRate.store(sampleRate, std::memory_order_relaxed);
+}
+
+void SpectrumAnalyzer::push(const float* samples, int numSamples) noexcept
+{
+    if (! active.load(std::memory_order_acquire))
+        return;
+
+    // If the worker falls behind, the excess is simply dropped
+    const juce::AbstractFifo::ScopedWrite w(fifo, numSamples);
+
+    if (w.blockSize1 > 0)
+        std::copy(samples, samples + w.blockSize1, fifoBuffer.data() + w.startIndex1);
+
+    if (w.blockSize2 > 0)
+        std::copy(samples + w.blockSize1, samples + w.blockSize1 + w.blockSize2, fifoBuffer.data() + w.startIndex2);
+}
+
+//==============================================================================
+void SpectrumAnalyzer::addViewer()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if (numViewers++ == 0)
+    {
+        allocate();
+        active.store(true, std::memory_order_release);
+        worker.startThread(juce::Thread::Priority::low);
+    }
+}
+
+void SpectrumAnalyzer::removeViewer()
+{
+    JUCE_ASSERT_MESSAGE_THREAD
+    jassert(numViewers > 0);
+
+    if (--numViewers == 0)
+    {
+        active.store(false, std::memory_order_relaxed);
+        worker.stopThread(1000);
+    }
+}
+
+// Kept once allocated: the audio thread may still be inside push() after
+// the last viewer has gone
+void SpectrumAnalyzer::allocate()
+{
+    if (fft != nullptr)
+        return;
+
+    fifoBuffer.resize((size_t) fifoSize);
+    history.assign((size_t) fftSize, 0.0f);
+    fftData.assign((size_t) fftSize * 2, 0.0f);
+
+    fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+    window = std::make_unique<juce::dsp::WindowingFunction<float>>((size_t) fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+}
+
+//==============================================================================
+void SpectrumAnalyzer::Worker::run()
+{
+    owner.discardPending();
+
+    while (! threadShouldExit())
+    {
+        const auto sr = owner.currentSampleRate.load(std::memory_order_relaxed);
+
+        if (sr != owner.mappedSampleRate)
+            owner.updateBandMap(sr);
+
+        bool analysed = false;
+
+        while (owner.readHop())
+        {
+            owner.analyseFrame();
+            analysed = true;
+        }
+
+        if (analysed)
+        {
+            owner.frames.getWriteBuffer() = owner.held;
+            owner.frames.publish();
+        }
+
+        wait(10);
+    }
+}
+
+// Anything left over from the last time the view was open is stale
+void SpectrumAnalyzer::discardPending()
+{
+    fifo.finishedRead(fifo.getNumReady());
+    std::fill(history.begin(), history.end(), 0.0f);
+    held.fill(minDecibels);
+}
+
+bool SpectrumAnalyzer::readHop()
+{
+    if (fifo.getNumReady() < hopSize)
+        return false;
+
+    std::copy(history.begin() + hopSize, history.end(), history.begin());
+    auto* dst = history.data() + (fftSize - hopSize);
+
+    const juce::AbstractFifo::ScopedRead r(fifo, hopSize);
+    std::copy(fifoBuffer.data() + r.startIndex1, fifoBuffer.data() + r.startIndex1 + r.blockSize1, dst);
+    std::copy(fifoBuffer.data() + r.startIndex2, fifoBuffer.data() + r.startIndex2 + r.blockSize2, dst + r.blockSize1);
+
+    return true;
+}
+
+void SpectrumAnalyzer::analyseFrame()
+{
+    std::copy(history.begin(), history.end(), fftData.begin());
+    window->multiplyWithWindowingTable(fftData.data(), (size_t) fftSize);
+    fft->performFrequencyOnlyForwardTransform(fftData.data(), true);
+
+    // A full-scale sine reads 0 dB: fftSize / 2 for the one-sided spectrum,
+    // halved again by the Hann window's coherent gain
+    constexpr float scale = 4.0f / (float) fftSize;
+    const float decay = peakDecayDbPerSecond * (float) hopSize / (float) mappedSampleRate;
+
+    for (size_t b = 0; b < (size_t) numBands; ++b)
+    {
+        const int first = bandEdges[b];
+        const int last  = juce::jmax(first + 1, bandEdges[b + 1]);
+
+        float peak = 0.0f;
+
+        for (int bin = first; bin < last; ++bin)
+            peak = juce::jmax(peak, fftData[(size_t) bin]);
+
+        const float db = juce::Decibels::gainToDecibels(peak * scale, minDecibels);
+        held[b] = juce::jmax(db, held[b] - decay);
+    }
+}
+
+// Band b covers minFrequency * ratio^b .. minFrequency * ratio^(b+1). Bands
+// narrower than one bin at the low end repeat the nearest bin.
+void SpectrumAnalyzer::updateBandMap(double sampleRate)
+{
+    const float top = juce::jmin(20000.0f, (float) sampleRate * 0.5f);
+    const float binsPerHz = (float) fftSize / (float) sampleRate;
+
+    for (size_t b = 0; b <= (size_t) numBands; ++b)
+    {
+        const float f = minFrequency * std::pow(top / minFrequency, (float) b / (float) numBands);
+        bandEdges[b] = juce::jlimit(1, fftSize / 2 - 1, juce::roundToInt(f * binsPerHz));
+    }
+
+    mappedSampleRate = sampleRate;
+    maxFrequency.store(top, std::memory_order_relaxed);
+}
@@ -0,0 +1,93 @@
+#ifndef EFFEM_UNIT_SPECTRUMANALYZER_H
+#define EFFEM_UNIT_SPECTRUMANALYZER_H
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include "TripleBuffer.h"
+
+//==============================================================================
+// Spectrum analyzer for the editor. The audio thread only copies samples into
+// a lock-free FIFO; a background thread runs Hann-windowed FFT frames with 75%
+// overlap, maps the bins onto log-spaced bands with peak-hold decay and
+// publishes ready-to-draw levels through a triple buffer.
+//
+// Nothing is computed (and push() returns immediately) unless at least one
+// view has called addViewer(). The FIFO and the FFT state are only allocated
+// by the first one, so an instance whose editor is never opened doesn't
+// carry them.
+class SpectrumAnalyzer
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize  = 1 << fftOrder;
+    static constexpr int hopSize  = fftSize / 4;
+    static constexpr int numBands = 160;
+
+    static constexpr float minFrequency = 20.0f;
+    static constexpr float minDecibels  = -96.0f;
+
+    // Band levels in dB, minDecibels..0, lowest band first
+    using Frame = std::array<float, numBands>;
+
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer();
+
+    // ===== Audio thread =====
+    void prepare (double sampleRate);
+    void push (const float* samples, int numSamples) noexcept;
+
+    // ===== Message thread =====
+    // The worker runs while at least one viewer is registered
+    void addViewer();
+    void removeViewer();
+
+    // Newest frame; fetch() returns false if nothing new was published
+    TripleBuffer<Frame>& getFrames() noexcept { return frames; }
+
+    float getMaxFrequency() const noexcept { return maxFrequency.load (std::memory_order_relaxed); }
+
+private:
+    //==============================================================================
+    class Worker : public juce::Thread
+    {
+    public:
+        explicit Worker (SpectrumAnalyzer& o) : juce::Thread ("EFFEM spectrum"), owner (o) {}
+        void run() override;
+
+    private:
+        SpectrumAnalyzer& owner;
+    };
+
+    void allocate();
+    void discardPending();
+    bool readHop();
+    void analyseFrame();
+    void updateBandMap (double sampleRate);
+
+    // Audio -> worker
+    static constexpr int fifoSize = 1 << 15;
+    juce::AbstractFifo fifo { fifoSize };
+    std::vector<float> fifoBuffer;
+    std::atomic<bool> active { false };
+    std::atomic<double> currentSampleRate { 44100.0 };
+    std::atomic<float> maxFrequency { 20000.0f };
+
+    // Worker state
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::unique_ptr<juce::dsp::WindowingFunction<float>> window;
+    std::vector<float> history;        // last fftSize input samples
+    std::vector<float> fftData;        // 2 * fftSize, as performFrequencyOnlyForwardTransform wants
+    std::array<int, numBands + 1> bandEdges {};
+    Frame held {};
+    double mappedSampleRate = 0.0;
+
+    TripleBuffer<Frame> frames;
+
+    Worker worker { *this };
+    int numViewers = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyzer)
+};
+
+#endif //EFFEM_UNIT_SPECTRUMANALYZER_H
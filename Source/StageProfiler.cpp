@@ -0,0 +1,148 @@
+#include "StageProfiler.h"
+#include <bit>
+
+//==============================================================================
+const char* StageProfiler::getStageName (int stage)
+{
+    switch (stage)
+    {
+        case params:      return "Params";
+        case oscillators: return "Oscillators";
+        case drive:       return "Drive";
+        case envelope:    return "Envelope";
+        case filter:      return "Filter";
+        case voiceMix:    return "Voice mix";
+        case synthRender: return "Synth total";
+        case master:      return "Master";
+        case effects:     return "Effects";
+        case scope:       return "Scope";
+        default:          break;
+    }
+    return "";
+}
+
+//==============================================================================
+void StageProfiler::prepare (double sampleRate, int)
+{
+    currentSampleRate.store (sampleRate, std::memory_order_relaxed);
+    pending.fill (0);
+}
+
+void StageProfiler::endCallback (int numSamples) noexcept
+{
+    for (size_t i = 0; i < (size_t) numStages; ++i)
+    {
+        const auto nanos = (juce::uint64) juce::jmax ((juce::int64) 0, pending[i]);
+        pending[i] = 0;
+
+        auto& c = counters[i];
+        c.count.fetch_add (1, std::memory_order_relaxed);
+        c.sumNanos.fetch_add (nanos, std::memory_order_relaxed);
+
+        // Only this thread raises the max; the reader resets it with exchange(),
+        // so a lost update just means one interval under-reports.
+        if (nanos > c.maxNanos.load (std::memory_order_relaxed))
+            c.maxNanos.store (nanos, std::memory_order_relaxed);
+
+        c.histogram[(size_t) bucketFor (nanos)].fetch_add (1, std::memory_order_relaxed);
+    }
+
+    samplesProcessed.fetch_add ((juce::uint64) numSamples, std::memory_order_release);
+}
+
+//==============================================================================
+// Buckets 0..7 are exact nanoseconds, after that each octave is split into 8.
+int StageProfiler::bucketFor (juce::uint64 nanos) noexcept
+{
+    if (nanos < 8)
+        return (int) nanos;
+
+    const int msb = (int) std::bit_width (nanos) - 1;     // >= 3
+    const int sub = (int) ((nanos >> (msb - 3)) & 7);
+
+    return juce::jmin (numBuckets - 1, 8 + (msb - 3) * 8 + sub);
+}
+
+double StageProfiler::bucketUpperBound (int bucket) noexcept
+{
+    if (bucket < 8)
+        return (double) (bucket + 1);
+
+    const int octave = (bucket - 8) / 8;
+    const int sub    = (bucket - 8) % 8;
+
+    return std::ldexp ((double) (8 + sub + 1), octave);
+}
+
+//==============================================================================
+std::array<StageProfiler::StageStats, StageProfiler::numStages>
+StageProfiler::Reader::update (StageProfiler& p)
+{
+    std::array<StageStats, numStages> result;
+
+    const auto samples      = p.samplesProcessed.load (std::memory_order_acquire);
+    const auto deltaSamples = samples - lastSamples;
+    lastSamples = samples;
+
+    const double intervalNanos = (double) deltaSamples * 1.0e9
+                               / p.currentSampleRate.load (std::memory_order_relaxed);
+
+    for (size_t i = 0; i < (size_t) numStages; ++i)
+    {
+        auto& c = p.counters[i];
+
+        const auto count = c.count.load (std::memory_order_relaxed);
+        const auto sum   = c.sumNanos.load (std::memory_order_relaxed);
+        const auto max   = c.maxNanos.exchange (0, std::memory_order_relaxed);
+
+        const auto deltaCount = count - lastCount[i];
+        const auto deltaSum   = sum - lastSum[i];
+        lastCount[i] = count;
+        lastSum[i]   = sum;
+
+        // p99 from the histogram delta since the last update
+        std::array<juce::uint32, numBuckets> delta;
+        juce::uint64 total = 0;
+
+        for (size_t b = 0; b < (size_t) numBuckets; ++b)
+        {
+            const auto v = c.histogram[b].load (std::memory_order_relaxed);
+            delta[b] = v - lastHistogram[i][b];
+            lastHistogram[i][b] = v;
+            total += delta[b];
+        }
+
+        double p99 = 0.0;
+
+        if (total > 0)
+        {
+            const auto target = total - total / 100;   // 99th percentile rank
+            juce::uint64 seen = 0;
+
+            for (int b = 0; b < numBuckets; ++b)
+            {
+                seen += delta[(size_t) b];
+
+                if (seen >= target)
+                {
+                    p99 = bucketUpperBound (b);
+                    break;
+                }
+            }
+        }
+
+        auto& s = result[i];
+
+        if (deltaCount > 0)
+        {
+            s.meanMicros = (double) deltaSum / (double) deltaCount * 1.0e-3;
+            s.p99Micros  = juce::jmin (p99, (double) max) * 1.0e-3;
+            s.maxMicros  = (double) max * 1.0e-3;
+        }
+
+        if (intervalNanos > 0.0)
+            s.budgetShare = (double) deltaSum / intervalNanos;
+    }
+
+    return result;
+}
@@ -0,0 +1,137 @@
+#ifndef EFFEM_UNIT_STAGEPROFILER_H
+#define EFFEM_UNIT_STAGEPROFILER_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+
+// Compile-time switch for the timing probes. Configure with -DEFFEM_PROFILING=ON
+// to build them in; when it is 0 the EFFEM_PROFILE_* macros expand to nothing.
+#ifndef EFFEM_PROFILING
+ #define EFFEM_PROFILING 0
+#endif
+
+//==============================================================================
+// Per-stage CPU timing for processBlock and SynthVoice::renderNextBlock.
+//
+// The audio thread sums the time spent in each stage during a callback and
+// publishes the totals once per callback into lock-free counters (sum, max and
+// a log-scaled histogram). The editor takes snapshots at UI rate and computes
+// mean / p99 / max over the interval since its previous snapshot.
+class StageProfiler
+{
+public:
+    enum Stage
+    {
+        params = 0,        // parameter reads + voice updates
+        oscillators,       // per voice: osc1/osc2 + mix
+        drive,             // per voice: waveshaper
+        envelope,          // per voice: ADSR
+        filter,            // per voice: SVF
+        voiceMix,          // per voice: accumulate into the output buffer
+        synthRender,       // juce::Synthesiser::renderNextBlock as a whole
+        master,            // pan, master gain, mute
+        effects,           // chorus, delay, reverb
+        scope,             // oscilloscope feed
+        numStages
+    };
+
+    static const char* getStageName (int stage);
+
+    // ===== Audio thread =====
+    void prepare (double sampleRate, int samplesPerBlock);
+    void addTime (Stage stage, juce::int64 nanos) noexcept   { pending[(size_t) stage] += nanos; }
+    void endCallback (int numSamples) noexcept;
+
+    static juce::int64 now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds> (
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    //==============================================================================
+    // Lap timer used through the EFFEM_PROFILE_LAP macros: each lap() charges the
+    // time since the previous mark to a stage, so straight-line code can be split
+    // into stages without adding scopes. A null profiler is allowed so voices can
+    // be rendered before the processor hands them one.
+    class LapTimer
+    {
+    public:
+        explicit LapTimer (StageProfiler* p) noexcept
+            : profiler (p), last (p != nullptr ? now() : 0) {}
+
+        void lap (Stage stage) noexcept
+        {
+            if (profiler == nullptr)
+                return;
+
+            const auto t = now();
+            profiler->addTime (stage, t - last);
+            last = t;
+        }
+
+    private:
+        StageProfiler* profiler;
+        juce::int64 last;
+
+        JUCE_DECLARE_NON_COPYABLE (LapTimer)
+    };
+
+    //==============================================================================
+    // ===== Reader side (message thread) =====
+    struct StageStats
+    {
+        double meanMicros  = 0.0;
+        double p99Micros   = 0.0;
+        double maxMicros   = 0.0;
+        double budgetShare = 0.0;   // mean / block duration
+    };
+
+    static constexpr int numBuckets = 8 + 34 * 8;   // 8 sub-buckets per octave up to ~2^37 ns
+
+    // Holds the previous raw counter values so successive calls report the
+    // interval in between. One Reader per consumer.
+    class Reader
+    {
+    public:
+        std::array<StageStats, numStages> update (StageProfiler&);
+
+    private:
+        std::array<juce::uint64, numStages> lastCount {}, lastSum {};
+        std::array<std::array<juce::uint32, numBuckets>, numStages> lastHistogram {};
+        juce::uint64 lastSamples = 0;
+    };
+
+private:
+    static int bucketFor (juce::uint64 nanos) noexcept;
+    static double bucketUpperBound (int bucket) noexcept;
+
+    struct Counters
+    {
+        std::atomic<juce::uint64> count { 0 };
+        std::atomic<juce::uint64> sumNanos { 0 };
+        std::atomic<juce::uint64> maxNanos { 0 };
+        std::array<std::atomic<juce::uint32>, numBuckets> histogram {};
+    };
+
+    std::array<juce::int64, numStages> pending {};
+    std::array<Counters, numStages> counters;
+
+    std::atomic<juce::uint64> samplesProcessed { 0 };
+    std::atomic<double> currentSampleRate { 44100.0 };
+};
+
+#if EFFEM_PROFILING
+ #define EFFEM_PROFILE_LAP_START(profiler)     StageProfiler::LapTimer effemLapTimer (profiler)
+ #define EFFEM_PROFILE_LAP(stage)              effemLapTimer.lap (StageProfiler::stage)
+ #define EFFEM_PROFILE_END_CALLBACK(profiler, numSamples)  (profiler).endCallback (numSamples)
+#else
+ #define EFFEM_PROFILE_LAP_START(profiler)
+ #define EFFEM_PROFILE_LAP(stage)
+ #define EFFEM_PROFILE_END_CALLBACK(profiler, numSamples)
+#endif
+
+#endif //EFFEM_UNIT_STAGEPROFILER_H
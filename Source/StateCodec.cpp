@@ -0,0 +1,150 @@
+#include "StateCodec.h"
+#include <cstring>
+#include <unordered_map>
+
+static constexpr char stateMagic[4] = { 'E', 'F', 'S', 'T' };
+
+//==============================================================================
+// FNV-1a over the UTF-8 ID: stable across platforms and JUCE versions.
+juce::uint32 StateCodec::hashParameterID (const juce::String& paramID) noexcept
+{
+    juce::uint32 hash = 2166136261u;
+
+    for (auto* p = paramID.toRawUTF8(); *p != 0; ++p)
+    {
+        hash ^= (juce::uint8) *p;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool StateCodec::isBinaryState (const void* data, int sizeInBytes) noexcept
+{
+    return data != nullptr
+        && sizeInBytes >= 8
+        && std::memcmp (data, stateMagic, sizeof (stateMagic)) == 0;
+}
+
+//==============================================================================
+void StateCodec::write (juce::AudioProcessorValueTreeState& state, juce::MemoryBlock& destData)
+{
+    auto tree = state.copyState();
+
+    juce::MemoryOutputStream out (destData, false);
+    out.write (stateMagic, sizeof (stateMagic));
+    out.writeShort ((short) currentVersion);
+
+    // Parameter records
+    juce::Array<juce::ValueTree> paramTrees;
+
+    for (int i = tree.getNumChildren(); --i >= 0;)
+    {
+        auto child = tree.getChild (i);
+
+        if (child.hasProperty ("id") && child.hasProperty ("value"))
+        {
+            paramTrees.add (child);
+            tree.removeChild (i, nullptr);
+        }
+    }
+
+    out.writeShort ((short) paramTrees.size());
+
+    for (int i = paramTrees.size(); --i >= 0;)   // restore the original order
+    {
+        const auto& p = paramTrees.getReference (i);
+        out.writeInt ((int) hashParameterID (p["id"].toString()));
+        out.writeFloat ((float) p["value"]);
+    }
+
+    // Everything else (non-parameter properties and children)
+    juce::MemoryOutputStream extra;
+    tree.writeToStream (extra);
+
+    out.writeInt ((int) extra.getDataSize());
+    out.write (extra.getData(), extra.getDataSize());
+}
+
+//==============================================================================
+bool StateCodec::read (juce::AudioProcessorValueTreeState& state,
+                       const void* data, int sizeInBytes)
+{
+    if (isBinaryState (data, sizeInBytes))
+        return readBinary (state, data, sizeInBytes);
+
+    // Sessions saved before the binary format
+    std::unique_ptr<juce::XmlElement> xml (juce::AudioProcessor::getXmlFromBinary (data, sizeInBytes));
+
+    if (xml && xml->hasTagName (state.state.getType()))
+    {
+        state.replaceState (juce::ValueTree::fromXml (*xml));
+        return true;
+    }
+
+    return false;
+}
+
+bool StateCodec::readBinary (juce::AudioProcessorValueTreeState& state,
+                             const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream in (data, (size_t) sizeInBytes, false);
+    in.skipNextBytes (sizeof (stateMagic));
+
+    const auto version = (juce::uint16) in.readShort();
+
+    if (version == 0 || version > currentVersion)
+        return false;
+
+    const int numRecords = (juce::uint16) in.readShort();
+
+    if (in.getNumBytesRemaining() < (juce::int64) numRecords * 8 + 4)
+        return false;
+
+    // Hash -> ID for the parameters this build knows about
+    std::unordered_map<juce::uint32, juce::String> idsByHash;
+
+    for (auto* p : state.processor.getParameters())
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p))
+            idsByHash[hashParameterID (ranged->paramID)] = ranged->paramID;
+
+    juce::Array<juce::ValueTree> paramTrees;
+
+    for (int i = 0; i < numRecords; ++i)
+    {
+        const auto hash  = (juce::uint32) in.readInt();
+        const auto value = in.readFloat();
+
+        auto it = idsByHash.find (hash);
+
+        if (it == idsByHash.end())
+            continue;   // parameter no longer exists
+
+        juce::ValueTree param ("PARAM");
+        param.setProperty ("id", it->second, nullptr);
+        param.setProperty ("value", value, nullptr);
+        paramTrees.add (param);
+    }
+
+    const auto extraSize = (size_t) (juce::uint32) in.readInt();
+
+    if ((size_t) in.getNumBytesRemaining() < extraSize)
+        return false;
+
+    juce::ValueTree tree;
+
+    if (extraSize > 0)
+    {
+        juce::MemoryInputStream extra (static_cast<const char*> (data) + in.getPosition(), extraSize, false);
+        tree = juce::ValueTree::readFromStream (extra);
+    }
+
+    if (! tree.isValid() || ! tree.hasType (state.state.getType()))
+        tree = juce::ValueTree (state.state.getType());
+
+    for (auto& p : paramTrees)
+        tree.appendChild (p, nullptr);
+
+    state.replaceState (tree);
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef EFFEM_UNIT_STATECODEC_H
+#define EFFEM_UNIT_STATECODEC_H
+
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+//==============================================================================
+// Compact binary session state.
+//
+// Layout (little endian):
+//   char[4]  magic "EFST"
+//   uint16   version
+//   uint16   number of parameter records
+//   record[] { uint32 parameter ID hash, float32 value (denormalised) }
+//   uint32   size of the trailing block
+//   bytes    ValueTree::writeToStream of the non-parameter state
+//
+// Parameters are keyed by a hash of their ID, so reordering or adding
+// parameters doesn't break old sessions. Anything that isn't binary is treated
+// as the XML written by earlier versions.
+class StateCodec
+{
+public:
+    static constexpr juce::uint16 currentVersion = 1;
+
+    static juce::uint32 hashParameterID (const juce::String& paramID) noexcept;
+
+    static void write (juce::AudioProcessorValueTreeState& state, juce::MemoryBlock& destData);
+
+    static bool isBinaryState (const void* data, int sizeInBytes) noexcept;
+
+    // Decodes binary or legacy XML state and replaces the APVTS state with it.
+    static bool read (juce::AudioProcessorValueTreeState& state,
+                      const void* data, int sizeInBytes);
+
+private:
+    static bool readBinary (juce::AudioProcessorValueTreeState& state,
+                            const void* data, int sizeInBytes);
+};
+
+#endif //EFFEM_UNIT_STATECODEC_H
@@ -9,11 +9,24 @@
 #pragma once
 #include <juce_audio_processors/juce_audio_processors.h>
 
+// One per multitimbral part; a voice plays the part of the sound that
+// started it. Parts sharing a channel layer.
 class SynthSound : public juce::SynthesiserSound
 {
 public:
+    explicit SynthSound (int partIndex = 0) : part (partIndex), channel (partIndex == 0 ? 0 : -1) {}
+
     bool appliesToNote (int) override { return true; }
-    bool appliesToChannel (int) override { return true; }
+    bool appliesToChannel (int midiChannel) override { return channel == 0 || channel == midiChannel; }
+
+    int getPart() const noexcept { return part; }
+
+    // Audio thread: MIDI channel 1-16, 0 for any channel or -1 for none
+    void setChannel (int newChannel) noexcept { channel = newChannel; }
+
+private:
+    const int part;
+    int channel;
 };
 
 
@@ -3,6 +3,7 @@
 //
 
 #include "SynthVoice.h"
+#include "SimdKernels.h"
 
 //==============================================================================
 bool SynthVoice::canPlaySound (juce::SynthesiserSound* sound)
@@ -18,23 +19,160 @@ void SynthVoice::prepare (double sampleRate, int samplesPerBlock, int numChannel
 
     adsr.setSampleRate(sampleRate);
 
-    filterSpec.sampleRate = sampleRate;
-    filterSpec.maximumBlockSize = samplesPerBlock;
-    filterSpec.numChannels = numChannels;
-    filter.prepare(filterSpec);
+    filter.prepare(sampleRate, samplesPerBlock, numChannels);
+    blend.setRampLength(samplesPerBlock);
 
-    filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);
+    osc1Level.reset(sampleRate, EngineStateManager::crossfadeSeconds);
+    osc2Level.reset(sampleRate, EngineStateManager::crossfadeSeconds);
+
+    // Size the scratch buffers up front so rendering never allocates
+    tempBuffer1.setSize(numChannels, samplesPerBlock);
+    tempBuffer2.setSize(numChannels, samplesPerBlock);
+    mixBuffer  .setSize(numChannels, samplesPerBlock);
+}
+
+void SynthVoice::warmUp (MemoryWarmup& memory, const WaveTableCache& tables)
+{
+    memory.add(tempBuffer1);
+    memory.add(tempBuffer2);
+    memory.add(mixBuffer);
+    filter.warmUp(memory);
+
+    // One pass through each kernel the render path can pick, so the first
+    // notes don't pay for cold code and table pages. level is 0, so
+    // everything past the oscillators works on silence.
+    const int numSamples = mixBuffer.getNumSamples();
+    const auto& kernels = SimdKernels::get();
+
+    auto* dst = mixBuffer.getWritePointer(0);
+    auto* o1  = tempBuffer1.getReadPointer(0);
+    auto* o2  = tempBuffer2.getReadPointer(0);
+
+    level = 0.0f;
+
+    for (int w = 0; w < WaveTableCache::numWaveforms; ++w)
+    {
+        osc1.setWaveTable(tables.get(w), 0);
+        osc2.setWaveTable(tables.get(w), numSamples);
+        osc1.process(tempBuffer1);
+        osc2.process(tempBuffer2);
+    }
+
+    for (int on1 = 0; on1 < 2; ++on1)
+        for (int on2 = 0; on2 < 2; ++on2)
+            kernels.mix[on1][on2](dst, o1, o2, blend.getTarget(), 0.0f, level, numSamples);
+
+    mixRamping(dst, o1, o2, { blend.getTarget(), 0.0f }, numSamples);
+
+    for (int shape = 0; shape < Waveshaper::numShapes; ++shape)
+    {
+        drive.setShape(shape);
+        drive.setDrive(1.0f);
+        drive.process(dst, numSamples);
+    }
+
+    adsr.noteOn();
+    adsr.applyEnvelopeToBuffer(mixBuffer, 0, numSamples);
+
+    // Each type once crossfading and once steady; lowpass last, as prepared
+    for (int type : { VoiceFilter::highpass, VoiceFilter::bandpass, VoiceFilter::ladder,
+                      VoiceFilter::formant, VoiceFilter::comb, VoiceFilter::lowpass })
+    {
+        filter.setType(type, numSamples);
+        filter.process(mixBuffer, numSamples);
+        filter.process(mixBuffer, numSamples);
+    }
+
+    kernels.add(tempBuffer1.getWritePointer(0), dst, numSamples);
+
+    // Back to the state prepare() left
+    osc1.reset();
+    osc2.reset();
+    drive.setShape(Waveshaper::tanhCurve);
+    drive.setDrive(0.0f);
+    drive.reset();
+    adsr.reset();
+    filter.reset();
+
+    tempBuffer1.clear();
+    tempBuffer2.clear();
+    mixBuffer.clear();
 }
 
 //==============================================================================
 void SynthVoice::startNote (int midiNoteNumber, float velocity,
-                            juce::SynthesiserSound*, int)
+                            juce::SynthesiserSound* sound, int)
 {
-    baseFrequency = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+    // The voice pool is shared, so this voice may last have played another
+    // part; the per-block updates only know about the one it had then
+    auto* s = dynamic_cast<SynthSound*>(sound);
+
+    if (s != nullptr && s->getPart() != part)
+    {
+        part = s->getPart();
+
+        if (engine != nullptr)
+            applyPart(engine->parts[(size_t) part], 0);
+
+        if (partControls != nullptr)
+        {
+            updateControls(partControls[part]);
+            updateWaveTablePosition(partControls[part].wtPos1, partControls[part].wtPos2);
+        }
+    }
+
+    baseFrequency = tuning != nullptr ? (float) tuning->getFrequency(midiNoteNumber)
+                                      : (float) juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
+
+    // Keys the keyboard mapping leaves unmapped are silent
+    if (baseFrequency <= 0.0f)
+    {
+        clearCurrentNote();
+        return;
+    }
+
     level = velocity;
 
+    // The new pitch first, so the oscillators start on it instead of ramping
+    // over from the last note's; the other ramps may be stale too, since an
+    // idle voice doesn't render them
+    updateFrequencies();
     osc1.reset();
     osc2.reset();
+    drive.reset();
+    filter.finishRamps();
+    blend.finish();
+
+    dropCacheEntry();
+    noteCache = part == 0 ? renderCache : nullptr;
+    fadeOutRemaining = 0;
+    releaseRemaining = 0;
+
+    if (noteCache != nullptr)
+    {
+        cacheKey = { noteCache->getPatch(), midiNoteNumber, NoteRenderCache::quantiseVelocity(velocity) };
+        level = NoteRenderCache::getVelocityForStep(cacheKey.velocity);
+        oneShotSamples = (juce::int64) (envelopeSeconds * getSampleRate());
+        samplesPlayed = 0;
+
+        cacheEntry = noteCache->find(cacheKey);
+
+        if (cacheEntry >= 0)
+        {
+            cacheMode = CacheMode::playing;
+            cacheCursor = noteCache->getStart(cacheEntry);
+            isActive = true;
+            return;
+        }
+
+        // Nothing left over from the previous note may leak into the recording
+        cacheEntry = noteCache->beginRecording(cacheKey);
+        cacheMode = cacheEntry >= 0 ? CacheMode::recording : CacheMode::off;
+
+        filter.reset();
+        osc1Level.setCurrentAndTargetValue(osc1Level.getTargetValue());
+        osc2Level.setCurrentAndTargetValue(osc2Level.getTargetValue());
+    }
 
     isActive = true;
     adsr.noteOn();
@@ -44,9 +182,29 @@ void SynthVoice::startNote (int midiNoteNumber, float velocity,
 void SynthVoice::stopNote (float, bool allowTailOff)
 {
     if (allowTailOff)
-        adsr.noteOff();
+    {
+        if (cacheMode == CacheMode::playing)
+        {
+            // Past the decay only the filter tail is left, which note-off
+            // would cut uncached too
+            if (samplesPlayed >= oneShotSamples)
+                finishNote();
+            else if (releaseRemaining == 0)
+                releaseLength = releaseRemaining = juce::jmax(1, juce::roundToInt(adsr.getParameters().release * getSampleRate()));
+        }
+        else
+        {
+            // Rendered live: the normal release. A recording cut short by
+            // the key isn't what a held key plays, so it's dropped.
+            dropCacheEntry();
+            noteCache = nullptr;
+            adsr.noteOff();
+        }
+    }
     else
     {
+        dropCacheEntry();
+        noteCache = nullptr;
         adsr.reset();
         isActive = false;
         clearCurrentNote();
@@ -54,80 +212,98 @@ void SynthVoice::stopNote (float, bool allowTailOff)
 }
 
 //==============================================================================
-// Converts choice index → semitone offset
-static float indexToSemitone(int index)
+void SynthVoice::applyEngineState (const EngineState& s, int crossfadeSamples)
+{
+    engine = &s;
+
+    // A silent voice has nothing to fade from
+    applyPart(s.parts[(size_t) part], isActive ? crossfadeSamples : 0);
+
+    // Held notes follow a retune; a key that became unmapped keeps its pitch
+    tuning = s.tuning.get();
+
+    if (isActive)
+    {
+        const auto retuned = (float) tuning->getFrequency(getCurrentlyPlayingNote());
+
+        if (retuned > 0.0f)
+            baseFrequency = retuned;
+    }
+
+    updateFrequencies();
+}
+
+void SynthVoice::applyPart (const EngineState::Part& s, int fade)
 {
-    switch (index)
+    osc1.setWaveTable(s.osc1.table, fade);
+    osc2.setWaveTable(s.osc2.table, fade);
+
+    if (fade > 0)
     {
-        case 0: return -12.f;
-        case 1: return -7.f;
-        case 2: return  0.f;
-        case 3: return +7.f;
-        case 4: return +12.f;
+        osc1Level.setTargetValue(s.osc1.on ? 1.0f : 0.0f);
+        osc2Level.setTargetValue(s.osc2.on ? 1.0f : 0.0f);
     }
-    return 0.f;
+    else
+    {
+        osc1Level.setCurrentAndTargetValue(s.osc1.on ? 1.0f : 0.0f);
+        osc2Level.setCurrentAndTargetValue(s.osc2.on ? 1.0f : 0.0f);
+    }
+
+    pitchRatio1 = s.osc1.pitchRatio;
+    pitchRatio2 = s.osc2.pitchRatio;
+
+    filter.setType(s.filterType, fade);
+    adsr.setParameters(s.envelope);
+    envelopeSeconds = s.envelope.attack + s.envelope.decay;
 }
 
 //==============================================================================
-void SynthVoice::updateFromParameters(float gain1, float pitchIndex1, float detune1,
-                                      float gain2, float pitchIndex2, float detune2,
-                                      float blendAmount)
+void SynthVoice::updateControls(const EngineState::Controls& c)
 {
-    float semis1 = indexToSemitone((int)pitchIndex1);
-    float semis2 = indexToSemitone((int)pitchIndex2);
-
-    float pitchRatio1  = std::pow(2.f, semis1 / 12.f);
-    float pitchRatio2  = std::pow(2.f, semis2 / 12.f);
+    updateFromParameters(c.gain1, c.detune1, c.gain2, c.detune2, c.blend);
+    updateFilter(c.cutoff, c.resonance);
+    updateDrive(c.drive, c.driveType);
+    updateFM(c.fm1, c.fm2);
+}
 
-    float detuneRatio1 = std::pow(2.f, detune1 / 1200.f);
-    float detuneRatio2 = std::pow(2.f, detune2 / 1200.f);
+void SynthVoice::updateFromParameters(float gain1, float detune1,
+                                      float gain2, float detune2,
+                                      float blendAmount)
+{
+    detuneRatio1 = std::pow(2.f, detune1 / 1200.f);
+    detuneRatio2 = std::pow(2.f, detune2 / 1200.f);
 
     osc1.setGain(gain1);
     osc2.setGain(gain2);
 
-    osc1.setFrequency(baseFrequency * pitchRatio1 * detuneRatio1);
-    osc2.setFrequency(baseFrequency * pitchRatio2 * detuneRatio2);
+    updateFrequencies();
 
-    blend = juce::jlimit(0.f, 1.f, blendAmount);
+    blend.setTarget(juce::jlimit(0.f, 1.f, blendAmount));
 }
 
-//==============================================================================
-void SynthVoice::updateEnvelope(float a, float d, float s, float r)
+void SynthVoice::updateFrequencies()
 {
-    adsrParams.attack  = a;
-    adsrParams.decay   = d;
-    adsrParams.sustain = s;
-    adsrParams.release = r;
-    adsr.setParameters(adsrParams);
+    osc1.setFrequency(baseFrequency * pitchRatio1 * detuneRatio1);
+    osc2.setFrequency(baseFrequency * pitchRatio2 * detuneRatio2);
 }
 
 //==============================================================================
-void SynthVoice::updateFilter(float cutoff, float resonance, int type)
+void SynthVoice::updateFilter(float cutoff, float resonance)
 {
     filter.setCutoffFrequency(cutoff);
     filter.setResonance(resonance);
-
-    switch (type)
-    {
-        case 0: filter.setType(juce::dsp::StateVariableTPTFilterType::lowpass);  break;
-        case 1: filter.setType(juce::dsp::StateVariableTPTFilterType::highpass); break;
-        case 2: filter.setType(juce::dsp::StateVariableTPTFilterType::bandpass); break;
-    }
 }
 
-//==============================================================================
-void SynthVoice::updateOscillators(int wave1, int wave2, float blendAmount)
+void SynthVoice::updateDrive(float amount, int shape)
 {
-    osc1.setWaveform(wave1);
-    osc2.setWaveform(wave2);
-
-    blend = juce::jlimit(0.f, 1.f, blendAmount);
+    drive.setDrive(amount);
+    drive.setShape(shape);
 }
 
-void SynthVoice::updateOscOnOff(bool o1, bool o2)
+void SynthVoice::updateWaveTablePosition(float position1, float position2)
 {
-    osc1On = o1;
-    osc2On = o2;
+    osc1.setFramePosition(position1);
+    osc2.setFramePosition(position2);
 }
 
 void SynthVoice::updateFM(float fm1Amount, float fm2Amount)
@@ -136,6 +312,28 @@ void SynthVoice::updateFM(float fm1Amount, float fm2Amount)
     // fm2 = fm2Amount;
 }
 
+//==============================================================================
+// While an oscillator is being switched on or off its level ramps per sample
+void SynthVoice::mixRamping(float* dst, const float* o1, const float* o2,
+                            ParameterRamp<float>::Segment blendSegment, int numSamples) noexcept
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float b = blendSegment.at(i);
+        float s1 = o1[i] * osc1Level.getNextValue();
+        float s2 = o2[i] * osc2Level.getNextValue();
+
+        // Absolute mute if gain is too low (prevents saw bleed)
+        if (std::abs(s1) < 1e-6f) s1 = 0.0f;
+        if (std::abs(s2) < 1e-6f) s2 = 0.0f;
+
+        float mixed = s1 * (1.0f - b)
+                    + s2 * b;
+
+        dst[i] = mixed * level;
+    }
+}
+
 //==============================================================================
 // FM + Mixing + Envelope + Filtering
 void SynthVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer,
@@ -144,61 +342,188 @@ void SynthVoice::renderNextBlock(juce::AudioBuffer<float>& outputBuffer,
     if (!isActive)
         return;
 
+    if (cacheMode == CacheMode::playing)
+    {
+        renderFromCache(outputBuffer, startSample, numSamples);
+        return;
+    }
+
+    EFFEM_PROFILE_LAP_START(profiler);
+    EFFEM_TRACE_BEGIN(tracer, voiceRender, traceTrack, getCurrentlyPlayingNote());
+
     const int numChannels = outputBuffer.getNumChannels();
 
     tempBuffer1.setSize(numChannels, numSamples, false, false, true);
     tempBuffer2.setSize(numChannels, numSamples, false, false, true);
     mixBuffer  .setSize(numChannels, numSamples, false, false, true);
 
-    tempBuffer1.clear();
-    tempBuffer2.clear();
-    mixBuffer.clear();
+    const auto& kernels = SimdKernels::get();
 
-    osc1.process(tempBuffer1);
-    osc2.process(tempBuffer2);
+    // A switched-off oscillator isn't rendered, only kept in phase
+    const bool ramping = osc1Level.isSmoothing() || osc2Level.isSmoothing();
+    const bool on1 = ramping || osc1Level.getTargetValue() > 0.0f;
+    const bool on2 = ramping || osc2Level.getTargetValue() > 0.0f;
 
-    for (int ch = 0; ch < numChannels; ++ch)
+    if (on1) osc1.process(tempBuffer1); else osc1.advance(numSamples);
+    if (on2) osc2.process(tempBuffer2); else osc2.advance(numSamples);
+
+    // The oscillators write the same signal to every channel, so mix once
+    // and copy after the drive stage.
     {
-        auto* dst = mixBuffer.getWritePointer(ch);
-        auto* o1  = tempBuffer1.getReadPointer(ch);
-        auto* o2  = tempBuffer2.getReadPointer(ch);
+        auto* dst = mixBuffer.getWritePointer(0);
+        auto* o1  = tempBuffer1.getReadPointer(0);
+        auto* o2  = tempBuffer2.getReadPointer(0);
+        const auto b = blend.next(numSamples);
+
+        if (ramping)
+            mixRamping(dst, o1, o2, b, numSamples);
+        else
+            kernels.mix[on1 ? 1 : 0][on2 ? 1 : 0](dst, o1, o2, b.start, b.step, level, numSamples);
+    }
 
-        for (int i = 0; i < numSamples; ++i)
-        {
-            float s1 = osc1On ? o1[i] : 0.0f;
-            float s2 = osc2On ? o2[i] : 0.0f;
+    EFFEM_PROFILE_LAP(oscillators);
 
-            // Absolute mute if gain is too low (prevents saw bleed)
-            if (std::abs(s1) < 1e-6f) s1 = 0.0f;
-            if (std::abs(s2) < 1e-6f) s2 = 0.0f;
+    // Drive sits between the mix and the filter and still runs mono
+    if (drive.isActive())
+        drive.process(mixBuffer.getWritePointer(0), numSamples);
 
-            float mixed = s1 * (1.0f - blend)
-                        + s2 * blend;
+    for (int ch = 1; ch < numChannels; ++ch)
+        mixBuffer.copyFrom(ch, 0, mixBuffer.getReadPointer(0), numSamples);
 
-            dst[i] = mixed * level;
-        }
-    }
+    EFFEM_PROFILE_LAP(drive);
 
     // Apply envelope
     adsr.applyEnvelopeToBuffer(mixBuffer, 0, numSamples);
 
+    EFFEM_PROFILE_LAP(envelope);
+
     // Filter
-    juce::dsp::AudioBlock<float> block(mixBuffer);
-    filter.process(juce::dsp::ProcessContextReplacing<float>(block));
+    filter.process(mixBuffer, numSamples);
+
+    EFFEM_PROFILE_LAP(filter);
+
+    if (cacheMode == CacheMode::recording)
+        recordIntoCache(numSamples);
+
+    const bool fadedOut = fadeOutRemaining > 0 && applyFadeOut(fadeOutRemaining, fadeOutLength, numChannels, numSamples);
 
     // Add to output buffer
     for (int ch = 0; ch < numChannels; ++ch)
     {
         auto* dst = outputBuffer.getWritePointer(ch, startSample);
-        auto* src = mixBuffer.getReadPointer(ch);
+        kernels.add(dst, mixBuffer.getReadPointer(ch), numSamples);
+    }
 
-        for (int i = 0; i < numSamples; ++i)
-            dst[i] += src[i];
+    EFFEM_PROFILE_LAP(voiceMix);
+    EFFEM_TRACE_END(tracer, voiceRender, traceTrack);
+
+    if (fadedOut)
+    {
+        finishNote();
     }
+    else if (noteCache != nullptr)
+    {
+        samplesPlayed += numSamples;
 
-    if (!adsr.isActive())
+        if (samplesPlayed >= oneShotSamples && mixBuffer.getMagnitude(0, 0, numSamples) < 1.0e-5f)
+            finishNote();
+    }
+    else if (!adsr.isActive())
     {
         isActive = false;
         clearCurrentNote();
     }
 }
+
+//==============================================================================
+void SynthVoice::renderFromCache(juce::AudioBuffer<float>& outputBuffer,
+                                 int startSample, int numSamples)
+{
+    EFFEM_PROFILE_LAP_START(profiler);
+
+    mixBuffer.setSize(outputBuffer.getNumChannels(), numSamples, false, false, true);
+
+    auto* mono = mixBuffer.getWritePointer(0);
+    const int n = noteCache->read(cacheEntry, cacheCursor, mono, numSamples);
+    samplesPlayed += n;
+
+    const bool released = releaseRemaining > 0 && applyFadeOut(releaseRemaining, releaseLength, 1, n);
+    const bool fadedOut = fadeOutRemaining > 0 && applyFadeOut(fadeOutRemaining, fadeOutLength, 1, n);
+
+    for (int ch = 0; ch < outputBuffer.getNumChannels(); ++ch)
+        outputBuffer.addFrom(ch, startSample, mono, n);
+
+    EFFEM_PROFILE_LAP(voiceMix);
+
+    if (n < numSamples || released || fadedOut)
+        finishNote();
+}
+
+void SynthVoice::recordIntoCache(int numSamples)
+{
+    // A patch change mid-note makes the rest of this render a different sound
+    if (noteCache->getPatch() != cacheKey.patch
+         || ! noteCache->append(cacheEntry, mixBuffer.getReadPointer(0), numSamples))
+        dropCacheEntry();
+}
+
+void SynthVoice::finishNote()
+{
+    if (cacheMode == CacheMode::recording)
+    {
+        noteCache->finishRecording(cacheEntry);
+        cacheEntry = -1;
+        cacheMode = CacheMode::off;
+    }
+
+    dropCacheEntry();
+    noteCache = nullptr;
+
+    adsr.reset();
+    isActive = false;
+    clearCurrentNote();
+}
+
+//==============================================================================
+void SynthVoice::fadeOut()
+{
+    if (!isActive || fadeOutRemaining > 0)
+        return;
+
+    // A truncated render isn't worth keeping
+    if (cacheMode == CacheMode::recording)
+        dropCacheEntry();
+
+    fadeOutLength = fadeOutRemaining = juce::jmax(1, juce::roundToInt(getSampleRate() * stealFadeSeconds));
+}
+
+// Ramps mixBuffer down; returns true once the fade has reached silence
+bool SynthVoice::applyFadeOut(int& remainingSamples, int length,
+                              int numChannels, int numSamples) noexcept
+{
+    const int start = remainingSamples;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* data = mixBuffer.getWritePointer(ch);
+        int remaining = start;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            data[i] *= (float) remaining / (float) length;
+            remaining = juce::jmax(0, remaining - 1);
+        }
+    }
+
+    remainingSamples = juce::jmax(0, start - numSamples);
+    return remainingSamples == 0;
+}
+
+void SynthVoice::dropCacheEntry()
+{
+    if (cacheEntry >= 0)
+        noteCache->release(cacheEntry);
+
+    cacheEntry = -1;
+    cacheMode = CacheMode::off;
+}
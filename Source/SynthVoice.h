@@ -11,6 +11,13 @@
 #include <juce_dsp/juce_dsp.h>
 #include "SynthSound.h"
 #include "Oscillator.h"
+#include "VoiceFilter.h"
+#include "Waveshaper.h"
+#include "EngineState.h"
+#include "StageProfiler.h"
+#include "TraceRecorder.h"
+#include "NoteRenderCache.h"
+#include "MemoryWarmup.h"
 
 class SynthVoice : public juce::SynthesiserVoice
 {
@@ -29,38 +36,118 @@ public:
 
     void prepare (double sampleRate, int samplesPerBlock, int numChannels);
 
+    // After prepare(): faults in the scratch buffers and runs every render
+    // kernel once on silence, then puts the voice back as prepare() left it
+    void warmUp (MemoryWarmup& memory, const WaveTableCache& tables);
+
     // ===== Runtime parameter updates =====
-    void updateFromParameters (float gain1, float pitchIndex1, float detune1,
-                               float gain2, float pitchIndex2, float detune2,
+    // Structural settings from the double-buffered engine state. Tables and
+    // filter type crossfade over crossfadeSamples; nothing is rebuilt here.
+    void applyEngineState (const EngineState& state, int crossfadeSamples);
+
+    // Continuous controls for the voice's part, at control rate. A voice
+    // moving to another part picks its controls from the table at note-on.
+    void setPartControls (const EngineState::Controls* table) { partControls = table; }
+    void updateControls (const EngineState::Controls&);
+
+    // Multitimbral part of the current or last note
+    int getPart() const noexcept { return part; }
+
+    // Continuous controls, once per block. Gains, detune, blend, cutoff and
+    // resonance ramp to each new value across the following block.
+    void updateFromParameters (float gain1, float detune1,
+                               float gain2, float detune2,
                                float blendAmount);
 
-    void updateEnvelope (float attack, float decay, float sustain, float release);
-    void updateFilter (float cutoff, float resonance, int type);
-    void updateOscillators (int wave1, int wave2, float blendAmount);
-    void updateOscOnOff (bool o1, bool o2);
+    void updateFilter (float cutoff, float resonance);
+    void updateDrive (float amount, int shape);
     void updateFM (float fm1Amount, float fm2Amount);
+    void updateWaveTablePosition (float position1, float position2);
+
+    void setProfiler (StageProfiler* p) { profiler = p; }
+    void setTraceRecorder (TraceRecorder* t, int track) { tracer = t; traceTrack = track; }
+
+    // Cache used by notes started from now on, or nullptr when the cache is
+    // off or the current patch can't be cached. Set once per block.
+    void setRenderCache (NoteRenderCache* c) { renderCache = c; }
+
+    // Ends the note with a short fade instead of a cut (polyphony limiting)
+    static constexpr double stealFadeSeconds = 0.005;
+    void fadeOut();
+    bool isFadingOut() const noexcept { return fadeOutRemaining > 0; }
 
 private:
     Oscillator osc1, osc2;
     juce::AudioBuffer<float> tempBuffer1, tempBuffer2, mixBuffer;
 
     juce::ADSR adsr;
-    juce::ADSR::Parameters adsrParams;
 
-    juce::dsp::StateVariableTPTFilter<float> filter;
-    juce::dsp::ProcessSpec filterSpec;
+    Waveshaper drive;
+    VoiceFilter filter;
+
+    StageProfiler* profiler = nullptr;
+    TraceRecorder* tracer = nullptr;
+    int traceTrack = 0;
 
     // voice state
     float baseFrequency = 440.0f;
+    const TuningTable* tuning = nullptr;   // owned by the current EngineState
     float level = 0.0f;
     bool isActive = false;
 
-    bool osc1On = true;
-    bool osc2On = true;
+    // on/off as a ramped level so toggling an oscillator doesn't click
+    juce::SmoothedValue<float> osc1Level { 1.0f }, osc2Level { 1.0f };
+
+    float pitchRatio1 = 1.0f, pitchRatio2 = 1.0f;
+    float detuneRatio1 = 1.0f, detuneRatio2 = 1.0f;
+
+    void updateFrequencies();
+    void applyPart (const EngineState::Part&, int crossfadeSamples);
+
+    int part = 0;
+    const EngineState* engine = nullptr;                   // the last state applied
+    const EngineState::Controls* partControls = nullptr;   // one per part
+
+    // Mix while an on/off level ramps; steady states use SimdKernels::mix
+    void mixRamping (float* dst, const float* o1, const float* o2,
+                     ParameterRamp<float>::Segment blendSegment, int numSamples) noexcept;
+
+    // ===== Note render cache =====
+    // A cached note is a one-shot: held, it ends once the envelope has
+    // decayed and the output has gone silent. Note-off during the attack or
+    // decay changes the output, so a recording note stops recording and
+    // carries on live, and a note playing from the cache releases what's
+    // left of its render over the envelope's release. Past the decay the
+    // envelope is at zero and note-off ends the note, as it does uncached.
+    enum class CacheMode
+    {
+        off,
+        recording,
+        playing
+    };
+
+    void renderFromCache (juce::AudioBuffer<float>&, int startSample, int numSamples);
+    void recordIntoCache (int numSamples);
+    void finishNote();     // commits a one-shot's recording
+    bool applyFadeOut (int& remaining, int length, int numChannels, int numSamples) noexcept;
+    void dropCacheEntry();
+
+    NoteRenderCache* renderCache = nullptr;
+    NoteRenderCache* noteCache = nullptr;      // the cache the current note uses
+    CacheMode cacheMode = CacheMode::off;
+    NoteRenderCache::Key cacheKey;
+    NoteRenderCache::Cursor cacheCursor;
+    int cacheEntry = -1;
+    juce::int64 oneShotSamples = 0;            // attack + decay
+    juce::int64 samplesPlayed = 0;
+    float envelopeSeconds = 0.0f;
+
+    int fadeOutRemaining = 0, fadeOutLength = 0;
+    int releaseRemaining = 0, releaseLength = 0;   // a cached note's note-off
 
     float fm1 = 0.0f;
     float fm2 = 0.0f;
-    float blend = 0.5f;
+    ParameterRamp<float> blend { 0.5f };
 };
 
 #endif //EFFEM_UNIT_SYNTHVOICE_H
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "TraceRecorder.h"
+
+//==============================================================================
+const char* TraceRecorder::getEventName (int name)
+{
+    switch (name)
+    {
+        case processBlock: return "processBlock";
+        case params:       return "params";
+        case midi:         return "midi";
+        case voiceRender:  return "voice";
+        case xrun:         return "xrun";
+        default:           break;
+    }
+    return "";
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+//==============================================================================
+bool TraceRecorder::start (const juce::File& outputFile)
+{
+    stop();
+
+    auto newStream = std::make_unique<juce::FileOutputStream> (outputFile);
+
+    if (! newStream->openedOk())
+        return false;
+
+    newStream->setPosition (0);
+    newStream->truncate();
+
+    // The ring is kept for the lifetime of the recorder, so the audio thread
+    // can never see it disappear under it.
+    if (ring == nullptr)
+    {
+        ring = std::make_unique<Event[]> ((size_t) ringSize);
+        fifo = std::make_unique<juce::AbstractFifo> (ringSize);
+    }
+
+    stream = std::move (newStream);
+    *stream << "[\n";
+    firstEvent = true;
+    dropped.store (0);
+    startNanos = now();
+
+    writer = std::make_unique<Writer> (*this);
+    writer->startThread (juce::Thread::Priority::low);
+
+    recording.store (true, std::memory_order_release);
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if (! recording.exchange (false))
+        return;
+
+    writer->signalThreadShouldExit();
+    writer->notify();
+    writer->stopThread (2000);
+    writer.reset();
+
+    drain (*stream);
+    *stream << "\n]\n";
+    stream->flush();
+    stream.reset();
+}
+
+//==============================================================================
+void TraceRecorder::prepare (double newSampleRate)
+{
+    sampleRate = newSampleRate;
+}
+
+void TraceRecorder::push (char phase, Name name, int track,
+                          juce::int32 arg0, juce::int32 arg1) noexcept
+{
+    if (! recording.load (std::memory_order_acquire))
+        return;
+
+    const auto scope = fifo->write (1);
+
+    if (scope.blockSize1 + scope.blockSize2 == 0)
+    {
+        dropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& e = ring[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+    e.timeNanos = now();
+    e.arg0      = arg0;
+    e.arg1      = arg1;
+    e.track     = (juce::uint16) track;
+    e.name      = name;
+    e.phase     = phase;
+}
+
+void TraceRecorder::beginCallback() noexcept
+{
+    callbackStartNanos = now();
+    begin (processBlock);
+}
+
+void TraceRecorder::endCallback (int numSamples) noexcept
+{
+    end (processBlock);
+
+    const auto elapsedMicros  = (now() - callbackStartNanos) / 1000;
+    const auto deadlineMicros = (juce::int64) ((double) numSamples * 1.0e6 / sampleRate);
+
+    if (elapsedMicros > deadlineMicros)
+        instant (xrun, 0, (juce::int32) elapsedMicros, (juce::int32) deadlineMicros);
+}
+
+//==============================================================================
+void TraceRecorder::Writer::run()
+{
+    while (! threadShouldExit())
+    {
+        owner.drain (*owner.stream);
+        wait (50);
+    }
+}
+
+void TraceRecorder::drain (juce::OutputStream& out)
+{
+    const auto scope = fifo->read (fifo->getNumReady());
+
+    auto writeRange = [&] (int start, int size)
+    {
+        for (int i = start; i < start + size; ++i)
+        {
+            const auto& e = ring[(size_t) i];
+
+            // Stragglers from before this recording started
+            if (e.timeNanos < startNanos)
+                continue;
+
+            if (! firstEvent)
+                out << ",\n";
+
+            firstEvent = false;
+
+            out << "{\"name\":\"" << getEventName (e.name) << "\""
+                << ",\"ph\":\"" << juce::String::charToString (e.phase) << "\""
+                << ",\"ts\":" << juce::String ((double) (e.timeNanos - startNanos) * 1.0e-3, 3)
+                << ",\"pid\":1,\"tid\":" << (int) e.track;
+
+            if (e.phase == 'i')
+                out << ",\"s\":\"g\"";
+
+            if (e.name == xrun)
+                out << ",\"args\":{\"elapsed_us\":" << e.arg0 << ",\"deadline_us\":" << e.arg1 << "}";
+            else if (e.phase == 'B' && e.arg0 != 0)
+                out << ",\"args\":{\"value\":" << e.arg0 << "}";
+
+            out << "}";
+        }
+    };
+
+    writeRange (scope.startIndex1, scope.blockSize1);
+    writeRange (scope.startIndex2, scope.blockSize2);
+}
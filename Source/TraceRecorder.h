@@ -0,0 +1,124 @@
+#ifndef EFFEM_UNIT_TRACERECORDER_H
+#define EFFEM_UNIT_TRACERECORDER_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <chrono>
+
+// Compile-time switch for the callback tracer. Configure with -DEFFEM_TRACING=ON
+// to build it in; when it is 0 the EFFEM_TRACE_* macros expand to nothing.
+#ifndef EFFEM_TRACING
+ #define EFFEM_TRACING 0
+#endif
+
+//==============================================================================
+// Records begin/end/instant events from the audio thread into a preallocated
+// single-producer ring. A background thread drains it into a Chrome trace-event
+// JSON file (chrome://tracing, ui.perfetto.dev).
+//
+// Tracks map to trace "threads": track 0 is processBlock, voices use 1 + index.
+class TraceRecorder
+{
+public:
+    enum Name : juce::uint8
+    {
+        processBlock = 0,
+        params,
+        midi,
+        voiceRender,
+        xrun,
+        numNames
+    };
+
+    static const char* getEventName (int name);
+
+    TraceRecorder() = default;
+    ~TraceRecorder();
+
+    // ===== Message thread =====
+    // Allocates the ring on first use and starts the writer thread.
+    bool start (const juce::File& outputFile);
+    void stop();
+    bool isRecording() const noexcept { return recording.load (std::memory_order_relaxed); }
+
+    // Events lost because the ring was full
+    int getDroppedEventCount() const noexcept { return dropped.load (std::memory_order_relaxed); }
+
+    // ===== Audio thread =====
+    void prepare (double sampleRate);
+
+    void begin (Name name, int track = 0, juce::int32 arg = 0) noexcept   { push ('B', name, track, arg, 0); }
+    void end (Name name, int track = 0) noexcept                            { push ('E', name, track, 0, 0); }
+    void instant (Name name, int track, juce::int32 arg0, juce::int32 arg1) noexcept { push ('i', name, track, arg0, arg1); }
+
+    // Open/close the processBlock span. A callback that took longer than the
+    // audio it produced is flagged with an xrun instant event.
+    void beginCallback() noexcept;
+    void endCallback (int numSamples) noexcept;
+
+    static juce::int64 now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds> (
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct Event
+    {
+        juce::int64 timeNanos;
+        juce::int32 arg0, arg1;
+        juce::uint16 track;
+        Name name;
+        char phase;
+    };
+
+    static constexpr int ringSize = 1 << 16;
+
+    void push (char phase, Name name, int track, juce::int32 arg0, juce::int32 arg1) noexcept;
+
+    //==============================================================================
+    class Writer : public juce::Thread
+    {
+    public:
+        explicit Writer (TraceRecorder& o) : juce::Thread ("EFFEM trace writer"), owner (o) {}
+        void run() override;
+
+    private:
+        TraceRecorder& owner;
+    };
+
+    void drain (juce::OutputStream& out);
+
+    std::unique_ptr<Event[]> ring;
+    std::unique_ptr<juce::AbstractFifo> fifo;
+    std::unique_ptr<Writer> writer;
+    std::unique_ptr<juce::FileOutputStream> stream;
+
+    std::atomic<bool> recording { false };
+    std::atomic<int> dropped { 0 };
+
+    juce::int64 startNanos = 0;
+    juce::int64 callbackStartNanos = 0;
+    double sampleRate = 44100.0;
+    bool firstEvent = true;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TraceRecorder)
+};
+
+#if EFFEM_TRACING
+ #define EFFEM_TRACE_BEGIN(recorder, name, track, arg) \
+    do { if ((recorder) != nullptr) (recorder)->begin (TraceRecorder::name, track, arg); } while (false)
+ #define EFFEM_TRACE_END(recorder, name, track) \
+    do { if ((recorder) != nullptr) (recorder)->end (TraceRecorder::name, track); } while (false)
+ #define EFFEM_TRACE_BEGIN_CALLBACK(recorder)             (recorder).beginCallback()
+ #define EFFEM_TRACE_END_CALLBACK(recorder, numSamples)   (recorder).endCallback (numSamples)
+#else
+ #define EFFEM_TRACE_BEGIN(recorder, name, track, arg)
+ #define EFFEM_TRACE_END(recorder, name, track)
+ #define EFFEM_TRACE_BEGIN_CALLBACK(recorder)
+ #define EFFEM_TRACE_END_CALLBACK(recorder, numSamples)
+#endif
+
+#endif //EFFEM_UNIT_TRACERECORDER_H
@@ -0,0 +1,51 @@
+#ifndef EFFEM_UNIT_TRIPLEBUFFER_H
+#define EFFEM_UNIT_TRIPLEBUFFER_H
+
+#pragma once
+
+#include <array>
+#include <atomic>
+
+//==============================================================================
+// Lock-free single-producer / single-consumer triple buffer.
+//
+// The producer fills getWriteBuffer() and calls publish(); the consumer calls
+// fetch() and, if it returns true, reads the newest complete value from
+// getReadBuffer(). Neither side ever waits, and the reader never sees a
+// half-written value.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // ===== Producer =====
+    T& getWriteBuffer() noexcept { return buffers[(size_t) backIndex]; }
+
+    void publish() noexcept
+    {
+        backIndex = middle.exchange (backIndex | freshBit, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // ===== Consumer =====
+    // Returns false if nothing new has been published since the last fetch.
+    bool fetch() noexcept
+    {
+        if ((middle.load (std::memory_order_relaxed) & freshBit) == 0)
+            return false;
+
+        frontIndex = middle.exchange (frontIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T& getReadBuffer() const noexcept { return buffers[(size_t) frontIndex]; }
+
+private:
+    static constexpr int freshBit  = 4;
+    static constexpr int indexMask = 3;
+
+    std::array<T, 3> buffers {};
+    std::atomic<int> middle { 1 };
+    int backIndex = 0;    // producer only
+    int frontIndex = 2;   // consumer only
+};
+
+#endif //EFFEM_UNIT_TRIPLEBUFFER_H
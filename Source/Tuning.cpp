@@ -0,0 +1,233 @@
+#include "Tuning.h"
+
+namespace
+{
+    // Non-comment lines; Scala comments start with '!' in the first column
+    juce::StringArray getContentLines (const juce::String& text)
+    {
+        juce::StringArray lines, result;
+        lines.addLines (text);
+
+        for (auto& line : lines)
+            if (! line.startsWithChar ('!'))
+                result.add (line.trim());
+
+        return result;
+    }
+
+    // Anything after the first whitespace is a comment
+    juce::String firstToken (const juce::String& line)
+    {
+        return line.upToFirstOccurrenceOf (" ", false, false)
+                   .upToFirstOccurrenceOf ("\t", false, false);
+    }
+
+    bool isInteger (const juce::String& s)
+    {
+        const auto digits = s.startsWithChar ('-') || s.startsWithChar ('+') ? s.substring (1) : s;
+        return digits.isNotEmpty() && digits.containsOnly ("0123456789");
+    }
+
+    bool isNumber (const juce::String& s)
+    {
+        const auto digits = s.startsWithChar ('-') || s.startsWithChar ('+') ? s.substring (1) : s;
+        return digits.isNotEmpty() && digits.containsOnly ("0123456789.") && digits.indexOfChar ('.') == digits.lastIndexOfChar ('.');
+    }
+
+    int floorDiv (int a, int b) noexcept
+    {
+        const int q = a / b;
+        return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+    }
+}
+
+//==============================================================================
+std::shared_ptr<const TuningTable> TuningTable::createEqualTemperament()
+{
+    auto t = std::make_shared<TuningTable>();
+    t->name = "12-TET";
+
+    for (int n = 0; n < numNotes; ++n)
+        t->frequencies[(size_t) n] = 440.0 * std::pow (2.0, (n - 69) / 12.0);
+
+    return t;
+}
+
+//==============================================================================
+juce::Result ScalaTuning::parseScale (const juce::String& text, Scale& result)
+{
+    const auto lines = getContentLines (text);
+
+    if (lines.size() < 2)
+        return juce::Result::fail ("Scale file is missing its description or note count");
+
+    result.description = lines[0];
+    result.cents.clear();
+
+    const auto count = firstToken (lines[1]);
+
+    if (! isInteger (count) || count.getIntValue() <= 0)
+        return juce::Result::fail ("Invalid note count: " + lines[1]);
+
+    const int numNotes = count.getIntValue();
+
+    for (int i = 2; i < lines.size() && (int) result.cents.size() < numNotes; ++i)
+    {
+        const auto token = firstToken (lines[i]);
+
+        if (token.isEmpty())
+            continue;
+
+        double cents = 0.0;
+
+        // A period makes it cents, anything else is a ratio or an integer
+        if (token.containsChar ('.'))
+        {
+            if (! isNumber (token))
+                return juce::Result::fail ("Invalid pitch: " + lines[i]);
+
+            cents = token.getDoubleValue();
+        }
+        else
+        {
+            const auto num = token.upToFirstOccurrenceOf ("/", false, false);
+            const auto den = token.containsChar ('/') ? token.fromFirstOccurrenceOf ("/", false, false) : juce::String ("1");
+
+            if (! isInteger (num) || ! isInteger (den) || num.getLargeIntValue() <= 0 || den.getLargeIntValue() <= 0)
+                return juce::Result::fail ("Invalid pitch: " + lines[i]);
+
+            cents = 1200.0 * std::log2 ((double) num.getLargeIntValue() / (double) den.getLargeIntValue());
+        }
+
+        result.cents.push_back (cents);
+    }
+
+    if ((int) result.cents.size() != numNotes)
+        return juce::Result::fail ("Scale file lists fewer notes than its note count");
+
+    return juce::Result::ok();
+}
+
+juce::Result ScalaTuning::parseKeyboardMap (const juce::String& text, KeyboardMap& result)
+{
+    juce::StringArray tokens;
+
+    for (auto& line : getContentLines (text))
+        if (line.isNotEmpty())
+            tokens.add (firstToken (line));
+
+    if (tokens.size() < 7)
+        return juce::Result::fail ("Keyboard mapping header is incomplete");
+
+    for (int i = 0; i < 7; ++i)
+        if (i == 5 ? ! isNumber (tokens[i]) : ! isInteger (tokens[i]))
+            return juce::Result::fail ("Invalid keyboard mapping value: " + tokens[i]);
+
+    result.size               = tokens[0].getIntValue();
+    result.firstNote          = tokens[1].getIntValue();
+    result.lastNote           = tokens[2].getIntValue();
+    result.middleNote         = tokens[3].getIntValue();
+    result.referenceNote      = tokens[4].getIntValue();
+    result.referenceFrequency = tokens[5].getDoubleValue();
+    result.octaveDegree       = tokens[6].getIntValue();
+
+    if (result.size < 0 || result.referenceFrequency <= 0.0 || result.octaveDegree < 0)
+        return juce::Result::fail ("Invalid keyboard mapping header");
+
+    // Missing trailing entries are unmapped
+    result.mapping.assign ((size_t) result.size, -1);
+
+    for (int i = 0; i < result.size && 7 + i < tokens.size(); ++i)
+    {
+        const auto& entry = tokens[7 + i];
+
+        if (entry.equalsIgnoreCase ("x"))
+            continue;
+
+        if (! isInteger (entry) || entry.getIntValue() < 0)
+            return juce::Result::fail ("Invalid keyboard mapping entry: " + entry);
+
+        result.mapping[(size_t) i] = entry.getIntValue();
+    }
+
+    return juce::Result::ok();
+}
+
+//==============================================================================
+juce::Result ScalaTuning::compile (const Scale& scale, const KeyboardMap& map, TuningTable& result)
+{
+    const int numDegrees = (int) scale.cents.size();
+
+    if (numDegrees == 0)
+        return juce::Result::fail ("Scale has no notes");
+
+    const double period = scale.cents.back();
+    const int octaveDegree = map.octaveDegree > 0 ? map.octaveDegree : numDegrees;
+
+    auto centsOf = [&] (int degree)
+    {
+        const int octave = floorDiv (degree, numDegrees);
+        const int index  = degree - octave * numDegrees;
+
+        return (index == 0 ? 0.0 : scale.cents[(size_t) index - 1]) + octave * period;
+    };
+
+    // Scale degree played by a key, or false if the key is unmapped
+    auto degreeOf = [&] (int note, int& degree)
+    {
+        const int offset = note - map.middleNote;
+
+        if (map.size == 0)
+        {
+            degree = offset;
+            return true;
+        }
+
+        const int repeat = floorDiv (offset, map.size);
+        const int mapped = map.mapping[(size_t) (offset - repeat * map.size)];
+
+        if (mapped < 0)
+            return false;
+
+        degree = mapped + repeat * octaveDegree;
+        return true;
+    };
+
+    int referenceDegree = 0;
+
+    if (! degreeOf (map.referenceNote, referenceDegree))
+        return juce::Result::fail ("The reference note is not mapped");
+
+    const double referenceCents = centsOf (referenceDegree);
+
+    for (int note = 0; note < TuningTable::numNotes; ++note)
+    {
+        int degree = 0;
+        double frequency = 0.0;
+
+        if (note >= map.firstNote && note <= map.lastNote && degreeOf (note, degree))
+            frequency = map.referenceFrequency * std::pow (2.0, (centsOf (degree) - referenceCents) / 1200.0);
+
+        result.frequencies[(size_t) note] = frequency;
+    }
+
+    result.name = scale.description;
+    return juce::Result::ok();
+}
+
+juce::Result ScalaTuning::build (const juce::String& scaleText, const juce::String& keyboardMapText,
+                                 TuningTable& result)
+{
+    Scale scale;
+    KeyboardMap map;
+
+    auto r = parseScale (scaleText, scale);
+
+    if (r.wasOk() && keyboardMapText.isNotEmpty())
+        r = parseKeyboardMap (keyboardMapText, map);
+
+    if (r.wasOk())
+        r = compile (scale, map, result);
+
+    return r;
+}
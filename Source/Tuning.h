@@ -0,0 +1,76 @@
+#ifndef EFFEM_UNIT_TUNING_H
+#define EFFEM_UNIT_TUNING_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// MIDI note -> frequency, compiled once and then only read. A frequency of 0
+// marks a key the keyboard mapping leaves unmapped; those keys don't sound.
+struct TuningTable
+{
+    static constexpr int numNotes = 128;
+
+    std::array<double, numNotes> frequencies {};
+    juce::String name;
+
+    // Unique to each table constructed in this process (a copy keeps it), so
+    // it can stand for the contents once the table is shared. Never 0.
+    const juce::uint64 id = nextId();
+
+    static juce::uint64 nextId() noexcept
+    {
+        static std::atomic<juce::uint64> counter { 0 };
+        return ++counter;
+    }
+
+    double getFrequency (int midiNote) const noexcept
+    {
+        return juce::isPositiveAndBelow (midiNote, numNotes) ? frequencies[(size_t) midiNote] : 0.0;
+    }
+
+    // A4 = 440 Hz, identical to juce::MidiMessage::getMidiNoteInHertz
+    static std::shared_ptr<const TuningTable> createEqualTemperament();
+};
+
+//==============================================================================
+// Scala scale (.scl) and keyboard mapping (.kbm) files.
+// See https://www.huygens-fokker.org/scala/scl_format.html
+class ScalaTuning
+{
+public:
+    struct Scale
+    {
+        juce::String description;
+        std::vector<double> cents;   // degrees 1..N; the last one is the period
+    };
+
+    // Defaults are the linear mapping with degree 0 on middle C at its
+    // 12-TET pitch, so a 12-note equal scale reproduces standard tuning.
+    struct KeyboardMap
+    {
+        int size = 0;                       // 0 = every key is the next degree
+        int firstNote = 0, lastNote = 127;
+        int middleNote = 60;                // key that plays degree 0
+        int referenceNote = 60;
+        double referenceFrequency = 261.6255653005986;
+        int octaveDegree = 0;               // formal octave; 0 = the scale's period
+        std::vector<int> mapping;           // degree per key, -1 = unmapped
+    };
+
+    static juce::Result parseScale (const juce::String& text, Scale& result);
+    static juce::Result parseKeyboardMap (const juce::String& text, KeyboardMap& result);
+
+    static juce::Result compile (const Scale&, const KeyboardMap&, TuningTable& result);
+
+    // Parses and compiles; an empty keyboard map text means the default map.
+    static juce::Result build (const juce::String& scaleText, const juce::String& keyboardMapText,
+                               TuningTable& result);
+};
+
+#endif //EFFEM_UNIT_TUNING_H
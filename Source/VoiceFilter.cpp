@@ -0,0 +1,444 @@
+#include "VoiceFilter.h"
+
+//==============================================================================
+namespace
+{
+    // Padé approximant of tanh, reaching exactly +-1 at +-3
+    inline float fastTanh (float x) noexcept
+    {
+        x = juce::jlimit (-3.0f, 3.0f, x);
+        const float x2 = x * x;
+        return x * (27.0f + x2) / (27.0f + 9.0f * x2);
+    }
+
+    constexpr float maxLadderFeedback = 3.9f;   // self-oscillates at 4
+    constexpr float maxCombFeedback = 0.98f;
+
+    // A, E, I, O, U: formant frequencies of an adult male voice (Hz)
+    constexpr int numVowels = 5;
+    constexpr float vowels[numVowels][3] =
+    {
+        { 730.0f, 1090.0f, 2440.0f },
+        { 530.0f, 1840.0f, 2480.0f },
+        { 270.0f, 2290.0f, 3010.0f },
+        { 570.0f,  840.0f, 2410.0f },
+        { 300.0f,  870.0f, 2240.0f }
+    };
+
+    constexpr float formantLevels[3] = { 1.0f, 0.5f, 0.25f };
+
+    // Each band's 1/Q relative to the filter's, so higher formants are narrower
+    constexpr float formantWidths[3] = { 0.125f, 0.094f, 0.075f };
+}
+
+//==============================================================================
+void VoiceFilter::prepare (double newSampleRate, int samplesPerBlock, int numChannels)
+{
+    sampleRate = newSampleRate;
+
+    for (auto* r : { &gRamp, &R2Ramp, &amountRamp, &delayRamp })
+        r->setRampLength (samplesPerBlock);
+
+    for (auto& r : formantGRamps)
+        r.setRampLength (samplesPerBlock);
+
+    s1.assign ((size_t) numChannels, 0.0f);
+    s2.assign ((size_t) numChannels, 0.0f);
+    ladderState.assign ((size_t) numChannels * 4, 0.0f);
+    formantState.assign ((size_t) numChannels * 2 * numFormants, 0.0f);
+
+    // The longest delay is one period at minCombHz; the ring wraps with a mask
+    combSize = juce::nextPowerOfTwo ((int) std::ceil (sampleRate / minCombHz) + 2);
+    combLines.assign ((size_t) combSize * (size_t) numChannels, 0.0f);
+    combWrite = 0;
+
+    fadeScratch.assign ((size_t) samplesPerBlock, 0.0f);
+
+    updateCoefficients();
+    finishRamps();
+}
+
+void VoiceFilter::warmUp (MemoryWarmup& memory)
+{
+    memory.add (s1);
+    memory.add (s2);
+    memory.add (ladderState);
+    memory.add (formantState);
+    memory.add (combLines);
+    memory.add (fadeScratch);
+}
+
+void VoiceFilter::reset()
+{
+    for (int t : { lowpass, ladder, formant, comb })
+        clearState (t);
+
+    fadeRemaining = 0;
+    finishRamps();
+}
+
+void VoiceFilter::finishRamps() noexcept
+{
+    for (auto* r : { &gRamp, &R2Ramp, &amountRamp, &delayRamp })
+        r->finish();
+
+    for (auto& r : formantGRamps)
+        r.finish();
+}
+
+void VoiceFilter::clearState (int model) noexcept
+{
+    auto clear = [] (std::vector<float>& v) { std::fill (v.begin(), v.end(), 0.0f); };
+
+    switch (model)
+    {
+        case ladder:   clear (ladderState); break;
+        case formant:  clear (formantState); break;
+        case comb:     clear (combLines); break;
+        default:       clear (s1); clear (s2); break;
+    }
+}
+
+void VoiceFilter::setCutoffFrequency (float hz)
+{
+    if (hz != cutoff)
+    {
+        cutoff = hz;
+        updateCoefficients();
+    }
+}
+
+void VoiceFilter::setResonance (float newResonance)
+{
+    if (newResonance != resonance)
+    {
+        resonance = newResonance;
+        updateCoefficients();
+    }
+}
+
+void VoiceFilter::setType (int newType, int crossfadeSamples)
+{
+    if (newType == type)
+        return;
+
+    // A model that wasn't running holds whatever it had when it stopped
+    if (! (isStateVariable (newType) && isStateVariable (type)))
+        clearState (newType);
+
+    fadeFromType = type;
+    type = newType;
+    fadeLength = fadeRemaining = juce::jmax (0, crossfadeSamples);
+}
+
+void VoiceFilter::updateCoefficients() noexcept
+{
+    const auto pi = juce::MathConstants<double>::pi;
+
+    gRamp .setTarget ((float) std::tan (pi * (double) cutoff / sampleRate));
+    R2Ramp.setTarget (1.0f / resonance);
+
+    // The Resonance parameter's 0.1 - 1.5 as 0..1
+    amountRamp.setTarget (juce::jlimit (0.0f, 1.0f, (resonance - 0.1f) / 1.4f));
+
+    delayRamp.setTarget ((float) sampleRate / juce::jlimit (minCombHz, (float) sampleRate * 0.25f, cutoff));
+
+    // The cutoff's 20 Hz - 20 kHz, log scaled, morphs through the vowels
+    const float position = juce::jlimit (0.0f, 1.0f, std::log2 (juce::jmax (cutoff, 1.0f) / 20.0f) / std::log2 (1000.0f))
+                         * (float) (numVowels - 1);
+    const int v = juce::jmin ((int) position, numVowels - 2);
+    const float frac = position - (float) v;
+
+    for (int f = 0; f < numFormants; ++f)
+    {
+        const double hz = vowels[v][f] + frac * (vowels[v + 1][f] - vowels[v][f]);
+        formantGRamps[(size_t) f].setTarget ((float) std::tan (pi * juce::jmin (hz, 0.45 * sampleRate) / sampleRate));
+    }
+}
+
+//==============================================================================
+const VoiceFilter::Kernel VoiceFilter::kernels[2][numTypes] =
+{
+    { &VoiceFilter::processChannel<lowpass,  false>,
+      &VoiceFilter::processChannel<highpass, false>,
+      &VoiceFilter::processChannel<bandpass, false>,
+      &VoiceFilter::processLadder<false>,
+      &VoiceFilter::processFormant<false>,
+      &VoiceFilter::processComb<false> },
+    { &VoiceFilter::processChannel<lowpass,  true>,
+      &VoiceFilter::processChannel<highpass, true>,
+      &VoiceFilter::processChannel<bandpass, true>,
+      &VoiceFilter::processLadder<true>,
+      &VoiceFilter::processFormant<true>,
+      &VoiceFilter::processComb<true> }
+};
+
+void VoiceFilter::process (juce::AudioBuffer<float>& buffer, int numSamples)
+{
+    const int numChannels = juce::jmin (buffer.getNumChannels(), (int) s1.size());
+    const int fadeAtStart = fadeRemaining;
+
+    g      = gRamp.next (numSamples);
+    R2     = R2Ramp.next (numSamples);
+    amount = amountRamp.next (numSamples);
+    delay  = delayRamp.next (numSamples);
+
+    bool ramping = g.step != 0.0f || R2.step != 0.0f || amount.step != 0.0f || delay.step != 0.0f;
+
+    for (size_t f = 0; f < (size_t) numFormants; ++f)
+    {
+        formantG[f] = formantGRamps[f].next (numSamples);
+        ramping = ramping || formantG[f].step != 0.0f;
+    }
+
+    if (! ramping)
+        h = 1.0f / (1.0f + R2.start * g.start + g.start * g.start);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* data = buffer.getWritePointer (ch);
+
+        if (fadeAtStart <= 0)
+            (this->*kernels[ramping ? 1 : 0][type]) (data, ch, numSamples);
+        else if (isStateVariable (type) && isStateVariable (fadeFromType))
+            processCrossfade (data, ch, numSamples, fadeAtStart);
+        else
+            processModelCrossfade (data, ch, numSamples, fadeAtStart, ramping);
+    }
+
+    combWrite = (combWrite + numSamples) & (combSize - 1);
+
+    if (fadeAtStart > 0)
+        fadeRemaining = juce::jmax (0, fadeAtStart - numSamples);
+}
+
+template <int responseType, bool ramping>
+void VoiceFilter::processChannel (float* data, int channel, int numSamples) noexcept
+{
+    float z1 = s1[(size_t) channel];
+    float z2 = s2[(size_t) channel];
+
+    float gi = g.start, R2i = R2.start, hi = h;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        if constexpr (ramping)
+        {
+            gi  = g.at (i);
+            R2i = R2.at (i);
+            hi  = 1.0f / (1.0f + R2i * gi + gi * gi);
+        }
+
+        const float yHP = hi * (data[i] - z1 * (gi + R2i) - z2);
+        const float yBP = yHP * gi + z1;
+        z1 = yHP * gi + yBP;
+        const float yLP = yBP * gi + z2;
+        z2 = yBP * gi + yLP;
+
+        if constexpr (responseType == lowpass)        data[i] = yLP;
+        else if constexpr (responseType == highpass)  data[i] = yHP;
+        else                                          data[i] = yBP;
+    }
+
+    s1[(size_t) channel] = z1;
+    s2[(size_t) channel] = z2;
+}
+
+// Four TPT one-poles, y = G x + (1 - G) z each, in a feedback loop. The
+// loop's output is G^4 u + S with S what the states alone contribute, so the
+// input u = x - k y4 solves to (x - k S) / (1 + k G^4) without a delay; the
+// tanh then saturates it before the stages.
+template <bool ramping>
+void VoiceFilter::processLadder (float* data, int channel, int numSamples) noexcept
+{
+    auto* state = ladderState.data() + 4 * (size_t) channel;
+    float z1 = state[0], z2 = state[1], z3 = state[2], z4 = state[3];
+
+    float G = 0.0f, k = 0.0f, norm = 0.0f;
+
+    const auto coefficients = [&] (int i)
+    {
+        const float gi = g.at (i);
+        G = gi / (1.0f + gi);
+        k = amount.at (i) * maxLadderFeedback;
+
+        const float G2 = G * G;
+        norm = 1.0f / (1.0f + k * G2 * G2);
+    };
+
+    if constexpr (! ramping)
+        coefficients (0);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        if constexpr (ramping)
+            coefficients (i);
+
+        const float S = (1.0f - G) * (((z1 * G + z2) * G + z3) * G + z4);
+        const float u = fastTanh ((data[i] - k * S) * norm);
+
+        float v = (u - z1) * G;
+        const float y1 = v + z1;
+        z1 = y1 + v;
+
+        v = (y1 - z2) * G;
+        const float y2 = v + z2;
+        z2 = y2 + v;
+
+        v = (y2 - z3) * G;
+        const float y3 = v + z3;
+        z3 = y3 + v;
+
+        v = (y3 - z4) * G;
+        const float y4 = v + z4;
+        z4 = y4 + v;
+
+        // Gives back some of the passband level the feedback takes
+        data[i] = y4 * (1.0f + 0.5f * k);
+    }
+
+    state[0] = z1; state[1] = z2; state[2] = z3; state[3] = z4;
+}
+
+// Three state variable bandpasses in parallel. R2 * the bandpass output
+// peaks at unity, so each band's level is its formant's.
+template <bool ramping>
+void VoiceFilter::processFormant (float* data, int channel, int numSamples) noexcept
+{
+    auto* state = formantState.data() + 2 * numFormants * (size_t) channel;
+
+    float z1[numFormants], z2[numFormants];
+    float gf[numFormants], R[numFormants], hf[numFormants];
+
+    for (int f = 0; f < numFormants; ++f)
+    {
+        z1[f] = state[2 * f];
+        z2[f] = state[2 * f + 1];
+    }
+
+    const auto coefficients = [&] (int i)
+    {
+        const float r2 = R2.at (i);
+
+        for (int f = 0; f < numFormants; ++f)
+        {
+            gf[f] = formantG[(size_t) f].at (i);
+            R[f]  = formantWidths[f] * r2;
+            hf[f] = 1.0f / (1.0f + R[f] * gf[f] + gf[f] * gf[f]);
+        }
+    };
+
+    if constexpr (! ramping)
+        coefficients (0);
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        if constexpr (ramping)
+            coefficients (i);
+
+        const float x = data[i];
+        float out = 0.0f;
+
+        for (int f = 0; f < numFormants; ++f)
+        {
+            const float yHP = hf[f] * (x - z1[f] * (gf[f] + R[f]) - z2[f]);
+            const float yBP = yHP * gf[f] + z1[f];
+            z1[f] = yHP * gf[f] + yBP;
+            const float yLP = yBP * gf[f] + z2[f];
+            z2[f] = yBP * gf[f] + yLP;
+
+            out += formantLevels[f] * R[f] * yBP;
+        }
+
+        data[i] = out;
+    }
+
+    for (int f = 0; f < numFormants; ++f)
+    {
+        state[2 * f]     = z1[f];
+        state[2 * f + 1] = z2[f];
+    }
+}
+
+// y[n] = x[n] + fb * y[n - D], D fractional (linear interpolation), scaled by
+// 1 - fb so the peaks sit at unity
+template <bool ramping>
+void VoiceFilter::processComb (float* data, int channel, int numSamples) noexcept
+{
+    auto* line = combLines.data() + (size_t) combSize * (size_t) channel;
+    const int mask = combSize - 1;
+
+    float d = delay.start, fb = amount.start * maxCombFeedback;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        if constexpr (ramping)
+        {
+            d  = delay.at (i);
+            fb = amount.at (i) * maxCombFeedback;
+        }
+
+        // D >= 4, so both taps were written before this sample
+        const int w = (combWrite + i) & mask;
+        const float pos = (float) (w + combSize) - d;
+        const int tap = (int) pos;
+        const float frac = pos - (float) tap;
+
+        const float a = line[tap & mask];
+        const float delayed = a + frac * (line[(tap + 1) & mask] - a);
+
+        const float y = data[i] + fb * delayed;
+        line[w] = y;
+        data[i] = y * (1.0f - fb);
+    }
+}
+
+//==============================================================================
+void VoiceFilter::processCrossfade (float* data, int channel, int numSamples, int fade) noexcept
+{
+    float z1 = s1[(size_t) channel];
+    float z2 = s2[(size_t) channel];
+
+    // Type changes are rare enough for this one to take the ramp per sample
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float gi  = g.at (i);
+        const float R2i = R2.at (i);
+        const float hi  = 1.0f / (1.0f + R2i * gi + gi * gi);
+
+        const float yHP = hi * (data[i] - z1 * (gi + R2i) - z2);
+        const float yBP = yHP * gi + z1;
+        z1 = yHP * gi + yBP;
+        const float yLP = yBP * gi + z2;
+        z2 = yBP * gi + yLP;
+
+        const float outputs[3] = { yLP, yHP, yBP };
+        float y = outputs[type];
+
+        if (fade > 0)
+        {
+            const float a = (float) fade / (float) fadeLength;
+            y += a * (outputs[fadeFromType] - y);
+            --fade;
+        }
+
+        data[i] = y;
+    }
+
+    s1[(size_t) channel] = z1;
+    s2[(size_t) channel] = z2;
+}
+
+void VoiceFilter::processModelCrossfade (float* data, int channel, int numSamples, int fade, bool ramping) noexcept
+{
+    jassert (numSamples <= (int) fadeScratch.size());
+
+    auto* from = fadeScratch.data();
+    std::copy (data, data + numSamples, from);
+
+    (this->*kernels[ramping ? 1 : 0][fadeFromType]) (from, channel, numSamples);
+    (this->*kernels[ramping ? 1 : 0][type]) (data, channel, numSamples);
+
+    for (int i = 0; i < numSamples && fade > 0; ++i, --fade)
+        data[i] += (float) fade / (float) fadeLength * (from[i] - data[i]);
+}
@@ -0,0 +1,122 @@
+#ifndef EFFEM_UNIT_VOICEFILTER_H
+#define EFFEM_UNIT_VOICEFILTER_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <vector>
+#include "ParameterRamp.h"
+#include "MemoryWarmup.h"
+
+//==============================================================================
+// The per-voice filter. Lowpass, highpass and bandpass are a TPT state
+// variable filter (same topology and coefficients as
+// juce::dsp::StateVariableTPTFilter) computing all three outputs together,
+// so a change between them crossfades on one state. The other models keep
+// state of their own:
+//
+//  - ladder:  4-pole zero-delay-feedback ladder, the feedback solved exactly
+//             and a fast tanh on the input to the stages
+//  - formant: three parallel bandpasses at vowel formants; the cutoff morphs
+//             through A-E-I-O-U, the resonance narrows the bands
+//  - comb:    feedback comb tuned to the cutoff frequency, the resonance
+//             setting the feedback
+//
+// Cutoff and resonance changes ramp the coefficients linearly across the
+// next block rather than stepping (tan() etc. only run when a control
+// changes). Anything derived from them, h for the state variable filter,
+// the ladder's feedback gain, follows per sample only in a ramping block;
+// a steady block runs kernels with those hoisted.
+class VoiceFilter
+{
+public:
+    enum Type
+    {
+        lowpass = 0,
+        highpass,
+        bandpass,
+        ladder,
+        formant,
+        comb,
+        numTypes
+    };
+
+    static constexpr float minCombHz = 40.0f;   // sizes the comb's delay lines
+
+    void prepare (double sampleRate, int samplesPerBlock, int numChannels);
+    void warmUp (MemoryWarmup& memory);
+
+    // Clears the state and jumps to the latest cutoff / resonance
+    void reset();
+    void finishRamps() noexcept;
+
+    void setCutoffFrequency (float hz);
+    void setResonance (float resonance);
+    void setType (int newType, int crossfadeSamples);
+
+    void process (juce::AudioBuffer<float>& buffer, int numSamples);
+
+private:
+    using Ramp = ParameterRamp<float>;
+    using Segment = Ramp::Segment;
+
+    void updateCoefficients() noexcept;
+
+    static bool isStateVariable (int t) noexcept   { return t <= bandpass; }
+    void clearState (int model) noexcept;
+
+    // One kernel per type and steady / ramping coefficients, with both picked
+    // at compile time. Chosen per block.
+    template <int responseType, bool ramping>
+    void processChannel (float* data, int channel, int numSamples) noexcept;
+
+    template <bool ramping>
+    void processLadder (float* data, int channel, int numSamples) noexcept;
+
+    template <bool ramping>
+    void processFormant (float* data, int channel, int numSamples) noexcept;
+
+    template <bool ramping>
+    void processComb (float* data, int channel, int numSamples) noexcept;
+
+    using Kernel = void (VoiceFilter::*) (float*, int, int) noexcept;
+    static const Kernel kernels[2][numTypes];
+
+    // Type changes: between state variable responses on the shared state,
+    // otherwise by running both models and blending
+    void processCrossfade (float* data, int channel, int numSamples, int fade) noexcept;
+    void processModelCrossfade (float* data, int channel, int numSamples, int fade, bool ramping) noexcept;
+
+    double sampleRate = 44100.0;
+    float cutoff = 1000.0f;
+    float resonance = 1.0f / juce::MathConstants<float>::sqrt2;
+
+    static constexpr int numFormants = 3;
+
+    Ramp gRamp, R2Ramp;
+    Ramp amountRamp;                                // resonance as 0..1, ladder feedback and comb
+    std::array<Ramp, numFormants> formantGRamps;
+    Ramp delayRamp;                                 // comb delay in samples
+
+    // This block's coefficients; h is only valid while they're steady
+    Segment g {}, R2 {}, amount {}, delay {};
+    std::array<Segment, numFormants> formantG {};
+    float h = 0.0f;
+
+    // State, per channel
+    std::vector<float> s1, s2;
+    std::vector<float> ladderState;     // 4 per channel
+    std::vector<float> formantState;    // 2 per formant per channel
+    std::vector<float> combLines;       // combSize per channel
+    int combSize = 0, combWrite = 0;
+
+    std::vector<float> fadeScratch;     // the outgoing model's output
+
+    int type = lowpass;
+    int fadeFromType = lowpass;
+    int fadeRemaining = 0;
+    int fadeLength = 0;
+};
+
+#endif //EFFEM_UNIT_VOICEFILTER_H
@@ -0,0 +1,135 @@
+#include "WaveTable.h"
+#include <juce_dsp/juce_dsp.h>
+
+//==============================================================================
+WaveTable::WaveTable (const std::function<float (float)>& function, int numPoints)
+{
+    jassert (numPoints >= 2);
+
+    const auto pi = juce::MathConstants<float>::pi;
+
+    std::vector<float> points ((size_t) numPoints);
+
+    for (int i = 0; i < numPoints; ++i)
+        points[(size_t) i] = function (juce::jmap ((float) i, 0.0f, (float) (numPoints - 1), -pi, pi));
+
+    for (int j = 0; j <= size; ++j)
+    {
+        const auto pos   = (double) j * (double) (numPoints - 1) / (double) size;
+        const auto index = juce::jmin ((int) pos, numPoints - 2);
+        const auto frac  = (float) (pos - (double) index);
+
+        samples[(size_t) j] = points[(size_t) index] + frac * (points[(size_t) index + 1] - points[(size_t) index]);
+    }
+}
+
+WaveTable::WaveTable (const float* cycle)
+{
+    std::copy (cycle, cycle + size, samples.begin());
+    samples[(size_t) size] = cycle[0];
+}
+
+//==============================================================================
+WaveTableSet::WaveTableSet (std::unique_ptr<WaveTable> table)
+{
+    tables.push_back (std::move (table));
+}
+
+WaveTableSet::WaveTableSet (const float* frames, int frameCount)
+    : numFrames (juce::jlimit (1, maxFrames, frameCount)),
+      numLevels (numMipLevels)
+{
+    constexpr int size = WaveTable::size;
+
+    juce::dsp::FFT fft (WaveTable::order);
+    std::vector<float> spectrum ((size_t) size * 2), work ((size_t) size * 2);
+
+    // [frame][level] cycles, band-limited but not yet normalised
+    std::vector<float> cycles ((size_t) (numFrames * numLevels * size));
+    float peak = 0.0f;
+
+    for (int f = 0; f < numFrames; ++f)
+    {
+        std::fill (spectrum.begin(), spectrum.end(), 0.0f);
+        std::copy (frames + f * size, frames + (f + 1) * size, spectrum.begin());
+        fft.performRealOnlyForwardTransform (spectrum.data(), true);
+
+        // No DC, no Nyquist
+        spectrum[0] = spectrum[1] = 0.0f;
+        spectrum[(size_t) size] = spectrum[(size_t) size + 1] = 0.0f;
+
+        for (int level = 0; level < numLevels; ++level)
+        {
+            const int harmonics = (size / 2) >> level;
+
+            std::copy (spectrum.begin(), spectrum.begin() + size + 2, work.begin());
+            std::fill (work.begin() + 2 * (harmonics + 1), work.begin() + size + 2, 0.0f);
+            fft.performRealOnlyInverseTransform (work.data());
+
+            auto* dst = cycles.data() + (size_t) ((f * numLevels + level) * size);
+            std::copy (work.begin(), work.begin() + size, dst);
+
+            if (level == 0)
+                peak = juce::jmax (peak, juce::FloatVectorOperations::findMaximum (dst, size),
+                                         -juce::FloatVectorOperations::findMinimum (dst, size));
+        }
+    }
+
+    const float scale = peak > 0.0f ? 1.0f / peak : 1.0f;
+    juce::FloatVectorOperations::multiply (cycles.data(), scale, (int) cycles.size());
+
+    tables.resize ((size_t) (numLevels * numFrames));
+
+    for (int level = 0; level < numLevels; ++level)
+        for (int f = 0; f < numFrames; ++f)
+            tables[(size_t) (level * numFrames + f)]
+                = std::make_unique<WaveTable> (cycles.data() + (size_t) ((f * numLevels + level) * size));
+}
+
+//==============================================================================
+WaveTableCache::WaveTableCache()
+{
+    const auto pi = juce::MathConstants<float>::pi;
+
+    auto make = [] (const std::function<float (float)>& function, int numPoints)
+    {
+        return std::make_unique<WaveTableSet> (std::make_unique<WaveTable> (function, numPoints));
+    };
+
+    tables[sine] = make ([] (float x) { return std::sin (x); }, 128);
+
+    tables[square] = make ([] (float x)
+    {
+        return (x < 0.0f ? -1.0f : 1.0f);
+    }, 2);
+
+    tables[saw] = make ([pi] (float x)
+    {
+        return juce::jmap (x, -pi, pi, -1.0f, 1.0f);
+    }, 128);
+
+    tables[triangle] = make ([pi] (float x)
+    {
+        return asinf (std::sin (x)) * (2.0f / pi);
+    }, 128);
+
+    tables[add1] = make ([] (float x)
+    {
+        return std::sin (x) + 0.3f * std::sin (2.0f * x);
+    }, 128);
+
+    tables[add2] = make ([] (float x)
+    {
+        return std::sin (x)
+               + 0.3f * std::sin (2.0f * x)
+               + 0.15f * std::sin (3.0f * x);
+    }, 128);
+}
+
+const WaveTableSet* WaveTableCache::get (int waveform) const noexcept
+{
+    if (! juce::isPositiveAndBelow (waveform, (int) numWaveforms) || waveform == user)
+        return tables[sine].get();
+
+    return tables[(size_t) waveform].get();
+}
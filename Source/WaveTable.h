@@ -0,0 +1,150 @@
+#ifndef EFFEM_UNIT_WAVETABLE_H
+#define EFFEM_UNIT_WAVETABLE_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+//==============================================================================
+// Single-cycle lookup table, read with a normalised phase in [0, 1).
+// Holds size + 1 points; the last one is the wrap-around guard.
+class WaveTable
+{
+public:
+    static constexpr int order = 11;
+    static constexpr int size  = 1 << order;
+
+    // Samples `function` over [-pi, pi] at `numPoints` points and linearly
+    // resamples that to `size`, which is exactly what juce::dsp::Oscillator's
+    // lookup table produced for the same generator.
+    WaveTable (const std::function<float (float)>& function, int numPoints);
+
+    // Copies one cycle of `size` samples
+    explicit WaveTable (const float* cycle);
+
+    const float* getData() const noexcept { return samples.data(); }
+
+    inline float lookup (double phase) const noexcept
+    {
+        const auto pos   = phase * (double) size;
+        const auto index = (int) pos;
+        const auto frac  = (float) (pos - (double) index);
+
+        return samples[(size_t) index] + frac * (samples[(size_t) index + 1] - samples[(size_t) index]);
+    }
+
+private:
+    std::array<float, size + 1> samples {};
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveTable)
+};
+
+//==============================================================================
+// One or more single-cycle frames, each stored at several band limits.
+//
+// Mip level n keeps the first (size / 2) >> n harmonics, so level 0 is the
+// full-bandwidth frame and every level above halves it. The oscillator picks
+// the level per block from its pitch and morphs between neighbouring frames
+// with a position in [0, 1]. Immutable once built.
+class WaveTableSet
+{
+public:
+    static constexpr int maxFrames    = 256;
+    static constexpr int numMipLevels = WaveTable::order;   // 1024 .. 1 harmonics
+
+    // A single table read as-is at every pitch (the built-in waveforms)
+    explicit WaveTableSet (std::unique_ptr<WaveTable> table);
+
+    // numFrames consecutive cycles of WaveTable::size samples. Runs an FFT per
+    // frame and level and normalises the result, so only call this off the
+    // audio thread.
+    WaveTableSet (const float* frames, int numFrames);
+
+    int getNumFrames() const noexcept   { return numFrames; }
+    int getNumLevels() const noexcept   { return numLevels; }
+
+    // Unique to this set for the life of the process, unlike its address,
+    // which a later set can be allocated at. Never 0.
+    juce::uint64 getId() const noexcept { return id; }
+
+    const WaveTable& getFrame (int level, int frame) const noexcept
+    {
+        return *tables[(size_t) (level * numFrames + frame)];
+    }
+
+    // Lowest level whose harmonics all stay below Nyquist at this phase increment
+    int getLevelFor (double increment) const noexcept
+    {
+        if (numLevels == 1 || increment <= 0.0)
+            return 0;
+
+        const auto level = (int) std::ceil (std::log2 (increment * (double) WaveTable::size));
+        return juce::jlimit (0, numLevels - 1, level);
+    }
+
+    inline float lookup (double phase, int level, float position) const noexcept
+    {
+        const auto* row = tables.data() + (size_t) (level * numFrames);
+
+        if (numFrames == 1)
+            return row[0]->lookup (phase);
+
+        const auto pos  = juce::jlimit (0.0f, 1.0f, position) * (float) (numFrames - 1);
+        const auto i0   = juce::jmin ((int) pos, numFrames - 2);
+        const auto frac = pos - (float) i0;
+
+        const auto a = row[i0]->lookup (phase);
+        return a + frac * (row[i0 + 1]->lookup (phase) - a);
+    }
+
+private:
+    static juce::uint64 nextId() noexcept
+    {
+        static std::atomic<juce::uint64> counter { 0 };
+        return ++counter;
+    }
+
+    const juce::uint64 id = nextId();
+    int numFrames = 1, numLevels = 1;
+    std::vector<std::unique_ptr<WaveTable>> tables;   // [level * numFrames + frame]
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveTableSet)
+};
+
+//==============================================================================
+// The built-in waveforms, built once and shared by every voice of every
+// instance (use through juce::SharedResourcePointer). Immutable after
+// construction, so the audio thread can read it without locks.
+class WaveTableCache
+{
+public:
+    enum Waveform
+    {
+        sine = 0,
+        square,
+        saw,
+        triangle,
+        noise,      // no table: generated per voice from a seeded random source
+        add1,
+        add2,
+        user,       // a file loaded through WaveTableLibrary; sine until there is one
+        numWaveforms
+    };
+
+    WaveTableCache();
+
+    // nullptr for noise
+    const WaveTableSet* get (int waveform) const noexcept;
+
+private:
+    std::array<std::unique_ptr<WaveTableSet>, numWaveforms> tables;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveTableCache)
+};
+
+#endif //EFFEM_UNIT_WAVETABLE_H
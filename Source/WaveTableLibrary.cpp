@@ -0,0 +1,156 @@
+#include "WaveTableLibrary.h"
+#include <cstring>
+
+//==============================================================================
+WaveTableLibrary::WaveTableLibrary()
+{
+    formats.registerBasicFormats();
+}
+
+juce::Result WaveTableLibrary::canLoad (const juce::File& file) const
+{
+    std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (file));
+
+    if (reader == nullptr)
+        return juce::Result::fail ("Not a supported audio file: " + file.getFileName());
+
+    if (reader->lengthInSamples < 2)
+        return juce::Result::fail ("The file is too short to hold a wave cycle");
+
+    return juce::Result::ok();
+}
+
+std::shared_ptr<const WaveTableSet> WaveTableLibrary::load (const juce::File& file)
+{
+    juce::MemoryBlock data;
+
+    if (! file.loadFileAsData (data))
+        return nullptr;
+
+    const auto key = hashContents (data);
+
+    {
+        const juce::ScopedLock sl (lock);
+
+        if (auto existing = loaded[key].lock())
+            return existing;
+    }
+
+    std::shared_ptr<const WaveTableSet> table = decode (data);
+
+    if (table == nullptr)
+        return nullptr;
+
+    const juce::ScopedLock sl (lock);
+
+    // Another thread may have built the same data meanwhile; keep the first
+    if (auto existing = loaded[key].lock())
+        return existing;
+
+    // Drop entries whose tables are gone
+    for (auto it = loaded.begin(); it != loaded.end();)
+        it = it->second.expired() ? loaded.erase (it) : std::next (it);
+
+    loaded[key] = table;
+    return table;
+}
+
+//==============================================================================
+// FNV-1a, 64 bit
+juce::uint64 WaveTableLibrary::hashContents (const juce::MemoryBlock& data) noexcept
+{
+    juce::uint64 hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < data.getSize(); ++i)
+    {
+        hash ^= (juce::uint8) data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// The frame size from a RIFF "clm " chunk, whose text starts "<!>" and the size
+int WaveTableLibrary::findFrameSize (const juce::MemoryBlock& data)
+{
+    const auto* bytes = static_cast<const char*> (data.getData());
+    const auto total = data.getSize();
+
+    if (total < 12 || std::memcmp (bytes, "RIFF", 4) != 0 || std::memcmp (bytes + 8, "WAVE", 4) != 0)
+        return 0;
+
+    for (size_t pos = 12; pos + 8 <= total;)
+    {
+        const auto chunkSize = (size_t) juce::ByteOrder::littleEndianInt (bytes + pos + 4);
+        const auto* body = bytes + pos + 8;
+        const auto available = juce::jmin (chunkSize, total - pos - 8);
+
+        if (std::memcmp (bytes + pos, "clm ", 4) == 0 && available > 3 && std::memcmp (body, "<!>", 3) == 0)
+            return juce::String (body + 3, available - 3).getIntValue();
+
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return 0;
+}
+
+// Linear interpolation around one cycle of `length` samples, wrapping at the end
+static void resampleCycle (const float* source, int length, float* dest)
+{
+    constexpr int size = WaveTable::size;
+
+    for (int i = 0; i < size; ++i)
+    {
+        const auto pos   = (double) i * (double) length / (double) size;
+        const auto index = (int) pos;
+        const auto frac  = (float) (pos - (double) index);
+        const auto next  = (index + 1) % length;
+
+        dest[i] = source[index] + frac * (source[next] - source[index]);
+    }
+}
+
+std::unique_ptr<WaveTableSet> WaveTableLibrary::decode (const juce::MemoryBlock& data) const
+{
+    constexpr int size = WaveTable::size;
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formats.createReaderFor (std::make_unique<juce::MemoryInputStream> (data, false)));
+
+    if (reader == nullptr || reader->lengthInSamples < 2)
+        return nullptr;
+
+    const auto marked = findFrameSize (data);
+    const int frameSize = juce::isPositiveAndBelow (marked - 2, 1 << 16) ? marked : size;
+    const int length = (int) juce::jmin (reader->lengthInSamples, (juce::int64) WaveTableSet::maxFrames * frameSize);
+
+    juce::AudioBuffer<float> buffer ((int) reader->numChannels, length);
+    reader->read (&buffer, 0, length, 0, true, true);
+
+    // Mix down to mono
+    for (int ch = 1; ch < buffer.getNumChannels(); ++ch)
+        buffer.addFrom (0, 0, buffer, ch, 0, length);
+
+    buffer.applyGain (0, 0, length, 1.0f / (float) buffer.getNumChannels());
+    const auto* mono = buffer.getReadPointer (0);
+
+    // Only a whole number of frames is sliced; anything else would cut a
+    // cycle short, so it is taken as one cycle
+    if (length % frameSize != 0)
+    {
+        std::vector<float> cycle ((size_t) size);
+        resampleCycle (mono, length, cycle.data());
+        return std::make_unique<WaveTableSet> (cycle.data(), 1);
+    }
+
+    const int numFrames = length / frameSize;
+
+    if (frameSize == size)
+        return std::make_unique<WaveTableSet> (mono, numFrames);
+
+    std::vector<float> frames ((size_t) (numFrames * size));
+
+    for (int f = 0; f < numFrames; ++f)
+        resampleCycle (mono + f * frameSize, frameSize, frames.data() + (size_t) (f * size));
+
+    return std::make_unique<WaveTableSet> (frames.data(), numFrames);
+}
@@ -0,0 +1,49 @@
+#ifndef EFFEM_UNIT_WAVETABLELIBRARY_H
+#define EFFEM_UNIT_WAVETABLELIBRARY_H
+
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include "WaveTable.h"
+#include <map>
+
+//==============================================================================
+// Turns WAV (or any basic format) files into band-limited WaveTableSets.
+//
+// The frame size comes from the WAV's "clm " chunk ("<!>2048 ...", as written
+// by Serum and most wavetable editors) if it has one, and is WaveTable::size
+// otherwise. A file holding a whole number of frames is a multi-frame table
+// (up to WaveTableSet::maxFrames), each frame resampled to WaveTable::size if
+// it is another length. Any other length is one cycle, resampled to a single
+// frame. Tables are keyed by a hash of the file's contents and only weakly
+// held, so every instance in the process that loads the same data shares one
+// copy for as long as any of them uses it.
+//
+// Use through juce::SharedResourcePointer.
+class WaveTableLibrary
+{
+public:
+    WaveTableLibrary();
+
+    // Cheap check of the file header for the message thread
+    juce::Result canLoad (const juce::File&) const;
+
+    // Decodes and builds (or finds) the table. Blocks for the FFTs, so only
+    // call this from a background thread. Returns nullptr on failure.
+    std::shared_ptr<const WaveTableSet> load (const juce::File&);
+
+private:
+    static juce::uint64 hashContents (const juce::MemoryBlock&) noexcept;
+    static int findFrameSize (const juce::MemoryBlock&);   // 0 if not marked
+    std::unique_ptr<WaveTableSet> decode (const juce::MemoryBlock&) const;
+
+    // Only creates readers after construction
+    mutable juce::AudioFormatManager formats;
+
+    juce::CriticalSection lock;
+    std::map<juce::uint64, std::weak_ptr<const WaveTableSet>> loaded;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WaveTableLibrary)
+};
+
+#endif //EFFEM_UNIT_WAVETABLELIBRARY_H
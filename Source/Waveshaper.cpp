@@ -0,0 +1,135 @@
+#include "Waveshaper.h"
+#include <cmath>
+
+//==============================================================================
+// The curves and their antiderivatives (F(0) = 0 for tanh and hard clip)
+namespace
+{
+    template <int shape> float curve (float x) noexcept;
+    template <int shape> float antiderivative (float x) noexcept;
+
+    template <> float curve<Waveshaper::tanhCurve> (float x) noexcept   { return std::tanh (x); }
+
+    // log (cosh x), written so it doesn't overflow for large |x|
+    template <> float antiderivative<Waveshaper::tanhCurve> (float x) noexcept
+    {
+        const float a = std::abs (x);
+        return a + std::log1p (std::exp (-2.0f * a)) - 0.69314718f;   // ln 2
+    }
+
+    template <> float curve<Waveshaper::hardClip> (float x) noexcept   { return juce::jlimit (-1.0f, 1.0f, x); }
+
+    template <> float antiderivative<Waveshaper::hardClip> (float x) noexcept
+    {
+        const float a = std::abs (x);
+        return a <= 1.0f ? 0.5f * x * x : a - 0.5f;
+    }
+
+    // Triangle fold: linear through [-1, 1], reflected at each boundary
+    // (period 4). Its antiderivative is periodic too, piecewise quadratic.
+    template <> float curve<Waveshaper::foldback> (float x) noexcept
+    {
+        const float u = x + 1.0f - 4.0f * std::floor ((x + 1.0f) * 0.25f);   // [0, 4)
+        return u < 2.0f ? u - 1.0f : 3.0f - u;
+    }
+
+    template <> float antiderivative<Waveshaper::foldback> (float x) noexcept
+    {
+        const float u = x + 1.0f - 4.0f * std::floor ((x + 1.0f) * 0.25f);
+        return u < 2.0f ? 0.5f * (u - 1.0f) * (u - 1.0f)
+                        : 1.0f - 0.5f * (3.0f - u) * (3.0f - u);
+    }
+}
+
+//==============================================================================
+const Waveshaper::Kernel Waveshaper::kernels[] =
+{
+    &Waveshaper::processShape<tanhCurve>,
+    &Waveshaper::processShape<hardClip>,
+    &Waveshaper::processShape<foldback>
+};
+
+void Waveshaper::setShape (int newShape) noexcept
+{
+    newShape = juce::jlimit (0, numShapes - 1, newShape);
+
+    if (newShape == shape)
+        return;
+
+    shape = newShape;
+
+    // Keep the ADAA history consistent with the new curve
+    switch (shape)
+    {
+        case hardClip: F1 = antiderivative<hardClip> (x1);  break;
+        case foldback: F1 = antiderivative<foldback> (x1);  break;
+        default:       F1 = antiderivative<tanhCurve> (x1); break;
+    }
+}
+
+void Waveshaper::setDrive (float amount) noexcept
+{
+    amount = juce::jlimit (0.0f, 1.0f, amount);
+    targetGain = 1.0f + amount * (maxGain - 1.0f);
+    targetWet = juce::jmin (1.0f, amount / fadeInDrive);
+}
+
+void Waveshaper::reset() noexcept
+{
+    gain = targetGain;
+    wet = targetWet;
+    x1 = 0.0f;
+    F1 = 0.0f;
+}
+
+void Waveshaper::process (float* data, int numSamples) noexcept
+{
+    (this->*kernels[shape]) (data, numSamples);
+}
+
+template <int shape>
+void Waveshaper::processShape (float* data, int numSamples) noexcept
+{
+    constexpr float minDelta = 1.0e-3f;   // below this the midpoint is as good, and F cancels badly
+
+    if (numSamples <= 0)
+        return;
+
+    // Coming back on: the history is from whenever the stage last ran, so
+    // start it from this block's first sample instead
+    if (wet <= 0.0f)
+    {
+        gain = targetGain;
+        x1 = data[0] * gain;
+        F1 = antiderivative<shape> (x1);
+    }
+
+    const float gainStep = (targetGain - gain) / (float) numSamples;
+    const float wetStep = (targetWet - wet) / (float) numSamples;
+    float g = gain, w = wet, xPrev = x1, FPrev = F1;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        g += gainStep;
+        w += wetStep;
+
+        const float x = data[i] * g;
+        const float F = antiderivative<shape> (x);
+        const float dx = x - xPrev;
+
+        // Both sides are computed so the choice is a select, not a branch
+        const float mean = (F - FPrev) / (std::abs (dx) < minDelta ? 1.0f : dx);
+        const float mid  = curve<shape> (0.5f * (x + xPrev));
+
+        const float shaped = std::abs (dx) < minDelta ? mid : mean;
+        data[i] += w * (shaped - data[i]);
+
+        xPrev = x;
+        FPrev = F;
+    }
+
+    gain = targetGain;
+    wet = targetWet;
+    x1 = xPrev;
+    F1 = FPrev;
+}
@@ -0,0 +1,61 @@
+#ifndef EFFEM_UNIT_WAVESHAPER_H
+#define EFFEM_UNIT_WAVESHAPER_H
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+//==============================================================================
+// Per-voice drive stage with first-order antiderivative anti-aliasing (ADAA).
+//
+// Instead of f(x[n]) each sample outputs the mean of f over the segment from
+// x[n-1] to x[n], (F(x[n]) - F(x[n-1])) / (x[n] - x[n-1]) with F the
+// antiderivative of f. That cancels most of the aliasing the curve would
+// create without oversampling, at the cost of half a sample of delay. Where
+// the segment is too short to divide by, f at its midpoint is used.
+//
+// No curve is the identity (even tanh at unity gain bends), so the shaped
+// signal is crossfaded in from the dry one over the first fadeInDrive of the
+// drive range: drive 0 is exactly the bypass, and turning the drive up from
+// there has no jump. While isActive() is false process() needn't be called;
+// the ADAA history is restarted when it next is.
+class Waveshaper
+{
+public:
+    enum Shape
+    {
+        tanhCurve = 0,
+        hardClip,
+        foldback,
+        numShapes
+    };
+
+    static constexpr float maxGain = 20.0f;   // +26 dB at full drive
+    static constexpr float fadeInDrive = 0.05f;
+
+    void setShape (int newShape) noexcept;
+    void setDrive (float amount) noexcept;    // 0..1
+    bool isActive() const noexcept   { return targetWet > 0.0f || wet > 0.0f; }
+
+    void reset() noexcept;
+
+    // In place, mono. The gain and the crossfade ramp across the block when
+    // the drive moved.
+    void process (float* data, int numSamples) noexcept;
+
+private:
+    template <int shape>
+    void processShape (float* data, int numSamples) noexcept;
+
+    using Kernel = void (Waveshaper::*) (float*, int) noexcept;
+    static const Kernel kernels[numShapes];
+
+    int shape = tanhCurve;
+    float gain = 1.0f, targetGain = 1.0f;
+    float wet = 0.0f, targetWet = 0.0f;     // shaped share of the output
+
+    // Previous driven input and its antiderivative
+    float x1 = 0.0f, F1 = 0.0f;
+};
+
+#endif //EFFEM_UNIT_WAVESHAPER_H
@@ -0,0 +1,227 @@
+#include "GoldenCompare.h"
+#include <juce_dsp/juce_dsp.h>
+#include <cstring>
+
+//==============================================================================
+bool GoldenTolerance::parse (const juce::String& text, GoldenTolerance& result)
+{
+    const auto mode = text.upToFirstOccurrenceOf (":", false, false).trim().toLowerCase();
+    const auto value = text.fromFirstOccurrenceOf (":", false, false).trim();
+
+    if (mode == "exact" && value.isEmpty())
+    {
+        result.mode = exact;
+        return true;
+    }
+
+    if (mode == "ulp" && value.containsOnly ("0123456789") && value.isNotEmpty())
+    {
+        result.mode = ulp;
+        result.maxUlps = value.getIntValue();
+        return true;
+    }
+
+    if (mode == "spectral" && value.getDoubleValue() > 0.0)
+    {
+        result.mode = spectral;
+        result.maxSpectralDb = value.getDoubleValue();
+        return true;
+    }
+
+    return false;
+}
+
+juce::String GoldenTolerance::describe() const
+{
+    switch (mode)
+    {
+        case ulp:      return "ulp:" + juce::String (maxUlps);
+        case spectral: return "spectral:" + juce::String (maxSpectralDb) + " dB";
+        case exact:
+        default:       break;
+    }
+
+    return "exact";
+}
+
+//==============================================================================
+namespace
+{
+    // Distance between two floats counted in representable values, across zero
+    juce::int64 ulpDistance (float a, float b) noexcept
+    {
+        auto ordered = [] (float f)
+        {
+            juce::int32 i;
+            std::memcpy (&i, &f, sizeof (i));
+            return i < 0 ? (juce::int64) std::numeric_limits<juce::int32>::min() - i : (juce::int64) i;
+        };
+
+        return std::abs (ordered (a) - ordered (b));
+    }
+
+    bool bitIdentical (float a, float b) noexcept
+    {
+        return std::memcmp (&a, &b, sizeof (float)) == 0;
+    }
+
+    // Mean over frames of the RMS difference of the dB magnitude spectra.
+    // Bins more than rangeDb below the frame's reference peak are clamped
+    // there, so noise-floor detail doesn't dominate.
+    double spectralDistance (const float* reference, const float* render, int numSamples)
+    {
+        constexpr int order = 11;
+        constexpr int size = 1 << order;
+        constexpr int hop = size / 2;
+        constexpr float rangeDb = 90.0f;
+
+        juce::dsp::FFT fft (order);
+        juce::dsp::WindowingFunction<float> window (size, juce::dsp::WindowingFunction<float>::hann, false);
+        std::vector<float> a ((size_t) size * 2), b ((size_t) size * 2);
+
+        double total = 0.0;
+        int frames = 0;
+
+        for (int start = 0; start + size <= numSamples; start += hop)
+        {
+            std::fill (a.begin(), a.end(), 0.0f);
+            std::fill (b.begin(), b.end(), 0.0f);
+            std::copy (reference + start, reference + start + size, a.begin());
+            std::copy (render + start, render + start + size, b.begin());
+
+            window.multiplyWithWindowingTable (a.data(), (size_t) size);
+            window.multiplyWithWindowingTable (b.data(), (size_t) size);
+            fft.performFrequencyOnlyForwardTransform (a.data(), true);
+            fft.performFrequencyOnlyForwardTransform (b.data(), true);
+
+            const float peak = *std::max_element (a.begin(), a.begin() + size / 2 + 1);
+
+            if (peak <= 0.0f)
+            {
+                // Silent reference frame: any energy in the render counts fully
+                if (*std::max_element (b.begin(), b.begin() + size / 2 + 1) > 0.0f)
+                    total += rangeDb;
+
+                ++frames;
+                continue;
+            }
+
+            const float floorDb = juce::Decibels::gainToDecibels (peak) - rangeDb;
+            double sum = 0.0;
+
+            for (int k = 0; k <= size / 2; ++k)
+            {
+                const auto da = juce::jmax (floorDb, juce::Decibels::gainToDecibels (a[(size_t) k], -1000.0f));
+                const auto db = juce::jmax (floorDb, juce::Decibels::gainToDecibels (b[(size_t) k], -1000.0f));
+                sum += (double) (da - db) * (double) (da - db);
+            }
+
+            total += std::sqrt (sum / (size / 2 + 1));
+            ++frames;
+        }
+
+        return frames > 0 ? total / frames : 0.0;
+    }
+}
+
+//==============================================================================
+GoldenComparison compareGolden (const juce::AudioBuffer<float>& reference,
+                                const juce::AudioBuffer<float>& render,
+                                const GoldenTolerance& tolerance)
+{
+    GoldenComparison result;
+
+    if (reference.getNumChannels() != render.getNumChannels()
+         || reference.getNumSamples() != render.getNumSamples())
+    {
+        result.failure = "shape differs: reference " + juce::String (reference.getNumChannels()) + " x "
+                       + juce::String (reference.getNumSamples()) + ", render "
+                       + juce::String (render.getNumChannels()) + " x " + juce::String (render.getNumSamples());
+        return result;
+    }
+
+    double diffEnergy = 0.0, refEnergy = 0.0;
+    bool withinUlps = true;
+
+    for (int ch = 0; ch < reference.getNumChannels(); ++ch)
+    {
+        const auto* r = reference.getReadPointer (ch);
+        const auto* x = render.getReadPointer (ch);
+
+        for (int i = 0; i < reference.getNumSamples(); ++i)
+        {
+            refEnergy += (double) r[i] * r[i];
+
+            if (bitIdentical (r[i], x[i]))
+                continue;
+
+            const float diff = std::abs (r[i] - x[i]);
+            diffEnergy += (double) diff * diff;
+
+            if (result.mismatchedSamples++ == 0)
+            {
+                result.firstMismatchChannel = ch;
+                result.firstMismatchSample = i;
+            }
+
+            if (! (diff <= result.maxAbsDiff))   // also catches NaN
+            {
+                result.maxAbsDiff = diff;
+                result.maxAbsDiffChannel = ch;
+                result.maxAbsDiffSample = i;
+            }
+
+            const auto ulps = ulpDistance (r[i], x[i]);
+            result.maxUlps = juce::jmax (result.maxUlps, ulps);
+
+            const bool nearZero = std::abs (r[i]) < tolerance.floorLevel && std::abs (x[i]) < tolerance.floorLevel;
+
+            if (nearZero ? ! (diff <= tolerance.floorLevel) : ulps > tolerance.maxUlps)
+                withinUlps = false;
+        }
+    }
+
+    if (diffEnergy > 0.0)
+        result.diffRmsDb = refEnergy > 0.0 ? 10.0 * std::log10 (diffEnergy / refEnergy) : 0.0;
+
+    // Only worth the FFTs when the samples differ at all
+    if (result.mismatchedSamples > 0)
+        for (int ch = 0; ch < reference.getNumChannels(); ++ch)
+            result.spectralDb = juce::jmax (result.spectralDb,
+                                            spectralDistance (reference.getReadPointer (ch),
+                                                              render.getReadPointer (ch),
+                                                              reference.getNumSamples()));
+
+    switch (tolerance.mode)
+    {
+        case GoldenTolerance::exact:    result.passed = result.mismatchedSamples == 0; break;
+        case GoldenTolerance::ulp:      result.passed = withinUlps; break;
+        case GoldenTolerance::spectral: result.passed = result.spectralDb <= tolerance.maxSpectralDb; break;
+    }
+
+    return result;
+}
+
+juce::String GoldenComparison::report (double sampleRate) const
+{
+    if (failure.isNotEmpty())
+        return "  " + failure + "\n";
+
+    if (mismatchedSamples == 0)
+        return "  bit-identical\n";
+
+    auto at = [sampleRate] (int ch, int sample)
+    {
+        return "ch " + juce::String (ch) + " sample " + juce::String (sample)
+             + " (" + juce::String ((double) sample / sampleRate, 4) + " s)";
+    };
+
+    juce::String s;
+    s << "  differing samples  " << mismatchedSamples << "\n"
+      << "  first difference   " << at (firstMismatchChannel, firstMismatchSample) << "\n"
+      << "  max |diff|         " << juce::String (maxAbsDiff, 9) << " at " << at (maxAbsDiffChannel, maxAbsDiffSample) << "\n"
+      << "  max ulps           " << maxUlps << "\n"
+      << "  diff rms           " << juce::String (diffRmsDb, 1) << " dB re reference\n"
+      << "  spectral distance  " << juce::String (spectralDb, 4) << " dB\n";
+    return s;
+}
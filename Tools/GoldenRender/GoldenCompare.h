@@ -0,0 +1,58 @@
+#ifndef EFFEM_GOLDENRENDER_GOLDENCOMPARE_H
+#define EFFEM_GOLDENRENDER_GOLDENCOMPARE_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+//==============================================================================
+// How close a render has to be to its reference.
+//
+//  - exact:    every sample bit-identical
+//  - ulp:      every sample within maxUlps units in the last place; samples
+//              where both sides are below floorLevel in magnitude only need to
+//              be within floorLevel of each other, since ULPs near zero are
+//              meaninglessly small
+//  - spectral: mean log-spectral distance over STFT frames at or below
+//              maxSpectralDb, for rewrites that may reorder arithmetic
+//              (different FMA contraction, another summation order)
+struct GoldenTolerance
+{
+    enum Mode { exact, ulp, spectral };
+
+    Mode mode = exact;
+    int maxUlps = 0;
+    float floorLevel = 1.0e-6f;     // -120 dBFS
+    double maxSpectralDb = 0.1;
+
+    // "exact", "ulp:<n>" or "spectral:<dB>"
+    static bool parse (const juce::String&, GoldenTolerance& result);
+    juce::String describe() const;
+};
+
+//==============================================================================
+struct GoldenComparison
+{
+    bool passed = false;
+    juce::String failure;           // shape mismatch etc., empty otherwise
+
+    juce::int64 mismatchedSamples = 0;
+    int firstMismatchChannel = -1;
+    int firstMismatchSample = -1;
+
+    float maxAbsDiff = 0.0f;
+    int maxAbsDiffChannel = -1;
+    int maxAbsDiffSample = -1;
+
+    juce::int64 maxUlps = 0;
+    double diffRmsDb = -200.0;      // RMS of the difference relative to the reference RMS
+    double spectralDb = 0.0;
+
+    juce::String report (double sampleRate) const;
+};
+
+GoldenComparison compareGolden (const juce::AudioBuffer<float>& reference,
+                                const juce::AudioBuffer<float>& render,
+                                const GoldenTolerance&);
+
+#endif //EFFEM_GOLDENRENDER_GOLDENCOMPARE_H
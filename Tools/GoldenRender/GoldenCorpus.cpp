@@ -0,0 +1,182 @@
+#include "GoldenCorpus.h"
+#include "PluginProcessor.h"
+
+//==============================================================================
+namespace
+{
+    void addNote (juce::MidiMessageSequence& seq, double start, double length, int note, float velocity)
+    {
+        seq.addEvent (juce::MidiMessage::noteOn (1, note, velocity), start);
+        seq.addEvent (juce::MidiMessage::noteOff (1, note), start + length);
+    }
+
+    juce::MidiMessageSequence chord (double start, double length, std::initializer_list<int> notes, float velocity)
+    {
+        juce::MidiMessageSequence seq;
+
+        for (auto n : notes)
+            addNote (seq, start, length, n, velocity);
+
+        return seq;
+    }
+
+    // Sixteenths at 120 BPM over a fixed pattern, velocities cycling
+    juce::MidiMessageSequence arpeggio (int numSteps, std::initializer_list<int> pattern)
+    {
+        juce::MidiMessageSequence seq;
+        const std::vector<int> notes (pattern);
+
+        for (int i = 0; i < numSteps; ++i)
+            addNote (seq, i * 0.125, 0.1, notes[(size_t) i % notes.size()], 0.5f + 0.125f * (float) (i % 4));
+
+        return seq;
+    }
+
+    // More overlapping notes than there are voices, so stealing is covered
+    juce::MidiMessageSequence cluster()
+    {
+        juce::MidiMessageSequence seq;
+
+        for (int i = 0; i < 24; ++i)
+            addNote (seq, i * 0.04, 1.0 - i * 0.02, 36 + (i * 7) % 48, 0.3f + 0.025f * (float) i);
+
+        return seq;
+    }
+
+    std::vector<GoldenCase> buildCorpus()
+    {
+        std::vector<GoldenCase> corpus;
+
+        auto add = [&corpus] (juce::String name, std::vector<GoldenCase::Param> params,
+                              juce::MidiMessageSequence midi, double lengthSeconds)
+        {
+            GoldenCase c;
+            c.name = std::move (name);
+            c.params = std::move (params);
+            c.midi = std::move (midi);
+            c.lengthSeconds = lengthSeconds;
+            corpus.push_back (std::move (c));
+            return &corpus.back();
+        };
+
+        add ("init_chord", {}, chord (0.1, 1.0, { 60, 64, 67 }, 0.8f), 2.0);
+
+        add ("saw_square_arp",
+             { { "osc1Wave", 2 }, { "osc2Wave", 1 }, { "osc2Pitch", 0 }, { "osc2Detune", 7.0f },
+               { "attack", 0.005f }, { "decay", 0.15f }, { "sustain", 0.4f }, { "release", 0.1f },
+               { "filterCutoff", 2500.0f }, { "filterResonance", 0.6f } },
+             arpeggio (24, { 48, 55, 60, 63, 67, 70 }), 3.5);
+
+        add ("noise_drive",
+             { { "osc1Wave", 4 }, { "osc2Wave", 3 }, { "drive", 0.7f }, { "driveType", 2 },
+               { "filterType", 2 }, { "filterCutoff", 1200.0f } },
+             arpeggio (12, { 36, 43 }), 2.0);
+
+        add ("wavetable_highpass",
+             { { "osc1Wave", 5 }, { "osc2Wave", 6 }, { "osc1WtPos", 0.3f }, { "osc2WtPos", 0.8f },
+               { "filterType", 1 }, { "filterCutoff", 300.0f }, { "oscBlend", 0.3f }, { "pan", -0.4f } },
+             chord (0.0, 1.5, { 57, 64, 69, 72 }, 0.7f), 2.0);
+
+        add ("voice_stealing",
+             { { "osc1Wave", 2 }, { "osc2On", 0 }, { "release", 0.4f } },
+             cluster(), 2.5);
+
+        add ("effects_rack",
+             { { "osc1Wave", 3 }, { "chorusOn", 1 }, { "chorusDepth", 0.7f },
+               { "delayOn", 1 }, { "delaySync", 2 }, { "delayFeedback", 0.5f },
+               { "reverbOn", 1 }, { "reverbSize", 0.8f }, { "reverbMix", 0.4f } },
+             arpeggio (8, { 60, 67, 72, 76 }), 4.0);
+
+        // Structural and continuous changes mid-note, on odd block boundaries
+        auto* automated = add ("automation_odd_blocks",
+                               { { "osc1Wave", 0 }, { "osc2Wave", 2 }, { "sustain", 0.8f } },
+                               chord (0.05, 2.0, { 50, 57 }, 0.9f), 2.5);
+        automated->blockSize = 97;
+        automated->automation = { { 0.4, "osc1Wave", 1 },
+                                  { 0.7, "filterCutoff", 800.0f },
+                                  { 1.0, "osc2Pitch", 4 },
+                                  { 1.3, "filterType", 2 },
+                                  { 1.6, "masterGain", 0.4f } };
+
+        auto* highRate = add ("high_rate", { { "osc1Wave", 2 }, { "osc2Wave", 2 }, { "osc2Detune", -12.0f } },
+                              chord (0.0, 0.8, { 84, 91 }, 1.0f), 1.2);
+        highRate->sampleRate = 96000.0;
+        highRate->blockSize = 256;
+
+        return corpus;
+    }
+
+    void setParameter (AudioPluginAudioProcessor& processor, const char* id, float value)
+    {
+        auto* param = processor.getState().getParameter (id);
+        jassert (param != nullptr);   // a case names a parameter that no longer exists
+
+        if (param != nullptr)
+            param->setValueNotifyingHost (param->convertTo0to1 (value));
+    }
+}
+
+//==============================================================================
+const std::vector<GoldenCase>& getGoldenCorpus()
+{
+    static const auto corpus = buildCorpus();
+    return corpus;
+}
+
+juce::AudioBuffer<float> renderGoldenCase (const GoldenCase& c)
+{
+    AudioPluginAudioProcessor processor;
+    processor.setNonRealtime (true);
+
+    for (const auto& p : c.params)
+        setParameter (processor, p.id, p.value);
+
+    const int numChannels = processor.getTotalNumOutputChannels();
+    const int totalSamples = juce::roundToInt (c.lengthSeconds * c.sampleRate);
+
+    processor.setRateAndBufferSizeDetails (c.sampleRate, c.blockSize);
+    processor.prepareToPlay (c.sampleRate, c.blockSize);
+
+    juce::AudioBuffer<float> output (numChannels, totalSamples);
+    juce::AudioBuffer<float> block (numChannels, c.blockSize);
+    juce::MidiBuffer midi;
+
+    int nextEvent = 0;
+    size_t nextAutomation = 0;
+
+    for (int pos = 0; pos < totalSamples; pos += c.blockSize)
+    {
+        const int n = juce::jmin (c.blockSize, totalSamples - pos);
+
+        // Automation lands on the first block boundary at or after its time
+        while (nextAutomation < c.automation.size()
+               && juce::roundToInt (c.automation[nextAutomation].seconds * c.sampleRate) <= pos)
+        {
+            const auto& a = c.automation[nextAutomation++];
+            setParameter (processor, a.id, a.value);
+        }
+
+        midi.clear();
+
+        while (nextEvent < c.midi.getNumEvents())
+        {
+            const auto& message = c.midi.getEventPointer (nextEvent)->message;
+            const int samplePos = juce::roundToInt (message.getTimeStamp() * c.sampleRate);
+
+            if (samplePos >= pos + n)
+                break;
+
+            midi.addEvent (message, juce::jmax (0, samplePos - pos));
+            ++nextEvent;
+        }
+
+        block.setSize (numChannels, n, false, false, true);
+        processor.processBlock (block, midi);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            output.copyFrom (ch, pos, block, ch, 0, n);
+    }
+
+    processor.releaseResources();
+    return output;
+}
@@ -0,0 +1,48 @@
+#ifndef EFFEM_GOLDENRENDER_GOLDENCORPUS_H
+#define EFFEM_GOLDENRENDER_GOLDENCORPUS_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+
+//==============================================================================
+// The fixed set of renders the golden references are made from. Each case is
+// a patch (parameter values in their own units, choices by index), a MIDI
+// sequence and optional automation, rendered offline at a fixed rate and
+// block size.
+//
+// Changing a case invalidates its reference: regenerate it with --update and
+// say why in the commit.
+struct GoldenCase
+{
+    struct Param
+    {
+        const char* id;
+        float value;
+    };
+
+    struct Automation
+    {
+        double seconds;
+        const char* id;
+        float value;
+    };
+
+    juce::String name;
+    std::vector<Param> params;
+    std::vector<Automation> automation;
+    juce::MidiMessageSequence midi;     // timestamps in seconds
+
+    double sampleRate = 48000.0;
+    int blockSize = 512;
+    double lengthSeconds = 2.0;
+};
+
+const std::vector<GoldenCase>& getGoldenCorpus();
+
+// Renders a case through a fresh AudioPluginAudioProcessor in non-realtime
+// mode. Safe to call for different cases on different threads.
+juce::AudioBuffer<float> renderGoldenCase (const GoldenCase&);
+
+#endif //EFFEM_GOLDENRENDER_GOLDENCORPUS_H
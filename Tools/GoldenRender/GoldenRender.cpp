@@ -0,0 +1,198 @@
+#include "GoldenCorpus.h"
+#include "GoldenCompare.h"
+#include "SimdKernels.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+#include <iostream>
+
+//==============================================================================
+// Renders the golden corpus through the plugin and compares each case with its
+// reference WAV (32-bit float, one per case). Exits non-zero if any case
+// fails, so it can gate a kernel rewrite:
+//
+//   EFFEM_GoldenRender --update                       write the references
+//   EFFEM_GoldenRender                                bit-exact check
+//   EFFEM_GoldenRender --tolerance ulp:4 --threads 8  looser check, in parallel
+//   EFFEM_FORCE_ISA=baseline EFFEM_GoldenRender       check another ISA variant
+//
+// Cases are rendered on --threads threads, each with its own processor, so
+// the same references also prove renders don't depend on the thread count.
+namespace
+{
+    constexpr auto usage =
+        "usage: EFFEM_GoldenRender [--update] [--refs <dir>] [--case <name>]\n"
+        "                          [--tolerance exact|ulp:<n>|spectral:<dB>]\n"
+        "                          [--threads <n>] [--report <dir>] [--list]\n";
+
+    bool writeWav (const juce::File& file, const juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        file.deleteFile();
+        std::unique_ptr<juce::OutputStream> stream = std::make_unique<juce::FileOutputStream> (file);
+
+        if (! static_cast<juce::FileOutputStream&> (*stream).openedOk())
+            return false;
+
+        auto writer = juce::WavAudioFormat().createWriterFor (stream, juce::AudioFormatWriterOptions{}
+                                                                          .withSampleRate (sampleRate)
+                                                                          .withNumChannels (buffer.getNumChannels())
+                                                                          .withBitsPerSample (32));
+
+        return writer != nullptr && writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+    }
+
+    bool readWav (const juce::File& file, juce::AudioBuffer<float>& buffer)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (file.createInputStream().release(), true));
+
+        if (reader == nullptr)
+            return false;
+
+        buffer.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
+        return reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true);
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    const auto& corpus = getGoldenCorpus();
+
+    if (args.containsOption ("--list"))
+    {
+        for (const auto& c : corpus)
+            std::cout << c.name << "\n";
+
+        return 0;
+    }
+
+    const bool update = args.containsOption ("--update");
+    const auto only = args.getValueForOption ("--case");
+    const int numThreads = juce::jmax (1, args.getValueForOption ("--threads").getIntValue());
+
+    auto refsDir = juce::File (EFFEM_GOLDEN_REFERENCE_DIR);
+
+    if (args.containsOption ("--refs"))
+        refsDir = args.getFileForOption ("--refs");
+
+    GoldenTolerance tolerance;
+
+    if (args.containsOption ("--tolerance")
+         && ! GoldenTolerance::parse (args.getValueForOption ("--tolerance"), tolerance))
+    {
+        std::cerr << "bad --tolerance\n" << usage;
+        return 2;
+    }
+
+    juce::File reportDir;
+
+    if (args.containsOption ("--report"))
+    {
+        reportDir = args.getFileForOption ("--report");
+        reportDir.createDirectory();
+    }
+
+    std::vector<const GoldenCase*> cases;
+
+    for (const auto& c : corpus)
+        if (only.isEmpty() || c.name == only)
+            cases.push_back (&c);
+
+    if (cases.empty())
+    {
+        std::cerr << "no case named " << only << " (see --list)\n";
+        return 2;
+    }
+
+    // ===== Render =====
+    std::vector<juce::AudioBuffer<float>> renders (cases.size());
+
+    {
+        juce::ThreadPool pool (numThreads);
+
+        for (size_t i = 0; i < cases.size(); ++i)
+            pool.addJob ([&renders, &cases, i] { renders[i] = renderGoldenCase (*cases[i]); });
+
+        while (pool.getNumJobs() > 0)
+            juce::Thread::sleep (10);
+    }
+
+    // ===== Update or compare =====
+    if (update)
+    {
+        refsDir.createDirectory();
+
+        for (size_t i = 0; i < cases.size(); ++i)
+        {
+            const auto file = refsDir.getChildFile (cases[i]->name + ".wav");
+
+            if (! writeWav (file, renders[i], cases[i]->sampleRate))
+            {
+                std::cerr << "couldn't write " << file.getFullPathName() << "\n";
+                return 1;
+            }
+
+            std::cout << "wrote " << file.getFullPathName() << "\n";
+        }
+
+        return 0;
+    }
+
+    juce::String report;
+    report << "kernels " << SimdKernels::resolve().name << ", threads " << numThreads
+           << ", tolerance " << tolerance.describe() << "\n\n";
+
+    int failures = 0;
+
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        const auto& c = *cases[i];
+        juce::AudioBuffer<float> reference;
+        GoldenComparison result;
+
+        if (readWav (refsDir.getChildFile (c.name + ".wav"), reference))
+            result = compareGolden (reference, renders[i], tolerance);
+        else
+            result.failure = "no reference (run with --update)";
+
+        report << (result.passed ? "PASS " : "FAIL ") << c.name << "\n" << result.report (c.sampleRate);
+
+        if (result.passed)
+            continue;
+
+        ++failures;
+
+        if (reportDir != juce::File())
+        {
+            writeWav (reportDir.getChildFile (c.name + ".render.wav"), renders[i], c.sampleRate);
+
+            if (result.failure.isEmpty())
+            {
+                juce::AudioBuffer<float> diff (renders[i]);
+
+                for (int ch = 0; ch < diff.getNumChannels(); ++ch)
+                    juce::FloatVectorOperations::subtract (diff.getWritePointer (ch), reference.getReadPointer (ch),
+                                                           diff.getNumSamples());
+
+                writeWav (reportDir.getChildFile (c.name + ".diff.wav"), diff, c.sampleRate);
+            }
+        }
+    }
+
+    report << "\n" << (int) cases.size() - failures << " of " << (int) cases.size() << " passed\n";
+    std::cout << report;
+
+    if (reportDir != juce::File())
+        reportDir.getChildFile ("report.txt").replaceWithText (report);
+
+    return failures > 0 ? 1 : 0;
+}
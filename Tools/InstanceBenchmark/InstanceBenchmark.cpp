@@ -0,0 +1,248 @@
+#include "AllocationCounter.h"
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+#include <juce_events/juce_events.h>
+#include <iostream>
+
+//==============================================================================
+// What a big session costs before any audio runs: instantiates the plugin
+// the way a host loading a session does (construct, restore state, prepare)
+// and then opens and closes each instance's editor. Every phase is timed per
+// instance and its heap use counted; all instances stay alive until the end,
+// so shared resources are only paid for by the first one.
+//
+//   EFFEM_InstanceBenchmark                      100 instances, every editor
+//   EFFEM_InstanceBenchmark --instances 60 --editors 5
+//   EFFEM_InstanceBenchmark --state session.bin  restore a saved state instead
+//
+// Bytes are what the phase left allocated on the main thread, malloc-backed
+// storage such as HeapBlock and AudioBuffer included (see AllocationCounter.h)
+// and allocator rounding too; threads an instance starts aren't counted. The
+// first instance is reported on its own since it builds everything shared.
+namespace
+{
+    constexpr auto usage =
+        "usage: EFFEM_InstanceBenchmark [--instances <n>] [--editors <n>] [--state <file>]\n"
+        "                               [--report <file>]\n";
+
+    struct Sample
+    {
+        double seconds = 0.0;
+        std::ptrdiff_t bytes = 0;
+    };
+
+    template <typename Fn>
+    Sample measure (Fn&& fn)
+    {
+        AllocationCounter::begin();
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        fn();
+
+        const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        return { seconds, AllocationCounter::end().netBytes };
+    }
+
+    juce::String kilobytes (double bytes)
+    {
+        return juce::String (bytes / 1024.0, 1);
+    }
+
+    // first, then mean / max of the rest
+    juce::String row (const juce::String& label, const std::vector<Sample>& samples)
+    {
+        juce::String s;
+        s << label.paddedRight (' ', 18);
+
+        if (samples.empty())
+            return s << "-\n";
+
+        double sum = 0.0, worst = 0.0, bytes = 0.0;
+
+        for (size_t i = 1; i < samples.size(); ++i)
+        {
+            sum += samples[i].seconds;
+            worst = juce::jmax (worst, samples[i].seconds);
+            bytes += (double) samples[i].bytes;
+        }
+
+        const auto rest = (double) juce::jmax ((size_t) 1, samples.size() - 1);
+
+        s << juce::String (samples[0].seconds * 1000.0, 2).paddedLeft (' ', 10)
+          << kilobytes ((double) samples[0].bytes).paddedLeft (' ', 12)
+          << juce::String (sum / rest * 1000.0, 2).paddedLeft (' ', 12)
+          << juce::String (worst * 1000.0, 2).paddedLeft (' ', 10)
+          << kilobytes (bytes / rest).paddedLeft (' ', 12) << "\n";
+
+        return s;
+    }
+
+    // The state a host saved: a preset applied if the bank has one, and a few
+    // parameters moved away from their defaults
+    juce::MemoryBlock makeReferenceState()
+    {
+        AudioPluginAudioProcessor reference;
+
+        if (reference.getNumPrograms() > 1)
+            reference.setCurrentProgram (1);
+
+        for (auto* id : { "filterCutoff", "attack", "reverbMix", "oscBlend" })
+            if (auto* p = reference.getState().getParameter (id))
+                p->setValueNotifyingHost (0.3f);
+
+        juce::MemoryBlock block;
+        reference.getStateInformation (block);
+        return block;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    const auto option = [&args] (const char* name, int fallback)
+    {
+        return args.containsOption (name) ? args.getValueForOption (name).getIntValue() : fallback;
+    };
+
+    const int numInstances = juce::jmax (1, option ("--instances", 100));
+    const int numEditors = juce::jlimit (0, numInstances, option ("--editors", numInstances));
+
+    juce::MemoryBlock savedState;
+
+    if (args.containsOption ("--state"))
+    {
+        if (! args.getFileForOption ("--state").loadFileAsData (savedState))
+        {
+            std::cerr << "can't read " << args.getValueForOption ("--state") << "\n";
+            return 2;
+        }
+    }
+    else
+    {
+        savedState = makeReferenceState();
+    }
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 512;
+
+    // ===== Session load =====
+    std::vector<std::unique_ptr<AudioPluginAudioProcessor>> instances;
+    std::vector<Sample> construct, restore, prepare;
+    instances.reserve ((size_t) numInstances);
+
+    for (int i = 0; i < numInstances; ++i)
+    {
+        construct.push_back (measure ([&instances]
+        {
+            instances.push_back (std::make_unique<AudioPluginAudioProcessor>());
+        }));
+
+        auto& processor = *instances.back();
+
+        restore.push_back (measure ([&processor, &savedState]
+        {
+            processor.setStateInformation (savedState.getData(), (int) savedState.getSize());
+        }));
+
+        prepare.push_back (measure ([&processor]
+        {
+            processor.setRateAndBufferSizeDetails (sampleRate, blockSize);
+            processor.prepareToPlay (sampleRate, blockSize);
+        }));
+    }
+
+    // ===== Editors, one open at a time =====
+    // open:     the constructor, which the host waits on for its window
+    // paint:    the first full paint
+    // effects:  showing the effects rack, which is built then
+    std::vector<Sample> open, paint, effects, close;
+
+    for (int i = 0; i < numEditors; ++i)
+    {
+        auto& processor = *instances[(size_t) i];
+        std::unique_ptr<juce::AudioProcessorEditor> editor;
+
+        open.push_back (measure ([&processor, &editor]
+        {
+            editor.reset (processor.createEditorIfNeeded());
+        }));
+
+        paint.push_back (measure ([&editor]
+        {
+            editor->createComponentSnapshot (editor->getLocalBounds());
+        }));
+
+        auto* effemEditor = dynamic_cast<AudioPluginAudioProcessorEditor*> (editor.get());
+
+        effects.push_back (measure ([effemEditor]
+        {
+            if (effemEditor != nullptr)
+                effemEditor->showEffects();
+        }));
+
+        close.push_back (measure ([&editor]
+        {
+            editor.reset();
+        }));
+    }
+
+    // ===== Teardown =====
+    const auto teardown = measure ([&instances]
+    {
+        for (auto& p : instances)
+            p->releaseResources();
+
+        instances.clear();
+    });
+
+    // ===== Report =====
+    juce::String report;
+    report << numInstances << " instances at " << (int) sampleRate << " Hz / " << blockSize << ", "
+           << numEditors << " editors opened, " << (int) savedState.getSize() << " byte state\n\n";
+
+    report << juce::String().paddedRight (' ', 18)
+           << juce::String ("first ms").paddedLeft (' ', 10) << juce::String ("first KB").paddedLeft (' ', 12)
+           << juce::String ("mean ms").paddedLeft (' ', 12) << juce::String ("max ms").paddedLeft (' ', 10)
+           << juce::String ("mean KB").paddedLeft (' ', 12) << "\n"
+           << row ("construct", construct)
+           << row ("restore state", restore)
+           << row ("prepare", prepare)
+           << row ("editor open", open)
+           << row ("editor paint", paint)
+           << row ("editor effects", effects)
+           << row ("editor close", close)
+           << "\n";
+
+    double instanceSeconds = 0.0, instanceBytes = 0.0;
+
+    for (size_t i = 0; i < construct.size(); ++i)
+    {
+        instanceSeconds += construct[i].seconds + restore[i].seconds + prepare[i].seconds;
+        instanceBytes += (double) (construct[i].bytes + restore[i].bytes + prepare[i].bytes);
+    }
+
+    report << "per instance: " << juce::String (instanceSeconds / numInstances * 1000.0, 2) << " ms, "
+           << kilobytes (instanceBytes / numInstances) << " KB resident\n"
+           << "whole session: " << juce::String (instanceSeconds * 1000.0, 1) << " ms, "
+           << kilobytes (instanceBytes) << " KB; teardown " << juce::String (teardown.seconds * 1000.0, 1) << " ms\n";
+
+    if (! AllocationCounter::coversMalloc())
+        report << "(operator new / delete only: malloc isn't hooked on this build, so HeapBlock and\n"
+                  " AudioBuffer storage are missing from the KB columns)\n";
+
+    std::cout << report;
+
+    if (args.containsOption ("--report"))
+        args.getFileForOption ("--report").replaceWithText (report);
+
+    return 0;
+}
@@ -0,0 +1,203 @@
+#include "SimdKernels.h"
+#include <juce_core/juce_core.h>
+#include <iostream>
+#include <vector>
+
+//==============================================================================
+// Runs every SimdKernels variant this binary has and this CPU can run on the
+// same inputs, and checks each against the baseline within a tolerance. The
+// variants are the same loops built with different flags, none of which lets
+// the compiler contract or reassociate, so in practice they agree to the bit;
+// the tolerance only keeps a report about real drift rather than rounding.
+//
+//   EFFEM_KernelCheck               every kernel, every supported variant
+//   EFFEM_KernelCheck --seed 7
+//
+// Exits non-zero if a variant differs. Variants the CPU can't run are listed
+// as skipped, so a pass on a machine without AVX-512 says nothing about it.
+namespace
+{
+    constexpr auto usage = "usage: EFFEM_KernelCheck [--seed <n>]\n";
+
+    // Odd lengths leave a scalar tail after the vector body
+    constexpr int lengths[] = { 1, 3, 8, 15, 64, 255, 1027 };
+
+    constexpr float absoluteTolerance = 1.0e-5f;
+    constexpr float relativeTolerance = 1.0e-5f;
+
+    struct Inputs
+    {
+        std::vector<float> a, b, table;
+
+        explicit Inputs (juce::int64 seed)
+        {
+            juce::Random random (seed);
+
+            for (auto* v : { &a, &b })
+            {
+                v->resize ((size_t) lengths[std::size (lengths) - 1]);
+
+                for (auto& x : *v)
+                    x = random.nextFloat() * 2.0f - 1.0f;
+
+                // Straddle the mix's bleed threshold
+                for (size_t i = 0; i < v->size(); i += 17)
+                    (*v)[i] = (random.nextBool() ? 1.0f : -1.0f) * 1.0e-6f * (0.5f + random.nextFloat());
+            }
+
+            constexpr int tableSize = 2048;
+            table.resize (tableSize + 1);
+
+            for (int i = 0; i < tableSize; ++i)
+                table[(size_t) i] = std::sin (juce::MathConstants<float>::twoPi * (float) i / (float) tableSize)
+                                      + 0.1f * (random.nextFloat() - 0.5f);
+
+            table[tableSize] = table[0];
+        }
+
+        int tableSize() const noexcept   { return (int) table.size() - 1; }
+    };
+
+    class Check
+    {
+    public:
+        explicit Check (const char* variantName) : variant (variantName) {}
+
+        void compare (const juce::String& what, const std::vector<float>& expected, const std::vector<float>& actual)
+        {
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                const auto error = std::abs (expected[i] - actual[i]);
+
+                if (error > absoluteTolerance + relativeTolerance * std::abs (expected[i]))
+                {
+                    fail (what + " differs at " + juce::String ((int) i) + ": "
+                            + juce::String (expected[i], 9) + " vs " + juce::String (actual[i], 9));
+                    return;
+                }
+            }
+        }
+
+        void compare (const juce::String& what, double expected, double actual)
+        {
+            if (std::abs (expected - actual) > 1.0e-9)
+                fail (what + " differs: " + juce::String (expected, 12) + " vs " + juce::String (actual, 12));
+        }
+
+        int getFailures() const noexcept   { return failures; }
+
+    private:
+        void fail (const juce::String& message)
+        {
+            std::cout << "  " << variant << ": " << message << "\n";
+            ++failures;
+        }
+
+        const char* variant;
+        int failures = 0;
+    };
+
+    void checkVariant (const SimdKernels& reference, const SimdKernels& k, const Inputs& in, Check& check)
+    {
+        for (auto n : lengths)
+        {
+            const auto size = (size_t) n;
+            const auto suffix = " (" + juce::String (n) + " samples)";
+
+            for (int on1 = 0; on1 < 2; ++on1)
+            {
+                for (int on2 = 0; on2 < 2; ++on2)
+                {
+                    for (auto blendStep : { 0.0f, 0.4f / (float) n })
+                    {
+                        std::vector<float> expected (size), actual (size);
+                        reference.mix[on1][on2] (expected.data(), in.a.data(), in.b.data(), 0.3f, blendStep, 0.8f, n);
+                        k.mix[on1][on2] (actual.data(), in.a.data(), in.b.data(), 0.3f, blendStep, 0.8f, n);
+
+                        check.compare ("mix[" + juce::String (on1) + "][" + juce::String (on2) + "]"
+                                         + (blendStep != 0.0f ? " ramped" : "") + suffix, expected, actual);
+                    }
+                }
+            }
+
+            // A fast glide too: the phase is computed per sample in closed
+            // form, and a large step is where that would drift first
+            for (auto incrementStep : { 0.0, 1.0e-7, 2.0e-4 })
+            {
+                std::vector<float> expected (size), actual (size);
+                double expectedPhase = 0.123, actualPhase = 0.123;
+
+                reference.readTable (in.table.data(), in.tableSize(), expectedPhase, 0.0137, incrementStep,
+                                     0.7f, -0.1f / (float) n, expected.data(), n);
+                k.readTable (in.table.data(), in.tableSize(), actualPhase, 0.0137, incrementStep,
+                             0.7f, -0.1f / (float) n, actual.data(), n);
+
+                const auto label = juce::String ("readTable")
+                                     + (incrementStep > 1.0e-6 ? " fast glide" : incrementStep != 0.0 ? " gliding" : "") + suffix;
+                check.compare (label, expected, actual);
+                check.compare (label + " phase", expectedPhase, actualPhase);
+            }
+
+            {
+                auto expected = in.a, actual = in.a;
+                expected.resize (size);
+                actual.resize (size);
+
+                reference.add (expected.data(), in.b.data(), n);
+                k.add (actual.data(), in.b.data(), n);
+                check.compare ("add" + suffix, expected, actual);
+
+                reference.applyGain (expected.data(), 0.61f, n);
+                k.applyGain (actual.data(), 0.61f, n);
+                check.compare ("applyGain" + suffix, expected, actual);
+
+                reference.applyGainRamp (expected.data(), 1.0f, -0.9f / (float) n, n);
+                k.applyGainRamp (actual.data(), 1.0f, -0.9f / (float) n, n);
+                check.compare ("applyGainRamp" + suffix, expected, actual);
+            }
+        }
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    const auto seed = args.containsOption ("--seed") ? args.getValueForOption ("--seed").getLargeIntValue() : 1;
+    const Inputs inputs (seed);
+
+    const auto& reference = *SimdKernels::forIsa (SimdKernels::baseline);
+    int failures = 0;
+
+    for (int i = SimdKernels::baseline + 1; i < SimdKernels::numIsas; ++i)
+    {
+        const auto isa = (SimdKernels::Isa) i;
+        auto* kernels = SimdKernels::forIsa (isa);
+
+        if (kernels == nullptr)
+            continue;
+
+        if (! SimdKernels::isSupported (isa))
+        {
+            std::cout << kernels->name << ": skipped, this CPU can't run it\n";
+            continue;
+        }
+
+        Check check (kernels->name);
+        checkVariant (reference, *kernels, inputs, check);
+
+        std::cout << kernels->name << ": " << (check.getFailures() == 0 ? "matches" : "DIFFERS from")
+                  << " " << reference.name << "\n";
+
+        failures += check.getFailures();
+    }
+
+    return failures > 0 ? 1 : 0;
+}
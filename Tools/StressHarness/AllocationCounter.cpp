@@ -0,0 +1,447 @@
+#include "AllocationCounter.h"
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined (_MSC_VER)
+ #include <malloc.h>
+ #include <crtdbg.h>
+#elif defined (__APPLE__)
+ #include <malloc/malloc.h>
+ #include <mach/mach.h>
+#else
+ #include <malloc.h>
+#endif
+
+//==============================================================================
+// Where the counting happens:
+//
+//  - glibc:        malloc, calloc, realloc, free and the aligned forms are
+//                  defined here and forward to glibc's __libc_* entry points.
+//                  Definitions in the executable take precedence over libc's
+//                  for every module in the process, JUCE's HeapBlock and
+//                  libstdc++ included.
+//  - macOS:        the default malloc zone's functions are swapped for
+//                  counting ones at static initialisation.
+//  - MSVC, debug:  a CRT allocation hook.
+//
+// operator new / delete go through malloc / free, so they are counted once,
+// at that level. Anywhere else (an MSVC release build) only operator new /
+// delete are counted, and coversMalloc() says so.
+namespace
+{
+    thread_local bool counting = false;
+    thread_local AllocationCounter::Counts counts;
+
+    void recordAllocation (std::size_t requested, std::size_t usable) noexcept
+    {
+        if (! counting)
+            return;
+
+        ++counts.allocations;
+        counts.bytes += requested;
+        counts.netBytes += (std::ptrdiff_t) usable;
+    }
+
+    void recordFree (std::size_t usable) noexcept
+    {
+        if (! counting)
+            return;
+
+        ++counts.frees;
+        counts.netBytes -= (std::ptrdiff_t) usable;
+    }
+
+    constexpr auto defaultAlignment = alignof (std::max_align_t);
+}
+
+//==============================================================================
+#if defined (__GLIBC__)
+
+constexpr bool mallocIsCounted = true;
+
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void* __libc_valloc (size_t);
+    void* __libc_pvalloc (size_t);
+    void  __libc_free (void*);
+
+    void* malloc (size_t size) noexcept
+    {
+        auto* p = __libc_malloc (size);
+
+        if (p != nullptr)
+            recordAllocation (size, malloc_usable_size (p));
+
+        return p;
+    }
+
+    void* calloc (size_t n, size_t size) noexcept
+    {
+        auto* p = __libc_calloc (n, size);
+
+        if (p != nullptr)
+            recordAllocation (n * size, malloc_usable_size (p));
+
+        return p;
+    }
+
+    // Counted as a free and a new block, since that is what the caller risks
+    void* realloc (void* old, size_t size) noexcept
+    {
+        const auto oldSize = old != nullptr ? malloc_usable_size (old) : 0;
+        auto* p = __libc_realloc (old, size);
+
+        if (p == nullptr && size > 0)
+            return p;   // failed, the old block is untouched
+
+        if (old != nullptr)
+            recordFree (oldSize);
+
+        if (p != nullptr)
+            recordAllocation (size, malloc_usable_size (p));
+
+        return p;
+    }
+
+    void free (void* p) noexcept
+    {
+        if (p == nullptr)
+            return;
+
+        recordFree (malloc_usable_size (p));
+        __libc_free (p);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept
+    {
+        auto* p = __libc_memalign (alignment, size);
+
+        if (p != nullptr)
+            recordAllocation (size, malloc_usable_size (p));
+
+        return p;
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept
+    {
+        return memalign (alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+    {
+        if (alignment % sizeof (void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        auto* p = memalign (alignment, size);
+
+        if (p == nullptr)
+            return ENOMEM;
+
+        *result = p;
+        return 0;
+    }
+
+    void* valloc (size_t size) noexcept
+    {
+        auto* p = __libc_valloc (size);
+
+        if (p != nullptr)
+            recordAllocation (size, malloc_usable_size (p));
+
+        return p;
+    }
+
+    void* pvalloc (size_t size) noexcept
+    {
+        auto* p = __libc_pvalloc (size);
+
+        if (p != nullptr)
+            recordAllocation (size, malloc_usable_size (p));
+
+        return p;
+    }
+}
+
+//==============================================================================
+#elif defined (__APPLE__)
+
+constexpr bool mallocIsCounted = true;
+
+namespace
+{
+    malloc_zone_t original;
+
+    void* zoneMalloc (malloc_zone_t* zone, size_t size)
+    {
+        auto* p = original.malloc (zone, size);
+
+        if (p != nullptr)
+            recordAllocation (size, original.size (zone, p));
+
+        return p;
+    }
+
+    void* zoneCalloc (malloc_zone_t* zone, size_t n, size_t size)
+    {
+        auto* p = original.calloc (zone, n, size);
+
+        if (p != nullptr)
+            recordAllocation (n * size, original.size (zone, p));
+
+        return p;
+    }
+
+    void* zoneValloc (malloc_zone_t* zone, size_t size)
+    {
+        auto* p = original.valloc (zone, size);
+
+        if (p != nullptr)
+            recordAllocation (size, original.size (zone, p));
+
+        return p;
+    }
+
+    void* zoneMemalign (malloc_zone_t* zone, size_t alignment, size_t size)
+    {
+        auto* p = original.memalign (zone, alignment, size);
+
+        if (p != nullptr)
+            recordAllocation (size, original.size (zone, p));
+
+        return p;
+    }
+
+    void* zoneRealloc (malloc_zone_t* zone, void* old, size_t size)
+    {
+        const auto oldSize = old != nullptr ? original.size (zone, old) : 0;
+        auto* p = original.realloc (zone, old, size);
+
+        if (p == nullptr && size > 0)
+            return p;
+
+        if (old != nullptr)
+            recordFree (oldSize);
+
+        if (p != nullptr)
+            recordAllocation (size, original.size (zone, p));
+
+        return p;
+    }
+
+    void zoneFree (malloc_zone_t* zone, void* p)
+    {
+        if (p != nullptr)
+            recordFree (original.size (zone, p));
+
+        original.free (zone, p);
+    }
+
+    void zoneFreeDefiniteSize (malloc_zone_t* zone, void* p, size_t size)
+    {
+        if (p != nullptr)
+            recordFree (original.size (zone, p));
+
+        original.free_definite_size (zone, p, size);
+    }
+
+    // Installed before main(), so nothing allocated by the default zone is
+    // freed through a different set of functions
+    struct ZoneHook
+    {
+        ZoneHook()
+        {
+            auto* zone = malloc_default_zone();
+            original = *zone;
+
+            // The default zone is read-only since 10.7
+            const auto address = (vm_address_t) zone;
+            vm_protect (mach_task_self(), address, sizeof (malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE);
+
+            zone->malloc  = zoneMalloc;
+            zone->calloc  = zoneCalloc;
+            zone->valloc  = zoneValloc;
+            zone->realloc = zoneRealloc;
+            zone->free    = zoneFree;
+
+            if (zone->version >= 5 && original.memalign != nullptr)
+                zone->memalign = zoneMemalign;
+
+            if (zone->version >= 6 && original.free_definite_size != nullptr)
+                zone->free_definite_size = zoneFreeDefiniteSize;
+
+            vm_protect (mach_task_self(), address, sizeof (malloc_zone_t), 0, VM_PROT_READ);
+        }
+    };
+
+    const ZoneHook zoneHook;
+}
+
+//==============================================================================
+#elif defined (_MSC_VER) && defined (_DEBUG)
+
+constexpr bool mallocIsCounted = true;
+
+namespace
+{
+    int allocHook (int type, void* userData, size_t size, int blockType, long, const unsigned char*, int)
+    {
+        // The CRT's own bookkeeping blocks aren't the caller's
+        if (blockType == _CRT_BLOCK)
+            return TRUE;
+
+        switch (type)
+        {
+            case _HOOK_ALLOC:
+                recordAllocation (size, size);
+                break;
+
+            case _HOOK_REALLOC:
+                if (userData != nullptr)
+                    recordFree (_msize_dbg (userData, blockType));
+
+                recordAllocation (size, size);
+                break;
+
+            case _HOOK_FREE:
+                if (userData != nullptr)
+                    recordFree (_msize_dbg (userData, blockType));
+                break;
+
+            default:
+                break;
+        }
+
+        return TRUE;
+    }
+
+    struct CrtHook
+    {
+        CrtHook()   { _CrtSetAllocHook (allocHook); }
+    };
+
+    const CrtHook crtHook;
+}
+
+//==============================================================================
+#else
+
+constexpr bool mallocIsCounted = false;
+
+#endif
+
+//==============================================================================
+namespace
+{
+    std::size_t usableSize (void* p, std::size_t alignment) noexcept
+    {
+       #if defined (_MSC_VER)
+        return alignment > defaultAlignment ? _aligned_msize (p, alignment, 0) : _msize (p);
+       #elif defined (__APPLE__)
+        (void) alignment;
+        return malloc_size (p);
+       #else
+        (void) alignment;
+        return malloc_usable_size (p);
+       #endif
+    }
+
+    void* allocate (std::size_t size, std::size_t alignment) noexcept
+    {
+        if (size == 0)
+            size = 1;
+
+        void* p = nullptr;
+
+        if (alignment <= defaultAlignment)
+            p = std::malloc (size);
+        else
+           #if defined (_MSC_VER)
+            p = _aligned_malloc (size, alignment);
+           #else
+            // aligned_alloc wants the size to be a multiple of the alignment
+            p = std::aligned_alloc (alignment, (size + alignment - 1) / alignment * alignment);
+           #endif
+
+        if (! mallocIsCounted && p != nullptr)
+            recordAllocation (size, usableSize (p, alignment));
+
+        return p;
+    }
+
+    void release (void* p, std::size_t alignment) noexcept
+    {
+        if (p == nullptr)
+            return;
+
+        if (! mallocIsCounted)
+            recordFree (usableSize (p, alignment));
+
+       #if defined (_MSC_VER)
+        if (alignment > defaultAlignment)
+        {
+            _aligned_free (p);
+            return;
+        }
+       #else
+        (void) alignment;
+       #endif
+
+        std::free (p);
+    }
+
+    void* allocateOrThrow (std::size_t size, std::size_t alignment)
+    {
+        if (auto* p = allocate (size, alignment))
+            return p;
+
+        throw std::bad_alloc();
+    }
+}
+
+void AllocationCounter::begin() noexcept
+{
+    counts = {};
+    counting = true;
+}
+
+AllocationCounter::Counts AllocationCounter::end() noexcept
+{
+    counting = false;
+    return counts;
+}
+
+bool AllocationCounter::coversMalloc() noexcept
+{
+    return mallocIsCounted;
+}
+
+//==============================================================================
+// Every global form, routed through the functions above
+void* operator new   (std::size_t size)                                 { return allocateOrThrow (size, defaultAlignment); }
+void* operator new[] (std::size_t size)                                 { return allocateOrThrow (size, defaultAlignment); }
+void* operator new   (std::size_t size, const std::nothrow_t&) noexcept { return allocate (size, defaultAlignment); }
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept { return allocate (size, defaultAlignment); }
+
+void* operator new   (std::size_t size, std::align_val_t a)             { return allocateOrThrow (size, (std::size_t) a); }
+void* operator new[] (std::size_t size, std::align_val_t a)             { return allocateOrThrow (size, (std::size_t) a); }
+void* operator new   (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate (size, (std::size_t) a); }
+void* operator new[] (std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept { return allocate (size, (std::size_t) a); }
+
+void operator delete   (void* p) noexcept                               { release (p, defaultAlignment); }
+void operator delete[] (void* p) noexcept                               { release (p, defaultAlignment); }
+void operator delete   (void* p, std::size_t) noexcept                  { release (p, defaultAlignment); }
+void operator delete[] (void* p, std::size_t) noexcept                  { release (p, defaultAlignment); }
+void operator delete   (void* p, const std::nothrow_t&) noexcept        { release (p, defaultAlignment); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept        { release (p, defaultAlignment); }
+
+void operator delete   (void* p, std::align_val_t a) noexcept              { release (p, (std::size_t) a); }
+void operator delete[] (void* p, std::align_val_t a) noexcept              { release (p, (std::size_t) a); }
+void operator delete   (void* p, std::size_t, std::align_val_t a) noexcept { release (p, (std::size_t) a); }
+void operator delete[] (void* p, std::size_t, std::align_val_t a) noexcept { release (p, (std::size_t) a); }
+void operator delete   (void* p, std::align_val_t a, const std::nothrow_t&) noexcept { release (p, (std::size_t) a); }
+void operator delete[] (void* p, std::align_val_t a, const std::nothrow_t&) noexcept { release (p, (std::size_t) a); }
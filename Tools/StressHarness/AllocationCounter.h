@@ -0,0 +1,40 @@
+#ifndef EFFEM_STRESSHARNESS_ALLOCATIONCOUNTER_H
+#define EFFEM_STRESSHARNESS_ALLOCATIONCOUNTER_H
+
+#pragma once
+
+#include <cstddef>
+
+//==============================================================================
+// Counts heap traffic on the calling thread between begin() and end().
+//
+// The tools that link it interpose malloc, free and friends as well as the
+// global operator new / delete (see the .cpp), so this sees allocations made
+// anywhere below the measured call: HeapBlock and AudioBuffer storage, the
+// standard library and our own code alike. Where the platform gives no way in
+// to malloc, only operator new / delete are counted and coversMalloc() returns
+// false. Other threads (the engine state builder, the recorder's writer) are
+// not counted.
+namespace AllocationCounter
+{
+    struct Counts
+    {
+        int allocations = 0;
+        int frees = 0;
+        size_t bytes = 0;           // as requested
+
+        // Usable size of the blocks allocated minus those freed, which is what
+        // the window left resident. Includes allocator rounding.
+        std::ptrdiff_t netBytes = 0;
+
+        bool any() const noexcept   { return allocations > 0 || frees > 0; }
+    };
+
+    void begin() noexcept;
+    Counts end() noexcept;
+
+    // False where malloc-family allocations can't be seen
+    bool coversMalloc() noexcept;
+}
+
+#endif //EFFEM_STRESSHARNESS_ALLOCATIONCOUNTER_H
@@ -0,0 +1,341 @@
+#include "StressScenarios.h"
+#include "AllocationCounter.h"
+#include "PluginProcessor.h"
+#include <juce_events/juce_events.h>
+#include <iostream>
+
+//==============================================================================
+// Drives the processor through worst-case callbacks rather than average ones:
+// adversarial block sizes, sample-rate and layout changes mid-session, MIDI
+// floods and parameter storms (see StressScenarios.h). Every callback is
+// timed and its heap traffic counted; the report gives the time distribution
+// and every callback over the deadline with the input that caused it.
+//
+//   EFFEM_StressHarness                                   everything, 20000 callbacks
+//   EFFEM_StressHarness --scenario midi_flood --flood 1000
+//   EFFEM_StressHarness --deadline 50% --fail-on-alloc    half the block's real time
+//   EFFEM_StressHarness --seed 7 --callbacks 1235         rerun up to a flagged callback
+//
+// Exits non-zero if a callback missed the deadline (or, with --fail-on-alloc,
+// touched the heap). Timings are wall clock on whatever else the machine is
+// doing, so compare runs on a quiet machine.
+namespace
+{
+    constexpr auto usage =
+        "usage: EFFEM_StressHarness [--scenario <name>] [--callbacks <n>] [--seed <n>]\n"
+        "                           [--deadline <ms>|<percent>%] [--flood <events>]\n"
+        "                           [--multitimbral] [--fail-on-alloc] [--max-flagged <n>]\n"
+        "                           [--report <file>] [--list]\n";
+
+    // Either a fixed time or a share of the block's real-time duration
+    struct Deadline
+    {
+        double milliseconds = 2.0;
+        double proportion = 0.0;     // used instead when > 0
+
+        static bool parse (const juce::String& text, Deadline& result)
+        {
+            const auto t = text.trim();
+            const auto value = t.trimCharactersAtEnd ("%ms").getDoubleValue();
+
+            if (value <= 0.0)
+                return false;
+
+            result = {};
+
+            if (t.endsWithChar ('%'))
+                result.proportion = value / 100.0;
+            else
+                result.milliseconds = value;
+
+            return true;
+        }
+
+        double getSeconds (int numSamples, double sampleRate) const
+        {
+            if (proportion > 0.0)
+                return proportion * juce::jmax (1, numSamples) / sampleRate;
+
+            return milliseconds / 1000.0;
+        }
+
+        juce::String describe() const
+        {
+            return proportion > 0.0 ? juce::String (proportion * 100.0) + "% of the block"
+                                    : juce::String (milliseconds) + " ms";
+        }
+    };
+
+    struct Callback
+    {
+        int index = 0;
+        double seconds = 0.0, deadline = 0.0;
+
+        StressConfig config;
+        int numSamples = 0, previousSamples = 0;
+        int midiEvents = 0, parameters = 0;
+        bool afterPrepare = false;
+        AllocationCounter::Counts heap;
+
+        juce::String describe() const
+        {
+            juce::String s;
+            s << "#" << index << "  " << juce::String (seconds * 1000.0, 3) << " ms"
+              << " (deadline " << juce::String (deadline * 1000.0, 3) << "): "
+              << numSamples << " samples after " << previousSamples << ", " << config.describe()
+              << ", " << midiEvents << " MIDI, " << parameters << " parameters";
+
+            if (afterPrepare)
+                s << ", first after prepare";
+
+            if (heap.any())
+                s << ", " << heap.allocations << " allocations (" << (int) heap.bytes << " bytes), "
+                  << heap.frees << " frees";
+
+            return s;
+        }
+    };
+
+    double percentile (const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.0;
+
+        const auto index = (size_t) juce::jlimit (0.0, (double) sorted.size() - 1.0, std::ceil (p * (double) sorted.size()) - 1.0);
+        return sorted[index];
+    }
+
+    juce::String distribution (const juce::String& label, std::vector<double> seconds)
+    {
+        juce::String s;
+        s << label.paddedRight (' ', 22) << juce::String ((int) seconds.size()).paddedLeft (' ', 7);
+
+        if (seconds.empty())
+            return s << "\n";
+
+        std::sort (seconds.begin(), seconds.end());
+
+        for (auto p : { 0.5, 0.99, 0.999, 1.0 })
+            s << juce::String (percentile (seconds, p) * 1.0e6, 1).paddedLeft (' ', 11);
+
+        return s << "\n";
+    }
+
+    // What a host does around a sample-rate, block-size or layout change
+    bool prepare (AudioPluginAudioProcessor& processor, const StressConfig& config, bool first)
+    {
+        if (! first)
+            processor.releaseResources();
+
+        auto layout = processor.getBusesLayout();
+        const auto set = config.layout == StressConfig::mono ? juce::AudioChannelSet::mono()
+                                                             : juce::AudioChannelSet::stereo();
+
+        for (int i = 0; i < layout.outputBuses.size(); ++i)
+            layout.outputBuses.getReference (i) = i == 0 || config.layout == StressConfig::stereoWithParts
+                                                      ? set : juce::AudioChannelSet::disabled();
+
+        if (! processor.setBusesLayout (layout))
+            return false;
+
+        processor.setRateAndBufferSizeDetails (config.sampleRate, config.maxBlockSize);
+        processor.prepareToPlay (config.sampleRate, config.maxBlockSize);
+        return true;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << usage;
+        return 0;
+    }
+
+    if (args.containsOption ("--list"))
+    {
+        for (const auto& s : getStressScenarios())
+            std::cout << juce::String (s.name).paddedRight (' ', 18) << s.description << "\n";
+
+        return 0;
+    }
+
+    const auto scenarioName = args.containsOption ("--scenario") ? args.getValueForOption ("--scenario")
+                                                                 : juce::String ("everything");
+    const auto* scenario = findStressScenario (scenarioName);
+
+    if (scenario == nullptr)
+    {
+        std::cerr << "no scenario named " << scenarioName << " (see --list)\n";
+        return 2;
+    }
+
+    const auto option = [&args] (const char* name, int fallback)
+    {
+        return args.containsOption (name) ? args.getValueForOption (name).getIntValue() : fallback;
+    };
+
+    const int numCallbacks = juce::jmax (1, option ("--callbacks", 20000));
+    const int seed = option ("--seed", 1);
+    const int floodEvents = juce::jmax (1, option ("--flood", 500));
+    const int maxFlagged = juce::jmax (0, option ("--max-flagged", 20));
+    const bool failOnAllocation = args.containsOption ("--fail-on-alloc");
+
+    Deadline deadline;
+
+    if (args.containsOption ("--deadline")
+         && ! Deadline::parse (args.getValueForOption ("--deadline"), deadline))
+    {
+        std::cerr << "bad --deadline\n" << usage;
+        return 2;
+    }
+
+    // ===== Run =====
+    AudioPluginAudioProcessor processor;
+    processor.setNonRealtime (false);
+
+    // Every part on its own channel and output bus, so floods reach them all
+    if (args.containsOption ("--multitimbral"))
+    {
+        processor.setMultitimbral (true);
+
+        for (int part = 1; part < EngineState::maxParts; ++part)
+        {
+            processor.setPartEnabled (part, true);
+            processor.setPartChannel (part, part + 1);
+            processor.setPartOwnOutput (part, true);
+        }
+    }
+
+    const auto& parameters = processor.getParameters();
+    StressGenerator generator (*scenario, seed, parameters.size(), floodEvents);
+
+    std::vector<double> all, afterPrepare, floods, storms, tiny;
+    std::vector<Callback> overDeadline, allocating;
+    all.reserve ((size_t) numCallbacks);
+
+    double slowestPrepare = 0.0;
+    int numPrepares = 0, previousSamples = 0;
+
+    StressStep step;
+    juce::AudioBuffer<float> buffer;
+    juce::MidiBuffer midi;
+    bool prepared = false;
+
+    for (int i = 0; i < numCallbacks; ++i)
+    {
+        generator.next (step);
+
+        if (! prepared || step.reconfigure)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+
+            if (! prepare (processor, step.config, ! prepared))
+            {
+                std::cerr << "layout refused: " << step.config.describe() << "\n";
+                return 1;
+            }
+
+            slowestPrepare = juce::jmax (slowestPrepare, juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start));
+            ++numPrepares;
+
+            buffer.setSize (processor.getTotalNumOutputChannels(), step.config.maxBlockSize);
+        }
+
+        // Everything the host owns is set up outside the timed region
+        buffer.setSize (processor.getTotalNumOutputChannels(), step.numSamples, false, false, true);
+        midi = step.midi;
+
+        AllocationCounter::begin();
+        const auto start = juce::Time::getHighResolutionTicks();
+
+        for (const auto& [index, value] : step.parameters)
+            parameters[index]->setValueNotifyingHost (value);
+
+        processor.processBlock (buffer, midi);
+
+        const auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - start);
+        const auto heap = AllocationCounter::end();
+
+        Callback c;
+        c.index = i;
+        c.seconds = seconds;
+        c.deadline = deadline.getSeconds (step.numSamples, step.config.sampleRate);
+        c.config = step.config;
+        c.numSamples = step.numSamples;
+        c.previousSamples = previousSamples;
+        c.midiEvents = step.midi.getNumEvents();
+        c.parameters = (int) step.parameters.size();
+        c.afterPrepare = ! prepared || step.reconfigure;
+        c.heap = heap;
+
+        all.push_back (seconds);
+        if (c.afterPrepare)              afterPrepare.push_back (seconds);
+        if (c.midiEvents >= floodEvents) floods.push_back (seconds);
+        if (c.parameters > 1)            storms.push_back (seconds);
+        if (c.numSamples <= 16)          tiny.push_back (seconds);
+
+        if (seconds > c.deadline)
+            overDeadline.push_back (c);
+
+        if (heap.any())
+            allocating.push_back (c);
+
+        prepared = true;
+        previousSamples = step.numSamples;
+    }
+
+    processor.releaseResources();
+
+    // ===== Report =====
+    juce::String report;
+    report << "scenario " << scenario->name << ", seed " << seed << ", " << numCallbacks << " callbacks, "
+           << "deadline " << deadline.describe() << "\n"
+           << numPrepares << " prepares, slowest " << juce::String (slowestPrepare * 1000.0, 2) << " ms\n\n";
+
+    report << juce::String ("callback time (us)").paddedRight (' ', 22) << juce::String ("count").paddedLeft (' ', 7)
+           << "        p50        p99      p99.9        max\n"
+           << distribution ("all", all)
+           << distribution ("first after prepare", afterPrepare)
+           << distribution ("MIDI flood", floods)
+           << distribution ("parameter storm", storms)
+           << distribution ("16 samples or fewer", tiny)
+           << "\n";
+
+    const auto listWorst = [&report, maxFlagged] (std::vector<Callback> callbacks, const char* heading)
+    {
+        report << heading << ": " << (int) callbacks.size() << "\n";
+
+        std::sort (callbacks.begin(), callbacks.end(), [] (const Callback& a, const Callback& b)
+        {
+            return a.seconds - a.deadline > b.seconds - b.deadline;
+        });
+
+        for (size_t i = 0; i < callbacks.size() && (int) i < maxFlagged; ++i)
+            report << "  " << callbacks[i].describe() << "\n";
+
+        if ((int) callbacks.size() > maxFlagged)
+            report << "  ... " << (int) callbacks.size() - maxFlagged << " more\n";
+    };
+
+    listWorst (overDeadline, "over deadline");
+    listWorst (allocating, "touched the heap");
+
+    if (! AllocationCounter::coversMalloc())
+        report << "  (operator new / delete only: malloc isn't hooked on this build)\n";
+
+    if (! overDeadline.empty())
+        report << "\nrerun one with --scenario " << scenario->name << " --seed " << seed
+               << " --callbacks <index + 1>\n";
+
+    std::cout << report;
+
+    if (args.containsOption ("--report"))
+        args.getFileForOption ("--report").replaceWithText (report);
+
+    return ! overDeadline.empty() || (failOnAllocation && ! allocating.empty()) ? 1 : 0;
+}
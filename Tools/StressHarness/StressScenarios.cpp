@@ -0,0 +1,177 @@
+#include "StressScenarios.h"
+
+//==============================================================================
+namespace
+{
+    constexpr double sampleRates[] = { 22050.0, 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+    constexpr int maxBlockSizes[]  = { 16, 32, 64, 128, 256, 441, 512, 1024, 2048, 4096, 8192 };
+
+    // Odd sizes hosts really send (prime, or a remainder after a loop point)
+    constexpr int awkwardSizes[]   = { 3, 7, 13, 61, 97, 127, 251, 509, 1021 };
+
+    template <typename T, size_t n>
+    T pick (juce::Random& random, const T (&values)[n])
+    {
+        return values[(size_t) random.nextInt ((int) n)];
+    }
+}
+
+juce::String StressConfig::describe() const
+{
+    static const char* const layoutNames[] = { "mono", "stereo", "stereo + parts" };
+
+    return juce::String (sampleRate, 0) + " Hz, max " + juce::String (maxBlockSize)
+         + ", " + layoutNames[layout];
+}
+
+//==============================================================================
+const std::vector<StressScenario>& getStressScenarios()
+{
+    using Blocks = StressScenario::Blocks;
+
+    static const std::vector<StressScenario> scenarios
+    {
+        { "steady",          "the prepared block size every time, a few notes (the baseline)",
+          Blocks::fixed,       0.0f,  false, 0.0f,  0.0f },
+
+        { "variable_blocks", "random block sizes up to the prepared maximum",
+          Blocks::random,      0.0f,  false, 0.0f,  0.0f },
+
+        { "big_then_tiny",   "a maximum-size block, then a handful of samples, repeated",
+          Blocks::bigThenTiny, 0.0f,  false, 0.0f,  0.0f },
+
+        { "adversarial",     "block sizes hosts get wrong: 0, 1, primes, max - 1, sudden swings",
+          Blocks::adversarial, 0.0f,  false, 0.0f,  0.0f },
+
+        { "rate_changes",    "prepareToPlay with a new sample rate and block size mid-session",
+          Blocks::random,      0.02f, false, 0.0f,  0.0f },
+
+        { "layout_changes",  "output layout changes (mono, stereo, part buses) with re-prepares",
+          Blocks::random,      0.02f, true,  0.0f,  0.0f },
+
+        { "midi_flood",      "every block carries a MIDI flood across all channels",
+          Blocks::random,      0.0f,  false, 1.0f,  0.0f },
+
+        { "parameter_storm", "every parameter changes before every block",
+          Blocks::random,      0.0f,  false, 0.0f,  1.0f },
+
+        { "everything",      "all of the above, mixed",
+          Blocks::adversarial, 0.01f, true,  0.1f,  0.1f }
+    };
+
+    return scenarios;
+}
+
+const StressScenario* findStressScenario (const juce::String& name)
+{
+    for (const auto& s : getStressScenarios())
+        if (name == s.name)
+            return &s;
+
+    return nullptr;
+}
+
+//==============================================================================
+StressGenerator::StressGenerator (const StressScenario& s, juce::int64 seed, int numParams, int numFloodEvents)
+    : scenario (s), random (seed), numParameters (numParams), floodEvents (numFloodEvents)
+{
+}
+
+void StressGenerator::next (StressStep& step)
+{
+    step.reconfigure = callbackIndex > 0 && random.nextFloat() < scenario.reconfigureChance;
+
+    if (step.reconfigure)
+        reconfigure();
+
+    step.config = config;
+    step.numSamples = nextBlockSize();
+
+    step.midi.clear();
+    const bool flood = random.nextFloat() < scenario.floodChance;
+    addNotes (step.midi, step.numSamples, flood ? floodEvents : random.nextInt (4), flood);
+
+    step.parameters.clear();
+
+    if (random.nextFloat() < scenario.stormChance)
+    {
+        for (int i = 0; i < numParameters; ++i)
+            step.parameters.emplace_back (i, random.nextFloat());
+    }
+    else if (numParameters > 0 && random.nextInt (8) == 0)
+    {
+        // The odd automated parameter, as in an ordinary session
+        step.parameters.emplace_back (random.nextInt (numParameters), random.nextFloat());
+    }
+
+    ++callbackIndex;
+}
+
+int StressGenerator::nextBlockSize()
+{
+    const int max = config.maxBlockSize;
+
+    switch (scenario.blocks)
+    {
+        case StressScenario::Blocks::fixed:
+            return max;
+
+        case StressScenario::Blocks::random:
+            return 1 + random.nextInt (max);
+
+        case StressScenario::Blocks::bigThenTiny:
+            bigBlockNext = ! bigBlockNext;
+            return ! bigBlockNext ? max : juce::jmin (max, 1 + random.nextInt (16));
+
+        case StressScenario::Blocks::adversarial:
+            break;
+    }
+
+    switch (random.nextInt (8))
+    {
+        case 0:  return max;
+        case 1:  return 1;
+        case 2:  return random.nextInt (16) == 0 ? 0 : 2;
+        case 3:  return juce::jmin (max, pick (random, awkwardSizes));
+        case 4:  return juce::jmax (1, max - 1);
+        case 5:  return juce::jmax (1, max / 2 + 1);
+        default: return 1 + random.nextInt (max);
+    }
+}
+
+void StressGenerator::addNotes (juce::MidiBuffer& midi, int numSamples, int numEvents, bool flood)
+{
+    if (numSamples <= 0)
+        return;
+
+    for (int i = 0; i < numEvents; ++i)
+    {
+        const int pos = random.nextInt (numSamples);
+
+        // Floods use every channel, so multitimbral parts get their share;
+        // otherwise it's a player on channel 1
+        const int channel = flood ? 1 + random.nextInt (16) : 1;
+        const int note = flood ? random.nextInt (128) : 36 + random.nextInt (48);
+        const int kind = random.nextInt (flood ? 20 : 2);
+
+        if (kind < (flood ? 8 : 1))
+            midi.addEvent (juce::MidiMessage::noteOn (channel, note, (juce::uint8) (1 + random.nextInt (127))), pos);
+        else if (kind < 14 || ! flood)
+            midi.addEvent (juce::MidiMessage::noteOff (channel, note), pos);
+        else if (kind < 17)
+            midi.addEvent (juce::MidiMessage::controllerEvent (channel, random.nextInt (120), random.nextInt (128)), pos);
+        else if (kind < 19)
+            midi.addEvent (juce::MidiMessage::pitchWheel (channel, random.nextInt (16384)), pos);
+        else
+            midi.addEvent (juce::MidiMessage::allNotesOff (channel), pos);
+    }
+}
+
+void StressGenerator::reconfigure()
+{
+    config.sampleRate = pick (random, sampleRates);
+    config.maxBlockSize = pick (random, maxBlockSizes);
+
+    if (scenario.changeLayouts)
+        config.layout = (StressConfig::Layout) random.nextInt ((int) StressConfig::numLayouts);
+}
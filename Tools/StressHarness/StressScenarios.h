@@ -0,0 +1,97 @@
+#ifndef EFFEM_STRESSHARNESS_STRESSSCENARIOS_H
+#define EFFEM_STRESSHARNESS_STRESSSCENARIOS_H
+
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <vector>
+
+//==============================================================================
+// What the stress tool does to the processor, one callback at a time.
+//
+// A scenario sets the odds; StressGenerator turns a scenario and a seed into
+// a sequence of steps. The sequence only depends on those two (and the
+// parameter count), so a flagged callback is reproduced by rerunning with
+// the same seed for as many callbacks as its index.
+
+// The host setup a run of callbacks is prepared for
+struct StressConfig
+{
+    enum Layout
+    {
+        mono = 0,
+        stereo,
+        stereoWithParts,    // main plus every part output, all stereo
+        numLayouts
+    };
+
+    double sampleRate = 48000.0;
+    int maxBlockSize = 512;
+    Layout layout = stereo;
+
+    juce::String describe() const;
+};
+
+// One callback, and the reconfiguration before it if there is one
+struct StressStep
+{
+    bool reconfigure = false;       // releaseResources, layout, prepareToPlay
+    StressConfig config;
+
+    int numSamples = 0;
+    juce::MidiBuffer midi;
+
+    // Set on the audio thread just before processBlock, as a VST3 host does
+    std::vector<std::pair<int, float>> parameters;  // index, normalised value
+};
+
+//==============================================================================
+struct StressScenario
+{
+    enum class Blocks
+    {
+        fixed,              // always the prepared maximum
+        random,             // uniform in [1, max]
+        bigThenTiny,        // the maximum, then a handful of samples
+        adversarial         // max, 1, 0, primes, max - 1, random, mixed
+    };
+
+    const char* name;
+    const char* description;
+
+    Blocks blocks;
+    float reconfigureChance;        // per callback
+    bool changeLayouts;             // reconfigurations may change the buses too
+    float floodChance;              // a MIDI flood instead of the usual few notes
+    float stormChance;              // every parameter changed at once
+};
+
+const std::vector<StressScenario>& getStressScenarios();
+const StressScenario* findStressScenario (const juce::String& name);
+
+//==============================================================================
+class StressGenerator
+{
+public:
+    StressGenerator (const StressScenario&, juce::int64 seed, int numParameters, int floodEvents);
+
+    // The setup the first callback runs with
+    const StressConfig& getConfig() const noexcept   { return config; }
+
+    void next (StressStep&);
+
+private:
+    int nextBlockSize();
+    void addNotes (juce::MidiBuffer&, int numSamples, int numEvents, bool flood);
+    void reconfigure();
+
+    const StressScenario& scenario;
+    juce::Random random;
+    StressConfig config;
+
+    const int numParameters, floodEvents;
+    int callbackIndex = 0;
+    bool bigBlockNext = true;
+};
+
+#endif //EFFEM_STRESSHARNESS_STRESSSCENARIOS_H